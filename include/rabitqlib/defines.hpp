@@ -1,7 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <limits>
 
+// Translation units of the library are compiled with different SIMD flags, from which Eigen
+// derives its alignment. Pin the alignment so that inline Eigen code from any of them
+// allocates, frees and lays out objects in the same way.
+#ifndef EIGEN_MAX_ALIGN_BYTES
+#define EIGEN_MAX_ALIGN_BYTES 64
+#endif
+#ifndef EIGEN_MAX_STATIC_ALIGN_BYTES
+#define EIGEN_MAX_STATIC_ALIGN_BYTES 64
+#endif
+
 #include "rabitqlib/third/Eigen/Dense"
 
 #define BIT_ID(x) (__builtin_popcount((x) - 1))
@@ -64,4 +76,28 @@ struct AnnCandidate {
 
 enum MetricType : std::uint8_t { METRIC_L2, METRIC_IP };
 enum ScalarQuantizerType : std::uint8_t { RECONSTRUCTION, UNBIASED_ESTIMATION, PLAIN };
+
+// how score_ids() computes the distance of given candidates
+// SCORE_ONE_BIT:   estimate by the 1-bit code only
+// SCORE_FULL_BITS: estimate by all bits (1-bit code + ex code)
+// SCORE_EXACT:     compute exact distance by raw vectors
+enum ScoreMode : std::uint8_t { SCORE_ONE_BIT, SCORE_FULL_BITS, SCORE_EXACT };
+
+// estimated distance of a result and its error bounds, the bounds are est_dist -/+
+// f_error * g_error, where f_error is the error factor of the 1-bit code or of the total
+// code for full bits, exact distances have equal bounds
+struct DistBound {
+    float est_dist = 0;
+    float low_dist = 0;
+    float up_dist = 0;
+    bool exact = false;  // computed by raw vectors, i.e., exactly refined
+};
+
+// progress of index construction, called with the num of processed vectors and the num of
+// all vectors, always by the thread which calls the construction
+using ProgressFunc = std::function<void(size_t done, size_t total)>;
+
+// the next chunk of consecutive data rows for construction, sets rows (num * dim) and
+// returns num, 0 after the last chunk. rows stay valid until the next call
+using ChunkFunc = std::function<size_t(const float*& rows)>;
 }  // namespace rabitqlib
\ No newline at end of file
@@ -58,14 +58,32 @@ static inline void get_column(
 /**
  * @brief Pack quantization codes, store in blocks, the data orgnization is illustrated in
  * the link and kPerm0. Since we pack codes as 32-sized groups, if the num is not a multiple
- * of 32, we have to use some space for these absent data
+ * of 32, we have to use some space for these absent data. Dispatched to AVX2/AVX-512
+ * kernels, which transpose 16x16 bytes by unpack instructions.
  *
- * @param padded_dim dimension of quantized data (i.e., quantization code)
+ * @param padded_dim dimension of quantized data (i.e., quantization code), multiple of 64
  * @param quantization_code quantizaiton code, stored as uint8
  * @param num   number of quantization code
  * @param blocks packed quantization code
  */
-inline void pack_codes(
+void pack_codes(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+);
+
+/**
+ * @brief Inverse of pack_codes(), get the quantization codes of num vectors from blocks
+ *
+ * @param padded_dim dimension of quantized data (i.e., quantization code), multiple of 64
+ * @param blocks packed quantization code
+ * @param num   number of quantization code
+ * @param quantization_code quantizaiton code (num * padded_dim / 8), stored as uint8
+ */
+void unpack_codes(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+);
+
+// scalar reference of pack_codes()
+inline void pack_codes_scalar(
     size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
 ) {
     size_t num_rd = (num + 31) & ~31;  // round up num of vecs to multiple of batch size(32)
@@ -104,6 +122,86 @@ inline void pack_codes(
     }
 }
 
+// scalar reference of unpack_codes()
+inline void unpack_codes_scalar(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+) {
+    size_t cols = padded_dim / 8;
+    for (size_t row = 0; row < num; row += kBatchSize) {
+        for (size_t i = 0; i < cols; ++i) {
+            for (size_t j = 0; j < 16; ++j) {
+                // vector kPerm0[j] in lower 4 bits, vector kPerm0[j] + 16 in upper 4 bits
+                uint8_t upper = blocks[j];
+                uint8_t lower = blocks[j + 16];
+                size_t lane = row + static_cast<size_t>(kPerm0[j]);
+                size_t lanes[2] = {lane, lane + 16};
+                for (size_t h = 0; h < 2; ++h) {
+                    if (lanes[h] < num) {
+                        size_t shift = h * 4;
+                        quantization_code[(lanes[h] * cols) + i] = static_cast<uint8_t>(
+                            (((upper >> shift) & 15) << 4) | ((lower >> shift) & 15)
+                        );
+                    }
+                }
+            }
+            blocks += 32;
+        }
+    }
+}
+
+/**
+ * @brief Inverse of pack_codes() for a single vector, get the binary code of the vector
+ * at a given lane of a packed batch
+ *
+ * @param padded_dim dimension of quantized data
+ * @param blocks packed quantization code of one batch
+ * @param lane position of the vector in the batch (0 to kBatchSize - 1)
+ * @param binary_code binary code of the vector, one uint8 (0 or 1) for each dim
+ */
+inline void unpack_code(
+    size_t padded_dim, const uint8_t* blocks, size_t lane, uint8_t* binary_code
+) {
+    size_t pos = 0;  // position of the lane in kPerm0
+    while (static_cast<size_t>(kPerm0[pos]) != (lane & 15)) {
+        ++pos;
+    }
+    size_t shift = lane < 16 ? 0 : 4;
+
+    for (size_t i = 0; i < padded_dim / 8; ++i) {
+        uint8_t upper = (blocks[pos] >> shift) & 15;
+        uint8_t lower = (blocks[pos + 16] >> shift) & 15;
+        uint8_t byte = static_cast<uint8_t>((upper << 4) | lower);
+        for (size_t j = 0; j < 8; ++j) {
+            binary_code[(i * 8) + j] = (byte >> (7 - j)) & 1;
+        }
+        blocks += 32;
+    }
+}
+
+// binary code of the lane-th vector in a batch as uint64 words in the order of
+// pack_binary(), i.e., the 1st dim is the highest bit of the 1st word, see mask_ip_x0_q().
+// ! padded_dim % 64 == 0
+inline void unpack_code_words(
+    size_t padded_dim, const uint8_t* blocks, size_t lane, uint64_t* words
+) {
+    size_t pos = 0;  // position of the lane in kPerm0
+    while (static_cast<size_t>(kPerm0[pos]) != (lane & 15)) {
+        ++pos;
+    }
+    size_t shift = lane < 16 ? 0 : 4;
+
+    for (size_t i = 0; i < padded_dim / 64; ++i) {
+        uint64_t word = 0;
+        for (size_t j = 0; j < 8; ++j) {
+            uint64_t upper = (blocks[pos] >> shift) & 15;
+            uint64_t lower = (blocks[pos + 16] >> shift) & 15;
+            word = (word << 8) | (upper << 4) | lower;
+            blocks += 32;
+        }
+        words[i] = word;
+    }
+}
+
 // use fast scan to accumulate one block, dim % 16 == 0
 void accumulate(
     const uint8_t* __restrict__ codes,
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <cstdint>
 
 #include "rabitqlib/defines.hpp"
@@ -128,6 +129,56 @@ inline float split_distance_boosting(
     return ex_dist;
 }
 
+/**
+ * @brief Same as split_distance_boosting(), but read the ex code stage by stage (see
+ * RefineStages) and stop once the lower bound of the distance after a stage is no less
+ * than distk, i.e., the candidate is outside the current top-k. The factors of the ex code
+ * are read first, thus a dropped candidate reads its factors and the codes of the stages
+ * done so far.
+ *
+ * @param g_add query factor of the candidate
+ * @param distk current k-th distance, the candidate is dropped if its lower bound is not
+ * less than it
+ * @param ex_dist distance by all bits, only set if the candidate is not dropped
+ * @return false if the candidate is dropped
+ */
+template <class Query>
+inline bool split_distance_progressive(
+    const char* ex_data,
+    float (*ip_func_)(const float*, const uint8_t*, size_t),
+    const Query& q_obj,
+    const RefineStages<float>& stages,
+    size_t padded_dim,
+    size_t ex_bits,
+    float g_add,
+    float ip_x0_qr,
+    float distk,
+    float& ex_dist
+) {
+    ConstExDataMap<float> cur_ex(ex_data, padded_dim, ex_bits);
+    const float* query = q_obj.rotated_query();
+    float f_add = cur_ex.f_add_ex() + g_add;
+    float f_rescale = cur_ex.f_rescale_ex();
+    float error_scale = std::abs(f_rescale);
+
+    float ip = (static_cast<float>(1 << ex_bits) * ip_x0_qr) + q_obj.kbxsumq();
+    const uint8_t* ex_code = cur_ex.ex_code();
+    size_t begin = 0;
+    for (size_t i = 0; i + 1 < stages.num_stages(); ++i) {
+        size_t end = stages.end(i);
+        ip += ip_func_(query + begin, ex_code + (begin * ex_bits / 8), end - begin);
+        begin = end;
+        float est_dist = f_add + (f_rescale * (ip + stages.rest_mid(i)));
+        if (est_dist - (error_scale * stages.rest_error(i)) >= distk) {
+            return false;
+        }
+    }
+    ip += ip_func_(query + begin, ex_code + (begin * ex_bits / 8), padded_dim - begin);
+
+    ex_dist = f_add + (f_rescale * ip);
+    return true;
+}
+
 template <class Kernel, class Query>
 inline void split_single_fulldist_direct(
     const char* bin_data,
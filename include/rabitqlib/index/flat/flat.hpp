@@ -0,0 +1,308 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/chunked_file.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib::flat {
+/**
+ * @brief Exact index which stores raw vectors and scans all of them, used for ground
+ * truth, correctness checks and collections too small for approximate indices. Distances
+ * follow the other indices, i.e., squared euclidean distance for METRIC_L2 and 1 - <q, x>
+ * for METRIC_IP. Vectors get consecutive ids in the order of add().
+ *
+ * A single query is scanned by the distance functions of utils/space.hpp. A batch of queries is scanned
+ * by blocks, the inner products of a block of queries and a block of vectors are computed
+ * by one matrix product (GEMM), and L2 distances by ||q||^2 + ||x||^2 - 2<q, x>. Blocks of
+ * queries run in parallel.
+ */
+class FlatIndex {
+   private:
+    size_t dim_ = 0;                                 // dimension of data points
+    size_t num_ = 0;                                 // num of data points
+    MetricType metric_type_ = rabitqlib::METRIC_L2;  // metric type
+    std::vector<float> data_;                        // raw vectors (num_ * dim_)
+    std::vector<float> norms_;                       // squared l2 norms of vectors (num_)
+
+    static constexpr size_t kQueryBlock = 64;   // num of queries per block
+    static constexpr size_t kDataBlock = 1024;  // num of vectors per block
+
+    // raw vectors have no codes and no rotator, thus total_bits is 0, see IndexFileMeta
+    [[nodiscard]] IndexFileMeta file_meta() const {
+        IndexFileMeta meta;
+        meta.index_type = IndexFileType::Flat;
+        meta.dim = dim_;
+        meta.metric_type = metric_type_;
+        meta.total_bits = 0;
+        return meta;
+    }
+
+    void search_block(const float*, size_t, size_t, PID*, float*) const;
+
+    void save_stream(std::ostream&) const;
+
+    void load_stream(std::istream&);
+
+   public:
+    FlatIndex() = default;
+
+    explicit FlatIndex(size_t dim, MetricType metric_type = rabitqlib::METRIC_L2)
+        : dim_(dim), metric_type_(metric_type) {}
+
+    [[nodiscard]] size_t size() const { return num_; }
+    [[nodiscard]] size_t dimension() const { return dim_; }
+    [[nodiscard]] MetricType metric_type() const { return metric_type_; }
+
+    // raw vector of a data point (dim)
+    [[nodiscard]] const float* vector(PID id) const {
+        return data_.data() + (static_cast<size_t>(id) * dim_);
+    }
+
+    void add(const float*, size_t);
+
+    void search(const float*, size_t, PID*, float* dists = nullptr) const;
+
+    void search_batch(
+        const float*,
+        size_t,
+        size_t,
+        PID*,
+        float* dists = nullptr,
+        size_t num_threads = std::numeric_limits<size_t>::max()
+    ) const;
+
+    void save(const char*) const;
+
+    void save_compressed(const char*, const ChunkedFileConfig& config = {}) const;
+
+    void load(const char*, size_t num_threads = 0);
+};
+
+/**
+ * @brief Append vectors to the index, their ids start from the current size()
+ *
+ * @param data vectors (num * dim)
+ * @param num num of vectors
+ */
+inline void FlatIndex::add(const float* data, size_t num) {
+    if (num_ + num > static_cast<size_t>(kPidMax)) {
+        throw std::length_error("FlatIndex: too many vectors");
+    }
+    data_.insert(data_.end(), data, data + (num * dim_));
+    norms_.resize(num_ + num);
+    for (size_t i = num_; i < num_ + num; ++i) {
+        const float* vec = vector(static_cast<PID>(i));
+        norms_[i] = l2norm_sqr(vec, dim_);
+    }
+    num_ += num;
+}
+
+/**
+ * @brief Find the exact k nearest neighbors of a query
+ *
+ * @param query query vector (dim)
+ * @param k num of nearest neighbors
+ * @param results ids of results sorted by distances (min(k, size()))
+ * @param dists distances of results (min(k, size())), may be nullptr
+ */
+inline void FlatIndex::search(
+    const float* __restrict__ query,
+    size_t k,
+    PID* __restrict__ results,
+    float* __restrict__ dists
+) const {
+    if (k == 0 || num_ == 0) {
+        return;
+    }
+    buffer::SearchBuffer knns(std::min(k, num_));
+    for (size_t i = 0; i < num_; ++i) {
+        const float* vec = vector(static_cast<PID>(i));
+        float dist = metric_type_ == METRIC_IP ? dot_product_dis(query, vec, dim_)
+                                               : euclidean_sqr(query, vec, dim_);
+        knns.insert(static_cast<PID>(i), dist);
+    }
+
+    if (dists != nullptr) {
+        knns.copy_results(results, dists);
+    } else {
+        knns.copy_results(results);
+    }
+}
+
+/**
+ * @brief Find the exact k nearest neighbors of a batch of queries. Results of the i-th
+ * query are stored in results[i * k, i * k + min(k, size())).
+ *
+ * @param queries query vectors (num_queries * dim)
+ * @param num_queries num of queries
+ * @param k num of nearest neighbors
+ * @param results ids of results (num_queries * k)
+ * @param dists distances of results (num_queries * k), may be nullptr
+ * @param num_threads num of threads
+ */
+inline void FlatIndex::search_batch(
+    const float* queries,
+    size_t num_queries,
+    size_t k,
+    PID* results,
+    float* dists,
+    size_t num_threads
+) const {
+    size_t num_blocks = div_round_up(num_queries, kQueryBlock);
+    num_threads = std::max<size_t>(std::min(num_threads, rabitqlib::total_threads()), 1);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t b = 0; b < num_blocks; ++b) {
+        size_t begin = b * kQueryBlock;
+        size_t end = std::min(begin + kQueryBlock, num_queries);
+        search_block(
+            queries + (begin * dim_),
+            end - begin,
+            k,
+            results + (begin * k),
+            dists == nullptr ? nullptr : dists + (begin * k)
+        );
+    }
+}
+
+inline void FlatIndex::search_block(
+    const float* queries, size_t num_queries, size_t k, PID* results, float* dists
+) const {
+    if (k == 0 || num_ == 0) {
+        return;
+    }
+    std::vector<buffer::SearchBuffer<float>> knns;
+    knns.reserve(num_queries);
+    std::vector<float> query_norms(num_queries);
+    for (size_t i = 0; i < num_queries; ++i) {
+        knns.emplace_back(std::min(k, num_));
+        const float* query = queries + (i * dim_);
+        query_norms[i] = l2norm_sqr(query, dim_);
+    }
+
+    ConstRowMajorMatrixMap<float> query_mat(
+        queries, static_cast<long>(num_queries), static_cast<long>(dim_)
+    );
+    RowMajorMatrix<float> ips(num_queries, kDataBlock);
+    for (size_t begin = 0; begin < num_; begin += kDataBlock) {
+        size_t cnt = std::min(kDataBlock, num_ - begin);
+        ConstRowMajorMatrixMap<float> data_mat(
+            vector(static_cast<PID>(begin)), static_cast<long>(cnt), static_cast<long>(dim_)
+        );
+        auto ip_block = ips.leftCols(static_cast<long>(cnt));
+        ip_block.noalias() = query_mat * data_mat.transpose();
+
+        for (size_t i = 0; i < num_queries; ++i) {
+            const float* row = ips.data() + (i * kDataBlock);
+            const float* norms = norms_.data() + begin;
+            for (size_t j = 0; j < cnt; ++j) {
+                float dist = metric_type_ == METRIC_IP
+                                 ? 1 - row[j]
+                                 : std::max(query_norms[i] + norms[j] - (2 * row[j]), 0.0F);
+                knns[i].insert(static_cast<PID>(begin + j), dist);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_queries; ++i) {
+        if (dists != nullptr) {
+            knns[i].copy_results(results + (i * k), dists + (i * k));
+        } else {
+            knns[i].copy_results(results + (i * k));
+        }
+    }
+}
+
+inline void FlatIndex::save(const char* filename) const {
+    std::ofstream output(filename, std::ios::binary);
+    save_stream(output);
+    output.close();
+}
+
+// save as a chunked container (see chunked_file.hpp), load() detects the format
+inline void FlatIndex::save_compressed(
+    const char* filename, const ChunkedFileConfig& config
+) const {
+    ChunkedFileWriter writer(filename, file_meta(), config);
+    std::ostream output(&writer);
+    save_stream(output);
+    writer.finish();
+}
+
+inline void FlatIndex::save_stream(std::ostream& output) const {
+    output.write(reinterpret_cast<const char*>(&num_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&dim_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&metric_type_), sizeof(metric_type_));
+    output.write(
+        reinterpret_cast<const char*>(data_.data()),
+        static_cast<long>(sizeof(float) * num_ * dim_)
+    );
+}
+
+/**
+ * @brief Load index saved by save() or save_compressed(). For a chunked container, all
+ * chunks are verified and corruption throws std::runtime_error.
+ *
+ * @param filename path of index file
+ * @param num_threads num of threads for decompressing chunks, 0 means all threads
+ */
+inline void FlatIndex::load(const char* filename, size_t num_threads) {
+    if (!file_exists(filename)) {
+        throw std::runtime_error(std::string(filename) + " does not exist");
+    }
+
+    if (is_chunked_file(filename)) {
+        ChunkedFileReader reader(filename, num_threads);
+        if (reader.meta().index_type != IndexFileType::Flat) {
+            throw std::runtime_error(std::string(filename) + " is not a flat index");
+        }
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        load_stream(input);
+        if (input.fail()) {
+            throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+        }
+        reader.check_meta(file_meta());
+    } else {
+        std::ifstream input(filename, std::ios::binary);
+        assert(input.is_open());
+        load_stream(input);
+        if (input.fail()) {
+            throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+        }
+        input.close();
+    }
+}
+
+inline void FlatIndex::load_stream(std::istream& input) {
+    size_t num = 0;
+    input.read(reinterpret_cast<char*>(&num), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&dim_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&metric_type_), sizeof(metric_type_));
+
+    std::vector<float> data(num * dim_);
+    input.read(
+        reinterpret_cast<char*>(data.data()), static_cast<long>(sizeof(float) * num * dim_)
+    );
+
+    num_ = 0;
+    data_.clear();
+    norms_.clear();
+    add(data.data(), num);
+}
+}  // namespace rabitqlib::flat
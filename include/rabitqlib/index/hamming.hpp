@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "rabitqlib/fastscan/fastscan.hpp"
+#include "rabitqlib/fastscan/highacc_fastscan.hpp"
+#include "rabitqlib/index/lut.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib {
+/*
+ * Binary vectors are given packed, the bit of dim i is bit (7 - i % 8) of byte (i / 8),
+ * i.e., the order of numpy.packbits(). This is also the order of the 1-bit codes taken by
+ * fastscan::pack_codes(), thus binary vectors are packed into FastScan batches as they are.
+ */
+
+// bytes of a packed binary vector
+inline size_t binary_code_bytes(size_t dim) { return div_round_up(dim, 8); }
+
+// copy a packed binary vector of dim bits into padded_dim bits, unused bits are zero
+inline void pad_binary_code(
+    const uint8_t* __restrict__ code,
+    size_t dim,
+    size_t padded_dim,
+    uint8_t* __restrict__ dst
+) {
+    size_t bytes = binary_code_bytes(dim);
+    std::memcpy(dst, code, bytes);
+    std::memset(dst + bytes, 0, (padded_dim / 8) - bytes);
+    if (dim % 8 != 0) {
+        dst[bytes - 1] &= static_cast<uint8_t>(0xFF << (8 - (dim % 8)));
+    }
+}
+
+// padded binary vector to uint64 words in the order of pack_binary(), see mask_ip_x0_q()
+inline void binary_code_to_words(
+    const uint8_t* __restrict__ code, size_t padded_dim, uint64_t* __restrict__ words
+) {
+    for (size_t i = 0; i < padded_dim / 64; ++i) {
+        uint64_t word;
+        std::memcpy(&word, code + (i * 8), sizeof(uint64_t));
+        words[i] = __builtin_bswap64(word);
+    }
+}
+
+inline uint32_t hamming_distance(
+    const uint64_t* __restrict__ x, const uint64_t* __restrict__ y, size_t padded_dim
+) {
+    uint32_t ret = 0;
+    for (size_t i = 0; i < padded_dim / 64; ++i) {
+        ret += __builtin_popcountll(x[i] ^ y[i]);
+    }
+    return ret;
+}
+
+/**
+ * @brief Binary query, distances are Hamming distances. For each 4 dims, the lookup table
+ * of FastScan holds the num of different bits between the query and each of the 16
+ * codes, thus fastscan::accumulate() gives exact Hamming distances of a batch.
+ */
+class HammingQuery {
+   private:
+    size_t padded_dim_;
+    std::vector<uint64_t> words_;  // query in words
+    std::vector<uint8_t> lut_;     // lookup table (padded_dim * 4)
+
+   public:
+    explicit HammingQuery(const uint8_t* query, size_t dim, size_t padded_dim)
+        : padded_dim_(padded_dim), words_(padded_dim / 64), lut_(padded_dim << 2) {
+        std::vector<uint8_t> code(padded_dim / 8);
+        pad_binary_code(query, dim, padded_dim, code.data());
+        binary_code_to_words(code.data(), padded_dim, words_.data());
+
+        // a set bit of the code adds 1 if the bit of query is 0, and -1 otherwise
+        std::vector<float> sign(padded_dim);
+        std::vector<float> lut_float(padded_dim << 2);
+        for (size_t i = 0; i < padded_dim; ++i) {
+            sign[i] = ((code[i / 8] >> (7 - (i % 8))) & 1) != 0 ? -1.0F : 1.0F;
+        }
+        fastscan::pack_lut(padded_dim, sign.data(), lut_float.data());
+        for (size_t i = 0; i < padded_dim / 4; ++i) {
+            float ones = 0;
+            for (size_t j = 0; j < 4; ++j) {
+                ones += sign[(i * 4) + j] < 0 ? 1.0F : 0.0F;
+            }
+            for (size_t j = 0; j < 16; ++j) {
+                lut_[(i * 16) + j] = static_cast<uint8_t>(lut_float[(i * 16) + j] + ones);
+            }
+        }
+    }
+
+    // exact distances are computed by FastScan
+    [[nodiscard]] static constexpr float error() { return 0; }
+
+    [[nodiscard]] float distance(const uint64_t* words) const {
+        return static_cast<float>(hamming_distance(words_.data(), words, padded_dim_));
+    }
+
+    // distances to a FastScan batch of 32 binary vectors
+    void batch_distance(const uint8_t* codes, float* dists) const {
+        std::array<uint16_t, fastscan::kBatchSize> accu_res;
+        fastscan::accumulate(codes, lut_.data(), accu_res.data(), padded_dim_);
+        for (size_t i = 0; i < fastscan::kBatchSize; ++i) {
+            dists[i] = static_cast<float>(accu_res[i]);
+        }
+    }
+};
+
+/**
+ * @brief Float query against binary vectors (asymmetric distance). A binary vector b is
+ * taken as the vector 2b - 1 in {-1, 1}^dim, and the distance is ||q - (2b - 1)||^2 =
+ * ||q + 1||^2 - 4<q, b>. For a query in {-1, 1}^dim, it equals 4 times the Hamming
+ * distance. FastScan estimates <q, b> by the high accuracy lookup table, whose rounding
+ * error is bounded by error(), exact distances are computed by mask_ip_x0_q().
+ */
+class AsymmetricQuery {
+   private:
+    size_t padded_dim_;
+    std::vector<float> query_;  // padded query
+    Lut<float> lut_;            // lookup table of q
+    float base_ = 0;            // ||q + 1||^2
+    float error_ = 0;           // max error of estimated distances
+
+   public:
+    explicit AsymmetricQuery(const float* query, size_t dim, size_t padded_dim)
+        : padded_dim_(padded_dim), query_(padded_dim, 0) {
+        std::copy(query, query + dim, query_.begin());
+        lut_ = Lut<float>(query_.data(), padded_dim, true);
+        for (size_t i = 0; i < dim; ++i) {
+            base_ += (query[i] + 1) * (query[i] + 1);
+        }
+        // each entry of the table is rounded by at most delta / 2, 1% is for float errors
+        error_ = (2.0F * lut_.delta() * static_cast<float>(padded_dim / 4) * 1.01F) +
+                 (1e-5F * base_);
+    }
+
+    [[nodiscard]] float error() const { return error_; }
+
+    [[nodiscard]] float distance(const uint64_t* words) const {
+        return base_ - (4 * mask_ip_x0_q(query_.data(), words, padded_dim_));
+    }
+
+    // estimated distances to a FastScan batch of 32 binary vectors
+    void batch_distance(const uint8_t* codes, float* dists) const {
+        constexpr size_t kSafeChunkDim = 1024;
+        std::array<int32_t, fastscan::kBatchSize> accu_res;
+        std::array<int32_t, fastscan::kBatchSize> accu_sum{};
+        const uint8_t* lut_ptr = lut_.lut();
+        size_t remaining_dim = padded_dim_;
+        while (remaining_dim > 0) {
+            size_t cur_dim = std::min(remaining_dim, kSafeChunkDim);
+            fastscan::accumulate_hacc(codes, lut_ptr, accu_res.data(), cur_dim);
+            for (size_t i = 0; i < fastscan::kBatchSize; ++i) {
+                accu_sum[i] += accu_res[i];
+            }
+            codes += cur_dim << 2;
+            lut_ptr += cur_dim << 3;
+            remaining_dim -= cur_dim;
+        }
+        for (size_t i = 0; i < fastscan::kBatchSize; ++i) {
+            float ip = (lut_.delta() * static_cast<float>(accu_sum[i])) + lut_.sum_vl();
+            dists[i] = base_ - (4 * ip);
+        }
+    }
+};
+}  // namespace rabitqlib
@@ -11,6 +11,9 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -21,6 +24,7 @@
 #include "rabitqlib/quantization/data_layout.hpp"
 #include "rabitqlib/quantization/rabitq.hpp"
 #include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/chunked_file.hpp"
 #include "rabitqlib/utils/cpu_features.hpp"
 #include "rabitqlib/utils/rotator.hpp"
 #include "rabitqlib/utils/space.hpp"
@@ -40,15 +44,15 @@ class HierarchicalNSW;
 namespace detail {
 
 maxheap<std::pair<float, PID>> search_knn_avx2(
-    HierarchicalNSW&, const float*, size_t
+    const HierarchicalNSW&, const float*, size_t, size_t
 );
 
 maxheap<std::pair<float, PID>> search_knn_avx512_core(
-    HierarchicalNSW&, const float*, size_t
+    const HierarchicalNSW&, const float*, size_t, size_t
 );
 
 maxheap<std::pair<float, PID>> search_knn_avx512_popcnt(
-    HierarchicalNSW&, const float*, size_t
+    const HierarchicalNSW&, const float*, size_t, size_t
 );
 
 }  // namespace detail
@@ -68,14 +72,56 @@ class HierarchicalNSW {
     [[nodiscard]] size_t ef_construction() const { return ef_construction_; }
     [[nodiscard]] MetricType metric_type() const { return metric_type_; }
     [[nodiscard]] size_t max_elements() const { return max_elements_; }
+    [[nodiscard]] size_t refine_stages() const { return refine_stages_; }
+
+    /**
+     * @brief Read the ex code of a candidate in num_stages stages of dims during search,
+     * the candidate is dropped once its lower bound after a stage is outside the top-k, see
+     * RefineStages. 1 (by default) reads the whole ex code. Codes of more than 8 ex_bits
+     * always use 1 stage.
+     */
+    void set_refine_stages(size_t num_stages) { refine_stages_ = num_stages; }
+
+    /**
+     * @brief Quantize ex codes of METRIC_IP indices by the score-aware (anisotropic) loss,
+     * which weights the error parallel to each data vector by eta, see
+     * quant::anisotropic_eta(). Set before construction, 1 (by default) for the plain codes.
+     * It is ignored for METRIC_L2.
+     */
+    void set_score_aware(double eta) { eta_ = eta; }
 
     void save(const char*) const;
-    void load(const char*);
+    void save_compressed(const char*, const ChunkedFileConfig& = {}) const;
+    void load(const char*, size_t = 0);
 
-    void construct(size_t, const float*, size_t, const float*, PID*, size_t, bool);
+    void construct(
+        size_t, const float*, size_t, const float*, PID*, size_t, bool, const ProgressFunc&
+    );
     std::vector<std::vector<std::pair<float, PID>>> search(
         const float*, size_t, size_t, size_t, size_t
-    );
+    ) const;
+
+    std::vector<std::vector<std::pair<DistBound, PID>>> search_with_bounds(
+        const float*, size_t, size_t, size_t, size_t
+    ) const;
+
+    void score_ids(
+        const float*,
+        const PID*,
+        size_t,
+        float*,
+        ScoreMode mode = SCORE_FULL_BITS,
+        const float* data = nullptr
+    ) const;
+
+    void score_ids(
+        const float*,
+        const PID*,
+        size_t,
+        DistBound*,
+        ScoreMode mode = SCORE_FULL_BITS,
+        const float* data = nullptr
+    ) const;
 
     const float* rawDataPtr_{nullptr};
 
@@ -132,13 +178,13 @@ class HierarchicalNSW {
 
    private:
     friend maxheap<std::pair<float, PID>> detail::search_knn_avx2(
-        HierarchicalNSW&, const float*, size_t
+        const HierarchicalNSW&, const float*, size_t, size_t
     );
     friend maxheap<std::pair<float, PID>> detail::search_knn_avx512_core(
-        HierarchicalNSW&, const float*, size_t
+        const HierarchicalNSW&, const float*, size_t, size_t
     );
     friend maxheap<std::pair<float, PID>> detail::search_knn_avx512_popcnt(
-        HierarchicalNSW&, const float*, size_t
+        const HierarchicalNSW&, const float*, size_t, size_t
     );
 
     static constexpr PID kMaxLabelOperationLock = 65536;
@@ -150,7 +196,8 @@ class HierarchicalNSW {
     size_t maxM_{0};
     size_t maxM0_{0};
     size_t ef_construction_{0};
-    size_t ef_{0};
+    size_t refine_stages_{1};  // num of stages to read ex codes, see set_refine_stages()
+    double eta_{1};            // weight of parallel error of ex codes, see set_score_aware()
     MetricType metric_type_;
 
     double mult_{0.0}, revSize_{0.0};
@@ -195,6 +242,7 @@ class HierarchicalNSW {
     float (*ip_func_)(const float*, const uint8_t*, size_t);
 
     Rotator<float>* rotator_ = nullptr;
+    RotatorType rotator_type_ = RotatorType::FhtKacRotator;  // type of rotator_
 
     quant::RabitqConfig query_config_;
 
@@ -210,6 +258,13 @@ class HierarchicalNSW {
 
     float (*raw_dist_func_)(const float* __restrict__, const float* __restrict__, size_t);
 
+    [[nodiscard]] IndexFileMeta file_meta() const {
+        return {IndexFileType::HNSW, dim_, metric_type_, ex_bits_ + 1, rotator_type_};
+    }
+
+    void save_stream(std::ostream&) const;
+    void load_stream(std::istream&);
+
     void free_memory() {
         free(data_level0_memory_);
         data_level0_memory_ = nullptr;
@@ -228,8 +283,6 @@ class HierarchicalNSW {
         rotator_ = nullptr;
     }
 
-    void set_ef(size_t ef) { ef_ = ef; }
-
     std::mutex& get_lable_op_mutex(PID label) const {
         // calculate hash
         size_t lock_id = label & (kMaxLabelOperationLock - 1);
@@ -320,17 +373,33 @@ class HierarchicalNSW {
     template <class Kernel>
     void get_bin_est_direct(
         std::vector<float>&, SplitSingleQuery<float>&, PID, HierarchicalNSW::EstimateRecord&
-    );
+    ) const;
 
     template <class Kernel>
     void get_full_est_direct(
         std::vector<float>&, SplitSingleQuery<float>&, PID, HierarchicalNSW::EstimateRecord&
     ) const;
 
-    maxheap<std::pair<float, PID>> search_knn(const float*, size_t);
+    template <class Kernel>
+    bool get_full_est_progressive(
+        std::vector<float>&,
+        SplitSingleQuery<float>&,
+        const RefineStages<float>&,
+        PID,
+        float,
+        HierarchicalNSW::EstimateRecord&
+    ) const;
+
+    maxheap<std::pair<float, PID>> search_knn(const float*, size_t, size_t) const;
+
+    void score_ids_impl(
+        const float*, const PID*, size_t, float*, DistBound*, ScoreMode, const float*
+    ) const;
+
+    [[nodiscard]] float ex_error_factor(PID) const;
 
     template <class Kernel>
-    maxheap<std::pair<float, PID>> search_knn_direct(const float*, size_t);
+    maxheap<std::pair<float, PID>> search_knn_direct(const float*, size_t, size_t) const;
 
     template <class Kernel>
     void searchBaseLayerST_AdaptiveRerankOptDirect(
@@ -341,7 +410,7 @@ class HierarchicalNSW {
         std::vector<float>& q_to_centroids,
         const float* query,
         BoundedKNN& boundedKNN
-    );
+    ) const;
 
     // Construction
     // Currently only support index construction with non-quantized vectors
@@ -380,8 +449,13 @@ inline HierarchicalNSW::HierarchicalNSW(
       ) {
     max_elements_ = max_elements;
     dim_ = dim;
+    // random_seed seeds the rotator besides the levels of vertices
     rotator_ = choose_rotator<float>(
-        dim, RotatorType::FhtKacRotator, round_up_to_multiple(dim_, 64)
+        dim,
+        rotator_type_,
+        round_up_to_multiple(dim_, 64),
+        0,
+        static_cast<unsigned>(random_seed + 2)
     );
     padded_dim_ = rotator_->size();
     /* check size */
@@ -389,10 +463,10 @@ inline HierarchicalNSW::HierarchicalNSW(
     assert(padded_dim_ >= dim_);
     ex_bits_ = total_bits - 1;
 
-    if (total_bits < 1 || total_bits > 9) {
+    if (total_bits < 1 || total_bits > 16) {
         std::cerr << "Invalid number of bits for quantization in "
                      "HierarchicalNSW::HierarchicalNSW\n";
-        std::cerr << "Expected: 1 to 9  Input:" << total_bits << '\n';
+        std::cerr << "Expected: 1 to 16  Input:" << total_bits << '\n';
         std::cerr.flush();
         exit(1);
     };
@@ -413,7 +487,6 @@ inline HierarchicalNSW::HierarchicalNSW(
     maxM_ = M_;
     maxM0_ = M_ * 2;
     ef_construction_ = std::max(ef_construction, M_);
-    ef_ = 10;
 
     size_bin_data_ = BinDataMap<float>::data_bytes(padded_dim_);
     size_ex_data_ = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
@@ -460,7 +533,21 @@ inline HierarchicalNSW::~HierarchicalNSW() { free_memory(); }
 
 inline void HierarchicalNSW::save(const char* filename) const {
     std::ofstream output(filename, std::ios::binary);
+    save_stream(output);
+    output.close();
+}
 
+// save as a chunked container (see chunked_file.hpp), load() detects the format
+inline void HierarchicalNSW::save_compressed(
+    const char* filename, const ChunkedFileConfig& config
+) const {
+    ChunkedFileWriter writer(filename, file_meta(), config);
+    std::ostream output(&writer);
+    save_stream(output);
+    writer.finish();
+}
+
+inline void HierarchicalNSW::save_stream(std::ostream& output) const {
     output.write(reinterpret_cast<const char*>(&max_elements_), sizeof(size_t));
     output.write(reinterpret_cast<const char*>(&cur_element_count_), sizeof(size_t));
 
@@ -510,16 +597,35 @@ inline void HierarchicalNSW::save(const char* filename) const {
     }
 
     rotator_->save(output);
-    output.close();
 }
 
-inline void HierarchicalNSW::load(const char* filename) {
+inline void HierarchicalNSW::load(const char* filename, size_t num_threads) {
+    if (is_chunked_file(filename)) {
+        ChunkedFileReader reader(filename, num_threads);
+        if (reader.meta().index_type != IndexFileType::HNSW) {
+            throw std::runtime_error(std::string(filename) + " is not an HNSW index");
+        }
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        load_stream(input);
+        if (input.fail()) {
+            throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+        }
+        reader.check_meta(file_meta());
+        return;
+    }
+
     std::ifstream input(filename, std::ios::binary);
 
     if (!input.is_open()) {
         throw std::runtime_error("Cannot open file");
     }
 
+    load_stream(input);
+    input.close();
+}
+
+inline void HierarchicalNSW::load_stream(std::istream& input) {
     free_memory();
 
     input.read(reinterpret_cast<char*>(&max_elements_), sizeof(size_t));
@@ -577,7 +683,6 @@ inline void HierarchicalNSW::load(const char* filename) {
 
     element_levels_ = std::vector<int>(max_elements_);
     revSize_ = 1.0 / mult_;
-    ef_ = 10;
 
     for (size_t i = 0; i < cur_element_count_; i++) {
         label_lookup_[get_external_label(i)] = i;
@@ -600,15 +705,12 @@ inline void HierarchicalNSW::load(const char* filename) {
 
     visited_list_pool_ = std::make_unique<VisitedListPool>(1, max_elements_);
 
-    rotator_ = choose_rotator<float>(
-        dim_, RotatorType::FhtKacRotator, round_up_to_multiple(dim_, 64)
-    );
+    rotator_ = choose_rotator<float>(dim_, rotator_type_, round_up_to_multiple(dim_, 64));
     if (rotator_->size() != padded_dim_) {
         std::cerr << "Bad padded_dim_ for rotator in hnsw.load()\n";
         exit(1);
     }
     rotator_->load(input);
-    input.close();
 
     this->query_config_ =
         quant::faster_config(padded_dim_, SplitSingleQuery<float>::kNumBits);
@@ -621,7 +723,8 @@ inline void HierarchicalNSW::construct(
     const float* data,
     PID* cluster_ids,
     size_t num_threads = 0,
-    bool faster = false
+    bool faster = false,
+    const ProgressFunc& progress = {}
 ) {
     num_cluster_ = cluster_num;
     centroids_memory_ =
@@ -641,16 +744,27 @@ inline void HierarchicalNSW::construct(
     if (faster) {
         config = quant::faster_config(padded_dim_, ex_bits_ + 1);
     }
+    config.eta = eta_;
 
     std::cout << "Start HierarchicalNSW construction..." << '\n';
     rawDataPtr_ = data;
     std::cout << "Build edges with non-quantized vectors..." << '\n';
-    rabitqlib::ivf::parallel_for(
-        0,
-        data_num,
-        num_threads,
-        [&](size_t idx, size_t /*threadId*/) { add_point(idx, cluster_ids[idx], config); }
-    );
+    // insert by groups of points if the progress is reported
+    size_t step = progress ? std::max<size_t>(data_num / 100, 1) : data_num;
+    for (size_t begin = 0; begin < data_num; begin += step) {
+        size_t end = std::min(begin + step, data_num);
+        rabitqlib::ivf::parallel_for(
+            begin,
+            end,
+            num_threads,
+            [&](size_t idx, size_t /*threadId*/) {
+                add_point(idx, cluster_ids[idx], config);
+            }
+        );
+        if (progress) {
+            progress(end, data_num);
+        }
+    }
 }
 
 inline void HierarchicalNSW::add_point(
@@ -1009,7 +1123,7 @@ inline void HierarchicalNSW::get_bin_est_direct(
     SplitSingleQuery<float>& query_wrapper,
     PID currObj,
     HierarchicalNSW::EstimateRecord& res
-) {
+) const {
     if (metric_type_ == METRIC_IP) {
         float norm = q_to_centroids[get_clusterid_by_internalid(currObj)];
         float error = q_to_centroids[get_clusterid_by_internalid(currObj) + num_cluster_];
@@ -1081,10 +1195,56 @@ inline void HierarchicalNSW::get_full_est_direct(
     }
 }
 
+// same as get_full_est_direct(), but the vector is dropped once it is outside the top-k
+// after a stage of its ex code, see split_distance_progressive()
+template <class Kernel>
+inline bool HierarchicalNSW::get_full_est_progressive(
+    std::vector<float>& q_to_centroids,
+    SplitSingleQuery<float>& query_wrapper,
+    const RefineStages<float>& stages,
+    PID currObj,
+    float distk,
+    HierarchicalNSW::EstimateRecord& res
+) const {
+    PID cid = get_clusterid_by_internalid(currObj);
+    float norm = q_to_centroids[cid];
+    float g_add = norm * norm;
+    float g_error = norm;
+    if (metric_type_ == METRIC_IP) {
+        g_add = -norm;
+        g_error = q_to_centroids[cid + num_cluster_];
+    }
+
+    ConstBinDataMap<float> cur_bin(get_bindata_by_internalid(currObj), padded_dim_);
+    float ip_x0_qr = Kernel::mask_ip_x0_q(
+        query_wrapper.rotated_query(), cur_bin.bin_code(), padded_dim_
+    );
+    float est_dist = 0;
+    if (!split_distance_progressive(
+            get_exdata_by_internalid(currObj),
+            ip_func_,
+            query_wrapper,
+            stages,
+            padded_dim_,
+            ex_bits_,
+            g_add,
+            ip_x0_qr,
+            distk,
+            est_dist
+        )) {
+        return false;
+    }
+
+    res.ip_x0_qr = ip_x0_qr;
+    res.est_dist = est_dist;
+    res.low_dist =
+        est_dist - (cur_bin.f_error() * g_error / static_cast<float>(1 << ex_bits_));
+    return true;
+}
+
 inline std::vector<std::vector<std::pair<float, PID>>> HierarchicalNSW::search(
     const float* queries, size_t query_num, size_t TOPK, size_t efSearch, size_t thread_num
-) {
-    set_ef(efSearch);
+) const {
     std::vector<std::vector<std::pair<float, PID>>> results(query_num);
     rabitqlib::ivf::parallel_for(
         0,
@@ -1093,7 +1253,7 @@ inline std::vector<std::vector<std::pair<float, PID>>> HierarchicalNSW::search(
         [&](size_t idx, size_t /*threadId*/) {
             std::vector<float> rotated_query(padded_dim_);
             this->rotator_->rotate(queries + (idx * dim_), rotated_query.data());
-            maxheap<std::pair<float, PID>> knn = search_knn(rotated_query.data(), TOPK);
+            maxheap<std::pair<float, PID>> knn = search_knn(rotated_query.data(), TOPK, efSearch);
             while (knn.size()) {
                 results[idx].emplace_back(knn.top());
                 knn.pop();
@@ -1104,17 +1264,236 @@ inline std::vector<std::vector<std::pair<float, PID>>> HierarchicalNSW::search(
     return results;
 }
 
+/**
+ * @brief Same as search(), but output the estimated distance and its error bounds for
+ * each result (see DistBound) instead of the distance. Results of HNSW are never exactly
+ * refined.
+ */
+inline std::vector<std::vector<std::pair<DistBound, PID>>>
+HierarchicalNSW::search_with_bounds(
+    const float* queries, size_t query_num, size_t TOPK, size_t efSearch, size_t thread_num
+) const {
+    auto results = search(queries, query_num, TOPK, efSearch, thread_num);
+    std::vector<std::vector<std::pair<DistBound, PID>>> bounded(query_num);
+    rabitqlib::ivf::parallel_for(
+        0,
+        query_num,
+        thread_num,
+        [&](size_t idx, size_t /*threadId*/) {
+            size_t num = results[idx].size();
+            std::vector<PID> labels(num);
+            for (size_t i = 0; i < num; ++i) {
+                labels[i] = results[idx][i].second;
+            }
+            std::vector<DistBound> bounds(num);
+            score_ids(queries + (idx * dim_), labels.data(), num, bounds.data());
+            // keep the distances of search, which are the same estimations
+            for (size_t i = 0; i < num; ++i) {
+                float est_dist = results[idx][i].first;
+                float error = bounds[i].est_dist - bounds[i].low_dist;
+                bounded[idx].emplace_back(
+                    DistBound{est_dist, est_dist - error, est_dist + error, false}, labels[i]
+                );
+            }
+        }
+    );
+    return bounded;
+}
+
+/**
+ * @brief Compute distances between a query and an explicit list of candidates (labels).
+ * Candidates are scored in the order of their internal ids and the query factors of each
+ * cluster are computed once.
+ *
+ * @param query query vector (DIM)
+ * @param ids labels of candidates
+ * @param num num of candidates
+ * @param dists distances of candidates (num), in the same order as ids
+ * @param mode SCORE_ONE_BIT, SCORE_FULL_BITS or SCORE_EXACT
+ * @param data raw data vectors (N*DIM) for SCORE_EXACT, defaults to the data used in
+ * construction
+ */
+inline void HierarchicalNSW::score_ids(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    float* __restrict__ dists,
+    ScoreMode mode,
+    const float* data
+) const {
+    score_ids_impl(query, ids, num, dists, nullptr, mode, data);
+}
+
+/**
+ * @brief Same as score_ids(), but also output the error bounds of each distance, see
+ * DistBound. For SCORE_EXACT, the bounds equal the exact distance.
+ */
+inline void HierarchicalNSW::score_ids(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    DistBound* __restrict__ bounds,
+    ScoreMode mode,
+    const float* data
+) const {
+    score_ids_impl(query, ids, num, nullptr, bounds, mode, data);
+}
+
+// dists or bounds may be nullptr
+inline void HierarchicalNSW::score_ids_impl(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    float* __restrict__ dists,
+    DistBound* __restrict__ bounds,
+    ScoreMode mode,
+    const float* data
+) const {
+    std::vector<PID> internal_ids(num);
+    {
+        std::unique_lock<std::mutex> lock_table(label_lookup_lock_);
+        for (size_t i = 0; i < num; ++i) {
+            auto search = label_lookup_.find(ids[i]);
+            if (search == label_lookup_.end()) {
+                throw std::out_of_range(
+                    "Bad label " + std::to_string(ids[i]) + " in HNSW::score_ids"
+                );
+            }
+            internal_ids[i] = search->second;
+        }
+    }
+
+    // output the distance and the bounds of the idx-th candidate
+    auto output = [&](size_t idx, float est_dist, float low_dist, bool exact) {
+        if (dists != nullptr) {
+            dists[idx] = est_dist;
+        }
+        if (bounds != nullptr) {
+            bounds[idx] = {est_dist, low_dist, (2 * est_dist) - low_dist, exact};
+        }
+    };
+
+    if (mode == SCORE_EXACT) {
+        data = (data == nullptr) ? rawDataPtr_ : data;
+        if (data == nullptr) {
+            throw std::invalid_argument(
+                "HNSW::score_ids requires raw data for SCORE_EXACT"
+            );
+        }
+        for (size_t i = 0; i < num; ++i) {
+            const float* vec = data + (static_cast<size_t>(ids[i]) * dim_);
+            float dist = metric_type_ == METRIC_IP
+                             ? dot_product_dis<float>(query, vec, dim_)
+                             : euclidean_sqr<float>(query, vec, dim_);
+            output(i, dist, dist, true);
+        }
+        return;
+    }
+
+    std::vector<float> rotated_query(padded_dim_);
+    this->rotator_->rotate(query, rotated_query.data());
+    SplitSingleQuery<float> query_wrapper(
+        rotated_query.data(), padded_dim_, ex_bits_, query_config_, metric_type_
+    );
+
+    // visit candidates in memory order
+    std::vector<size_t> order(num);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return internal_ids[a] < internal_ids[b];
+    });
+
+    // g_add and g_error of each cluster, computed on demand
+    std::vector<float> g_add(num_cluster_);
+    std::vector<float> g_error(num_cluster_, -1);
+
+    for (size_t idx : order) {
+        PID internal_id = internal_ids[idx];
+        PID cid = get_clusterid_by_internalid(internal_id);
+        if (g_error[cid] < 0) {
+            const float* centroid =
+                reinterpret_cast<const float*>(centroids_memory_) + (cid * padded_dim_);
+            float norm =
+                std::sqrt(euclidean_sqr(rotated_query.data(), centroid, padded_dim_));
+            g_add[cid] = metric_type_ == METRIC_IP
+                             ? -dot_product(rotated_query.data(), centroid, padded_dim_)
+                             : norm * norm;
+            g_error[cid] = norm;
+        }
+
+        float ip_x0_qr;
+        float est_dist;
+        float low_dist;
+        if (mode == SCORE_ONE_BIT || ex_bits_ == 0) {
+            split_single_estdist(
+                get_bindata_by_internalid(internal_id),
+                query_wrapper,
+                padded_dim_,
+                ip_x0_qr,
+                est_dist,
+                low_dist,
+                g_add[cid],
+                g_error[cid]
+            );
+        } else {
+            split_single_fulldist(
+                get_bindata_by_internalid(internal_id),
+                get_exdata_by_internalid(internal_id),
+                ip_func_,
+                query_wrapper,
+                padded_dim_,
+                ex_bits_,
+                est_dist,
+                low_dist,
+                ip_x0_qr,
+                g_add[cid],
+                g_error[cid]
+            );
+        }
+        if (bounds != nullptr && mode != SCORE_ONE_BIT && ex_bits_ > 0) {
+            low_dist = est_dist - (ex_error_factor(internal_id) * g_error[cid]);
+        }
+        output(idx, est_dist, low_dist, false);
+    }
+}
+
+// error factor of the total code of a vector, see quant::ex_error_factor()
+inline float HierarchicalNSW::ex_error_factor(PID internal_id) const {
+    ConstBinDataMap<float> bin_data(get_bindata_by_internalid(internal_id), padded_dim_);
+    ConstExDataMap<float> ex_data(
+        get_exdata_by_internalid(internal_id), padded_dim_, ex_bits_
+    );
+
+    std::vector<uint8_t> bin_code(padded_dim_);
+    std::vector<uint16_t> ex_code(padded_dim_);
+    unpack_binary(bin_data.bin_code(), bin_code.data(), padded_dim_);
+    quant::rabitq_impl::ex_bits::unpacking_rabitqplus_code(
+        ex_data.ex_code(), ex_code.data(), padded_dim_, ex_bits_
+    );
+
+    return quant::ex_error_factor<float>(
+        bin_code.data(),
+        ex_code.data(),
+        padded_dim_,
+        ex_bits_,
+        bin_data.f_rescale(),
+        bin_data.f_error(),
+        ex_data.f_rescale_ex(),
+        metric_type_
+    );
+}
+
 inline maxheap<std::pair<float, PID>> HierarchicalNSW::search_knn(
-    const float* rotated_query, size_t TOPK
-) {
+    const float* rotated_query, size_t TOPK, size_t ef
+) const {
     if (rabitqlib::cpu::has_avx512_popcnt()) {
-        return detail::search_knn_avx512_popcnt(*this, rotated_query, TOPK);
+        return detail::search_knn_avx512_popcnt(*this, rotated_query, TOPK, ef);
     }
     if (rabitqlib::cpu::has_avx512_core() && rabitqlib::cpu::has_avx2()) {
-        return detail::search_knn_avx512_core(*this, rotated_query, TOPK);
+        return detail::search_knn_avx512_core(*this, rotated_query, TOPK, ef);
     }
     if (rabitqlib::cpu::has_avx2()) {
-        return detail::search_knn_avx2(*this, rotated_query, TOPK);
+        return detail::search_knn_avx2(*this, rotated_query, TOPK, ef);
     }
 
     throw std::runtime_error("HNSW search requires AVX2/FMA or AVX512 support");
@@ -1122,8 +1501,8 @@ inline maxheap<std::pair<float, PID>> HierarchicalNSW::search_knn(
 
 template <class Kernel>
 inline maxheap<std::pair<float, PID>> HierarchicalNSW::search_knn_direct(
-    const float* rotated_query, size_t TOPK
-) {
+    const float* rotated_query, size_t TOPK, size_t ef
+) const {
     maxheap<std::pair<float, PID>> result;
     if (cur_element_count_ == 0) {
         return result;
@@ -1197,7 +1576,7 @@ inline maxheap<std::pair<float, PID>> HierarchicalNSW::search_knn_direct(
     BoundedKNN boundedKnn(TOPK);
     searchBaseLayerST_AdaptiveRerankOptDirect<Kernel>(
         curr_obj,
-        std::max(ef_, TOPK),
+        std::max(ef, TOPK),
         TOPK,
         query_wrapper,
         q_to_centroids,
@@ -1222,10 +1601,11 @@ inline void HierarchicalNSW::searchBaseLayerST_AdaptiveRerankOptDirect(
     size_t TOPK,
     SplitSingleQuery<float>& query_wrapper,
     std::vector<float>& q_to_centroids,
-    [[maybe_unused]] const float* query,
+    const float* query,
     BoundedKNN& boundedKNN
-) {
+) const {
     HashBasedBooleanSet* vl = visited_list_pool_->get_free_vislist();
+    RefineStages<float> stages(query, padded_dim_, ex_bits_, refine_stages_);
 
     // Use our bounded priority queue instead of the maxheap.
     buffer::SearchBuffer<float> candidate_set(ef);
@@ -1282,17 +1662,25 @@ inline void HierarchicalNSW::searchBaseLayerST_AdaptiveRerankOptDirect(
 
             if (flag_update_KNNs) {
                 // Compute the full estimate if promising.
-                if (ex_bits_ > 0) {
+                bool kept = true;
+                if (ex_bits_ > 0 && stages.num_stages() > 1 && boundedKNN.size() >= TOPK) {
+                    // stop reading the ex code once the candidate is outside the top-k
+                    kept = get_full_est_progressive<Kernel>(
+                        q_to_centroids, query_wrapper, stages, candidate_id, distk, candest
+                    );
+                } else if (ex_bits_ > 0) {
                     get_full_est_direct<Kernel>(
                         q_to_centroids, query_wrapper, candidate_id, candest
                     );
                 }
-                Candidate cand{
-                    ResultRecord(candest.est_dist, candest.low_dist),
-                    static_cast<PID>(candidate_id)
-                };
-                boundedKNN.insert(cand);
-                distk = boundedKNN.worst().record.est_dist;
+                if (kept) {
+                    Candidate cand{
+                        ResultRecord(candest.est_dist, candest.low_dist),
+                        static_cast<PID>(candidate_id)
+                    };
+                    boundedKNN.insert(cand);
+                    distk = boundedKNN.worst().record.est_dist;
+                }
             }
 
             if (!candidate_set.is_full(candest.est_dist)) {
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace rabitqlib {
+
+namespace holder_impl {
+constexpr size_t kNumReaderStripes = 64;  // num of striped reader counters, power of 2
+
+// each thread is bound to one stripe, so that concurrent readers rarely share a cache line
+inline size_t reader_stripe() {
+    static std::atomic<size_t> next_stripe{0};
+    static thread_local size_t stripe =
+        next_stripe.fetch_add(1, std::memory_order_relaxed) & (kNumReaderStripes - 1);
+    return stripe;
+}
+
+struct alignas(64) ReaderCounter {
+    std::atomic<int64_t> count{0};
+};
+}  // namespace holder_impl
+
+/**
+ * @brief Holder of the current version of an index (IVF, HierarchicalNSW, QuantizedGraph
+ * or any other type). Readers take a cheap snapshot of the current version, a writer
+ * publishes a new version atomically, and the old version is freed once all searches
+ * that may still use it have drained.
+ *
+ * The reclamation is epoch-based (in the spirit of userspace RCU). Each reader registers
+ * itself in a striped counter of the parity of the current epoch. After swapping the
+ * pointer, the writer advances the epoch and waits until the counters of the previous
+ * parity drop to zero. Readers never block, writers are serialized.
+ *
+ * @tparam Index type of the index
+ */
+template <class Index>
+class IndexHolder {
+   private:
+    std::atomic<Index*> current_{nullptr};  // current version of index
+    std::atomic<uint64_t> epoch_{0};        // global epoch, flipped by writers
+    std::array<std::array<holder_impl::ReaderCounter, holder_impl::kNumReaderStripes>, 2>
+        readers_;              // active readers for each epoch parity
+    std::mutex writer_lock_;  // serialize writers
+    std::atomic<uint64_t> version_{0};  // num of published versions
+
+    void enter(size_t stripe, uint64_t& parity) {
+        while (true) {
+            uint64_t epoch = epoch_.load(std::memory_order_seq_cst);
+            parity = epoch & 1;
+            readers_[parity][stripe].count.fetch_add(1, std::memory_order_seq_cst);
+            // writer may flip the epoch between load and increment, retry in this case
+            if (epoch_.load(std::memory_order_seq_cst) == epoch) {
+                return;
+            }
+            readers_[parity][stripe].count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void leave(size_t stripe, uint64_t parity) {
+        readers_[parity][stripe].count.fetch_sub(1, std::memory_order_release);
+    }
+
+    [[nodiscard]] bool drained(uint64_t parity) const {
+        int64_t total = 0;
+        for (const auto& counter : readers_[parity]) {
+            total += counter.count.load(std::memory_order_seq_cst);
+        }
+        return total == 0;
+    }
+
+    // wait for all readers entered before this call, writer_lock_ must be held
+    void wait_readers() {
+        uint64_t old_parity = epoch_.fetch_add(1, std::memory_order_seq_cst) & 1;
+        while (!drained(old_parity)) {
+            std::this_thread::yield();
+        }
+    }
+
+   public:
+    /**
+     * @brief Read-side guard. The index pointed by a snapshot stays alive until the
+     * snapshot is destroyed, even if a new version is published meanwhile.
+     */
+    class Snapshot {
+        friend class IndexHolder;
+
+       private:
+        IndexHolder* holder_ = nullptr;
+        Index* index_ = nullptr;
+        size_t stripe_ = 0;
+        uint64_t parity_ = 0;
+
+        explicit Snapshot(IndexHolder* holder) : holder_(holder) {
+            stripe_ = holder_impl::reader_stripe();
+            holder_->enter(stripe_, parity_);
+            index_ = holder_->current_.load(std::memory_order_acquire);
+        }
+
+        void release() {
+            if (holder_ != nullptr) {
+                holder_->leave(stripe_, parity_);
+                holder_ = nullptr;
+                index_ = nullptr;
+            }
+        }
+
+       public:
+        Snapshot() = default;
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        Snapshot(Snapshot&& other) noexcept
+            : holder_(std::exchange(other.holder_, nullptr))
+            , index_(std::exchange(other.index_, nullptr))
+            , stripe_(other.stripe_)
+            , parity_(other.parity_) {}
+
+        Snapshot& operator=(Snapshot&& other) noexcept {
+            if (this != &other) {
+                release();
+                holder_ = std::exchange(other.holder_, nullptr);
+                index_ = std::exchange(other.index_, nullptr);
+                stripe_ = other.stripe_;
+                parity_ = other.parity_;
+            }
+            return *this;
+        }
+
+        ~Snapshot() { release(); }
+
+        [[nodiscard]] Index* get() const { return index_; }
+
+        Index* operator->() const { return index_; }
+
+        Index& operator*() const { return *index_; }
+
+        explicit operator bool() const { return index_ != nullptr; }
+    };
+
+    explicit IndexHolder() = default;
+
+    explicit IndexHolder(std::unique_ptr<Index> index) : current_(index.release()) {
+        version_ = current_.load() != nullptr ? 1 : 0;
+    }
+
+    IndexHolder(const IndexHolder&) = delete;
+    IndexHolder& operator=(const IndexHolder&) = delete;
+
+    // all snapshots must be released before the holder is destroyed
+    ~IndexHolder() { delete current_.load(); }
+
+    // take a snapshot of current version, wait-free unless racing with a writer
+    [[nodiscard]] Snapshot acquire() { return Snapshot(this); }
+
+    /**
+     * @brief Publish a new version of index. The call returns after all readers that may
+     * still use the old version have drained and the old version is freed. Thus, at most
+     * two versions are alive at the same time.
+     *
+     * @param index new version, nullptr is allowed for unloading the index
+     */
+    void publish(std::unique_ptr<Index> index) {
+        std::lock_guard<std::mutex> lock(writer_lock_);
+        Index* old_index = current_.exchange(index.release(), std::memory_order_acq_rel);
+        wait_readers();
+        delete old_index;
+        version_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Unpublish current version and free it before loading the next one. Queries
+     * issued meanwhile see an empty snapshot. Use this instead of publish() when the old
+     * and the new versions can not be held in memory together.
+     */
+    void retire() { publish(nullptr); }
+
+    // load a new version from file by Index::load() and publish it
+    template <typename... Args>
+    void load_and_publish(const char* filename, Args&&... args) {
+        auto index = std::make_unique<Index>(std::forward<Args>(args)...);
+        index->load(filename);
+        publish(std::move(index));
+    }
+
+    // wait until all readers entered before this call have drained
+    void synchronize() {
+        std::lock_guard<std::mutex> lock(writer_lock_);
+        wait_readers();
+    }
+
+    [[nodiscard]] uint64_t version() const { return version_.load(std::memory_order_relaxed); }
+};
+}  // namespace rabitqlib
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/fastscan/fastscan.hpp"
+#include "rabitqlib/index/hamming.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/memory.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib::ivf {
+/**
+ * @brief IVF over binary vectors (see hamming.hpp for the bit order). Vectors are not
+ * rotated nor quantized, their bits are packed into FastScan batches as 1-bit codes, thus
+ * scanning a cluster costs the same as IVF with 1-bit codes. A binary query gets exact
+ * Hamming distances from FastScan. A float query gets distances to the {-1, 1} vectors
+ * (see AsymmetricQuery), vectors whose FastScan lower bounds are less than the current
+ * k-th distance are re-ranked exactly by their bits, which are also stored in words.
+ *
+ * Centroids are binary vectors as well, e.g., the majority bits of clusters.
+ */
+class BinaryIVF {
+   private:
+    size_t num_ = 0;                      // num of data points
+    size_t dim_ = 0;                      // num of bits of data points
+    size_t padded_dim_ = 0;               // num of bits after padding, multiple of 64
+    size_t num_clusters_ = 0;             // num of clusters
+    std::vector<uint64_t> centroids_;     // centroids in words
+    std::vector<size_t> cluster_starts_;  // first vector of each cluster (num_clusters + 1)
+    std::vector<size_t> batch_starts_;    // first batch of each cluster (num_clusters + 1)
+    std::vector<uint8_t, memory::AlignedAllocator<uint8_t>> batches_;  // FastScan batches
+    std::vector<uint64_t> words_;         // vectors in words, in the order of clusters
+    std::vector<PID> ids_;                // ids of vectors, in the order of clusters
+
+    [[nodiscard]] size_t num_words() const { return padded_dim_ / 64; }
+
+    [[nodiscard]] size_t batch_bytes() const {
+        return padded_dim_ * fastscan::kBatchSize / 8;
+    }
+
+    template <class Query>
+    void search_impl(const Query&, size_t, size_t, PID*, float*) const;
+
+   public:
+    explicit BinaryIVF() = default;
+
+    explicit BinaryIVF(size_t num, size_t dim, size_t num_clusters)
+        : num_(num)
+        , dim_(dim)
+        , padded_dim_(round_up_to_multiple(dim, 64))
+        , num_clusters_(num_clusters) {}
+
+    [[nodiscard]] size_t size() const { return num_; }
+    [[nodiscard]] size_t dimension() const { return dim_; }
+    [[nodiscard]] size_t num_clusters() const { return num_clusters_; }
+
+    void construct(
+        const uint8_t*,
+        const uint8_t*,
+        const PID*,
+        size_t num_threads = std::numeric_limits<size_t>::max()
+    );
+
+    void search(const uint8_t*, size_t, size_t, PID*, float* dists = nullptr) const;
+
+    void search(const float*, size_t, size_t, PID*, float* dists = nullptr) const;
+
+    void save(const char*) const;
+
+    void load(const char*);
+};
+
+/**
+ * @brief Construct the index, vector i gets id i
+ *
+ * @param data packed binary vectors (num * binary_code_bytes(dim))
+ * @param centroids packed binary centroids (num_clusters * binary_code_bytes(dim))
+ * @param cluster_ids cluster of each vector (num)
+ * @param num_threads num of threads for packing clusters
+ */
+inline void BinaryIVF::construct(
+    const uint8_t* data,
+    const uint8_t* centroids,
+    const PID* cluster_ids,
+    size_t num_threads
+) {
+    size_t code_bytes = binary_code_bytes(dim_);
+    std::vector<uint8_t> code(padded_dim_ / 8);
+    centroids_.resize(num_clusters_ * num_words());
+    for (size_t c = 0; c < num_clusters_; ++c) {
+        pad_binary_code(centroids + (c * code_bytes), dim_, padded_dim_, code.data());
+        binary_code_to_words(code.data(), padded_dim_, &centroids_[c * num_words()]);
+    }
+
+    std::vector<std::vector<PID>> members(num_clusters_);
+    for (size_t i = 0; i < num_; ++i) {
+        if (cluster_ids[i] >= num_clusters_) {
+            throw std::invalid_argument("BinaryIVF: bad cluster id");
+        }
+        members[cluster_ids[i]].push_back(static_cast<PID>(i));
+    }
+    cluster_starts_.assign(num_clusters_ + 1, 0);
+    batch_starts_.assign(num_clusters_ + 1, 0);
+    for (size_t c = 0; c < num_clusters_; ++c) {
+        cluster_starts_[c + 1] = cluster_starts_[c] + members[c].size();
+        batch_starts_[c + 1] =
+            batch_starts_[c] + div_round_up(members[c].size(), fastscan::kBatchSize);
+    }
+    batches_.assign(batch_starts_[num_clusters_] * batch_bytes(), 0);
+    words_.resize(num_ * num_words());
+    ids_.resize(num_);
+
+    num_threads = std::max<size_t>(std::min(num_threads, rabitqlib::total_threads()), 1);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t c = 0; c < num_clusters_; ++c) {
+        size_t num = members[c].size();
+        std::vector<uint8_t> codes(num * padded_dim_ / 8);
+        for (size_t i = 0; i < num; ++i) {
+            size_t pos = cluster_starts_[c] + i;
+            uint8_t* cur_code = &codes[i * padded_dim_ / 8];
+            const uint8_t* src = data + (members[c][i] * code_bytes);
+            pad_binary_code(src, dim_, padded_dim_, cur_code);
+            binary_code_to_words(cur_code, padded_dim_, &words_[pos * num_words()]);
+            ids_[pos] = members[c][i];
+        }
+        for (size_t i = 0; i < num; i += fastscan::kBatchSize) {
+            size_t batch = batch_starts_[c] + (i / fastscan::kBatchSize);
+            fastscan::pack_codes(
+                padded_dim_,
+                &codes[i * padded_dim_ / 8],
+                std::min(fastscan::kBatchSize, num - i),
+                &batches_[batch * batch_bytes()]
+            );
+        }
+    }
+}
+
+/**
+ * @brief Search the k nearest neighbors of a binary query by Hamming distance
+ *
+ * @param query packed binary query (binary_code_bytes(dim))
+ * @param k num of nearest neighbors
+ * @param nprobe num of clusters to probe
+ * @param results ids of results (k), kPidMax if fewer than k vectors are found
+ * @param dists Hamming distances of results (k), may be nullptr
+ */
+inline void BinaryIVF::search(
+    const uint8_t* __restrict__ query,
+    size_t k,
+    size_t nprobe,
+    PID* __restrict__ results,
+    float* __restrict__ dists
+) const {
+    search_impl(HammingQuery(query, dim_, padded_dim_), k, nprobe, results, dists);
+}
+
+/**
+ * @brief Search the k nearest neighbors of a float query, distances are those to the
+ * {-1, 1} vectors of binary vectors (see AsymmetricQuery). Parameters are the same as
+ * search() of binary queries.
+ */
+inline void BinaryIVF::search(
+    const float* __restrict__ query,
+    size_t k,
+    size_t nprobe,
+    PID* __restrict__ results,
+    float* __restrict__ dists
+) const {
+    search_impl(AsymmetricQuery(query, dim_, padded_dim_), k, nprobe, results, dists);
+}
+
+template <class Query>
+inline void BinaryIVF::search_impl(
+    const Query& q_obj, size_t k, size_t nprobe, PID* results, float* dists
+) const {
+    std::fill(results, results + k, kPidMax);
+    if (k == 0 || num_clusters_ == 0) {
+        return;
+    }
+    nprobe = std::min(nprobe, num_clusters_);
+    std::vector<AnnCandidate<float>> centroid_dist(num_clusters_);
+    for (size_t c = 0; c < num_clusters_; ++c) {
+        centroid_dist[c].id = static_cast<PID>(c);
+        centroid_dist[c].distance = q_obj.distance(&centroids_[c * num_words()]);
+    }
+    std::partial_sort(
+        centroid_dist.begin(),
+        centroid_dist.begin() + static_cast<long>(nprobe),
+        centroid_dist.end()
+    );
+
+    buffer::SearchBuffer knns(k);
+    std::array<float, fastscan::kBatchSize> est_dist;
+    for (size_t i = 0; i < nprobe; ++i) {
+        size_t c = centroid_dist[i].id;
+        for (size_t batch = batch_starts_[c]; batch < batch_starts_[c + 1]; ++batch) {
+            q_obj.batch_distance(&batches_[batch * batch_bytes()], est_dist.data());
+            size_t begin =
+                cluster_starts_[c] + ((batch - batch_starts_[c]) * fastscan::kBatchSize);
+            size_t num = std::min(fastscan::kBatchSize, cluster_starts_[c + 1] - begin);
+            for (size_t lane = 0; lane < num; ++lane) {
+                float dist = est_dist[lane];
+                if (dist - q_obj.error() >= knns.top_dist()) {
+                    continue;
+                }
+                // estimated distances are re-ranked exactly
+                if (q_obj.error() > 0) {
+                    dist = q_obj.distance(&words_[(begin + lane) * num_words()]);
+                }
+                knns.insert(ids_[begin + lane], dist);
+            }
+        }
+    }
+
+    if (dists != nullptr) {
+        knns.copy_results(results, dists);
+    } else {
+        knns.copy_results(results);
+    }
+}
+
+inline void BinaryIVF::save(const char* filename) const {
+    std::ofstream output(filename, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(&num_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&dim_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&num_clusters_), sizeof(size_t));
+    output.write(
+        reinterpret_cast<const char*>(centroids_.data()),
+        static_cast<long>(sizeof(uint64_t) * centroids_.size())
+    );
+    output.write(
+        reinterpret_cast<const char*>(cluster_starts_.data()),
+        static_cast<long>(sizeof(size_t) * cluster_starts_.size())
+    );
+    output.write(
+        reinterpret_cast<const char*>(ids_.data()),
+        static_cast<long>(sizeof(PID) * ids_.size())
+    );
+    output.write(
+        reinterpret_cast<const char*>(words_.data()),
+        static_cast<long>(sizeof(uint64_t) * words_.size())
+    );
+    output.write(
+        reinterpret_cast<const char*>(batches_.data()), static_cast<long>(batches_.size())
+    );
+    if (!output) {
+        throw std::runtime_error(std::string("failed to write ") + filename);
+    }
+}
+
+inline void BinaryIVF::load(const char* filename) {
+    if (!file_exists(filename)) {
+        throw std::runtime_error(std::string(filename) + " does not exist");
+    }
+    std::ifstream input(filename, std::ios::binary);
+    input.read(reinterpret_cast<char*>(&num_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&dim_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&num_clusters_), sizeof(size_t));
+    padded_dim_ = round_up_to_multiple(dim_, 64);
+
+    centroids_.resize(num_clusters_ * num_words());
+    cluster_starts_.resize(num_clusters_ + 1);
+    ids_.resize(num_);
+    words_.resize(num_ * num_words());
+    input.read(
+        reinterpret_cast<char*>(centroids_.data()),
+        static_cast<long>(sizeof(uint64_t) * centroids_.size())
+    );
+    input.read(
+        reinterpret_cast<char*>(cluster_starts_.data()),
+        static_cast<long>(sizeof(size_t) * cluster_starts_.size())
+    );
+    input.read(reinterpret_cast<char*>(ids_.data()), static_cast<long>(sizeof(PID) * num_));
+    input.read(
+        reinterpret_cast<char*>(words_.data()),
+        static_cast<long>(sizeof(uint64_t) * words_.size())
+    );
+
+    batch_starts_.assign(num_clusters_ + 1, 0);
+    for (size_t c = 0; c < num_clusters_; ++c) {
+        size_t num = cluster_starts_[c + 1] - cluster_starts_[c];
+        batch_starts_[c + 1] = batch_starts_[c] + div_round_up(num, fastscan::kBatchSize);
+    }
+    batches_.resize(batch_starts_[num_clusters_] * batch_bytes());
+    input.read(
+        reinterpret_cast<char*>(batches_.data()), static_cast<long>(batches_.size())
+    );
+    if (input.fail()) {
+        throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+    }
+}
+}  // namespace rabitqlib::ivf
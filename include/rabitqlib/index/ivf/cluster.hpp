@@ -1,14 +1,40 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 
 #include "rabitqlib/defines.hpp"
 
 namespace rabitqlib::ivf {
 
+/**
+ * @brief Memory layout of the clusters of an IVF.
+ *
+ * Separate:    1-bit codes of all batches | ex codes of all vectors | PIDs of all vectors
+ * Interleaved: batch 0 (1-bit codes | ex codes | PIDs) | batch 1 (...) | ...
+ *
+ * With Interleaved, the ex codes and PIDs of the vectors refined after a FastScan batch
+ * are next to the batch itself, instead of in two distant and probably cold regions.
+ */
+enum class ClusterLayout : uint8_t { Separate, Interleaved };
+
+/**
+ * @brief A range of batches of a cluster whose vectors are in a range of norms, for the
+ * norm-range partitioning of METRIC_IP (see IVF::set_norm_buckets()). Vectors of a cluster
+ * are sorted by descending norms, thus the buckets of a cluster are consecutive.
+ */
+struct NormBucket {
+    uint32_t begin;      // 1st batch of the bucket in its cluster
+    uint32_t end;        // end of batches of the bucket in its cluster
+    float max_norm;      // max ||o|| of vectors in the bucket
+    float max_residual;  // max ||o - c|| of vectors in the bucket
+    float max_angular;   // max ||o / ||o|| - c / ||c|||| of vectors in the bucket
+};
+
 /**
  * @brief Cluster is used for ivf index with rabitq+. Components are only used for record
- * the addresses for different part of data.
+ * the addresses for different part of data. With ClusterLayout::Interleaved, batch_data
+ * points to the first batch of the cluster and ex_data is nullptr.
  *
  */
 class Cluster {
@@ -4,6 +4,8 @@
 #include <cstddef>
 #include <cstring>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
@@ -84,8 +86,8 @@ class Initializer {
     virtual void centroids_distances(
         const float*, size_t, std::vector<AnnCandidate<float>>&
     ) const = 0;
-    virtual void load(std::ifstream&, const char*) = 0;
-    virtual void save(std::ofstream&, const char*) const = 0;
+    virtual void load(std::istream&, const char*) = 0;
+    virtual void save(std::ostream&, const char*) const = 0;
 };
 inline Initializer::~Initializer() {}
 
@@ -127,14 +129,14 @@ class FlatInitializer : public Initializer {
     }
 
     // for flat initer, we save & load into the ifstream
-    void save(std::ofstream& output, const char*) const override {
+    void save(std::ostream& output, const char*) const override {
         output.write(
             reinterpret_cast<const char*>(centroids_.data()),
             static_cast<long>(sizeof(float) * dim_ * num_cluster_)
         );
     }
 
-    void load(std::ifstream& input, const char*) override {
+    void load(std::istream& input, const char*) override {
         input.read(
             reinterpret_cast<char*>(centroids_.data()),
             static_cast<long>(sizeof(float) * dim_ * num_cluster_)
@@ -184,14 +186,36 @@ class HNSWInitializer : public Initializer {
         }
     }
 
-    // for hnsw initer, we save & load into a separate file by hnswlib
-    void save(std::ofstream&, const char* filename) const override {
+    // for hnsw initer, we save & load into a separate file by hnswlib. Without a filename
+    // (chunked containers), the hnswlib index is kept in the stream with its size ahead.
+    void save(std::ostream& output, const char* filename) const override {
+        if (filename == nullptr) {
+            std::ostringstream buffer(std::ios::binary);
+            alg_hnsw_->saveIndex(buffer);
+            std::string bytes = buffer.str();
+            size_t num_bytes = bytes.size();
+            output.write(reinterpret_cast<const char*>(&num_bytes), sizeof(size_t));
+            output.write(bytes.data(), static_cast<long>(num_bytes));
+            return;
+        }
         std::string hnsw(filename);
         hnsw += ".hnsw";
         alg_hnsw_->saveIndex(hnsw);
     }
 
-    void load(std::ifstream&, const char* filename) override {
+    void load(std::istream& input, const char* filename) override {
+        if (filename == nullptr) {
+            size_t num_bytes = 0;
+            input.read(reinterpret_cast<char*>(&num_bytes), sizeof(size_t));
+            std::string bytes(num_bytes, '\0');
+            input.read(bytes.data(), static_cast<long>(num_bytes));
+            if (input.fail()) {
+                throw std::runtime_error("unexpected end of data in HNSWInitializer::load");
+            }
+            std::istringstream buffer(bytes, std::ios::binary);
+            alg_hnsw_->loadIndex(buffer, &space_, num_cluster_);
+            return;
+        }
         std::string hnsw(filename);
         hnsw += ".hnsw";
         alg_hnsw_->loadIndex(hnsw, &space_, num_cluster_);
@@ -3,11 +3,18 @@
 #include <omp.h>
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -19,6 +26,7 @@
 #include "rabitqlib/quantization/data_layout.hpp"
 #include "rabitqlib/quantization/rabitq.hpp"
 #include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/chunked_file.hpp"
 #include "rabitqlib/utils/memory.hpp"
 #include "rabitqlib/utils/rotator.hpp"
 #include "rabitqlib/utils/space.hpp"
@@ -41,9 +49,82 @@ class IVF {
     std::vector<Cluster> cluster_lst_;   // List of clusters in ivf
     MetricType metric_type_ = rabitqlib::METRIC_L2;  // metric type
     float (*ip_func_)(const float*, const uint8_t*, size_t) = nullptr;
+    std::vector<PID> id_pos_;             // position of each PID in ids_
+    std::vector<size_t> cluster_starts_;  // position of the 1st vector of each cluster
+    ClusterLayout layout_ = ClusterLayout::Separate;  // layout of clusters
+    size_t refine_stages_ = 1;  // num of stages to read ex codes, see set_refine_stages()
+    double eta_ = 1;            // weight of parallel error of ex codes, see set_score_aware()
+    size_t num_norm_buckets_ = 1;  // max num of norm buckets per cluster, set_norm_buckets()
+    std::vector<NormBucket> norm_buckets_;  // buckets of all clusters, empty if not bucketed
+    std::vector<size_t> bucket_starts_;     // 1st bucket of each cluster (num_cluster_ + 1)
+    size_t num_local_groups_ = 0;  // max num of local rotations, see set_local_rotations()
+    std::vector<uint32_t> local_group_;  // group of each cluster, empty without local rotations
+    std::vector<rotator_impl::LearnedRotator<float>> local_rotators_;  // one for each group
+
+    // tags of optional sections after ids
+    static constexpr uint64_t kNormBucketsTag = 0x5354454B43554252;
+    static constexpr uint64_t kLocalRotationsTag = 0x534E4F495441544F;
+
+    /**
+     * @brief The rotated query and its LUTs in the space where the codes of a cluster are
+     * quantized, i.e., the space of the global rotation, or the local space of the group of
+     * the cluster (see set_local_rotations()).
+     */
+    struct ClusterQuery {
+        std::vector<float> rotated_query;
+        SplitBatchQuery<float> q_obj;
+        RefineStages<float> stages;
+
+        ClusterQuery(std::vector<float> query, const IVF& ivf, bool use_hacc)
+            : rotated_query(std::move(query))
+            , q_obj(
+                  rotated_query.data(),
+                  ivf.padded_dim_,
+                  ivf.ex_bits_,
+                  ivf.metric_type_,
+                  use_hacc
+              )
+            , stages(rotated_query.data(), ivf.padded_dim_, ivf.ex_bits_, ivf.refine_stages_) {}
+    };
+
+    // queries of the clusters visited by a search, the query of a group of clusters is
+    // rotated and gets its LUTs once, then it is shared by all batches of these clusters
+    class ClusterQueries {
+       private:
+        const IVF& ivf_;
+        const float* rotated_query_;
+        bool use_hacc_;
+        std::unique_ptr<ClusterQuery> global_;
+        std::unordered_map<uint32_t, std::unique_ptr<ClusterQuery>> local_;
+
+       public:
+        explicit ClusterQueries(const IVF& ivf, const float* rotated_query, bool use_hacc)
+            : ivf_(ivf), rotated_query_(rotated_query), use_hacc_(use_hacc) {}
+
+        ClusterQuery& of(PID cid) {
+            if (ivf_.local_group_.empty()) {
+                if (!global_) {
+                    global_ = std::make_unique<ClusterQuery>(
+                        std::vector<float>(rotated_query_, rotated_query_ + ivf_.padded_dim_),
+                        ivf_,
+                        use_hacc_
+                    );
+                }
+                return *global_;
+            }
+            uint32_t group = ivf_.local_group_[cid];
+            auto& local = local_[group];
+            if (!local) {
+                std::vector<float> query(ivf_.padded_dim_);
+                ivf_.local_rotators_[group].rotate(rotated_query_, query.data());
+                local = std::make_unique<ClusterQuery>(std::move(query), ivf_, use_hacc_);
+            }
+            return *local;
+        }
+    };
 
     void quantize_cluster(
-        Cluster&,
+        PID,
         const std::vector<PID>&,
         const float*,
         const float*,
@@ -60,34 +141,145 @@ class IVF {
         for (auto size : cluster_sizes) {
             total_blocks += div_round_up(size, fastscan::kBatchSize);
         }
-        return total_blocks * BatchDataMap<float>::data_bytes(padded_dim_);
+        return total_blocks * batch_stride();
     }
 
+    // num of bytes of ex codes in ex_data_, 0 for ClusterLayout::Interleaved
     [[nodiscard]] size_t ex_data_bytes() const {
+        if (layout_ == ClusterLayout::Interleaved) {
+            return 0;
+        }
         return ExDataMap<float>::data_bytes(padded_dim_, ex_bits_) * num_;
     }
 
+    // distance between consecutive batches of a cluster in batch_data_, for
+    // ClusterLayout::Interleaved, a batch is followed by the ex codes and PIDs of its vectors
+    [[nodiscard]] size_t batch_stride() const {
+        size_t bytes = BatchDataMap<float>::data_bytes(padded_dim_);
+        if (layout_ == ClusterLayout::Interleaved) {
+            bytes += (ExDataMap<float>::data_bytes(padded_dim_, ex_bits_) + sizeof(PID)) *
+                     fastscan::kBatchSize;
+            bytes = round_up_to_multiple(bytes, 64);
+        }
+        return bytes;
+    }
+
+    // 1-bit codes and factors of the batch-th batch of a cluster
+    [[nodiscard]] char* batch_of(const Cluster& cp, size_t batch) const {
+        return cp.batch_data() + (batch * batch_stride());
+    }
+
+    // ex code of the 1st vector of a batch, ex codes of a batch are consecutive
+    [[nodiscard]] char* batch_ex_data(const Cluster& cp, size_t batch) const {
+        size_t ex_bytes = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+        if (layout_ == ClusterLayout::Interleaved) {
+            return batch_of(cp, batch) + BatchDataMap<float>::data_bytes(padded_dim_);
+        }
+        return cp.ex_data() + (batch * fastscan::kBatchSize * ex_bytes);
+    }
+
+    // PIDs of the vectors of a batch
+    [[nodiscard]] PID* batch_ids(const Cluster& cp, size_t batch) const {
+        if (layout_ == ClusterLayout::Interleaved) {
+            size_t ex_bytes = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+            return reinterpret_cast<PID*>(
+                batch_ex_data(cp, batch) + (fastscan::kBatchSize * ex_bytes)
+            );
+        }
+        return cp.ids() + (batch * fastscan::kBatchSize);
+    }
+
+    // ex code of the offset-th vector of a cluster
+    [[nodiscard]] char* ex_data_at(const Cluster& cp, size_t offset) const {
+        size_t ex_bytes = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+        return batch_ex_data(cp, offset / fastscan::kBatchSize) +
+               ((offset % fastscan::kBatchSize) * ex_bytes);
+    }
+
+    void interleave_ids(const Cluster&) const;
+
+    std::vector<std::vector<PID>> load_cluster_ids(const PID*, std::vector<size_t>&) const;
+
     void allocate_memory(const std::vector<size_t>&);
 
     void init_clusters(const std::vector<size_t>&);
 
+    void init_id_map();
+
+    void init_norm_buckets(std::vector<std::vector<PID>>&, const float*, const float*);
+
+    void init_local_rotations(
+        const std::vector<std::vector<PID>>&, const float*, const float*, size_t
+    );
+
+    void train_rotator(const float*, const float*, const PID*);
+
+    void reconstruct_rotated(size_t, float*) const;
+
+    [[nodiscard]] float ex_error_factor(const Cluster&, size_t) const;
+
+    [[nodiscard]] float exact_ip_x0_qr(const char*, size_t, const float*) const;
+
+    [[nodiscard]] PID locate_cluster(size_t pos) const {
+        auto it = std::upper_bound(cluster_starts_.begin(), cluster_starts_.end(), pos);
+        return static_cast<PID>(it - cluster_starts_.begin() - 1);
+    }
+
+    [[nodiscard]] IndexFileMeta file_meta() const {
+        return {IndexFileType::IVF, dim_, metric_type_, ex_bits_ + 1, type_};
+    }
+
+    // chunked: the initializer is kept in the stream, not in a file beside the index
+    void save_stream(std::ostream&, const char*, bool chunked = false) const;
+
+    void load_stream(std::istream&, const char*, bool chunked = false);
+
     void free_memory() {
         ::delete initer_;
         std::free(batch_data_);
         std::free(ex_data_);
         std::free(ids_);
+        initer_ = nullptr;
+        batch_data_ = nullptr;
+        ex_data_ = nullptr;
+        ids_ = nullptr;
     }
 
+    void score_ids_impl(
+        const float*, const PID*, size_t, float*, DistBound*, ScoreMode, const float*, bool
+    ) const;
+
+    template <class Buffer>
+    void search_clusters(const float*, size_t, Buffer&, bool) const;
+
+    template <class Buffer>
+    void search_norm_buckets(
+        const float*,
+        const std::vector<AnnCandidate<float>>&,
+        ClusterQueries&,
+        Buffer&,
+        bool
+    ) const;
+
+    template <class Buffer>
     void search_cluster(
-        const Cluster&, const SplitBatchQuery<float>&, buffer::SearchBuffer<float>&, bool
+        const Cluster&,
+        const SplitBatchQuery<float>&,
+        const RefineStages<float>&,
+        Buffer&,
+        bool,
+        size_t begin = 0,
+        size_t end = std::numeric_limits<size_t>::max()
     ) const;
 
+    template <class Buffer>
     void scan_one_batch(
         const char* batch_data,
         const char* ex_data,
         const PID* ids,
         const SplitBatchQuery<float>& q_obj,
-        buffer::SearchBuffer<float>& knns,
+        const RefineStages<float>& stages,
+        Buffer& knns,
         size_t num_points,
         bool
     ) const;
@@ -100,7 +292,8 @@ class IVF {
         size_t,
         size_t,
         MetricType metric_type = rabitqlib::METRIC_L2,
-        RotatorType type = RotatorType::FhtKacRotator
+        RotatorType type = RotatorType::FhtKacRotator,
+        ClusterLayout layout = ClusterLayout::Separate
     );
 
     ~IVF();
@@ -110,17 +303,89 @@ class IVF {
     [[nodiscard]] size_t nbits() const { return ex_bits_ + 1; }
     [[nodiscard]] MetricType metric_type() const { return metric_type_; }
     [[nodiscard]] RotatorType rotator_type() const { return type_; }
+    [[nodiscard]] ClusterLayout layout() const { return layout_; }
+    [[nodiscard]] size_t refine_stages() const { return refine_stages_; }
+
+    /**
+     * @brief Read the ex code of a candidate in num_stages stages of dims during search,
+     * the candidate is dropped once its lower bound after a stage is outside the top-k, see
+     * RefineStages. 1 (by default) reads the whole ex code. Codes of more than 8 ex_bits
+     * always use 1 stage.
+     */
+    void set_refine_stages(size_t num_stages) { refine_stages_ = num_stages; }
+
+    /**
+     * @brief Quantize ex codes of METRIC_IP indices by the score-aware (anisotropic) loss,
+     * which weights the error parallel to each data vector by eta, see
+     * quant::anisotropic_eta(). Set before construction, 1 (by default) for the plain codes.
+     * It is ignored for METRIC_L2.
+     */
+    void set_score_aware(double eta) { eta_ = eta; }
+
+    void set_rotator_rounds(size_t rounds);
+
+    [[nodiscard]] size_t norm_buckets() const { return num_norm_buckets_; }
+
+    void set_norm_buckets(size_t num_buckets);
+
+    [[nodiscard]] size_t local_rotations() const { return local_rotators_.size(); }
 
-    void construct(const float*, const float*, const PID*, bool, size_t);
+    void set_local_rotations(size_t num_groups);
+
+    void construct(
+        const float*, const float*, const PID*, bool, size_t, const ProgressFunc&
+    );
+
+    void construct_chunked(
+        const float*, const PID*, const ChunkFunc&, bool, size_t, const ProgressFunc&
+    );
 
     void save(const char*) const;
 
-    void load(const char*);
+    void save_compressed(const char*, const ChunkedFileConfig& config = {}) const;
+
+    void load(
+        const char*,
+        size_t num_threads = 0,
+        ClusterLayout layout = ClusterLayout::Separate
+    );
 
     void search(const float*, size_t, size_t, PID*, bool) const;
 
     void search(const float*, size_t, size_t, PID*, float*, bool) const;
 
+    [[nodiscard]] std::vector<buffer::GroupHits<float>> search_grouped(
+        const float*, size_t, size_t, size_t, const PID*, bool use_hacc = true
+    ) const;
+
+    void search_with_bounds(
+        const float*, size_t, size_t, PID*, DistBound*, bool use_hacc = true
+    ) const;
+
+    void score_ids(
+        const float*,
+        const PID*,
+        size_t,
+        float*,
+        ScoreMode mode = SCORE_FULL_BITS,
+        const float* data = nullptr,
+        bool use_hacc = true
+    ) const;
+
+    void score_ids(
+        const float*,
+        const PID*,
+        size_t,
+        DistBound*,
+        ScoreMode mode = SCORE_FULL_BITS,
+        const float* data = nullptr,
+        bool use_hacc = true
+    ) const;
+
+    void reconstruct(PID, float*) const;
+
+    void reconstruct_batch(const PID*, size_t, float*, size_t num_threads = 1) const;
+
     [[nodiscard]] size_t padded_dim() const { return this->padded_dim_; }
 
     [[nodiscard]] size_t num_clusters() const { return this->num_cluster_; }
@@ -132,7 +397,8 @@ inline IVF::IVF(
     size_t cluster_num,
     size_t bits,
     MetricType metric_type,
-    RotatorType type
+    RotatorType type,
+    ClusterLayout layout
 )
     : num_(n)
     , dim_(dim)
@@ -140,57 +406,87 @@ inline IVF::IVF(
     , num_cluster_(cluster_num)
     , ex_bits_(bits - 1)
     , type_(type)
-    , metric_type_(metric_type) {
-    if (bits < 1 || bits > 9) {
+    , metric_type_(metric_type)
+    , layout_(layout) {
+    if (bits < 1 || bits > 16) {
         std::cerr << "Invalid number of bits for quantization in IVF::IVF\n";
-        std::cerr << "Expected: 1 to 9  Input:" << bits << '\n';
+        std::cerr << "Expected: 1 to 16  Input:" << bits << '\n';
         std::cerr.flush();
         exit(1);
     };
-    rotator_ = choose_rotator<float>(dim, type, round_up_to_multiple(dim_, 64));
+    rotator_ = choose_rotator<float>(dim, type, index_padded_dim(dim_, type));
     padded_dim_ = rotator_->size();
     /* check size */
     assert(padded_dim_ % 64 == 0);
     assert(padded_dim_ >= dim_);
 }
 
+/**
+ * @brief Redraw the rotator of FhtKacRotator or SorfRotator with the given num of rounds,
+ * 0 for the default. Fewer rounds rotate queries faster but mix the coordinates less,
+ * see docs/rabitq/rotator.md. Set before construct(), the rounds are saved with the
+ * rotator.
+ */
+inline void IVF::set_rotator_rounds(size_t rounds) {
+    if (type_ != RotatorType::FhtKacRotator && type_ != RotatorType::SorfRotator) {
+        throw std::invalid_argument(
+            "IVF::set_rotator_rounds is only for FhtKacRotator and SorfRotator"
+        );
+    }
+    Rotator<float>* rotator = choose_rotator<float>(dim_, type_, padded_dim_, rounds);
+    delete rotator_;
+    rotator_ = rotator;
+}
+
 inline IVF::~IVF() {
     delete rotator_;
     free_memory();
 }
 
 /**
- * @brief Construct clusters in IVF
+ * @brief Construct clusters in IVF. A LearnedRotator is trained on the residuals of data to
+ * their centroids at first, and so are the local rotations if they are set.
  *
  * @param data Data objects (N*DIM)
  * @param centroids Centroid vectors (K*DIM)
  * @param clustter_ids Cluster ID for each data objects
+ * @param progress called after each group of clusters is quantized, may be empty
  */
 inline void IVF::construct(
-    const float* data, const float* centroids, const PID* cluster_ids, bool faster = false,
-    size_t num_threads = std::numeric_limits<size_t>::max()
+    const float* data,
+    const float* centroids,
+    const PID* cluster_ids,
+    bool faster = false,
+    size_t num_threads = std::numeric_limits<size_t>::max(),
+    const ProgressFunc& progress = {}
 ) {
     std::cout << "Start IVF construction...\n";
 
-    // get id list for each cluster
-    std::cout << "\tLoading clustering information...\n";
-    std::vector<size_t> counts(num_cluster_, 0);
-    std::vector<std::vector<PID>> id_lists(num_cluster_);
-    for (size_t i = 0; i < num_; ++i) {
-        PID cid = cluster_ids[i];
-        if (cid > num_cluster_) {
-            std::cerr << "Bad cluster id\n";
-            exit(1);
-        }
-        id_lists[cid].push_back(static_cast<PID>(i));
-        counts[cid] += 1;
-    }
+    std::vector<size_t> counts;
+    std::vector<std::vector<PID>> id_lists = load_cluster_ids(cluster_ids, counts);
 
+    free_memory();  // memory of a previous construction or a loaded index
     allocate_memory(counts);
 
     // init the cluster list
     init_clusters(counts);
 
+    if (type_ == RotatorType::LearnedRotator) {
+        train_rotator(data, centroids, cluster_ids);
+    }
+
+    norm_buckets_.clear();
+    bucket_starts_.clear();
+    if (num_norm_buckets_ > 1) {
+        init_norm_buckets(id_lists, data, centroids);
+    }
+
+    local_group_.clear();
+    local_rotators_.clear();
+    if (num_local_groups_ > 0) {
+        init_local_rotations(id_lists, data, centroids, num_threads);
+    }
+
     // all rotated centroids
     std::vector<float> rotated_centroids(num_cluster_ * padded_dim_);
 
@@ -198,18 +494,199 @@ inline void IVF::construct(
     if (faster) {
         config = quant::faster_config(padded_dim_, ex_bits_ + 1);
     }
+    config.eta = eta_;
 
     num_threads = std::min(num_threads, rabitqlib::total_threads());
-    /* Quantize each cluster */
+    /* Quantize each cluster, by groups of clusters if the progress is reported */
+    size_t step = progress ? std::max(num_threads * 4, num_cluster_ / 100) : num_cluster_;
+    size_t num_done = 0;
+    for (size_t begin = 0; begin < num_cluster_; begin += step) {
+        size_t end = std::min(begin + step, num_cluster_);
 #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (size_t i = begin; i < end; ++i) {
+            const float* cur_centroid = centroids + (i * dim_);
+            float* cur_rotated_c = &rotated_centroids[i * padded_dim_];
+            quantize_cluster(
+                static_cast<PID>(i), id_lists[i], data, cur_centroid, cur_rotated_c, config
+            );
+        }
+        if (progress) {
+            for (size_t i = begin; i < end; ++i) {
+                num_done += counts[i];
+            }
+            progress(num_done, num_);
+        }
+    }
+
+    this->initer_->add_vectors(rotated_centroids.data(), num_threads);
+
+    init_id_map();
+}
+
+/**
+ * @brief Construct clusters in IVF from data given in chunks of consecutive rows, e.g.,
+ * slices of a memory-mapped file, thus the data never needs to be in memory as a whole.
+ * Rows are rotated as they arrive and buffered by clusters, a FastScan batch of a cluster
+ * is quantized once it is full or the cluster is complete. Thus at most K * 32 rotated
+ * vectors are buffered, and the index is the same as the one by construct(). Rows are
+ * rotated before the whole data is seen, thus a LearnedRotator keeps its random initial
+ * rotation. Norm buckets and local rotations need a whole cluster, thus they are not
+ * supported.
+ *
+ * @param centroids Centroid vectors (K*DIM)
+ * @param cluster_ids Cluster ID for each data objects (N)
+ * @param next_chunk gives the chunks of data objects in order, N rows in total
+ * @param progress called after each chunk is processed, may be empty
+ */
+inline void IVF::construct_chunked(
+    const float* centroids,
+    const PID* cluster_ids,
+    const ChunkFunc& next_chunk,
+    bool faster = false,
+    size_t num_threads = std::numeric_limits<size_t>::max(),
+    const ProgressFunc& progress = {}
+) {
+    std::cout << "Start IVF construction from chunks...\n";
+    if (num_norm_buckets_ > 1) {
+        throw std::invalid_argument("IVF::construct_chunked does not support norm buckets");
+    }
+    if (num_local_groups_ > 0) {
+        throw std::invalid_argument(
+            "IVF::construct_chunked does not support local rotations"
+        );
+    }
+    norm_buckets_.clear();
+    bucket_starts_.clear();
+    local_group_.clear();
+    local_rotators_.clear();
+
+    std::vector<size_t> counts;
+    std::vector<std::vector<PID>> id_lists = load_cluster_ids(cluster_ids, counts);
+
+    free_memory();  // memory of a previous construction or a loaded index
+    allocate_memory(counts);
+
+    init_clusters(counts);
+
+    quant::RabitqConfig config;
+    if (faster) {
+        config = quant::faster_config(padded_dim_, ex_bits_ + 1);
+    }
+    config.eta = eta_;
+
+    num_threads = std::min(num_threads, rabitqlib::total_threads());
+    std::vector<float> rotated_centroids(num_cluster_ * padded_dim_);
     for (size_t i = 0; i < num_cluster_; ++i) {
-        const float* cur_centroid = centroids + (i * dim_);
-        float* cur_rotated_c = &rotated_centroids[i * padded_dim_];
-        Cluster& cp = cluster_lst_[i];
-        quantize_cluster(cp, id_lists[i], data, cur_centroid, cur_rotated_c, config);
+        std::copy(id_lists[i].begin(), id_lists[i].end(), cluster_lst_[i].ids());
+        interleave_ids(cluster_lst_[i]);
+        rotator_->rotate(centroids + (i * dim_), &rotated_centroids[i * padded_dim_]);
+    }
+
+    std::vector<std::vector<float>> pending(num_cluster_);  // rotated vectors to quantize
+    std::vector<size_t> num_quantized(num_cluster_, 0);
+    std::vector<size_t> num_arrived(num_cluster_, 0);
+
+    size_t num_rows = 0;
+    std::vector<float> rotated_rows;
+    while (true) {
+        const float* rows = nullptr;
+        size_t num = next_chunk(rows);
+        if (num == 0) {
+            break;
+        }
+        if (num_rows + num > num_) {
+            throw std::invalid_argument(
+                "IVF::construct_chunked: more data rows than " + std::to_string(num_)
+            );
+        }
+
+        rotated_rows.resize(num * padded_dim_);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (size_t i = 0; i < num; ++i) {
+            rotator_->rotate(rows + (i * dim_), &rotated_rows[i * padded_dim_]);
+        }
+
+        std::vector<PID> ready;  // clusters with full batches or all vectors arrived
+        for (size_t i = 0; i < num; ++i) {
+            PID cid = cluster_ids[num_rows + i];
+            const float* cur = &rotated_rows[i * padded_dim_];
+            pending[cid].insert(pending[cid].end(), cur, cur + padded_dim_);
+            ++num_arrived[cid];
+            size_t num_pending = pending[cid].size() / padded_dim_;
+            if (num_pending == fastscan::kBatchSize || num_arrived[cid] == counts[cid]) {
+                ready.push_back(cid);
+            }
+        }
+        num_rows += num;
+
+        std::sort(ready.begin(), ready.end());
+        ready.erase(std::unique(ready.begin(), ready.end()), ready.end());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (size_t j = 0; j < ready.size(); ++j) {
+            PID cid = ready[j];
+            Cluster& cp = cluster_lst_[cid];
+            size_t num_pending = pending[cid].size() / padded_dim_;
+            if (num_arrived[cid] != counts[cid]) {
+                num_pending -= num_pending % fastscan::kBatchSize;
+            }
+            for (size_t k = 0; k < num_pending; k += fastscan::kBatchSize) {
+                size_t done = num_quantized[cid];
+                quant::quantize_split_batch(
+                    pending[cid].data() + (k * padded_dim_),
+                    &rotated_centroids[cid * padded_dim_],
+                    std::min(fastscan::kBatchSize, num_pending - k),
+                    padded_dim_,
+                    ex_bits_,
+                    batch_of(cp, done / fastscan::kBatchSize),
+                    ex_data_at(cp, done),
+                    metric_type_,
+                    config
+                );
+                num_quantized[cid] += std::min(fastscan::kBatchSize, num_pending - k);
+            }
+            pending[cid].erase(
+                pending[cid].begin(),
+                pending[cid].begin() + static_cast<std::ptrdiff_t>(num_pending * padded_dim_)
+            );
+            if (pending[cid].empty()) {
+                pending[cid].shrink_to_fit();
+            }
+        }
+
+        if (progress) {
+            progress(num_rows, num_);
+        }
+    }
+
+    if (num_rows != num_) {
+        throw std::invalid_argument(
+            "IVF::construct_chunked: " + std::to_string(num_rows) + " data rows, expected " +
+            std::to_string(num_)
+        );
     }
 
     this->initer_->add_vectors(rotated_centroids.data(), num_threads);
+
+    init_id_map();
+}
+
+// id list and size of each cluster
+inline std::vector<std::vector<PID>> IVF::load_cluster_ids(
+    const PID* cluster_ids, std::vector<size_t>& counts
+) const {
+    std::cout << "\tLoading clustering information...\n";
+    counts.assign(num_cluster_, 0);
+    std::vector<std::vector<PID>> id_lists(num_cluster_);
+    for (size_t i = 0; i < num_; ++i) {
+        PID cid = cluster_ids[i];
+        if (cid > num_cluster_) {
+            std::cerr << "Bad cluster id\n";
+            exit(1);
+        }
+        id_lists[cid].push_back(static_cast<PID>(i));
+        counts[cid] += 1;
+    }
+    return id_lists;
 }
 
 inline void IVF::allocate_memory(const std::vector<size_t>& cluster_sizes) {
@@ -221,7 +698,7 @@ inline void IVF::allocate_memory(const std::vector<size_t>& cluster_sizes) {
     }
     this->batch_data_ =
         memory::align_allocate<64, char, true>(batch_data_bytes(cluster_sizes));
-    if (ex_bits_ > 0) {
+    if (ex_data_bytes() > 0) {
         this->ex_data_ = memory::align_allocate<64, char, true>(ex_data_bytes());
     }
     this->ids_ = memory::align_allocate<64, PID, true>(ids_bytes());
@@ -233,6 +710,7 @@ inline void IVF::allocate_memory(const std::vector<size_t>& cluster_sizes) {
  * @brief intialize the cluster list: finding idx for all data
  */
 inline void IVF::init_clusters(const std::vector<size_t>& cluster_sizes) {
+    this->cluster_lst_.clear();  // clusters of a previously loaded index
     this->cluster_lst_.reserve(num_cluster_);
     size_t added_vectors = 0;
     size_t added_batches = 0;
@@ -241,11 +719,12 @@ inline void IVF::init_clusters(const std::vector<size_t>& cluster_sizes) {
         size_t num = cluster_sizes[i];
         size_t num_batches = div_round_up(num, fastscan::kBatchSize);
 
-        char* current_batch_data =
-            batch_data_ + (BatchDataMap<float>::data_bytes(padded_dim_) * added_batches);
+        char* current_batch_data = batch_data_ + (batch_stride() * added_batches);
         char* current_ex_data =
-            ex_data_ +
-            (added_vectors * ExDataMap<float>::data_bytes(padded_dim_, ex_bits_));
+            layout_ == ClusterLayout::Interleaved
+                ? nullptr
+                : ex_data_ +
+                      (added_vectors * ExDataMap<float>::data_bytes(padded_dim_, ex_bits_));
         PID* ids = ids_ + added_vectors;
 
         Cluster cur_cluster(num, current_batch_data, current_ex_data, ids);
@@ -256,14 +735,206 @@ inline void IVF::init_clusters(const std::vector<size_t>& cluster_sizes) {
     }
 }
 
+/**
+ * @brief build the map from PID to its position in ids_, used by score_ids()
+ */
+inline void IVF::init_id_map() {
+    cluster_starts_.resize(num_cluster_);
+    for (size_t i = 0; i < num_cluster_; ++i) {
+        cluster_starts_[i] = static_cast<size_t>(cluster_lst_[i].ids() - ids_);
+    }
+
+    id_pos_.assign(num_, kPidMax);
+    for (size_t pos = 0; pos < num_; ++pos) {
+        PID id = ids_[pos];
+        if (id < num_) {
+            id_pos_[id] = static_cast<PID>(pos);
+        }
+    }
+}
+
+/**
+ * @brief Partition each cluster of a METRIC_IP index by norm ranges. At construction,
+ * vectors of a cluster are sorted by descending norms and split into at most num_buckets
+ * buckets of whole FastScan batches. Each bucket keeps the max norm, the max residual
+ * norm and the max distance between the unit vectors of o and c, which give 3 upper
+ * bounds of <q, o> for the vectors of the bucket: ||q|| * max_norm, <q, c> + ||q|| *
+ * max_residual and max_norm * max(<q, c / ||c||> + ||q|| * max_angular, 0). Search visits
+ * the buckets of the probed clusters in descending order of the smallest bound and stops
+ * at the first bucket that cannot reach the k-th result, thus the buckets of small norms
+ * are skipped as a whole. With one cluster, the index is a plain norm-range partitioning.
+ * 1 (by default) keeps the clusters whole. Set before construct(), the buckets are saved
+ * with the index.
+ */
+inline void IVF::set_norm_buckets(size_t num_buckets) {
+    if (metric_type_ != METRIC_IP && num_buckets > 1) {
+        throw std::invalid_argument("IVF::set_norm_buckets is only for METRIC_IP");
+    }
+    num_norm_buckets_ = std::max<size_t>(num_buckets, 1);
+}
+
+// sort vectors of each cluster by descending norms and split them into norm buckets
+inline void IVF::init_norm_buckets(
+    std::vector<std::vector<PID>>& id_lists, const float* data, const float* centroids
+) {
+    bucket_starts_.assign(1, 0);
+    for (size_t i = 0; i < num_cluster_; ++i) {
+        std::vector<PID>& ids = id_lists[i];
+        const float* centroid = centroids + (i * dim_);
+        float centroid_norm = std::sqrt(l2norm_sqr(centroid, dim_));
+        std::vector<std::pair<float, PID>> norms(ids.size());
+        for (size_t j = 0; j < ids.size(); ++j) {
+            norms[j] = {std::sqrt(l2norm_sqr(data + (ids[j] * dim_), dim_)), ids[j]};
+        }
+        std::sort(norms.begin(), norms.end(), std::greater<>());
+        for (size_t j = 0; j < ids.size(); ++j) {
+            ids[j] = norms[j].second;
+        }
+
+        size_t num_batches = div_round_up(ids.size(), fastscan::kBatchSize);
+        size_t num_buckets = std::min(num_norm_buckets_, num_batches);
+        for (size_t b = 0; b < num_buckets; ++b) {
+            NormBucket bucket{
+                static_cast<uint32_t>(b * num_batches / num_buckets),
+                static_cast<uint32_t>((b + 1) * num_batches / num_buckets),
+                0,
+                0,
+                0
+            };
+            size_t end = std::min<size_t>(bucket.end * fastscan::kBatchSize, ids.size());
+            bucket.max_norm = norms[bucket.begin * fastscan::kBatchSize].first;
+            for (size_t j = bucket.begin * fastscan::kBatchSize; j < end; ++j) {
+                const float* vec = data + (ids[j] * dim_);
+                float residual = std::sqrt(euclidean_sqr(vec, centroid, dim_));
+                bucket.max_residual = std::max(bucket.max_residual, residual);
+                // 2 bounds unit vectors, also for zero vectors and zero centroids
+                float angular = 2;
+                if (norms[j].first > 0 && centroid_norm > 0) {
+                    float cos = dot_product(vec, centroid, dim_) / norms[j].first /
+                                centroid_norm;
+                    angular = std::sqrt(std::max(2 - (2 * cos), 0.0F));
+                }
+                bucket.max_angular = std::max(bucket.max_angular, angular);
+            }
+            norm_buckets_.push_back(bucket);
+        }
+        bucket_starts_.push_back(norm_buckets_.size());
+    }
+}
+
+/**
+ * @brief Learn a local rotation for each group of clusters, on top of the global rotation.
+ * Residuals of clusters differ in their spectra (e.g., some clusters are of low rank), thus
+ * a LearnedRotator trained on the residuals of a group suits its codes better than a
+ * rotation shared by all clusters. Clusters are assigned to the nearest of num_groups
+ * evenly picked centroids, num_groups >= num of clusters gives a rotation for each cluster,
+ * and 0 (by default) disables local rotations. A search rotates the query once for each
+ * group it visits, which is a product of padded_dim^2 and is shared by all batches of the
+ * clusters in the group. Each rotation keeps padded_dim^2 floats. A rotation trained on a
+ * few hundred vectors is biased for far queries, thus groups of several clusters are
+ * preferred to a rotation for each cluster. Set before construct(), the rotations are saved
+ * with the index.
+ */
+inline void IVF::set_local_rotations(size_t num_groups) { num_local_groups_ = num_groups; }
+
+// group clusters and train the rotation of each group on the globally rotated residuals
+inline void IVF::init_local_rotations(
+    const std::vector<std::vector<PID>>& id_lists,
+    const float* data,
+    const float* centroids,
+    size_t num_threads
+) {
+    size_t num_groups = std::min(num_local_groups_, num_cluster_);
+    local_group_.resize(num_cluster_);
+    std::vector<std::vector<PID>> group_clusters(num_groups);
+    for (size_t i = 0; i < num_cluster_; ++i) {
+        uint32_t group = static_cast<uint32_t>(i);
+        if (num_groups < num_cluster_) {
+            float best = std::numeric_limits<float>::max();
+            for (size_t g = 0; g < num_groups; ++g) {
+                const float* seed = centroids + ((g * num_cluster_ / num_groups) * dim_);
+                float dist = euclidean_sqr(centroids + (i * dim_), seed, dim_);
+                if (dist < best) {
+                    best = dist;
+                    group = static_cast<uint32_t>(g);
+                }
+            }
+        }
+        local_group_[i] = group;
+        group_clusters[group].push_back(static_cast<PID>(i));
+    }
+
+    local_rotators_.clear();
+    for (size_t g = 0; g < num_groups; ++g) {
+        local_rotators_.emplace_back(padded_dim_, padded_dim_);
+    }
+
+    num_threads = std::min(num_threads, rabitqlib::total_threads());
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t g = 0; g < num_groups; ++g) {
+        // residuals of evenly sampled vectors in the group
+        size_t num_vecs = 0;
+        for (PID cid : group_clusters[g]) {
+            num_vecs += id_lists[cid].size();
+        }
+        size_t num_sample =
+            std::min(num_vecs, rotator_impl::LearnedRotator<float>::kMaxTrainSize);
+        std::vector<float> residuals(num_sample * dim_);
+        size_t cur = 0;    // index of the next sampled vector in the group
+        size_t start = 0;  // index of the 1st vector of the current cluster in the group
+        for (PID cid : group_clusters[g]) {
+            const float* centroid = centroids + (cid * dim_);
+            const std::vector<PID>& ids = id_lists[cid];
+            for (; cur < num_sample && cur * num_vecs / num_sample < start + ids.size();
+                 ++cur) {
+                const float* vec = data + (ids[(cur * num_vecs / num_sample) - start] * dim_);
+                for (size_t j = 0; j < dim_; ++j) {
+                    residuals[(cur * dim_) + j] = vec[j] - centroid[j];
+                }
+            }
+            start += ids.size();
+        }
+
+        std::vector<float> rotated(num_sample * padded_dim_);
+        rotator_->rotate_batch(residuals.data(), num_sample, rotated.data());
+        local_rotators_[g].train(
+            rotated.data(),
+            num_sample,
+            quant::scalar_reconstructor<float>(padded_dim_, ex_bits_ + 1)
+        );
+    }
+}
+
+// learn the rotation from residuals of evenly sampled data to their centroids, which are
+// the vectors quantized by RaBitQ
+inline void IVF::train_rotator(
+    const float* data, const float* centroids, const PID* cluster_ids
+) {
+    size_t num_sample = std::min(num_, rotator_impl::LearnedRotator<float>::kMaxTrainSize);
+    std::vector<float> residuals(num_sample * dim_);
+    for (size_t i = 0; i < num_sample; ++i) {
+        size_t id = i * num_ / num_sample;
+        const float* centroid = centroids + (cluster_ids[id] * dim_);
+        for (size_t j = 0; j < dim_; ++j) {
+            residuals[(i * dim_) + j] = data[(id * dim_) + j] - centroid[j];
+        }
+    }
+    rotator_->train(
+        residuals.data(),
+        num_sample,
+        quant::scalar_reconstructor<float>(padded_dim_, ex_bits_ + 1)
+    );
+}
+
 inline void IVF::quantize_cluster(
-    Cluster& cp,
+    PID cid,
     const std::vector<PID>& IDs,
     const float* data,
     const float* cur_centroid,
     float* rotated_centroid,
     const quant::RabitqConfig& config
 ) {
+    Cluster& cp = cluster_lst_[cid];
     size_t num_points = IDs.size();
     if (cp.num() != num_points) {
         std::cerr << "Size of cluster and IDs are inequivalent\n";
@@ -278,30 +949,53 @@ inline void IVF::quantize_cluster(
     this->rotator_->rotate(cur_centroid, rotated_centroid);
 
     // rotate vectors for this cluster
-    std::vector<float> rotated_data(padded_dim_ * num_points);
+    std::vector<float> cluster_data(dim_ * num_points);
     for (size_t i = 0; i < num_points; ++i) {
-        rotator_->rotate(data + (IDs[i] * dim_), rotated_data.data() + (i * padded_dim_));
+        std::copy_n(data + (IDs[i] * dim_), dim_, &cluster_data[i * dim_]);
+    }
+    std::vector<float> rotated_data(padded_dim_ * num_points);
+    rotator_->rotate_batch(cluster_data.data(), num_points, rotated_data.data());
+
+    // codes are quantized in the local space of the cluster, if any
+    const float* code_centroid = rotated_centroid;
+    std::vector<float> local_centroid;
+    if (!local_group_.empty()) {
+        const auto& local_rotator = local_rotators_[local_group_[cid]];
+        local_centroid.resize(padded_dim_);
+        local_rotator.rotate(rotated_centroid, local_centroid.data());
+        code_centroid = local_centroid.data();
+        std::vector<float> local_data(padded_dim_ * num_points);
+        local_rotator.rotate_batch(rotated_data.data(), num_points, local_data.data());
+        rotated_data.swap(local_data);
     }
 
-    char* batch_data = cp.batch_data();
-    char* ex_data = cp.ex_data();
     for (size_t i = 0; i < num_points; i += fastscan::kBatchSize) {
         size_t n = std::min(fastscan::kBatchSize, num_points - i);
+        size_t batch = i / fastscan::kBatchSize;
 
         quant::quantize_split_batch(
             rotated_data.data() + (i * padded_dim_),
-            rotated_centroid,
+            code_centroid,
             n,
             padded_dim_,
             ex_bits_,
-            batch_data,
-            ex_data,
+            batch_of(cp, batch),
+            batch_ex_data(cp, batch),
             metric_type_,
             config
         );
+    }
+    interleave_ids(cp);
+}
 
-        batch_data += BatchDataMap<float>::data_bytes(padded_dim_);
-        ex_data += ExDataMap<float>::data_bytes(padded_dim_, ex_bits_) * n;
+// copy PIDs of a cluster to its batches, only for ClusterLayout::Interleaved
+inline void IVF::interleave_ids(const Cluster& cp) const {
+    if (layout_ != ClusterLayout::Interleaved) {
+        return;
+    }
+    for (size_t i = 0; i < cp.num(); i += fastscan::kBatchSize) {
+        size_t n = std::min(fastscan::kBatchSize, cp.num() - i);
+        std::copy(cp.ids() + i, cp.ids() + i + n, batch_ids(cp, i / fastscan::kBatchSize));
     }
 }
 
@@ -312,7 +1006,31 @@ inline void IVF::save(const char* filename) const {
     }
 
     std::ofstream output(filename, std::ios::binary);
+    save_stream(output, filename);
+    output.close();
+}
+
+/**
+ * @brief Save the index as a chunked container (see chunked_file.hpp), i.e., the same
+ * bytes as save() but framed into checksummed and optionally compressed chunks. The HNSW
+ * initializer of many clusters is also kept in the chunks instead of a separate .hnsw
+ * file, thus the container is a single file. load() detects the format by itself.
+ */
+inline void IVF::save_compressed(const char* filename, const ChunkedFileConfig& config)
+    const {
+    if (cluster_lst_.size() == 0) {
+        std::cerr << "IVF not constructed\n";
+        return;
+    }
 
+    ChunkedFileWriter writer(filename, file_meta(), config);
+    std::ostream output(&writer);
+    save_stream(output, filename, true);
+    writer.finish();
+}
+
+inline void IVF::save_stream(std::ostream& output, const char* filename, bool chunked)
+    const {
     /* Save meta data */
     output.write(reinterpret_cast<const char*>(&num_), sizeof(size_t));
     output.write(reinterpret_cast<const char*>(&dim_), sizeof(size_t));
@@ -336,24 +1054,104 @@ inline void IVF::save(const char* filename) const {
     this->rotator_->save(output);
 
     /* Save data */
-    this->initer_->save(output, filename);
-    output.write(
-        reinterpret_cast<const char*>(batch_data_),
-        static_cast<long>(batch_data_bytes(cluster_sizes))
-    );
-    output.write(
-        reinterpret_cast<const char*>(ex_data_), static_cast<long>(ex_data_bytes())
-    );
+    this->initer_->save(output, chunked ? nullptr : filename);
+    if (layout_ == ClusterLayout::Separate) {
+        output.write(
+            reinterpret_cast<const char*>(batch_data_),
+            static_cast<long>(batch_data_bytes(cluster_sizes))
+        );
+        output.write(
+            reinterpret_cast<const char*>(ex_data_), static_cast<long>(ex_data_bytes())
+        );
+    } else {
+        // files are always in the separate layout, thus the layout is chosen by load()
+        size_t batch_bytes = BatchDataMap<float>::data_bytes(padded_dim_);
+        size_t ex_bytes = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+        for (const auto& cur_cluster : cluster_lst_) {
+            for (size_t i = 0; i < cur_cluster.num(); i += fastscan::kBatchSize) {
+                output.write(
+                    batch_of(cur_cluster, i / fastscan::kBatchSize),
+                    static_cast<long>(batch_bytes)
+                );
+            }
+        }
+        for (const auto& cur_cluster : cluster_lst_) {
+            for (size_t i = 0; i < cur_cluster.num(); i += fastscan::kBatchSize) {
+                size_t n = std::min(fastscan::kBatchSize, cur_cluster.num() - i);
+                output.write(
+                    batch_ex_data(cur_cluster, i / fastscan::kBatchSize),
+                    static_cast<long>(n * ex_bytes)
+                );
+            }
+        }
+    }
     output.write(reinterpret_cast<const char*>(ids_), static_cast<long>(ids_bytes()));
 
-    output.close();
+    /* Save norm buckets, the section is absent in files without them */
+    if (!norm_buckets_.empty()) {
+        size_t num_buckets = norm_buckets_.size();
+        output.write(reinterpret_cast<const char*>(&kNormBucketsTag), sizeof(uint64_t));
+        output.write(reinterpret_cast<const char*>(&num_norm_buckets_), sizeof(size_t));
+        output.write(reinterpret_cast<const char*>(&num_buckets), sizeof(size_t));
+        output.write(
+            reinterpret_cast<const char*>(bucket_starts_.data()),
+            static_cast<long>(sizeof(size_t) * (num_cluster_ + 1))
+        );
+        output.write(
+            reinterpret_cast<const char*>(norm_buckets_.data()),
+            static_cast<long>(sizeof(NormBucket) * num_buckets)
+        );
+    }
+
+    /* Save local rotations, the section is absent in files without them */
+    if (!local_rotators_.empty()) {
+        size_t num_groups = local_rotators_.size();
+        output.write(reinterpret_cast<const char*>(&kLocalRotationsTag), sizeof(uint64_t));
+        output.write(reinterpret_cast<const char*>(&num_local_groups_), sizeof(size_t));
+        output.write(reinterpret_cast<const char*>(&num_groups), sizeof(size_t));
+        output.write(
+            reinterpret_cast<const char*>(local_group_.data()),
+            static_cast<long>(sizeof(uint32_t) * num_cluster_)
+        );
+        for (const auto& local_rotator : local_rotators_) {
+            local_rotator.save(output);
+        }
+    }
 }
 
-inline void IVF::load(const char* filename) {
+/**
+ * @brief Load index saved by save() or save_compressed(). For a chunked container, all
+ * chunks are verified and corruption throws std::runtime_error.
+ *
+ * @param filename path of index file
+ * @param num_threads num of threads for decompressing chunks, 0 means all threads
+ * @param layout layout of clusters in memory, independent of the layout of the file
+ */
+inline void IVF::load(const char* filename, size_t num_threads, ClusterLayout layout) {
     std::cout << "Loading IVF...\n";
-    std::ifstream input(filename, std::ios::binary);
-    assert(input.is_open());
+    layout_ = layout;
+    if (is_chunked_file(filename)) {
+        ChunkedFileReader reader(filename, num_threads);
+        if (reader.meta().index_type != IndexFileType::IVF) {
+            throw std::runtime_error(std::string(filename) + " is not an IVF index");
+        }
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        load_stream(input, filename, true);
+        if (input.fail()) {
+            throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+        }
+        reader.check_meta(file_meta());
+    } else {
+        std::ifstream input(filename, std::ios::binary);
+        assert(input.is_open());
+        load_stream(input, filename);
+        input.close();
+    }
+    std::cout << "Index loaded\n";
+}
 
+inline void IVF::load_stream(std::istream& input, const char* filename, bool chunked) {
     /* Load meta data */
     std::cout << "\tLoading meta data...\n";
     input.read(reinterpret_cast<char*>(&this->num_), sizeof(size_t));
@@ -363,7 +1161,7 @@ inline void IVF::load(const char* filename) {
     input.read(reinterpret_cast<char*>(&type_), sizeof(type_));
     input.read(reinterpret_cast<char*>(&metric_type_), sizeof(metric_type_));
 
-    rotator_ = choose_rotator<float>(dim_, type_, round_up_to_multiple(dim_, 64));
+    rotator_ = choose_rotator<float>(dim_, type_, index_padded_dim(dim_, type_));
     padded_dim_ = rotator_->size();
 
     /* Load number of vectors of each cluster */
@@ -386,16 +1184,89 @@ inline void IVF::load(const char* filename) {
     /* Load data */
     free_memory();
     allocate_memory(cluster_sizes);
-    this->initer_->load(input, filename);
-    input.read(batch_data_, static_cast<long>(batch_data_bytes(cluster_sizes)));
-    input.read(ex_data_, static_cast<long>(ex_data_bytes()));
-    input.read(reinterpret_cast<char*>(ids_), static_cast<long>(ids_bytes()));
-
-    /* Init each cluster */
     init_clusters(cluster_sizes);
+    this->initer_->load(input, chunked ? nullptr : filename);
+    if (layout_ == ClusterLayout::Separate) {
+        input.read(batch_data_, static_cast<long>(batch_data_bytes(cluster_sizes)));
+        input.read(ex_data_, static_cast<long>(ex_data_bytes()));
+    } else {
+        size_t batch_bytes = BatchDataMap<float>::data_bytes(padded_dim_);
+        size_t ex_bytes = ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+        for (const auto& cur_cluster : cluster_lst_) {
+            for (size_t i = 0; i < cur_cluster.num(); i += fastscan::kBatchSize) {
+                input.read(
+                    batch_of(cur_cluster, i / fastscan::kBatchSize),
+                    static_cast<long>(batch_bytes)
+                );
+            }
+        }
+        for (const auto& cur_cluster : cluster_lst_) {
+            for (size_t i = 0; i < cur_cluster.num(); i += fastscan::kBatchSize) {
+                size_t n = std::min(fastscan::kBatchSize, cur_cluster.num() - i);
+                input.read(
+                    batch_ex_data(cur_cluster, i / fastscan::kBatchSize),
+                    static_cast<long>(n * ex_bytes)
+                );
+            }
+        }
+    }
+    input.read(reinterpret_cast<char*>(ids_), static_cast<long>(ids_bytes()));
 
-    input.close();
-    std::cout << "Index loaded\n";
+    for (const auto& cur_cluster : cluster_lst_) {
+        interleave_ids(cur_cluster);
+    }
+    init_id_map();
+
+    /* Load optional sections (norm buckets, local rotations) if they exist */
+    num_norm_buckets_ = 1;
+    norm_buckets_.clear();
+    bucket_starts_.clear();
+    num_local_groups_ = 0;
+    local_group_.clear();
+    local_rotators_.clear();
+    while (input.peek() != std::char_traits<char>::eof()) {
+        uint64_t tag = 0;
+        input.read(reinterpret_cast<char*>(&tag), sizeof(uint64_t));
+        if (tag == kNormBucketsTag) {
+            size_t num_buckets = 0;
+            input.read(reinterpret_cast<char*>(&num_norm_buckets_), sizeof(size_t));
+            input.read(reinterpret_cast<char*>(&num_buckets), sizeof(size_t));
+            bucket_starts_.resize(num_cluster_ + 1);
+            norm_buckets_.resize(num_buckets);
+            input.read(
+                reinterpret_cast<char*>(bucket_starts_.data()),
+                static_cast<long>(sizeof(size_t) * (num_cluster_ + 1))
+            );
+            input.read(
+                reinterpret_cast<char*>(norm_buckets_.data()),
+                static_cast<long>(sizeof(NormBucket) * num_buckets)
+            );
+        } else if (tag == kLocalRotationsTag) {
+            size_t num_groups = 0;
+            input.read(reinterpret_cast<char*>(&num_local_groups_), sizeof(size_t));
+            input.read(reinterpret_cast<char*>(&num_groups), sizeof(size_t));
+            local_group_.resize(num_cluster_);
+            input.read(
+                reinterpret_cast<char*>(local_group_.data()),
+                static_cast<long>(sizeof(uint32_t) * num_cluster_)
+            );
+            if (std::any_of(local_group_.begin(), local_group_.end(), [&](uint32_t g) {
+                    return g >= num_groups;
+                })) {
+                throw std::runtime_error(
+                    std::string(filename) + ": invalid group of local rotations"
+                );
+            }
+            local_rotators_.reserve(num_groups);
+            for (size_t i = 0; i < num_groups; ++i) {
+                local_rotators_.emplace_back(padded_dim_, padded_dim_, false);
+                local_rotators_.back().load(input);
+            }
+        } else {
+            throw std::runtime_error(std::string(filename) + ": unknown data after IVF ids");
+        }
+    }
+    input.clear(input.rdstate() & ~std::ios::eofbit);
 }
 
 inline void IVF::search(
@@ -415,6 +1286,83 @@ inline void IVF::search(
     PID* __restrict__ results,
     float* __restrict__ dists,
     bool use_hacc
+) const {
+    buffer::SearchBuffer knns(k);
+    search_clusters(query, nprobe, knns, use_hacc);
+
+    if (dists != nullptr) {
+        knns.copy_results(results, dists);
+    } else {
+        knns.copy_results(results);
+    }
+}
+
+/**
+ * @brief Grouped (diversified) top-k search, return the best num_groups groups with at
+ * most group_size hits for each group, e.g., at most 3 products for each seller. Hits are
+ * kept in bounded heaps of their groups during the scan, and the bound of each candidate
+ * (see GroupedBuffer::top_dist()) is used for pruning in the same way as the k-th distance
+ * of search().
+ *
+ * @param query query vector (DIM)
+ * @param num_groups max number of groups in results
+ * @param group_size max number of hits for each group
+ * @param nprobe num of clusters to probe
+ * @param group_keys group key of each vector (num of vectors), indexed by PID
+ * @param use_hacc use high accuracy fastscan or not
+ * @return groups sorted by their best hits, hits of each group sorted by distance
+ */
+inline std::vector<buffer::GroupHits<float>> IVF::search_grouped(
+    const float* __restrict__ query,
+    size_t num_groups,
+    size_t group_size,
+    size_t nprobe,
+    const PID* __restrict__ group_keys,
+    bool use_hacc
+) const {
+    buffer::GroupedBuffer<float> groups(num_groups, group_size, group_keys);
+    search_clusters(query, nprobe, groups, use_hacc);
+    return groups.results();
+}
+
+/**
+ * @brief Same as search(), but output the estimated distance and its error bounds for
+ * each result (see DistBound) instead of the distance, e.g., for rerankers which fetch raw
+ * vectors only for results whose bounds are not tight enough. Results of IVF are never
+ * exactly refined. If fewer than k vectors are found, the rest of results are kPidMax.
+ *
+ * @param query query vector (DIM)
+ * @param k num of nearest neighbors
+ * @param nprobe num of clusters to probe
+ * @param results ids of results (k)
+ * @param bounds distances and bounds of results (k)
+ * @param use_hacc use high accuracy fastscan or not
+ */
+inline void IVF::search_with_bounds(
+    const float* __restrict__ query,
+    size_t k,
+    size_t nprobe,
+    PID* __restrict__ results,
+    DistBound* __restrict__ bounds,
+    bool use_hacc
+) const {
+    std::vector<float> dists(k);
+    std::fill(results, results + k, kPidMax);
+    this->search(query, k, nprobe, results, dists.data(), use_hacc);
+
+    size_t num = std::find(results, results + k, kPidMax) - results;
+    score_ids(query, results, num, bounds, SCORE_FULL_BITS, nullptr, use_hacc);
+    // keep the distances of search, which are the same estimations
+    for (size_t i = 0; i < num; ++i) {
+        float error = bounds[i].up_dist - bounds[i].est_dist;
+        bounds[i] = {dists[i], dists[i] - error, dists[i] + error, false};
+    }
+}
+
+// probe the nprobe closest clusters of the query and insert candidates into knns
+template <class Buffer>
+inline void IVF::search_clusters(
+    const float* __restrict__ query, size_t nprobe, Buffer& knns, bool use_hacc
 ) const {
     nprobe = std::min(nprobe, num_cluster_);  // corner case
     std::vector<float> rotated_query(padded_dim_);
@@ -424,17 +1372,21 @@ inline void IVF::search(
     std::vector<AnnCandidate<float>> centroid_dist(nprobe);
     this->initer_->centroids_distances(rotated_query.data(), nprobe, centroid_dist);
 
-    buffer::SearchBuffer knns(k);
+    ClusterQueries queries(*this, rotated_query.data(), use_hacc);
 
-    SplitBatchQuery<float> q_obj(
-        rotated_query.data(), padded_dim_, ex_bits_, metric_type_, use_hacc
-    );
+    if (!norm_buckets_.empty()) {
+        search_norm_buckets(rotated_query.data(), centroid_dist, queries, knns, use_hacc);
+        return;
+    }
 
     for (size_t i = 0; i < nprobe; ++i) {
         PID cid = centroid_dist[i].id;
         float dist = centroid_dist[i].distance;
         const Cluster& cur_cluster = cluster_lst_[cid];
+        ClusterQuery& query_obj = queries.of(cid);
+        SplitBatchQuery<float>& q_obj = query_obj.q_obj;
 
+        // distances to centroids are the same in local spaces
         if (metric_type_ == METRIC_L2) {
             q_obj.set_g_add(dist);
         } else if (metric_type_ == METRIC_IP) {
@@ -449,53 +1401,127 @@ inline void IVF::search(
             return;
         }
         // q_obj.set_g_add(dist);
-        search_cluster(cur_cluster, q_obj, knns, use_hacc);
+        search_cluster(cur_cluster, q_obj, query_obj.stages, knns, use_hacc);
     }
+}
 
-    if (dists != nullptr) {
-        knns.copy_results(results, dists);
-    } else {
-        knns.copy_results(results);
+/**
+ * @brief Visit the norm buckets of the probed clusters in descending order of the upper
+ * bounds of their inner products (see set_norm_buckets()). Distances of METRIC_IP are
+ * 1 - <q, o>, thus the scan stops once 1 - bound is not less than the k-th distance, and
+ * the remaining buckets are skipped.
+ */
+template <class Buffer>
+inline void IVF::search_norm_buckets(
+    const float* rotated_query,
+    const std::vector<AnnCandidate<float>>& centroid_dist,
+    ClusterQueries& queries,
+    Buffer& knns,
+    bool use_hacc
+) const {
+    struct Candidate {
+        float bound;   // upper bound of inner products in the bucket
+        size_t probe;  // index in centroid_dist
+        size_t bucket;
+    };
+
+    float query_norm = std::sqrt(l2norm_sqr(rotated_query, padded_dim_));
+    std::vector<float> centroid_ips(centroid_dist.size());
+    std::vector<Candidate> candidates;
+    candidates.reserve(
+        std::min(centroid_dist.size() * num_norm_buckets_, norm_buckets_.size())
+    );
+    for (size_t i = 0; i < centroid_dist.size(); ++i) {
+        PID cid = centroid_dist[i].id;
+        const float* centroid = initer_->centroid(cid);
+        centroid_ips[i] = dot_product<float>(rotated_query, centroid, padded_dim_);
+        float centroid_norm = std::sqrt(l2norm_sqr(centroid, padded_dim_));
+        float unit_ip = centroid_norm > 0 ? centroid_ips[i] / centroid_norm : 0;
+        for (size_t b = bucket_starts_[cid]; b < bucket_starts_[cid + 1]; ++b) {
+            const NormBucket& bucket = norm_buckets_[b];
+            float bound = std::min(
+                {query_norm * bucket.max_norm,
+                 centroid_ips[i] + (query_norm * bucket.max_residual),
+                 bucket.max_norm *
+                     std::max(unit_ip + (query_norm * bucket.max_angular), 0.0F)}
+            );
+            candidates.push_back({bound, i, b});
+        }
+    }
+    // a max heap of bounds, since most buckets are skipped and need no order
+    auto less_bound = [](const Candidate& a, const Candidate& b) { return a.bound < b.bound; };
+    std::make_heap(candidates.begin(), candidates.end(), less_bound);
+
+    for (auto end = candidates.end(); end != candidates.begin(); --end) {
+        std::pop_heap(candidates.begin(), end, less_bound);
+        const Candidate& cand = *(end - 1);
+        if (1 - cand.bound >= knns.top_dist()) {
+            break;
+        }
+        PID cid = centroid_dist[cand.probe].id;
+        const NormBucket& bucket = norm_buckets_[cand.bucket];
+        ClusterQuery& query_obj = queries.of(cid);
+        query_obj.q_obj.set_g_add(
+            centroid_dist[cand.probe].distance, centroid_ips[cand.probe]
+        );
+        search_cluster(
+            cluster_lst_[cid],
+            query_obj.q_obj,
+            query_obj.stages,
+            knns,
+            use_hacc,
+            bucket.begin,
+            bucket.end
+        );
     }
 }
 
+// scan batches [begin, end) of a cluster, the whole cluster by default
+template <class Buffer>
 inline void IVF::search_cluster(
     const Cluster& cur_cluster,
     const SplitBatchQuery<float>& q_obj,
-    buffer::SearchBuffer<float>& knns,
-    bool use_hacc
+    const RefineStages<float>& stages,
+    Buffer& knns,
+    bool use_hacc,
+    size_t begin,
+    size_t end
 ) const {
-    size_t iter = cur_cluster.num() / fastscan::kBatchSize;
-    size_t remain = cur_cluster.num() - (iter * fastscan::kBatchSize);
-
-    const char* batch_data = cur_cluster.batch_data();
-    const char* ex_data = cur_cluster.ex_data();
-    const PID* ids = cur_cluster.ids();
+    size_t num_batches =
+        std::min(div_round_up(cur_cluster.num(), fastscan::kBatchSize), end);
+    bool prefetch = layout_ == ClusterLayout::Interleaved;
+    size_t prefetch_lines = div_round_up(BatchDataMap<float>::data_bytes(padded_dim_), 64);
 
     /* Compute distances block by block */
-    for (size_t i = 0; i < iter; ++i) {
+    for (size_t i = begin; i < num_batches; ++i) {
+        const char* batch_data = batch_of(cur_cluster, i);
+        if (prefetch && i + 1 < num_batches) {
+            // 1-bit codes of the next batch, while this batch is scanned and refined
+            memory::mem_prefetch_l1(batch_data + batch_stride(), prefetch_lines);
+        }
+        size_t num_points =
+            std::min(fastscan::kBatchSize, cur_cluster.num() - (i * fastscan::kBatchSize));
         scan_one_batch(
-            batch_data, ex_data, ids, q_obj, knns, fastscan::kBatchSize, use_hacc
+            batch_data,
+            batch_ex_data(cur_cluster, i),
+            batch_ids(cur_cluster, i),
+            q_obj,
+            stages,
+            knns,
+            num_points,
+            use_hacc
         );
-
-        batch_data += BatchDataMap<float>::data_bytes(padded_dim_);
-        ex_data +=
-            ExDataMap<float>::data_bytes(padded_dim_, ex_bits_) * fastscan::kBatchSize;
-        ids += fastscan::kBatchSize;
-    }
-
-    if (remain > 0) {
-        // scan the last block
-        scan_one_batch(batch_data, ex_data, ids, q_obj, knns, remain, use_hacc);
     }
 }
 
+template <class Buffer>
 inline void IVF::scan_one_batch(
     const char* batch_data,
     const char* ex_data,
     const PID* ids,
     const SplitBatchQuery<float>& q_obj,
-    buffer::SearchBuffer<float>& knns,
+    const RefineStages<float>& stages,
+    Buffer& knns,
     size_t num_points,
     bool use_hacc
 ) const {
@@ -526,19 +1552,360 @@ inline void IVF::scan_one_batch(
         return;
     }
 
-    // incremental distance computation - V2
+    // incremental distance computation - V2. top_dist(id) of grouped search is tighter
+    // than distk for candidates of kept or excluded groups, see GroupedBuffer
     for (size_t i = 0; i < num_points; ++i) {
         float lower_dist = low_distance[i];
-        if (lower_dist < distk) {
+        if (lower_dist < distk && lower_dist < knns.top_dist(ids[i])) {
             PID id = ids[i];
             ConstExDataMap<float> cur_ex(ex_data, padded_dim_, ex_bits_);
+            if (ex_bits_ > 8) {
+                ip_x0_qr[i] = exact_ip_x0_qr(batch_data, i, q_obj.rotated_query());
+            }
+            float ex_dist = 0;
+            bool kept = true;
+            if (stages.num_stages() == 1) {
+                ex_dist = split_distance_boosting(
+                    ex_data, ip_func_, q_obj, padded_dim_, ex_bits_, ip_x0_qr[i]
+                );
+            } else {
+                // stop reading the ex code once the candidate is outside the top-k
+                kept = split_distance_progressive(
+                    ex_data,
+                    ip_func_,
+                    q_obj,
+                    stages,
+                    padded_dim_,
+                    ex_bits_,
+                    q_obj.g_add(),
+                    ip_x0_qr[i],
+                    knns.top_dist(id),
+                    ex_dist
+                );
+            }
+            if (kept) {
+                knns.insert(id, ex_dist);
+                distk = knns.top_dist();
+            }
+        }
+        ex_data += ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+    }
+}
+
+/**
+ * @brief Compute distances between a query and an explicit list of candidates, e.g., the
+ * candidates from a keyword search or a filter. Candidates are sorted by their positions,
+ * thus candidates in the same cluster share the query factors and candidates in the same
+ * FastScan batch share one batch estimation.
+ *
+ * @param query query vector (DIM)
+ * @param ids PIDs of candidates
+ * @param num num of candidates
+ * @param dists distances of candidates (num), in the same order as ids
+ * @param mode SCORE_ONE_BIT, SCORE_FULL_BITS or SCORE_EXACT
+ * @param data raw data vectors (N*DIM), only required by SCORE_EXACT
+ * @param use_hacc if use high accuracy fastscan
+ */
+inline void IVF::score_ids(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    float* __restrict__ dists,
+    ScoreMode mode,
+    const float* data,
+    bool use_hacc
+) const {
+    score_ids_impl(query, ids, num, dists, nullptr, mode, data, use_hacc);
+}
+
+/**
+ * @brief Same as score_ids(), but also output the error bounds of each distance, see
+ * DistBound. For SCORE_EXACT, the bounds equal the exact distance.
+ */
+inline void IVF::score_ids(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    DistBound* __restrict__ bounds,
+    ScoreMode mode,
+    const float* data,
+    bool use_hacc
+) const {
+    score_ids_impl(query, ids, num, nullptr, bounds, mode, data, use_hacc);
+}
+
+// dists or bounds may be nullptr
+inline void IVF::score_ids_impl(
+    const float* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    float* __restrict__ dists,
+    DistBound* __restrict__ bounds,
+    ScoreMode mode,
+    const float* data,
+    bool use_hacc
+) const {
+    for (size_t i = 0; i < num; ++i) {
+        if (ids[i] >= id_pos_.size() || id_pos_[ids[i]] == kPidMax) {
+            throw std::out_of_range(
+                "Bad id " + std::to_string(ids[i]) + " in IVF::score_ids"
+            );
+        }
+    }
+
+    // output the distance and the bounds of the idx-th candidate
+    auto output = [&](size_t idx, float est_dist, float error, bool exact) {
+        if (dists != nullptr) {
+            dists[idx] = est_dist;
+        }
+        if (bounds != nullptr) {
+            bounds[idx] = {est_dist, est_dist - error, est_dist + error, exact};
+        }
+    };
+
+    if (mode == SCORE_EXACT) {
+        if (data == nullptr) {
+            throw std::invalid_argument("IVF::score_ids requires raw data for SCORE_EXACT");
+        }
+        for (size_t i = 0; i < num; ++i) {
+            const float* vec = data + (static_cast<size_t>(ids[i]) * dim_);
+            float dist = metric_type_ == METRIC_IP
+                             ? dot_product_dis<float>(query, vec, dim_)
+                             : euclidean_sqr<float>(query, vec, dim_);
+            output(i, dist, 0, true);
+        }
+        return;
+    }
+
+    std::vector<float> rotated_query(padded_dim_);
+    this->rotator_->rotate(query, rotated_query.data());
+
+    ClusterQueries queries(*this, rotated_query.data(), use_hacc);
+    SplitBatchQuery<float>* q_obj = nullptr;
+
+    // group candidates by cluster and FastScan batch
+    std::vector<size_t> order(num);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return id_pos_[ids[a]] < id_pos_[ids[b]];
+    });
+
+    std::array<float, fastscan::kBatchSize> est_distance;
+    std::array<float, fastscan::kBatchSize> low_distance;
+    std::array<float, fastscan::kBatchSize> ip_x0_qr;
+
+    PID cur_cid = kPidMax;
+    size_t cur_batch = std::numeric_limits<size_t>::max();
+    for (size_t idx : order) {
+        size_t pos = id_pos_[ids[idx]];
+        PID cid = locate_cluster(pos);
+        const Cluster& cur_cluster = cluster_lst_[cid];
+
+        if (cid != cur_cid) {
+            const float* centroid = initer_->centroid(cid);
+            float dist =
+                std::sqrt(euclidean_sqr(rotated_query.data(), centroid, padded_dim_));
+            q_obj = &queries.of(cid).q_obj;
+            if (metric_type_ == METRIC_IP) {
+                q_obj->set_g_add(
+                    dist, dot_product<float>(rotated_query.data(), centroid, padded_dim_)
+                );
+            } else {
+                q_obj->set_g_add(dist);
+            }
+            cur_cid = cid;
+            cur_batch = std::numeric_limits<size_t>::max();
+        }
+
+        size_t offset = pos - cluster_starts_[cid];
+        size_t batch = offset / fastscan::kBatchSize;
+        if (batch != cur_batch) {
+            split_batch_estdist(
+                batch_of(cur_cluster, batch),
+                *q_obj,
+                padded_dim_,
+                est_distance.data(),
+                low_distance.data(),
+                ip_x0_qr.data(),
+                use_hacc
+            );
+            cur_batch = batch;
+        }
+
+        size_t lane = offset % fastscan::kBatchSize;
+        float error = est_distance[lane] - low_distance[lane];
+        if (mode == SCORE_ONE_BIT || ex_bits_ == 0) {
+            output(idx, est_distance[lane], error, false);
+        } else {
+            if (ex_bits_ > 8) {
+                ip_x0_qr[lane] = exact_ip_x0_qr(
+                    batch_of(cur_cluster, batch), lane, q_obj->rotated_query()
+                );
+            }
             float ex_dist = split_distance_boosting(
-                ex_data, ip_func_, q_obj, padded_dim_, ex_bits_, ip_x0_qr[i]
+                ex_data_at(cur_cluster, offset),
+                ip_func_,
+                *q_obj,
+                padded_dim_,
+                ex_bits_,
+                ip_x0_qr[lane]
             );
-            knns.insert(id, ex_dist);
-            distk = knns.top_dist();
+            if (bounds != nullptr) {
+                error = ex_error_factor(cur_cluster, offset) * q_obj->g_error();
+            }
+            output(idx, ex_dist, error, false);
         }
-        ex_data += ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+    }
+}
+
+// exact <q_r, x_b> of the lane-th vector in a batch. For more than 8 ex_bits, the ip of the
+// 1st bit is weighted by 2^ex_bits, thus the error of the ip estimated by FastScan LUTs
+// dominates the error of the total code, and the ip is computed exactly instead. The code
+// is unpacked to words chunk by chunk on the stack and summed by mask_ip_x0_q().
+inline float IVF::exact_ip_x0_qr(
+    const char* batch_data, size_t lane, const float* rotated_query
+) const {
+    constexpr size_t kChunkDim = 1024;
+    ConstBatchDataMap<float> cur_batch(batch_data, padded_dim_);
+    const uint8_t* blocks = cur_batch.bin_code();
+    std::array<uint64_t, kChunkDim / 64> words;
+    float res = 0;
+    for (size_t dim = 0; dim < padded_dim_; dim += kChunkDim) {
+        size_t chunk_dim = std::min(kChunkDim, padded_dim_ - dim);
+        // 32 bytes of blocks per 8 dims
+        fastscan::unpack_code_words(chunk_dim, blocks + (dim * 4), lane, words.data());
+        res += mask_ip_x0_q(rotated_query + dim, words.data(), chunk_dim);
+    }
+    return res;
+}
+
+// error factor of the total code of the offset-th vector in a cluster, see
+// quant::ex_error_factor()
+inline float IVF::ex_error_factor(const Cluster& cur_cluster, size_t offset) const {
+    size_t batch = offset / fastscan::kBatchSize;
+    size_t lane = offset % fastscan::kBatchSize;
+    ConstBatchDataMap<float> batch_data(batch_of(cur_cluster, batch), padded_dim_);
+    ConstExDataMap<float> ex_data(ex_data_at(cur_cluster, offset), padded_dim_, ex_bits_);
+
+    std::vector<uint8_t> bin_code(padded_dim_);
+    std::vector<uint16_t> ex_code(padded_dim_);
+    fastscan::unpack_code(padded_dim_, batch_data.bin_code(), lane, bin_code.data());
+    quant::rabitq_impl::ex_bits::unpacking_rabitqplus_code(
+        ex_data.ex_code(), ex_code.data(), padded_dim_, ex_bits_
+    );
+
+    return quant::ex_error_factor<float>(
+        bin_code.data(),
+        ex_code.data(),
+        padded_dim_,
+        ex_bits_,
+        batch_data.f_rescale()[lane],
+        batch_data.f_error()[lane],
+        ex_data.f_rescale_ex(),
+        metric_type_
+    );
+}
+
+/**
+ * @brief Decode the vector at a given position of ids_ in the rotated space, i.e., the
+ * rotated centroid plus the residual reconstructed from the bin + ex codes and factors
+ */
+inline void IVF::reconstruct_rotated(size_t pos, float* rotated_vec) const {
+    PID cid = locate_cluster(pos);
+    const Cluster& cur_cluster = cluster_lst_[cid];
+    size_t offset = pos - cluster_starts_[cid];
+    size_t batch = offset / fastscan::kBatchSize;
+    size_t lane = offset % fastscan::kBatchSize;
+
+    ConstBatchDataMap<float> batch_data(batch_of(cur_cluster, batch), padded_dim_);
+    std::vector<uint8_t> bin_code(padded_dim_);
+    fastscan::unpack_code(padded_dim_, batch_data.bin_code(), lane, bin_code.data());
+
+    std::vector<uint16_t> ex_code(padded_dim_);
+    float f_rescale_ex = 0;
+    if (ex_bits_ > 0) {
+        ConstExDataMap<float> ex_data(
+            ex_data_at(cur_cluster, offset), padded_dim_, ex_bits_
+        );
+        quant::rabitq_impl::ex_bits::unpacking_rabitqplus_code(
+            ex_data.ex_code(), ex_code.data(), padded_dim_, ex_bits_
+        );
+        f_rescale_ex = ex_data.f_rescale_ex();
+    }
+
+    // codes of a cluster with a local rotation are decoded in its local space first
+    const rotator_impl::LearnedRotator<float>* local_rotator =
+        local_group_.empty() ? nullptr : &local_rotators_[local_group_[cid]];
+    std::vector<float> local_centroid;
+    std::vector<float> local_vec;
+    const float* centroid = initer_->centroid(cid);
+    float* decoded = rotated_vec;
+    if (local_rotator != nullptr) {
+        local_centroid.resize(padded_dim_);
+        local_vec.resize(padded_dim_);
+        local_rotator->rotate(centroid, local_centroid.data());
+        centroid = local_centroid.data();
+        decoded = local_vec.data();
+    }
+
+    quant::reconstruct_split<float>(
+        bin_code.data(),
+        ex_code.data(),
+        centroid,
+        padded_dim_,
+        ex_bits_,
+        batch_data.f_rescale()[lane],
+        batch_data.f_error()[lane],
+        f_rescale_ex,
+        decoded,
+        metric_type_
+    );
+    if (local_rotator != nullptr) {
+        local_rotator->inverse_rotate(decoded, rotated_vec);
+    }
+}
+
+/**
+ * @brief Reconstruct an approximate data vector from the quantization codes, thus a
+ * separated store of raw vectors is not required by jobs that tolerate the quantization
+ * error (e.g., clustering, deduplication). The error decreases with total_bits.
+ *
+ * @param id PID of the vector
+ * @param vec reconstructed vector (DIM)
+ */
+inline void IVF::reconstruct(PID id, float* vec) const {
+    if (id >= id_pos_.size() || id_pos_[id] == kPidMax) {
+        throw std::out_of_range("Bad id " + std::to_string(id) + " in IVF::reconstruct");
+    }
+    std::vector<float> rotated_vec(padded_dim_);
+    reconstruct_rotated(id_pos_[id], rotated_vec.data());
+    rotator_->inverse_rotate(rotated_vec.data(), vec);
+}
+
+/**
+ * @brief Reconstruct a batch of vectors, see reconstruct()
+ *
+ * @param ids PIDs of vectors
+ * @param num num of vectors
+ * @param vecs reconstructed vectors (num*DIM), in the same order as ids
+ * @param num_threads num of threads
+ */
+inline void IVF::reconstruct_batch(
+    const PID* ids, size_t num, float* vecs, size_t num_threads
+) const {
+    for (size_t i = 0; i < num; ++i) {
+        if (ids[i] >= id_pos_.size() || id_pos_[ids[i]] == kPidMax) {
+            throw std::out_of_range(
+                "Bad id " + std::to_string(ids[i]) + " in IVF::reconstruct_batch"
+            );
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < num; ++i) {
+        std::vector<float> rotated_vec(padded_dim_);
+        reconstruct_rotated(id_pos_[ids[i]], rotated_vec.data());
+        rotator_->inverse_rotate(rotated_vec.data(), vecs + (i * dim_));
     }
 }
 }  // namespace rabitqlib::ivf
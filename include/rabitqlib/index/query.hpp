@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <numeric>
 #include <utility>
+#include <vector>
 
 #include "rabitqlib/defines.hpp"
 #include "rabitqlib/index/lut.hpp"
@@ -189,4 +191,58 @@ class SplitSingleQuery {
     void set_g_error(T norm) { G_error_ = norm; }
 };
 
+
+/**
+ * @brief Stages of progressive refinement by ex codes for a given query. A stage reads the
+ * ex codes of the next range of dims, ends of stages are multiples of 64, i.e., whole
+ * blocks of all packings of ex codes (see pack_excode.hpp). After a stage, the ex codes of
+ * the remaining dims are taken as their midpoint m = (2^ex_bits - 1) / 2, whose error
+ * sum(q[i] * (code[i] - m)) is bounded by epsilon * m * ||q_rest|| with the same epsilon
+ * as the error bound of the 1-bit code (a probabilistic bound, not a worst-case one).
+ *
+ * Codes of more than 8 ex_bits are stored in 2 planes (see packing_rabitqplus_code()) and
+ * always use a single stage.
+ */
+template <typename T>
+class RefineStages {
+   private:
+    std::vector<size_t> ends_;   // end dim of each stage, the last one is padded_dim
+    std::vector<T> rest_mid_;    // m * sum of query over dims after each stage
+    std::vector<T> rest_error_;  // epsilon * m * norm of query over dims after each stage
+
+   public:
+    explicit RefineStages(
+        const T* rotated_query, size_t padded_dim, size_t ex_bits, size_t num_stages
+    ) {
+        constexpr size_t kStageAlign = 64;
+        size_t num_blocks = padded_dim / kStageAlign;
+        if (ex_bits == 0 || ex_bits > 8 || padded_dim % kStageAlign != 0) {
+            num_stages = 1;
+        }
+        num_stages = std::max<size_t>(std::min(num_stages, num_blocks), 1);
+        T mid = static_cast<T>((1 << ex_bits) - 1) / 2;
+        for (size_t i = 1; i <= num_stages; ++i) {
+            size_t end =
+                i == num_stages ? padded_dim : num_blocks * i / num_stages * kStageAlign;
+            T sum = std::accumulate(rotated_query + end, rotated_query + padded_dim, T(0));
+            T sqr_sum = std::inner_product(
+                rotated_query + end, rotated_query + padded_dim, rotated_query + end, T(0)
+            );
+            ends_.push_back(end);
+            rest_mid_.push_back(mid * sum);
+            rest_error_.push_back(
+                static_cast<T>(quant::rabitq_impl::kConstEpsilon) * mid * std::sqrt(sqr_sum)
+            );
+        }
+    }
+
+    [[nodiscard]] size_t num_stages() const { return ends_.size(); }
+
+    [[nodiscard]] size_t end(size_t stage) const { return ends_[stage]; }
+
+    [[nodiscard]] T rest_mid(size_t stage) const { return rest_mid_[stage]; }
+
+    [[nodiscard]] T rest_error(size_t stage) const { return rest_error_[stage]; }
+};
+
 }  // namespace rabitqlib
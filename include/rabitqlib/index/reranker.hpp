@@ -0,0 +1,317 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/space.hpp"
+
+namespace rabitqlib {
+/**
+ * @brief Fetch the raw vectors of a batch of ids, vecs (num * dim) are stored row by row.
+ * FetchFunc returns once vecs are filled, AsyncFetchFunc returns a future which is ready
+ * once vecs are filled. vecs stay valid until the future is ready.
+ */
+using FetchFunc = std::function<void(const PID* ids, size_t num, float* vecs)>;
+using AsyncFetchFunc =
+    std::function<std::future<void>(const PID* ids, size_t num, float* vecs)>;
+
+struct RerankConfig {
+    size_t batch_size = 8;    // max num of vectors in one fetch
+    size_t max_inflight = 4;  // max num of pending fetches, only used by AsyncFetchFunc
+};
+
+struct RerankStats {
+    size_t num_candidates = 0;  // num of candidates given to rerank()
+    size_t num_fetched = 0;     // num of raw vectors fetched
+    size_t num_saved = 0;       // num of candidates whose raw vectors are not fetched
+    size_t num_batches = 0;     // num of calls to the fetch function
+};
+
+/**
+ * @brief Rerank candidates of an index by their error bounds (see DistBound and
+ * docs/rabitq/reranking.md). Raw vectors are fetched only for the candidates whose bounds
+ * overlap the boundary of the top-k, in the order of their lower bounds, and the rerank
+ * stops as soon as the top-k set is certified, i.e., the k-th smallest upper bound is no
+ * larger than the lower bound of any other candidate.
+ *
+ * With an AsyncFetchFunc, up to max_inflight fetches are pending at the same time, thus
+ * the latency of storage is overlapped. A pending fetch is never cancelled, so a few more
+ * vectors than necessary may be fetched. rerank() is const and thread-safe if the fetch
+ * function is.
+ */
+class Reranker {
+   private:
+    size_t dim_;
+    MetricType metric_type_;
+    FetchFunc fetch_;
+    AsyncFetchFunc async_fetch_;
+    RerankConfig config_;
+
+    struct Batch {
+        std::vector<size_t> idx;  // positions of candidates
+        std::vector<PID> ids;
+        std::vector<float> vecs;
+        std::future<void> done;
+    };
+
+    // positions of candidates which may change the top-k, in the order of lower bounds,
+    // empty if the top-k is certified
+    [[nodiscard]] static std::vector<size_t> undecided(
+        const std::vector<DistBound>& bounds,
+        const std::vector<size_t>& by_low,
+        std::vector<size_t>& by_up,
+        size_t k
+    ) {
+        std::vector<size_t> res;
+        size_t num = bounds.size();
+        if (num <= k) {
+            return res;
+        }
+        std::nth_element(
+            by_up.begin(),
+            by_up.begin() + (k - 1),
+            by_up.end(),
+            [&](size_t a, size_t b) { return bounds[a].up_dist < bounds[b].up_dist; }
+        );
+        std::vector<bool> in_topk(num, false);
+        float max_up = bounds[by_up[k - 1]].up_dist;
+        for (size_t i = 0; i < k; ++i) {
+            in_topk[by_up[i]] = true;
+        }
+        float min_low = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < num; ++i) {
+            if (!in_topk[i]) {
+                min_low = std::min(min_low, bounds[i].low_dist);
+            }
+        }
+        if (max_up <= min_low) {
+            return res;
+        }
+        for (size_t i : by_low) {
+            bool overlap = in_topk[i] ? bounds[i].up_dist > min_low
+                                      : bounds[i].low_dist < max_up;
+            if (overlap && !bounds[i].exact) {
+                res.push_back(i);
+            }
+        }
+        return res;
+    }
+
+   public:
+    explicit Reranker(
+        size_t dim, MetricType metric_type, FetchFunc fetch, RerankConfig config = {}
+    )
+        : dim_(dim)
+        , metric_type_(metric_type)
+        , fetch_(std::move(fetch))
+        , config_(config) {
+        if (!fetch_) {
+            throw std::invalid_argument("Reranker: empty fetch function");
+        }
+    }
+
+    explicit Reranker(
+        size_t dim, MetricType metric_type, AsyncFetchFunc fetch, RerankConfig config = {}
+    )
+        : dim_(dim)
+        , metric_type_(metric_type)
+        , async_fetch_(std::move(fetch))
+        , config_(config) {
+        if (!async_fetch_) {
+            throw std::invalid_argument("Reranker: empty fetch function");
+        }
+    }
+
+    /**
+     * @brief Find the k nearest candidates of a query
+     *
+     * @param query query vector (dim)
+     * @param ids ids of candidates (num)
+     * @param bounds estimated distances and bounds of candidates (num), e.g., from
+     * search_with_bounds() or score_ids()
+     * @param num num of candidates
+     * @param k num of nearest neighbors
+     * @param results ids of results sorted by distances (min(k, num))
+     * @param result_bounds distances of results (min(k, num)), exact is set if the raw
+     * vector is fetched, otherwise est_dist is the estimated distance, may be nullptr
+     * @return stats of this rerank
+     */
+    RerankStats rerank(
+        const float* query,
+        const PID* ids,
+        const DistBound* bounds,
+        size_t num,
+        size_t k,
+        PID* results,
+        DistBound* result_bounds = nullptr
+    ) const {
+        RerankStats stats;
+        stats.num_candidates = num;
+        if (num == 0 || k == 0) {
+            stats.num_saved = num;
+            return stats;
+        }
+
+        std::vector<DistBound> cur(bounds, bounds + num);
+        std::vector<size_t> by_low(num);
+        std::iota(by_low.begin(), by_low.end(), 0);
+        std::sort(by_low.begin(), by_low.end(), [&](size_t a, size_t b) {
+            return cur[a].low_dist < cur[b].low_dist;
+        });
+        std::vector<size_t> by_up = by_low;
+        std::vector<bool> requested(num, false);
+        size_t batch_size = std::max<size_t>(config_.batch_size, 1);
+        size_t max_inflight = async_fetch_ ? std::max<size_t>(config_.max_inflight, 1) : 1;
+
+        // take exact distances of a finished batch
+        auto finish = [&](Batch& batch) {
+            batch.done.get();
+            for (size_t i = 0; i < batch.idx.size(); ++i) {
+                const float* vec = batch.vecs.data() + (i * dim_);
+                float dist = metric_type_ == METRIC_IP ? dot_product_dis(query, vec, dim_)
+                                                       : euclidean_sqr(query, vec, dim_);
+                cur[batch.idx[i]] = {dist, dist, dist, true};
+            }
+        };
+
+        std::deque<Batch> inflight;
+        while (true) {
+            std::vector<size_t> todo = undecided(cur, by_low, by_up, k);
+            todo.erase(
+                std::remove_if(
+                    todo.begin(), todo.end(), [&](size_t idx) { return requested[idx]; }
+                ),
+                todo.end()
+            );
+
+            // issue fetches in the order of lower bounds
+            size_t pos = 0;
+            while (pos < todo.size() && inflight.size() < max_inflight) {
+                size_t cnt = std::min(batch_size, todo.size() - pos);
+                Batch batch;
+                batch.idx.assign(todo.begin() + pos, todo.begin() + pos + cnt);
+                batch.vecs.resize(cnt * dim_);
+                for (size_t idx : batch.idx) {
+                    batch.ids.push_back(ids[idx]);
+                    requested[idx] = true;
+                }
+                if (async_fetch_) {
+                    batch.done = async_fetch_(batch.ids.data(), cnt, batch.vecs.data());
+                } else {
+                    std::promise<void> done;
+                    fetch_(batch.ids.data(), cnt, batch.vecs.data());
+                    done.set_value();
+                    batch.done = done.get_future();
+                }
+                inflight.push_back(std::move(batch));
+                stats.num_fetched += cnt;
+                ++stats.num_batches;
+                pos += cnt;
+            }
+
+            if (inflight.empty()) {
+                break;
+            }
+            finish(inflight.front());
+            inflight.pop_front();
+        }
+
+        // by_up[0, k) is the certified top-k, rank it by the distances we have
+        size_t num_res = std::min(k, num);
+        std::sort(by_up.begin(), by_up.begin() + num_res, [&](size_t a, size_t b) {
+            return cur[a].est_dist < cur[b].est_dist;
+        });
+        for (size_t i = 0; i < num_res; ++i) {
+            results[i] = ids[by_up[i]];
+            if (result_bounds != nullptr) {
+                result_bounds[i] = cur[by_up[i]];
+            }
+        }
+        stats.num_saved = num - stats.num_fetched;
+        return stats;
+    }
+
+    [[nodiscard]] size_t dimension() const { return dim_; }
+};
+
+/**
+ * @brief FetchFunc which reads raw vectors from a file by pread(), rows of the file are
+ * row_bytes apart and the vector of each row starts at row_offset bytes, e.g., row_bytes
+ * = 4 + dim * 4 and row_offset = 4 for .fvecs files. The file is closed on destruction.
+ * Safe to be called by multiple threads.
+ */
+class PreadFetcher {
+   private:
+    int fd_ = -1;
+    size_t dim_;
+    size_t row_bytes_;
+    size_t row_offset_;
+
+   public:
+    PreadFetcher(const std::string& path, size_t dim, size_t row_bytes, size_t row_offset)
+        : dim_(dim), row_bytes_(row_bytes), row_offset_(row_offset) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            throw std::runtime_error(
+                "PreadFetcher: open " + path + ": " + std::strerror(errno)
+            );
+        }
+    }
+
+    // fetcher of a .fvecs file
+    static PreadFetcher fvecs(const std::string& path, size_t dim) {
+        return {path, dim, sizeof(int) + (dim * sizeof(float)), sizeof(int)};
+    }
+
+    PreadFetcher(const PreadFetcher&) = delete;
+    PreadFetcher& operator=(const PreadFetcher&) = delete;
+    PreadFetcher(PreadFetcher&& other) noexcept
+        : fd_(std::exchange(other.fd_, -1))
+        , dim_(other.dim_)
+        , row_bytes_(other.row_bytes_)
+        , row_offset_(other.row_offset_) {}
+    PreadFetcher& operator=(PreadFetcher&&) = delete;
+
+    ~PreadFetcher() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    void operator()(const PID* ids, size_t num, float* vecs) const {
+        size_t bytes = dim_ * sizeof(float);
+        for (size_t i = 0; i < num; ++i) {
+            auto offset = static_cast<off_t>((ids[i] * row_bytes_) + row_offset_);
+            auto* dst = reinterpret_cast<char*>(vecs + (i * dim_));
+            size_t done = 0;
+            while (done < bytes) {
+                ssize_t ret = ::pread(fd_, dst + done, bytes - done, offset + done);
+                if (ret < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (ret <= 0) {
+                    throw std::runtime_error(
+                        "PreadFetcher: failed to read vector " + std::to_string(ids[i])
+                    );
+                }
+                done += static_cast<size_t>(ret);
+            }
+        }
+    }
+};
+}  // namespace rabitqlib
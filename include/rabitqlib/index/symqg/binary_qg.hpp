@@ -0,0 +1,385 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/fastscan/fastscan.hpp"
+#include "rabitqlib/index/hamming.hpp"
+#include "rabitqlib/index/symqg/graph_builder.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/hashset.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/memory.hpp"
+#include "rabitqlib/utils/tools.hpp"
+#include "rabitqlib/utils/visited_pool.hpp"
+
+namespace rabitqlib::symqg {
+/**
+ * @brief Quantized graph over binary vectors (see hamming.hpp for the bit order). As in
+ * QuantizedGraph, each vertex stores its neighbors' codes in FastScan batches, but the
+ * codes are the bits of neighbors themselves instead of RaBitQ codes of rotated vectors.
+ * Thus a binary query gets exact Hamming distances of all neighbors from FastScan, and a
+ * float query gets estimated distances to the {-1, 1} vectors (see AsymmetricQuery).
+ * Instead of raw vectors, each vertex keeps its bits in words for exact distances.
+ *
+ * The graph is built by GraphBuilder as QGBuilder does (search candidates on the current
+ * graph, prune and add reverse edges), but by exact Hamming distances of the words, thus
+ * building needs no float vectors.
+ */
+class BinaryQG {
+   private:
+    size_t num_points_ = 0;    // num points
+    size_t degree_bound_ = 0;  // degree bound, multiple of 32
+    size_t dim_ = 0;           // num of bits of data points
+    size_t padded_dim_ = 0;    // num of bits after padding, multiple of 64
+    PID entry_point_ = 0;      // entry point of graph
+    size_t ef_ = 0;            // size of search pool
+
+    // each row holds batches of neighbors' codes, neighbor ids and the vertex in words
+    size_t neighbor_offset_ = 0;  // offset of neighbors
+    size_t words_offset_ = 0;     // offset of words
+    size_t row_offset_ = 0;       // length of entire row, multiple of 64
+    std::vector<char, memory::AlignedAllocator<char>> data_;
+    std::unique_ptr<VisitedListPool> visited_list_pool_ = nullptr;
+
+    void initialize();
+
+    [[nodiscard]] size_t batch_bytes() const {
+        return padded_dim_ * fastscan::kBatchSize / 8;
+    }
+
+    [[nodiscard]] uint8_t* get_batch_data(PID data_id) {
+        return reinterpret_cast<uint8_t*>(&data_[row_offset_ * data_id]);
+    }
+
+    [[nodiscard]] const uint8_t* get_batch_data(PID data_id) const {
+        return reinterpret_cast<const uint8_t*>(&data_[row_offset_ * data_id]);
+    }
+
+    [[nodiscard]] PID* get_neighbors(PID data_id) {
+        return reinterpret_cast<PID*>(&data_[(row_offset_ * data_id) + neighbor_offset_]);
+    }
+
+    [[nodiscard]] const PID* get_neighbors(PID data_id) const {
+        return reinterpret_cast<const PID*>(
+            &data_[(row_offset_ * data_id) + neighbor_offset_]
+        );
+    }
+
+    [[nodiscard]] uint64_t* get_words(PID data_id) {
+        return reinterpret_cast<uint64_t*>(&data_[(row_offset_ * data_id) + words_offset_]);
+    }
+
+    [[nodiscard]] const uint64_t* get_words(PID data_id) const {
+        return reinterpret_cast<const uint64_t*>(
+            &data_[(row_offset_ * data_id) + words_offset_]
+        );
+    }
+
+    [[nodiscard]] float distance(PID x, PID y) const {
+        return static_cast<float>(hamming_distance(get_words(x), get_words(y), padded_dim_));
+    }
+
+    [[nodiscard]] PID find_medoid(size_t) const;
+
+    void set_neighbors(PID, const CandidateList&);
+
+    template <class Query>
+    void search_impl(const Query&, size_t, PID*, float*) const;
+
+   public:
+    explicit BinaryQG() = default;
+
+    explicit BinaryQG(size_t num, size_t dim, size_t max_deg);
+
+    [[nodiscard]] auto num_vertices() const { return this->num_points_; }
+
+    [[nodiscard]] auto dimension() const { return this->dim_; }
+
+    [[nodiscard]] auto degree_bound() const { return this->degree_bound_; }
+
+    [[nodiscard]] auto entry_point() const { return this->entry_point_; }
+
+    void build(
+        const uint8_t*,
+        size_t,
+        size_t num_iter = 3,
+        size_t num_threads = std::numeric_limits<size_t>::max()
+    );
+
+    void set_ef(size_t cur_ef) { this->ef_ = cur_ef; }
+
+    void search(const uint8_t*, size_t, PID*, float* dists = nullptr) const;
+
+    void search(const float*, size_t, PID*, float* dists = nullptr) const;
+
+    void save(const char*) const;
+
+    void load(const char*);
+};
+
+inline BinaryQG::BinaryQG(size_t num, size_t dim, size_t max_deg)
+    : num_points_(num)
+    , degree_bound_(max_deg)
+    , dim_(dim)
+    , padded_dim_(round_up_to_multiple(dim, 64)) {
+    if (max_deg == 0 || max_deg % fastscan::kBatchSize != 0) {
+        throw std::invalid_argument("BinaryQG: degree bound must be a multiple of 32");
+    }
+    initialize();
+}
+
+inline void BinaryQG::initialize() {
+    neighbor_offset_ = batch_bytes() * (degree_bound_ / fastscan::kBatchSize);
+    words_offset_ = neighbor_offset_ + (degree_bound_ * sizeof(PID));
+    row_offset_ = round_up_to_multiple(words_offset_ + (padded_dim_ / 8), 64);
+    data_.assign(num_points_ * row_offset_, 0);
+    visited_list_pool_ = std::make_unique<VisitedListPool>(1, num_points_);
+}
+
+// the vertex nearest to the majority bits of all vertices
+inline PID BinaryQG::find_medoid(size_t num_threads) const {
+    size_t num_words = padded_dim_ / 64;
+    std::vector<size_t> ones(padded_dim_, 0);
+#pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<size_t> local_ones(padded_dim_, 0);
+#pragma omp for schedule(static)
+        for (size_t i = 0; i < num_points_; ++i) {
+            const uint64_t* words = get_words(static_cast<PID>(i));
+            for (size_t j = 0; j < padded_dim_; ++j) {
+                local_ones[j] += (words[j / 64] >> (63 - (j % 64))) & 1;
+            }
+        }
+#pragma omp critical
+        for (size_t j = 0; j < padded_dim_; ++j) {
+            ones[j] += local_ones[j];
+        }
+    }
+
+    std::vector<uint64_t> majority(num_words, 0);
+    for (size_t j = 0; j < padded_dim_; ++j) {
+        if (2 * ones[j] > num_points_) {
+            majority[j / 64] |= uint64_t{1} << (63 - (j % 64));
+        }
+    }
+
+    PID medoid = 0;
+    uint32_t min_dist = std::numeric_limits<uint32_t>::max();
+    for (size_t i = 0; i < num_points_; ++i) {
+        uint32_t dist =
+            hamming_distance(majority.data(), get_words(static_cast<PID>(i)), padded_dim_);
+        if (dist < min_dist) {
+            min_dist = dist;
+            medoid = static_cast<PID>(i);
+        }
+    }
+    return medoid;
+}
+
+// write the neighbors of cur_id. If the list is short (before the last iteration, or there
+// are fewer vertices than the degree bound), the vertex itself takes the rest slots, which
+// are skipped by searches since it is visited before its neighbors are scanned.
+inline void BinaryQG::set_neighbors(PID cur_id, const CandidateList& list) {
+    PID* dst = get_neighbors(cur_id);
+    size_t cnt = std::min(list.size(), degree_bound_);
+    for (size_t i = 0; i < cnt; ++i) {
+        dst[i] = list[i].id;
+    }
+    std::fill(dst + cnt, dst + degree_bound_, cur_id);
+}
+
+/**
+ * @brief Build the graph, vertex i is the i-th vector
+ *
+ * @param data packed binary vectors (num * binary_code_bytes(dim))
+ * @param ef_build size of search pool for indexing
+ * @param num_iter num of iterations, each searches candidates of all vertices on the
+ * current graph and adds reverse edges
+ * @param num_threads num of threads for indexing
+ */
+inline void BinaryQG::build(
+    const uint8_t* data, size_t ef_build, size_t num_iter, size_t num_threads
+) {
+    if (num_iter < 1) {
+        throw std::invalid_argument("BinaryQG: num of iterations should be >= 1");
+    }
+    num_threads = std::max<size_t>(std::min(num_threads, rabitqlib::total_threads()), 1);
+    if (num_points_ == 0) {
+        return;
+    }
+
+    size_t code_bytes = binary_code_bytes(dim_);
+    std::vector<uint8_t> codes(num_points_ * padded_dim_ / 8);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (size_t i = 0; i < num_points_; ++i) {
+        uint8_t* cur_code = &codes[i * padded_dim_ / 8];
+        pad_binary_code(data + (i * code_bytes), dim_, padded_dim_, cur_code);
+        binary_code_to_words(cur_code, padded_dim_, get_words(static_cast<PID>(i)));
+    }
+
+    entry_point_ = find_medoid(num_threads);
+
+    auto dist = [this](PID x, PID y) { return distance(x, y); };
+    GraphBuilder<decltype(dist)> builder(
+        dist, num_points_, degree_bound_, ef_build, num_threads
+    );
+    builder.set_entry_point(entry_point_);
+    builder.random_init();
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < num_points_; ++i) {
+        set_neighbors(static_cast<PID>(i), builder.neighbors(static_cast<PID>(i)));
+    }
+
+    // candidates are searched on the current graph by exact distances, neighbors are
+    // written after all vertices
+    auto neighbors_of = [this](PID cur, std::vector<PID>& ids) {
+        const PID* ptr_nb = get_neighbors(cur);
+        ids.assign(ptr_nb, ptr_nb + degree_bound_);
+    };
+    auto find = [&](PID cur_id, CandidateList& candidates, HashBasedBooleanSet& vis) {
+        builder.greedy_search(cur_id, candidates, vis, neighbors_of);
+    };
+    for (size_t iter = 0; iter < num_iter; ++iter) {
+        builder.iter(iter + 1 == num_iter, find);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+        for (size_t i = 0; i < num_points_; ++i) {
+            set_neighbors(static_cast<PID>(i), builder.neighbors(static_cast<PID>(i)));
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t i = 0; i < num_points_; ++i) {
+        std::vector<uint8_t> neighbor_codes(fastscan::kBatchSize * padded_dim_ / 8);
+        const PID* neighbors = get_neighbors(static_cast<PID>(i));
+        uint8_t* batch_data = get_batch_data(static_cast<PID>(i));
+        for (size_t j = 0; j < degree_bound_; j += fastscan::kBatchSize) {
+            for (size_t l = 0; l < fastscan::kBatchSize; ++l) {
+                const uint8_t* src = &codes[neighbors[j + l] * padded_dim_ / 8];
+                std::copy_n(src, padded_dim_ / 8, &neighbor_codes[l * padded_dim_ / 8]);
+            }
+            fastscan::pack_codes(
+                padded_dim_, neighbor_codes.data(), fastscan::kBatchSize, batch_data
+            );
+            batch_data += batch_bytes();
+        }
+    }
+}
+
+/**
+ * @brief Search the k nearest neighbors of a binary query by Hamming distance
+ *
+ * @param query packed binary query (binary_code_bytes(dim))
+ * @param k num of nearest neighbors
+ * @param results ids of results (k), kPidMax if fewer than k vertices are visited
+ * @param dists Hamming distances of results (k), may be nullptr
+ */
+inline void BinaryQG::search(
+    const uint8_t* __restrict__ query, size_t k, PID* __restrict__ results, float* dists
+) const {
+    search_impl(HammingQuery(query, dim_, padded_dim_), k, results, dists);
+}
+
+/**
+ * @brief Search the k nearest neighbors of a float query, distances are those to the
+ * {-1, 1} vectors of binary vectors (see AsymmetricQuery). Parameters are the same as
+ * search() of binary queries.
+ */
+inline void BinaryQG::search(
+    const float* __restrict__ query, size_t k, PID* __restrict__ results, float* dists
+) const {
+    search_impl(AsymmetricQuery(query, dim_, padded_dim_), k, results, dists);
+}
+
+// same as QuantizedGraph::search(), the exact distance of a vertex is computed by its
+// words once it is visited
+template <class Query>
+inline void BinaryQG::search_impl(
+    const Query& q_obj, size_t k, PID* results, float* dists
+) const {
+    std::fill(results, results + k, kPidMax);
+    if (k == 0 || num_points_ == 0) {
+        return;
+    }
+
+    buffer::SearchBuffer<float> search_pool(std::max(ef_, k));
+    search_pool.insert(entry_point_, std::numeric_limits<float>::max());
+
+    buffer::SearchBuffer<float> res_pool(k);
+    auto* vis = visited_list_pool_->get_free_vislist();
+
+    std::vector<float> est_dist(degree_bound_);
+    while (search_pool.has_next()) {
+        PID cur_node = search_pool.pop();
+        if (vis->get(cur_node)) {
+            continue;
+        }
+        vis->set(cur_node);
+        res_pool.insert(cur_node, q_obj.distance(get_words(cur_node)));
+
+        const uint8_t* batch_data = get_batch_data(cur_node);
+        for (size_t i = 0; i < degree_bound_; i += fastscan::kBatchSize) {
+            q_obj.batch_distance(batch_data, &est_dist[i]);
+            batch_data += batch_bytes();
+        }
+
+        const PID* ptr_nb = get_neighbors(cur_node);
+        for (size_t i = 0; i < degree_bound_; ++i) {
+            PID cur_neighbor = ptr_nb[i];
+            if (search_pool.is_full(est_dist[i]) || vis->get(cur_neighbor)) {
+                continue;
+            }
+            search_pool.insert(cur_neighbor, est_dist[i]);
+            memory::mem_prefetch_l2(
+                reinterpret_cast<const char*>(get_batch_data(search_pool.next_id())), 10
+            );
+        }
+    }
+
+    visited_list_pool_->release_vis_list(vis);
+    if (dists != nullptr) {
+        res_pool.copy_results(results, dists);
+    } else {
+        res_pool.copy_results(results);
+    }
+}
+
+inline void BinaryQG::save(const char* filename) const {
+    std::ofstream output(filename, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(&num_points_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&degree_bound_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&dim_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&entry_point_), sizeof(PID));
+    output.write(data_.data(), static_cast<long>(data_.size()));
+    if (!output) {
+        throw std::runtime_error(std::string("failed to write ") + filename);
+    }
+}
+
+inline void BinaryQG::load(const char* filename) {
+    if (!file_exists(filename)) {
+        throw std::runtime_error(std::string(filename) + " does not exist");
+    }
+    std::ifstream input(filename, std::ios::binary);
+    input.read(reinterpret_cast<char*>(&num_points_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&degree_bound_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&dim_), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&entry_point_), sizeof(PID));
+    padded_dim_ = round_up_to_multiple(dim_, 64);
+    initialize();
+    input.read(data_.data(), static_cast<long>(data_.size()));
+    if (input.fail()) {
+        throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+    }
+}
+}  // namespace rabitqlib::symqg
@@ -0,0 +1,733 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/hashset.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib::symqg {
+constexpr size_t kMaxBsIter = 5;  // max iter for binary search of pruning bar
+using CandidateList = std::vector<AnnCandidate<float>>;
+
+/**
+ * @brief Construction of the neighbor lists of a symqg-style graph, shared by QGBuilder and
+ * BinaryQG. The lists of the graph under construction are kept here, and the graph takes
+ * them by its own layout after each step. DistFunc gives the exact distance between
+ * vertices, dist(x, y) -> float. Since graph_refine() supplements edges by the angles
+ * between vertices, distances should behave as squared euclidean distances, as the
+ * Hamming distances of binary vectors do.
+ */
+template <class DistFunc>
+class GraphBuilder {
+   protected:
+    DistFunc dist_;
+    size_t ef_build_;      // size of search pool for indexing
+    size_t num_threads_;   // number of threads used for indexing
+    size_t num_nodes_;     // num of data points
+    size_t degree_bound_;  // degree bound, multiple of 32
+    PID entry_point_ = 0;  // entry point of searches on the graph
+    static constexpr size_t kMaxCandidatePoolSize =
+        750;  // max num of candidates for indexing
+    static constexpr size_t kMaxPrunedSize =
+        300;                                    // max number of recorded pruned candidates
+    std::vector<CandidateList> new_neighbors_;  // new neighbors for current iteration
+    std::vector<CandidateList> pruned_neighbors_;    // recorded pruned neighbors
+    std::vector<HashBasedBooleanSet> visited_list_;  // list of visited hash set
+
+    static bool insert_neighbor(CandidateList&, PID, float, size_t);
+    void heuristic_prune(PID, CandidateList&, CandidateList&, bool);
+    void add_reverse_edges(bool);
+    void add_pruned_edges(
+        const CandidateList&, const CandidateList&, CandidateList&, float
+    );
+    void robust_prune(const CandidateList&, CandidateList&, CandidateList&, float) const;
+
+   public:
+    explicit GraphBuilder(
+        DistFunc dist,
+        size_t num_nodes,
+        size_t degree_bound,
+        size_t ef_build,
+        size_t num_threads
+    )
+        : dist_{std::move(dist)}
+        , ef_build_{ef_build}
+        , num_threads_{std::max<size_t>(num_threads, 1)}
+        , num_nodes_{num_nodes}
+        , degree_bound_{degree_bound}
+        , new_neighbors_(num_nodes)
+        , pruned_neighbors_(num_nodes)
+        , visited_list_(
+              num_threads_,
+              HashBasedBooleanSet(std::min(ef_build_ * ef_build_, num_nodes_ / 10))
+          ) {}
+
+    void set_entry_point(PID entry_point) { entry_point_ = entry_point; }
+
+    // neighbors of a vertex sorted by distances
+    [[nodiscard]] const CandidateList& neighbors(PID data_id) const {
+        return new_neighbors_[data_id];
+    }
+
+    void random_init();
+
+    void nndescent_init();
+
+    void finish_init();
+
+    template <class FindFunc>
+    void search_new_neighbors(bool refine, const FindFunc& find);
+
+    template <class NeighborFunc>
+    void greedy_search(PID, CandidateList&, HashBasedBooleanSet&, const NeighborFunc&) const;
+
+    template <class FindFunc>
+    void iter(bool refine, const FindFunc& find);
+
+    void insert_vertices(float scale);
+
+    void graph_refine();
+};
+
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::add_pruned_edges(
+    const CandidateList& result,
+    const CandidateList& pruned_list,
+    CandidateList& new_result,
+    float threshold
+) {
+    size_t start = 0;
+    new_result.clear();
+    new_result = result;
+
+    std::unordered_set<PID> nei_set;
+    nei_set.reserve(degree_bound_);
+    for (const auto& nei : result) {
+        nei_set.emplace(nei.id);
+    }
+
+    while (new_result.size() < degree_bound_ && start < pruned_list.size()) {
+        const auto& cur = pruned_list[start];
+        bool occlude = false;
+        float dik_sqr = cur.distance;
+
+        if (nei_set.find(cur.id) != nei_set.end()) {
+            occlude = true;
+            break;
+        }
+
+        for (auto& nei : new_result) {
+            float dij_sqr = nei.distance;
+            if (dij_sqr > dik_sqr) {
+                break;
+            }
+            float djk_sqr = dist_(nei.id, cur.id);
+            float cosine =
+                (dik_sqr + dij_sqr - djk_sqr) / (2 * std::sqrt(dij_sqr * dik_sqr));
+            if (cosine > threshold) {
+                occlude = true;
+                break;
+            }
+        }
+
+        if (!occlude) {
+            new_result.emplace_back(cur);
+            nei_set.emplace(cur.id);
+            std::sort(new_result.begin(), new_result.end());
+        }
+
+        ++start;
+    }
+}
+
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::heuristic_prune(
+    PID cur_id, CandidateList& pool, CandidateList& pruned_results, bool refine
+) {
+    if (pool.empty()) {
+        return;
+    }
+    pruned_results.clear();
+    size_t poolsize = pool.size();
+
+    // if we dont have enough candidates, just keep all neighbors
+    if (poolsize <= degree_bound_) {
+        pruned_results = pool;
+        return;
+    }
+
+    std::vector<bool> pruned(
+        poolsize, false
+    );                 // bool vector to record if this neighbor is pruned
+    size_t start = 0;  // start position
+
+    while (pruned_results.size() < degree_bound_ && start < poolsize) {
+        auto candidate_id = pool[start].id;
+
+        // if already pruned, move to next
+        if (pruned[start]) {
+            ++start;
+            continue;
+        }
+
+        pruned_results.emplace_back(pool[start]);  // add current candidate to result
+
+        // i : current vertex
+        // j : neighbor added in this iter
+        // k : remained unpruned candidate neighbor
+        for (size_t k = start + 1; k < poolsize; ++k) {
+            if (pruned[k]) {
+                continue;
+            }
+            float dik = pool[k].distance;
+            auto djk = dist_(candidate_id, pool[k].id);
+
+            if (djk < dik) {
+                if (refine && pruned_neighbors_[cur_id].size() < kMaxPrunedSize) {
+                    pruned_neighbors_[cur_id].emplace_back(pool[k]);
+                }
+                pruned[k] = true;
+            }
+        }
+
+        ++start;
+    }
+}
+
+/**
+ * @brief search for new neighbor on the current graph
+ *
+ * @param refine refine = true means recording pruned candidates
+ * @param find find(cur_id, candidates, vis) appends the vertices expanded by a search of
+ * cur_id on the current graph (except cur_id) to candidates, and marks them in vis
+ */
+template <class DistFunc>
+template <class FindFunc>
+inline void GraphBuilder<DistFunc>::search_new_neighbors(bool refine, const FindFunc& find) {
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        PID cur_id = i;
+        auto tid = omp_get_thread_num();
+        CandidateList candidates;
+        HashBasedBooleanSet& vis = visited_list_[tid];
+        candidates.reserve(2 * kMaxCandidatePoolSize);
+        vis.clear();
+        find(cur_id, candidates, vis);
+
+        // add current neighbors
+        for (auto& nei : new_neighbors_[cur_id]) {
+            auto neighbor_id = nei.id;
+            if (neighbor_id != cur_id && !vis.get(neighbor_id)) {
+                candidates.emplace_back(nei);
+            }
+        }
+
+        size_t min_size = std::min(candidates.size(), kMaxCandidatePoolSize);
+        std::partial_sort(
+            candidates.begin(),
+            candidates.begin() + static_cast<long>(min_size),
+            candidates.end()
+        );
+        candidates.resize(min_size);
+
+        // prune and update qg
+        heuristic_prune(cur_id, candidates, new_neighbors_[cur_id], refine);
+    }
+}
+
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::add_reverse_edges(bool refine) {
+    std::vector<std::mutex> locks(num_nodes_);
+    std::vector<CandidateList> reverse_buffer(num_nodes_);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (PID data_id = 0; data_id < num_nodes_; ++data_id) {
+        for (const auto& nei : new_neighbors_[data_id]) {
+            PID dst = nei.id;
+            bool dup = false;
+            CandidateList& dst_neighbors = new_neighbors_[dst];
+            std::lock_guard lock(locks[dst]);
+            for (auto& dst_nei : dst_neighbors) {
+                if (dst_nei.id == data_id) {
+                    dup = true;
+                    break;
+                }
+            }
+            if (dup) {
+                continue;
+            }
+
+            if (dst_neighbors.size() < degree_bound_) {
+                dst_neighbors.emplace_back(data_id, nei.distance);
+            } else {
+                if (reverse_buffer[dst].size() < kMaxCandidatePoolSize) {
+                    reverse_buffer[dst].emplace_back(data_id, nei.distance);
+                }
+            }
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (PID data_id = 0; data_id < num_nodes_; ++data_id) {
+        CandidateList& tmp_pool = reverse_buffer[data_id];
+        tmp_pool.reserve(tmp_pool.size() + degree_bound_);
+        tmp_pool.insert(
+            tmp_pool.end(), new_neighbors_[data_id].begin(), new_neighbors_[data_id].end()
+        );
+        std::sort(tmp_pool.begin(), tmp_pool.end());
+        heuristic_prune(data_id, tmp_pool, new_neighbors_[data_id], refine);
+    }
+}
+
+// uniformly random neighbors, at most num of vertices - 1 if the graph is small
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::random_init() {
+    const PID min_id = 0;
+    const PID max_id = num_nodes_ - 1;
+    size_t cap = std::min(degree_bound_, num_nodes_ - 1);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        std::unordered_set<PID> neighbor_set;
+        neighbor_set.reserve(cap);
+        while (neighbor_set.size() < cap) {
+            PID rand_id = rand_integer<PID>(min_id, max_id);
+            if (rand_id != i) {
+                neighbor_set.emplace(rand_id);
+            }
+        }
+
+        new_neighbors_[i].reserve(cap);
+        for (PID cur_neigh : neighbor_set) {
+            new_neighbors_[i].emplace_back(cur_neigh, dist_(i, cur_neigh));
+        }
+    }
+}
+
+// insert a neighbor into a list sorted by distances with at most cap neighbors, return
+// if the list is updated
+template <class DistFunc>
+inline bool GraphBuilder<DistFunc>::insert_neighbor(
+    CandidateList& list, PID id, float dist, size_t cap
+) {
+    if (list.size() >= cap && dist >= list.back().distance) {
+        return false;
+    }
+    for (const auto& nei : list) {
+        if (nei.id == id) {
+            return false;
+        }
+    }
+    AnnCandidate<float> cur(id, dist);
+    list.insert(std::upper_bound(list.begin(), list.end(), cur), cur);
+    if (list.size() > cap) {
+        list.pop_back();
+    }
+    return true;
+}
+
+// fill the initial graph in new_neighbors_ to the degree bound by random vertices, which
+// serve as long edges
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::finish_init() {
+    size_t cap = std::min(degree_bound_, num_nodes_ - 1);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        CandidateList& list = new_neighbors_[i];
+        while (list.size() < cap) {
+            PID rand_id = rand_integer<PID>(0, static_cast<PID>(num_nodes_) - 1);
+            if (rand_id != i) {
+                insert_neighbor(list, rand_id, dist_(i, rand_id), cap);
+            }
+        }
+    }
+}
+
+/**
+ * @brief init the graph by NN-Descent (Dong et al., WWW'11), i.e., starting from random
+ * neighbors, neighbors of neighbors (including reverse ones) are joined locally until few
+ * lists are updated in an iteration. Only a sample of new neighbors joins in each
+ * iteration, so that each pair of vertices is compared about once.
+ */
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::nndescent_init() {
+    constexpr size_t kMaxIter = 10;
+    constexpr float kDelta = 0.01F;  // stop if fewer updates than kDelta * n * K
+    // K of the kNN graph, other half of the neighbors are random
+    size_t cap = std::min(degree_bound_ / 2, num_nodes_ - 1);
+    size_t sample_size = std::max<size_t>(cap / 2, 1);
+
+    std::cout << "Initializing graph by NN-Descent...\n";
+    std::vector<std::vector<bool>> is_new(num_nodes_);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        while (new_neighbors_[i].size() < cap) {
+            PID rand_id = rand_integer<PID>(0, static_cast<PID>(num_nodes_) - 1);
+            if (rand_id != i) {
+                insert_neighbor(new_neighbors_[i], rand_id, dist_(i, rand_id), cap);
+            }
+        }
+        is_new[i].assign(cap, true);
+    }
+
+    std::vector<std::mutex> locks(num_nodes_);
+    for (size_t iter = 0; iter < kMaxIter; ++iter) {
+        std::vector<std::vector<PID>> new_cands(num_nodes_);
+        std::vector<std::vector<PID>> old_cands(num_nodes_);
+
+        // sample new neighbors and mark them as old, then add reverse candidates
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+        for (size_t i = 0; i < num_nodes_; ++i) {
+            std::lock_guard lock(locks[i]);
+            for (size_t j = 0; j < new_neighbors_[i].size(); ++j) {
+                if (!is_new[i][j]) {
+                    old_cands[i].push_back(new_neighbors_[i][j].id);
+                } else if (new_cands[i].size() < sample_size) {
+                    new_cands[i].push_back(new_neighbors_[i][j].id);
+                    is_new[i][j] = false;
+                }
+            }
+        }
+        std::vector<std::vector<PID>> new_reverse(num_nodes_);
+        std::vector<std::vector<PID>> old_reverse(num_nodes_);
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+        for (size_t i = 0; i < num_nodes_; ++i) {
+            for (PID nei : new_cands[i]) {
+                std::lock_guard lock(locks[nei]);
+                if (new_reverse[nei].size() < sample_size) {
+                    new_reverse[nei].push_back(static_cast<PID>(i));
+                }
+            }
+            for (PID nei : old_cands[i]) {
+                std::lock_guard lock(locks[nei]);
+                if (old_reverse[nei].size() < sample_size) {
+                    old_reverse[nei].push_back(static_cast<PID>(i));
+                }
+            }
+        }
+
+        // local join
+        std::atomic<size_t> num_updates{0};
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+        for (size_t i = 0; i < num_nodes_; ++i) {
+            std::vector<PID>& news = new_cands[i];
+            std::vector<PID>& olds = old_cands[i];
+            news.insert(news.end(), new_reverse[i].begin(), new_reverse[i].end());
+            olds.insert(olds.end(), old_reverse[i].begin(), old_reverse[i].end());
+            std::sort(news.begin(), news.end());
+            news.erase(std::unique(news.begin(), news.end()), news.end());
+
+            size_t updates = 0;
+            auto join = [&](PID u, PID v) {
+                if (u == v) {
+                    return;
+                }
+                float dist = dist_(u, v);
+                for (auto [x, y] : {std::pair{u, v}, std::pair{v, u}}) {
+                    std::lock_guard lock(locks[x]);
+                    CandidateList& list = new_neighbors_[x];
+                    if (list.size() >= cap && dist >= list.back().distance) {
+                        continue;
+                    }
+                    size_t pos = std::upper_bound(
+                                     list.begin(), list.end(), AnnCandidate<float>(y, dist)
+                                 ) -
+                                 list.begin();
+                    if (insert_neighbor(list, y, dist, cap)) {
+                        is_new[x].insert(is_new[x].begin() + static_cast<long>(pos), true);
+                        is_new[x].resize(list.size());
+                        ++updates;
+                    }
+                }
+            };
+            for (size_t a = 0; a < news.size(); ++a) {
+                for (size_t b = a + 1; b < news.size(); ++b) {
+                    join(news[a], news[b]);
+                }
+                for (PID old : olds) {
+                    join(news[a], old);
+                }
+            }
+            num_updates += updates;
+        }
+
+        std::cout << "\tNN-Descent iter " << iter << ", updates " << num_updates << '\n';
+        if (static_cast<float>(num_updates) <
+            kDelta * static_cast<float>(num_nodes_ * cap)) {
+            break;
+        }
+    }
+
+    finish_init();
+}
+
+/**
+ * @brief refine the graph structure, make sure the degree for each vertex equals the
+ * degree bound (multiple of 32), or num of vertices - 1 if the graph is small
+ *
+ */
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::graph_refine() {
+    std::cout << "Supplementing edges...\n";
+    size_t cap = std::min(degree_bound_, num_nodes_ - 1);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        CandidateList& cur_neighbors = new_neighbors_[i];
+        size_t cur_degree = cur_neighbors.size();
+
+        // skip vertices with enough neighbors
+        if (cur_degree >= cap) {
+            continue;
+        }
+
+        CandidateList& pruned_list = pruned_neighbors_[i];
+        CandidateList new_result;
+        new_result.reserve(degree_bound_);
+
+        std::sort(pruned_list.begin(), pruned_list.end());
+
+        // use binary search to get refined results
+        float left = 0.5;
+        float right = 1.0;
+        size_t iter = 0;
+        while (iter++ < kMaxBsIter) {
+            float mid = (left + right) / 2;
+            add_pruned_edges(cur_neighbors, pruned_list, new_result, mid);
+            if (new_result.size() < degree_bound_) {
+                left = mid;
+            } else {
+                right = mid;
+            }
+        }
+
+        // update neighbors with larger cosine value since we want to retain more edges
+        add_pruned_edges(cur_neighbors, pruned_list, new_result, right);
+
+        // if the vertex still doesn't have enough neighbors, use random vertices
+        if (new_result.size() < cap) {
+            std::unordered_set<PID> ids;
+            ids.reserve(degree_bound_);
+            for (auto& neighbor : new_result) {
+                ids.emplace(neighbor.id);
+            }
+            while (new_result.size() < cap) {
+                PID rand_id = rand_integer<PID>(0, static_cast<PID>(num_nodes_) - 1);
+                if (rand_id != static_cast<PID>(i) && ids.find(rand_id) == ids.end()) {
+                    new_result.emplace_back(rand_id, dist_(rand_id, i));
+                    ids.emplace(rand_id);
+                }
+            }
+        }
+
+        cur_neighbors = new_result;
+    }
+    std::cout << "Supplementing finished...\n";
+}
+
+/**
+ * @brief greedy beam search for cur_id by exact distances from the entry point, all
+ * expanded vertices except cur_id are appended to results and marked in vis
+ *
+ * @param neighbors_of neighbors_of(vertex, ids) copies the neighbors of the vertex on the
+ * graph to be searched into ids
+ */
+template <class DistFunc>
+template <class NeighborFunc>
+inline void GraphBuilder<DistFunc>::greedy_search(
+    PID cur_id,
+    CandidateList& results,
+    HashBasedBooleanSet& vis,
+    const NeighborFunc& neighbors_of
+) const {
+    buffer::SearchBuffer<float> pool(ef_build_);
+    pool.insert(entry_point_, dist_(cur_id, entry_point_));
+
+    std::vector<PID> neighbors;
+    while (pool.has_next()) {
+        PID cur = pool.pop();
+        if (vis.get(cur)) {
+            continue;
+        }
+        vis.set(cur);
+        if (cur != cur_id) {
+            results.emplace_back(cur, dist_(cur_id, cur));
+        }
+        neighbors_of(cur, neighbors);
+        for (PID nei : neighbors) {
+            if (!vis.get(nei)) {
+                pool.insert(nei, dist_(cur_id, nei));
+            }
+        }
+    }
+}
+
+/**
+ * @brief robust (alpha) pruning of Vamana, a candidate k is pruned by a kept neighbor j if
+ * scale * d(j, k) < d(i, k), pruned candidates are appended to pruned for graph_refine()
+ *
+ * @param pool candidates sorted by distances, without duplicates
+ */
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::robust_prune(
+    const CandidateList& pool, CandidateList& results, CandidateList& pruned, float scale
+) const {
+    results.clear();
+    std::vector<bool> removed(pool.size(), false);
+    for (size_t j = 0; j < pool.size() && results.size() < degree_bound_; ++j) {
+        if (removed[j]) {
+            continue;
+        }
+        results.emplace_back(pool[j]);
+        for (size_t k = j + 1; k < pool.size(); ++k) {
+            if (removed[k]) {
+                continue;
+            }
+            float djk = dist_(pool[j].id, pool[k].id);
+            if (scale * djk < pool[k].distance) {
+                removed[k] = true;
+                if (pruned.size() < kMaxPrunedSize) {
+                    pruned.emplace_back(pool[k]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief one pass of greedy insertion (DiskANN/Vamana style), see
+ * QGBuilder::build_vamana(). The random graph of random_init() is the start, and
+ * graph_refine() supplements edges at the end.
+ *
+ * @param scale scale of d(j, k) in robust_prune()
+ */
+template <class DistFunc>
+inline void GraphBuilder<DistFunc>::insert_vertices(float scale) {
+    std::vector<std::mutex> locks(num_nodes_);
+    for (size_t i = 0; i < num_nodes_; ++i) {
+        pruned_neighbors_[i].clear();
+    }
+
+    // insert vertices in random order
+    std::vector<PID> order(num_nodes_);
+    std::iota(order.begin(), order.end(), 0);
+    for (size_t i = num_nodes_; i > 1; --i) {
+        std::swap(order[i - 1], order[rand_integer<size_t>(0, i - 1)]);
+    }
+
+    // search on the graph under construction
+    auto neighbors_of = [&](PID cur, std::vector<PID>& ids) {
+        std::lock_guard lock(locks[cur]);
+        ids.clear();
+        for (const auto& nei : new_neighbors_[cur]) {
+            ids.push_back(nei.id);
+        }
+    };
+
+    std::cout << "Inserting vertices...\n";
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+    for (size_t idx = 0; idx < num_nodes_; ++idx) {
+        PID cur_id = order[idx];
+        HashBasedBooleanSet& vis = visited_list_[omp_get_thread_num()];
+        vis.clear();
+        CandidateList candidates;
+        candidates.reserve(2 * kMaxCandidatePoolSize);
+        greedy_search(cur_id, candidates, vis, neighbors_of);
+
+        // add current neighbors which are not expanded
+        {
+            std::lock_guard lock(locks[cur_id]);
+            for (const auto& nei : new_neighbors_[cur_id]) {
+                if (nei.id != cur_id && !vis.get(nei.id)) {
+                    candidates.emplace_back(nei);
+                }
+            }
+        }
+
+        size_t min_size = std::min(candidates.size(), kMaxCandidatePoolSize);
+        std::partial_sort(
+            candidates.begin(),
+            candidates.begin() + static_cast<long>(min_size),
+            candidates.end()
+        );
+        candidates.resize(min_size);
+
+        CandidateList result;
+        CandidateList pruned;
+        robust_prune(candidates, result, pruned, scale);
+        {
+            std::lock_guard lock(locks[cur_id]);
+            new_neighbors_[cur_id] = result;
+            pruned_neighbors_[cur_id] = std::move(pruned);
+        }
+
+        // add reverse edges, neighbor lists are kept sorted
+        for (const auto& nei : result) {
+            PID dst = nei.id;
+            std::lock_guard lock(locks[dst]);
+            CandidateList& dst_neighbors = new_neighbors_[dst];
+            bool dup = std::any_of(
+                dst_neighbors.begin(),
+                dst_neighbors.end(),
+                [cur_id](const auto& dst_nei) { return dst_nei.id == cur_id; }
+            );
+            if (dup) {
+                continue;
+            }
+            AnnCandidate<float> reverse(cur_id, nei.distance);
+            if (dst_neighbors.size() < degree_bound_) {
+                dst_neighbors.insert(
+                    std::upper_bound(dst_neighbors.begin(), dst_neighbors.end(), reverse),
+                    reverse
+                );
+            } else {
+                CandidateList pool = dst_neighbors;
+                pool.emplace_back(reverse);
+                std::sort(pool.begin(), pool.end());
+                robust_prune(pool, dst_neighbors, pruned_neighbors_[dst], scale);
+            }
+        }
+    }
+
+    // make sure each vertex has degree_bound_ neighbors
+    graph_refine();
+}
+
+/**
+ * @brief one iteration of building, i.e., search candidates of all vertices on the
+ * current graph (see search_new_neighbors()), prune them and add reverse edges
+ *
+ * @param refine refine = true means supplementing edges by pruned candidates
+ */
+template <class DistFunc>
+template <class FindFunc>
+inline void GraphBuilder<DistFunc>::iter(bool refine, const FindFunc& find) {
+    if (refine) {
+        for (size_t i = 0; i < num_nodes_; ++i) {
+            pruned_neighbors_[i].clear();
+            pruned_neighbors_[i].reserve(kMaxPrunedSize);
+        }
+    }
+
+    search_new_neighbors(refine, find);
+
+    add_reverse_edges(refine);
+
+    // Use pruned edges to refine graph
+    if (refine) {
+        graph_refine();
+    }
+}
+}  // namespace rabitqlib::symqg
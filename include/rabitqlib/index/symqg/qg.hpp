@@ -2,6 +2,8 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -9,7 +11,13 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -20,6 +28,7 @@
 #include "rabitqlib/quantization/rabitq.hpp"
 #include "rabitqlib/utils/array.hpp"
 #include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/chunked_file.hpp"
 #include "rabitqlib/utils/hashset.hpp"
 #include "rabitqlib/utils/io.hpp"
 #include "rabitqlib/utils/memory.hpp"
@@ -32,6 +41,7 @@ namespace rabitqlib::symqg {
 template <typename T = float>
 class QuantizedGraph {
     friend class QGBuilder;
+    friend struct QGVertexDistance;
 
    private:
     size_t num_points_ = 0;                           // num points
@@ -62,6 +72,15 @@ class QuantizedGraph {
     size_t row_offset_ = 0;         // length of entire row
     size_t ef_ = 0;
 
+    // (vertex, slot) of the nearest in-neighbor of each vertex, where the 1-bit code used by
+    // score_ids() is stored. Built on demand by score_ids() and invalidated once the graph
+    // is updated
+    mutable std::vector<std::pair<PID, PID>> in_edges_;
+    mutable std::atomic<bool> in_edges_ready_{false};
+    mutable std::mutex in_edges_lock_;
+
+    void init_in_edges() const;
+
     void initialize();
 
     void copy_vectors(const T*);
@@ -115,6 +134,15 @@ class QuantizedGraph {
         size_t
     ) const;
 
+    // QG stores 1-bit codes for neighbors and raw vectors for re-ranking
+    [[nodiscard]] IndexFileMeta file_meta() const {
+        return {IndexFileType::QG, dim_, metric_type_, 1, rotator_type_};
+    }
+
+    void save_stream(std::ostream&) const;
+
+    void load_stream(std::istream&);
+
    public:
     explicit QuantizedGraph(
         size_t num,
@@ -142,7 +170,9 @@ class QuantizedGraph {
 
     void save(const char*) const;
 
-    void load(const char*);
+    void save_compressed(const char*, const ChunkedFileConfig& = {}) const;
+
+    void load(const char*, size_t = 0);
 
     void set_ef(size_t);
 
@@ -154,6 +184,21 @@ class QuantizedGraph {
         uint32_t* __restrict__ results,
         T* __restrict__ dists
     );
+
+    void search_with_bounds(
+        const T* __restrict__ query,
+        uint32_t knn,
+        uint32_t* __restrict__ results,
+        DistBound* __restrict__ bounds
+    );
+
+    std::vector<buffer::GroupHits<T>> search_grouped(
+        const T* __restrict__ query, size_t num_groups, size_t group_size, const PID*
+    );
+
+    void score_ids(
+        const T*, const PID*, size_t, T*, ScoreMode mode = SCORE_FULL_BITS
+    ) const;
 };
 
 template <typename T>
@@ -191,7 +236,26 @@ inline void QuantizedGraph<T>::save(const char* filename) const {
     std::cout << "Saving quantized graph to " << filename << '\n';
     std::ofstream output(filename, std::ios::binary);
     assert(output.is_open());
+    save_stream(output);
+    output.close();
+    std::cout << "\tQuantized graph saved!\n";
+}
+
+// save as a chunked container (see chunked_file.hpp), load() detects the format
+template <typename T>
+inline void QuantizedGraph<T>::save_compressed(
+    const char* filename, const ChunkedFileConfig& config
+) const {
+    std::cout << "Saving compressed quantized graph to " << filename << '\n';
+    ChunkedFileWriter writer(filename, file_meta(), config);
+    std::ostream output(&writer);
+    save_stream(output);
+    writer.finish();
+    std::cout << "\tQuantized graph saved!\n";
+}
 
+template <typename T>
+inline void QuantizedGraph<T>::save_stream(std::ostream& output) const {
     /* Basic variants */
     output.write(reinterpret_cast<const char*>(&num_points_), sizeof(size_t));
     output.write(reinterpret_cast<const char*>(&degree_bound_), sizeof(size_t));
@@ -206,13 +270,10 @@ inline void QuantizedGraph<T>::save(const char* filename) const {
 
     /* Rotator */
     this->rotator_->save(output);
-
-    output.close();
-    std::cout << "\tQuantized graph saved!\n";
 }
 
 template <typename T>
-inline void QuantizedGraph<T>::load(const char* filename) {
+inline void QuantizedGraph<T>::load(const char* filename, size_t num_threads) {
     std::cout << "loading quantized graph " << filename << '\n';
 
     /* Check existence */
@@ -221,9 +282,29 @@ inline void QuantizedGraph<T>::load(const char* filename) {
         exit(1);
     }
 
-    std::ifstream input(filename, std::ios::binary);
-    assert(input.is_open());
+    if (is_chunked_file(filename)) {
+        ChunkedFileReader reader(filename, num_threads);
+        if (reader.meta().index_type != IndexFileType::QG) {
+            throw std::runtime_error(std::string(filename) + " is not a QG index");
+        }
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        load_stream(input);
+        if (input.fail()) {
+            throw std::runtime_error(std::string(filename) + ": unexpected end of data");
+        }
+        reader.check_meta(file_meta());
+    } else {
+        std::ifstream input(filename, std::ios::binary);
+        assert(input.is_open());
+        load_stream(input);
+        input.close();
+    }
+    std::cout << "Quantized graph loaded!\n";
+}
 
+template <typename T>
+inline void QuantizedGraph<T>::load_stream(std::istream& input) {
     /* Basic variants */
     input.read(reinterpret_cast<char*>(&num_points_), sizeof(size_t));
     input.read(reinterpret_cast<char*>(&degree_bound_), sizeof(size_t));
@@ -246,9 +327,6 @@ inline void QuantizedGraph<T>::load(const char* filename) {
         std::cerr << "Bad padded_dim_ for rotator in QuantizedGraph<T>.load()\n";
         exit(1);
     }
-
-    input.close();
-    std::cout << "Quantized graph loaded!\n";
 }
 
 template <typename T>
@@ -344,6 +422,78 @@ inline void QuantizedGraph<T>::search(
     res_pool.copy_results(results, dists);
 }
 
+/**
+ * @brief search on qg and output the distance bounds of results (see DistBound). Results of
+ * qg are re-ranked by raw vectors, thus they are always exactly refined and their bounds
+ * equal their distances. If fewer than knn vectors are found, the rest of results are
+ * kPidMax.
+ */
+template <typename T>
+inline void QuantizedGraph<T>::search_with_bounds(
+    const T* __restrict__ query,
+    uint32_t k,
+    uint32_t* __restrict__ results,
+    DistBound* __restrict__ bounds
+) {
+    std::vector<T> dists(k);
+    std::fill(results, results + k, kPidMax);
+    search(query, k, results, dists.data());
+    for (size_t i = 0; i < k && results[i] != kPidMax; ++i) {
+        auto dist = static_cast<float>(dists[i]);
+        bounds[i] = {dist, dist, dist, true};
+    }
+}
+
+/**
+ * @brief grouped (diversified) search on qg, return the best num_groups groups with at
+ * most group_size hits for each group. Every visited vertex is inserted into the bounded
+ * heap of its group with its exact distance. The beam size is at least
+ * num_groups * group_size so that the traversal visits enough vertices to fill the groups.
+ *
+ * @param query         unrotated query vector, dimension_ elements
+ * @param num_groups    max number of groups in results
+ * @param group_size    max number of hits for each group
+ * @param group_keys    group key of each vertex, indexed by PID
+ * @return groups sorted by their best hits, hits of each group sorted by distance
+ */
+template <typename T>
+inline std::vector<buffer::GroupHits<T>> QuantizedGraph<T>::search_grouped(
+    const T* __restrict__ query, size_t num_groups, size_t group_size, const PID* group_keys
+) {
+    std::vector<T> rotated_query(padded_dim_);
+    rotator_->rotate(query, rotated_query.data());
+
+    // init query
+    BatchQuery<T> q_obj(rotated_query.data(), padded_dim_);
+
+    buffer::SearchBuffer<T> search_pool(std::max(ef_, num_groups * group_size));
+    // init search buffer
+    search_pool.insert(this->entry_point_, std::numeric_limits<T>::max());
+
+    buffer::GroupedBuffer<T> res_pool(num_groups, group_size, group_keys);
+    auto* vis = visited_list_pool_->get_free_vislist();
+
+    std::vector<T> est_dist(degree_bound_);  // estimated distances
+
+    while (search_pool.has_next()) {
+        PID cur_node = search_pool.pop();
+        if (vis->get(cur_node)) {
+            continue;
+        }
+        vis->set(cur_node);
+
+        q_obj.set_g_add(raw_dist_func_(query, get_vector(cur_node), dim_));
+
+        scan_neighbors(
+            q_obj, cur_node, est_dist.data(), search_pool, *vis, this->degree_bound_
+        );
+        res_pool.insert(cur_node, q_obj.g_add());
+    }
+
+    visited_list_pool_->release_vis_list(vis);
+    return res_pool.results();
+}
+
 // scan a data row (including data vec and quantization codes for its neighbors)
 // store estimated distance & return exact distnace for current vertex
 template <typename T>
@@ -407,7 +557,9 @@ template <typename T>
 inline void QuantizedGraph<T>::initialize() {
     ::delete rotator_;
 
-    rotator_ = choose_rotator<float>(dim_, rotator_type_, round_up_to_multiple(dim_, 64));
+    rotator_ = choose_rotator<float>(
+        dim_, rotator_type_, index_padded_dim(dim_, rotator_type_)
+    );
     padded_dim_ = rotator_->size();
 
     /* check size */
@@ -477,6 +629,8 @@ inline void QuantizedGraph<T>::update_qg(
     if (cur_degree == 0) {
         return;
     }
+    in_edges_ready_.store(false, std::memory_order_relaxed);
+
     // copy neighbors
     PID* neighbor_ptr = get_neighbors(cur_id);
     for (size_t i = 0; i < cur_degree; ++i) {
@@ -509,4 +663,115 @@ inline void QuantizedGraph<T>::update_qg(
         batch_data += QGBatchDataMap<T>::data_bytes(padded_dim_);
     }
 }
+
+template <typename T>
+inline void QuantizedGraph<T>::init_in_edges() const {
+    std::lock_guard<std::mutex> lock(in_edges_lock_);
+    if (in_edges_ready_.load(std::memory_order_acquire)) {
+        return;
+    }
+    // the error of a 1-bit estimation grows with the distance of the vector to the vertex
+    // storing its code, thus the code of the nearest in-neighbor is taken
+    in_edges_.assign(num_points_, {kPidMax, kPidMax});
+    std::vector<T> in_dists(num_points_, std::numeric_limits<T>::max());
+    for (PID i = 0; i < num_points_; ++i) {
+        const PID* ptr_nb = get_neighbors(i);
+        for (PID j = 0; j < degree_bound_; ++j) {
+            PID cur_neighbor = ptr_nb[j];
+            if (cur_neighbor >= num_points_ || cur_neighbor == i) {
+                continue;
+            }
+            T dist = euclidean_sqr<T>(get_vector(i), get_vector(cur_neighbor), dim_);
+            if (dist < in_dists[cur_neighbor]) {
+                in_dists[cur_neighbor] = dist;
+                in_edges_[cur_neighbor] = {i, j};
+            }
+        }
+    }
+    in_edges_ready_.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Compute distances between a query and an explicit list of candidates.
+ *
+ * QG keeps raw vectors, so SCORE_FULL_BITS and SCORE_EXACT both return exact distances.
+ * The 1-bit code of a vertex is stored in the row of one of its in-neighbors. For
+ * SCORE_ONE_BIT, candidates are grouped by the in-neighbor and the FastScan batch holding
+ * their codes, each group costs one distance to the in-neighbor and one batch estimation.
+ * Vertices without in-edges fall back to exact distances.
+ *
+ * @param query query vector (DIM)
+ * @param ids ids of candidates
+ * @param num num of candidates
+ * @param dists distances of candidates (num), in the same order as ids
+ * @param mode SCORE_ONE_BIT, SCORE_FULL_BITS or SCORE_EXACT
+ */
+template <typename T>
+inline void QuantizedGraph<T>::score_ids(
+    const T* __restrict__ query,
+    const PID* __restrict__ ids,
+    size_t num,
+    T* __restrict__ dists,
+    ScoreMode mode
+) const {
+    for (size_t i = 0; i < num; ++i) {
+        if (ids[i] >= num_points_) {
+            throw std::out_of_range(
+                "Bad id " + std::to_string(ids[i]) + " in QuantizedGraph::score_ids"
+            );
+        }
+    }
+
+    if (mode != SCORE_ONE_BIT) {
+        for (size_t i = 0; i < num; ++i) {
+            dists[i] = raw_dist_func_(query, get_vector(ids[i]), dim_);
+        }
+        return;
+    }
+
+    if (!in_edges_ready_.load(std::memory_order_acquire)) {
+        init_in_edges();
+    }
+
+    std::vector<T> rotated_query(padded_dim_);
+    rotator_->rotate(query, rotated_query.data());
+    BatchQuery<T> q_obj(rotated_query.data(), padded_dim_);
+
+    // group candidates by the batch storing their codes
+    std::vector<size_t> order(num);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return in_edges_[ids[a]] < in_edges_[ids[b]];
+    });
+
+    std::vector<T> est_dist(fastscan::kBatchSize);
+    PID cur_vertex = kPidMax;
+    PID cur_batch = kPidMax;
+    for (size_t idx : order) {
+        auto [vertex, slot] = in_edges_[ids[idx]];
+        if (vertex == kPidMax) {
+            dists[idx] = raw_dist_func_(query, get_vector(ids[idx]), dim_);
+            continue;
+        }
+
+        if (vertex != cur_vertex) {
+            q_obj.set_g_add(raw_dist_func_(query, get_vector(vertex), dim_));
+            cur_vertex = vertex;
+            cur_batch = kPidMax;
+        }
+
+        PID batch = slot / fastscan::kBatchSize;
+        if (batch != cur_batch) {
+            size_t batch_bytes = QGBatchDataMap<T>::data_bytes(padded_dim_);
+            qg_batch_estdist(
+                get_batch_data(vertex) + (batch * batch_bytes),
+                q_obj,
+                padded_dim_,
+                est_dist.data()
+            );
+            cur_batch = batch;
+        }
+        dists[idx] = est_dist[slot % fastscan::kBatchSize];
+    }
+}
 }  // namespace rabitqlib::symqg
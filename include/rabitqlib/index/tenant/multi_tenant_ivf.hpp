@@ -0,0 +1,1046 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/fastscan/fastscan.hpp"
+#include "rabitqlib/index/estimator.hpp"
+#include "rabitqlib/index/query.hpp"
+#include "rabitqlib/quantization/data_layout.hpp"
+#include "rabitqlib/quantization/rabitq.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "rabitqlib/utils/page_arena.hpp"
+#include "rabitqlib/utils/rotator.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib::tenant {
+using TenantId = uint64_t;
+
+/**
+ * @brief Many small IVF indices (tenants) in one object. All tenants share one rotator,
+ * one quantization config and the code kernels, and the batches of all their clusters are
+ * pages of one PageArena. A page holds a FastScan batch of 32 vectors followed by their ex
+ * codes and PIDs, i.e., the ClusterLayout::Interleaved layout of IVF.
+ *
+ * Each tenant has its own centroids, clusters and PIDs, a search of a tenant only reads
+ * its clusters. Vectors are added to the nearest centroid and removed by moving the last
+ * vector of the cluster into the hole, thus no tombstones are kept.
+ *
+ * Tenants live in files of a directory. A tenant is loaded when it is used, and the least
+ * recently used tenants are saved (if changed) and evicted once the memory of loaded
+ * tenants exceeds the budget. Changes of loaded tenants are written by flush() or by
+ * eviction, not by the destructor.
+ *
+ * All member functions are thread-safe. Searches of a tenant run concurrently, add() and
+ * remove() of a tenant are exclusive to other calls on the same tenant.
+ */
+class MultiTenantIVF {
+   private:
+    struct Location {
+        uint32_t cluster;  // cluster of the vector
+        uint32_t offset;   // position of the vector in the cluster
+    };
+
+    struct Tenant {
+        TenantId id = 0;
+        std::shared_mutex mutex;                   // shared by searches
+        std::atomic<bool> resident{false};         // clusters are in memory
+        std::atomic<size_t> pins{0};               // acquire() in progress, not evicted
+        bool dirty = false;                        // changed since the last save
+        bool dropped = false;                      // removed by drop_tenant()
+        uint64_t last_used = 0;                    // guarded by mutex_ of the container
+        size_t bytes = 0;                          // memory of the tenant if resident
+        size_t num_clusters = 0;                   // num of clusters
+        std::vector<float> centroids;              // rotated centroids (num_clusters * D)
+        std::vector<std::vector<char*>> pages;     // pages of each cluster
+        std::vector<size_t> sizes;                 // num of vectors of each cluster
+        std::unordered_map<PID, Location> id_map;  // location of each PID
+    };
+
+    // estimated bytes of an entry of Tenant::id_map
+    static constexpr size_t kIdEntryBytes = sizeof(std::pair<PID, Location>) + 32;
+
+    std::string directory_;                      // directory of tenant files
+    size_t dim_;                                 // dimension of data points
+    size_t padded_dim_;                          // dimension after padding
+    size_t ex_bits_;                             // total bits = ex_bits_ + 1
+    MetricType metric_type_;                     // metric type
+    RotatorType type_;                           // type of rotator
+    size_t memory_budget_;                       // max bytes of resident tenants
+    std::unique_ptr<Rotator<float>> rotator_;    // rotator shared by all tenants
+    quant::RabitqConfig config_;                 // quantization config of all tenants
+    float (*ip_func_)(const float*, const uint8_t*, size_t) = nullptr;
+    memory::PageArena arena_;                    // pages of all tenants
+    std::unordered_map<TenantId, std::shared_ptr<Tenant>> tenants_;
+    std::atomic<size_t> resident_bytes_{0};      // memory of resident tenants
+    uint64_t clock_ = 0;                         // for last_used
+    mutable std::mutex mutex_;                   // guards tenants_ and last_used
+
+    [[nodiscard]] size_t batch_bytes() const {
+        return BatchDataMap<float>::data_bytes(padded_dim_);
+    }
+
+    [[nodiscard]] size_t ex_bytes() const {
+        return ExDataMap<float>::data_bytes(padded_dim_, ex_bits_);
+    }
+
+    [[nodiscard]] static size_t page_bytes(size_t padded_dim, size_t ex_bits) {
+        return BatchDataMap<float>::data_bytes(padded_dim) +
+               ((ExDataMap<float>::data_bytes(padded_dim, ex_bits) + sizeof(PID)) *
+                fastscan::kBatchSize);
+    }
+
+    [[nodiscard]] char* ex_data_of(char* page, size_t lane) const {
+        return page + batch_bytes() + (lane * ex_bytes());
+    }
+
+    [[nodiscard]] PID* ids_of(char* page) const {
+        return reinterpret_cast<PID*>(
+            page + batch_bytes() + (fastscan::kBatchSize * ex_bytes())
+        );
+    }
+
+    // packed 1-bit codes of a page
+    [[nodiscard]] static uint8_t* codes_of(char* page) {
+        return reinterpret_cast<uint8_t*>(page);
+    }
+
+    [[nodiscard]] std::string tenant_file(TenantId id) const {
+        return directory_ + "/tenant_" + std::to_string(id) + ".bin";
+    }
+
+    [[nodiscard]] std::string meta_file() const { return directory_ + "/meta.bin"; }
+
+    // id of a file named by tenant_file(), false for other names
+    [[nodiscard]] static bool parse_tenant_file(const std::string& name, TenantId& id) {
+        constexpr size_t kPrefix = 7;  // "tenant_"
+        constexpr size_t kSuffix = 4;  // ".bin"
+        if (name.size() <= kPrefix + kSuffix || name.rfind("tenant_", 0) != 0 ||
+            name.compare(name.size() - kSuffix, kSuffix, ".bin") != 0) {
+            return false;
+        }
+        const char* first = name.data() + kPrefix;
+        const char* last = name.data() + name.size() - kSuffix;
+        auto [ptr, ec] = std::from_chars(first, last, id);
+        return ec == std::errc() && ptr == last;
+    }
+
+    [[nodiscard]] size_t tenant_bytes(const Tenant&) const;
+
+    void update_bytes(Tenant&);
+
+    [[nodiscard]] std::shared_ptr<Tenant> find(TenantId);
+
+    template <class Lock>
+    Lock acquire(TenantId, std::shared_ptr<Tenant>&);
+
+    void enforce_budget(const Tenant*);
+
+    void save_tenant(const Tenant&) const;
+
+    void load_tenant(Tenant&);
+
+    void unload_tenant(Tenant&);
+
+    void release_pages(Tenant&);
+
+    [[nodiscard]] PID nearest_cluster(const Tenant&, const float*) const;
+
+    void quantize_cluster(
+        Tenant&, size_t, const float*, const PID*, const std::vector<PID>&
+    );
+
+    void append(Tenant&, size_t, const float*, PID);
+
+    void move_vector(Tenant&, size_t, size_t, size_t);
+
+    void scan_cluster(
+        const Tenant&,
+        size_t,
+        const SplitBatchQuery<float>&,
+        buffer::SearchBuffer<float>&,
+        bool
+    ) const;
+
+   public:
+    explicit MultiTenantIVF(
+        const std::string&,
+        size_t,
+        size_t,
+        MetricType metric_type = METRIC_L2,
+        size_t memory_budget = std::numeric_limits<size_t>::max(),
+        RotatorType type = RotatorType::FhtKacRotator,
+        bool faster = false
+    );
+
+    MultiTenantIVF(const MultiTenantIVF&) = delete;
+    MultiTenantIVF& operator=(const MultiTenantIVF&) = delete;
+
+    [[nodiscard]] size_t dimension() const { return dim_; }
+    [[nodiscard]] size_t nbits() const { return ex_bits_ + 1; }
+    [[nodiscard]] MetricType metric_type() const { return metric_type_; }
+    [[nodiscard]] size_t memory_budget() const { return memory_budget_; }
+
+    // bytes of all resident tenants
+    [[nodiscard]] size_t memory_usage() const { return resident_bytes_.load(); }
+
+    // bytes of chunks mapped by the arena, including free pages
+    [[nodiscard]] size_t arena_bytes() const { return arena_.reserved_bytes(); }
+
+    [[nodiscard]] bool has_tenant(TenantId) const;
+
+    [[nodiscard]] bool is_resident(TenantId) const;
+
+    [[nodiscard]] std::vector<TenantId> tenants() const;
+
+    void create_tenant(
+        TenantId,
+        size_t,
+        const float*,
+        const PID*,
+        size_t,
+        const float*,
+        const PID*,
+        size_t num_threads = 1
+    );
+
+    void drop_tenant(TenantId);
+
+    void add(TenantId, size_t, const float*, const PID*);
+
+    bool remove(TenantId, PID);
+
+    void search(
+        TenantId,
+        const float*,
+        size_t,
+        size_t,
+        PID*,
+        float* dists = nullptr,
+        bool use_hacc = true
+    );
+
+    [[nodiscard]] size_t tenant_size(TenantId);
+
+    [[nodiscard]] size_t tenant_memory(TenantId);
+
+    void evict(TenantId);
+
+    void flush();
+};
+
+/**
+ * @brief Open the container in a directory. If the directory has a container, its rotator
+ * is loaded and its tenants are known (but not loaded), and the parameters must be the same
+ * as those of the container. Otherwise, a new rotator is created and saved.
+ *
+ * @param directory directory of tenant files, created if not exists
+ * @param dim dimension of data points
+ * @param total_bits bits of codes, 1 to 9
+ * @param metric_type metric type
+ * @param memory_budget max bytes of resident tenants, the tenant in use is never evicted
+ * @param type type of rotator
+ * @param faster use the faster quantization config (see quant::faster_config())
+ */
+inline MultiTenantIVF::MultiTenantIVF(
+    const std::string& directory,
+    size_t dim,
+    size_t total_bits,
+    MetricType metric_type,
+    size_t memory_budget,
+    RotatorType type,
+    bool faster
+)
+    : directory_(directory)
+    , dim_(dim)
+    , padded_dim_(index_padded_dim(dim, type))
+    , ex_bits_(total_bits - 1)
+    , metric_type_(metric_type)
+    , type_(type)
+    , memory_budget_(memory_budget)
+    , arena_(page_bytes(index_padded_dim(dim, type), total_bits - 1)) {
+    // codes of more than 8 ex bits need exact 1-bit IPs, which IVF computes separately
+    if (total_bits < 1 || total_bits > 9) {
+        throw std::invalid_argument("MultiTenantIVF: total_bits must be 1 to 9");
+    }
+    std::filesystem::create_directories(directory_);
+
+    rotator_.reset(choose_rotator<float>(dim_, type_, padded_dim_));
+    padded_dim_ = rotator_->size();
+    if (std::filesystem::exists(meta_file())) {
+        std::ifstream input(meta_file(), std::ios::binary);
+        size_t saved_dim = 0;
+        size_t saved_bits = 0;
+        MetricType saved_metric = METRIC_L2;
+        RotatorType saved_type = RotatorType::FhtKacRotator;
+        input.read(reinterpret_cast<char*>(&saved_dim), sizeof(size_t));
+        input.read(reinterpret_cast<char*>(&saved_bits), sizeof(size_t));
+        input.read(reinterpret_cast<char*>(&saved_metric), sizeof(MetricType));
+        input.read(reinterpret_cast<char*>(&saved_type), sizeof(RotatorType));
+        if (saved_dim != dim_ || saved_bits != total_bits || saved_metric != metric_type_ ||
+            saved_type != type_) {
+            throw std::invalid_argument(
+                "MultiTenantIVF: parameters differ from the container in " + directory_
+            );
+        }
+        rotator_->load(input);
+        if (input.fail()) {
+            throw std::runtime_error(meta_file() + ": unexpected end of data");
+        }
+    } else {
+        std::ofstream output(meta_file(), std::ios::binary);
+        output.write(reinterpret_cast<const char*>(&dim_), sizeof(size_t));
+        output.write(reinterpret_cast<const char*>(&total_bits), sizeof(size_t));
+        output.write(reinterpret_cast<const char*>(&metric_type_), sizeof(MetricType));
+        output.write(reinterpret_cast<const char*>(&type_), sizeof(RotatorType));
+        rotator_->save(output);
+    }
+
+    if (faster) {
+        config_ = quant::faster_config(padded_dim_, total_bits);
+    }
+    ip_func_ = select_excode_ipfunc(ex_bits_);
+
+    // tenants saved before, other files in the directory are ignored
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+        TenantId id = 0;
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && parse_tenant_file(name, id)) {
+            auto tenant = std::make_shared<Tenant>();
+            tenant->id = id;
+            tenants_[id] = tenant;
+        }
+    }
+}
+
+inline bool MultiTenantIVF::has_tenant(TenantId id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tenants_.count(id) > 0;
+}
+
+inline bool MultiTenantIVF::is_resident(TenantId id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tenants_.find(id);
+    return it != tenants_.end() && it->second->resident.load();
+}
+
+inline std::vector<TenantId> MultiTenantIVF::tenants() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<TenantId> ids;
+    ids.reserve(tenants_.size());
+    for (const auto& entry : tenants_) {
+        ids.push_back(entry.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+inline size_t MultiTenantIVF::tenant_bytes(const Tenant& tenant) const {
+    size_t num_pages = 0;
+    for (const auto& pages : tenant.pages) {
+        num_pages += pages.size();
+    }
+    return (num_pages * arena_.page_bytes()) + (sizeof(float) * tenant.centroids.size()) +
+           (kIdEntryBytes * tenant.id_map.size());
+}
+
+// call with the tenant locked exclusively
+inline void MultiTenantIVF::update_bytes(Tenant& tenant) {
+    size_t bytes = tenant.resident ? tenant_bytes(tenant) : 0;
+    resident_bytes_ += bytes;
+    resident_bytes_ -= tenant.bytes;
+    tenant.bytes = bytes;
+}
+
+inline std::shared_ptr<MultiTenantIVF::Tenant> MultiTenantIVF::find(TenantId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tenants_.find(id);
+    if (it == tenants_.end()) {
+        throw std::out_of_range("MultiTenantIVF: no tenant " + std::to_string(id));
+    }
+    it->second->last_used = ++clock_;
+    return it->second;
+}
+
+// lock a resident tenant, the tenant is loaded if it is not resident. The tenant is
+// pinned until it is locked, thus enforce_budget() of other calls does not evict it
+// between its load and its lock, even if it alone exceeds the budget.
+template <class Lock>
+inline Lock MultiTenantIVF::acquire(TenantId id, std::shared_ptr<Tenant>& tenant) {
+    tenant = find(id);
+    struct Pin {
+        Tenant& tenant;
+        explicit Pin(Tenant& pinned) : tenant(pinned) { ++tenant.pins; }
+        ~Pin() { --tenant.pins; }
+        Pin(const Pin&) = delete;
+        Pin& operator=(const Pin&) = delete;
+    } pin(*tenant);
+
+    while (true) {
+        Lock lock(tenant->mutex);
+        if (tenant->dropped) {
+            throw std::out_of_range("MultiTenantIVF: no tenant " + std::to_string(id));
+        }
+        if (tenant->resident) {
+            return lock;
+        }
+        lock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> load_lock(tenant->mutex);
+            if (!tenant->resident && !tenant->dropped) {
+                load_tenant(*tenant);
+            }
+        }
+        enforce_budget(tenant.get());
+        // only evict() unloads a pinned tenant, thus check again
+    }
+}
+
+// evict the least recently used tenants but keep until memory_usage() is in the budget.
+// Victims are picked under mutex_ and saved after it is released, thus lookups of other
+// tenants do not wait for the disk.
+inline void MultiTenantIVF::enforce_budget(const Tenant* keep) {
+    if (resident_bytes_ <= memory_budget_) {
+        return;
+    }
+    std::vector<std::shared_ptr<Tenant>> victims;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : tenants_) {
+            if (entry.second.get() != keep && entry.second->resident &&
+                entry.second->pins == 0) {
+                victims.push_back(entry.second);
+            }
+        }
+        std::sort(victims.begin(), victims.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs->last_used < rhs->last_used;
+        });
+    }
+    for (const auto& victim : victims) {
+        if (resident_bytes_ <= memory_budget_) {
+            break;
+        }
+        // tenants in use are skipped
+        std::unique_lock<std::shared_mutex> victim_lock(victim->mutex, std::try_to_lock);
+        if (victim_lock.owns_lock() && victim->resident && !victim->dropped &&
+            victim->pins == 0) {
+            unload_tenant(*victim);
+        }
+    }
+}
+
+inline void MultiTenantIVF::save_tenant(const Tenant& tenant) const {
+    std::string filename = tenant_file(tenant.id);
+    std::ofstream output(filename, std::ios::binary);
+    output.write(reinterpret_cast<const char*>(&padded_dim_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&ex_bits_), sizeof(size_t));
+    output.write(reinterpret_cast<const char*>(&tenant.num_clusters), sizeof(size_t));
+    output.write(
+        reinterpret_cast<const char*>(tenant.centroids.data()),
+        static_cast<long>(sizeof(float) * tenant.centroids.size())
+    );
+    output.write(
+        reinterpret_cast<const char*>(tenant.sizes.data()),
+        static_cast<long>(sizeof(size_t) * tenant.num_clusters)
+    );
+    for (const auto& pages : tenant.pages) {
+        for (const char* page : pages) {
+            output.write(page, static_cast<long>(arena_.page_bytes()));
+        }
+    }
+    if (!output) {
+        throw std::runtime_error("MultiTenantIVF: failed to write " + filename);
+    }
+}
+
+inline void MultiTenantIVF::load_tenant(Tenant& tenant) {
+    std::string filename = tenant_file(tenant.id);
+    std::ifstream input(filename, std::ios::binary);
+    if (!input.is_open()) {
+        throw std::runtime_error(filename + " does not exist");
+    }
+    size_t padded_dim = 0;
+    size_t ex_bits = 0;
+    input.read(reinterpret_cast<char*>(&padded_dim), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&ex_bits), sizeof(size_t));
+    input.read(reinterpret_cast<char*>(&tenant.num_clusters), sizeof(size_t));
+    if (padded_dim != padded_dim_ || ex_bits != ex_bits_) {
+        throw std::runtime_error(filename + " does not match the container");
+    }
+    tenant.centroids.resize(tenant.num_clusters * padded_dim_);
+    tenant.sizes.resize(tenant.num_clusters);
+    input.read(
+        reinterpret_cast<char*>(tenant.centroids.data()),
+        static_cast<long>(sizeof(float) * tenant.centroids.size())
+    );
+    input.read(
+        reinterpret_cast<char*>(tenant.sizes.data()),
+        static_cast<long>(sizeof(size_t) * tenant.num_clusters)
+    );
+
+    tenant.pages.assign(tenant.num_clusters, {});
+    tenant.id_map.clear();
+    for (size_t c = 0; c < tenant.num_clusters; ++c) {
+        size_t num_pages = div_round_up(tenant.sizes[c], fastscan::kBatchSize);
+        for (size_t p = 0; p < num_pages; ++p) {
+            char* page = arena_.allocate();
+            tenant.pages[c].push_back(page);
+            input.read(page, static_cast<long>(arena_.page_bytes()));
+            size_t begin = p * fastscan::kBatchSize;
+            size_t num = std::min(fastscan::kBatchSize, tenant.sizes[c] - begin);
+            const PID* ids = ids_of(page);
+            for (size_t i = 0; i < num; ++i) {
+                tenant.id_map[ids[i]] = {
+                    static_cast<uint32_t>(c), static_cast<uint32_t>(begin + i)
+                };
+            }
+        }
+    }
+    if (input.fail()) {
+        release_pages(tenant);
+        throw std::runtime_error(filename + ": unexpected end of data");
+    }
+
+    tenant.resident = true;
+    tenant.dirty = false;
+    update_bytes(tenant);
+}
+
+// call with the tenant locked exclusively
+inline void MultiTenantIVF::unload_tenant(Tenant& tenant) {
+    if (tenant.dirty) {
+        save_tenant(tenant);
+        tenant.dirty = false;
+    }
+    release_pages(tenant);
+    tenant.resident = false;
+    update_bytes(tenant);
+}
+
+inline void MultiTenantIVF::release_pages(Tenant& tenant) {
+    for (auto& pages : tenant.pages) {
+        for (char* page : pages) {
+            arena_.release(page);
+        }
+    }
+    tenant.pages.clear();
+    tenant.sizes.clear();
+    tenant.centroids.clear();
+    tenant.centroids.shrink_to_fit();
+    tenant.id_map = {};
+    tenant.num_clusters = 0;
+}
+
+inline PID MultiTenantIVF::nearest_cluster(
+    const Tenant& tenant, const float* rotated
+) const {
+    PID best = 0;
+    float best_dist = std::numeric_limits<float>::max();
+    for (size_t c = 0; c < tenant.num_clusters; ++c) {
+        const float* centroid = tenant.centroids.data() + (c * padded_dim_);
+        float dist = euclidean_sqr(rotated, centroid, padded_dim_);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = static_cast<PID>(c);
+        }
+    }
+    return best;
+}
+
+// quantize vectors of members into new pages of an empty cluster
+inline void MultiTenantIVF::quantize_cluster(
+    Tenant& tenant,
+    size_t cluster,
+    const float* data,
+    const PID* ids,
+    const std::vector<PID>& members
+) {
+    const float* centroid = tenant.centroids.data() + (cluster * padded_dim_);
+    std::vector<float> rotated(padded_dim_ * fastscan::kBatchSize);
+    for (size_t begin = 0; begin < members.size(); begin += fastscan::kBatchSize) {
+        size_t num = std::min(fastscan::kBatchSize, members.size() - begin);
+        char* page = arena_.allocate();
+        tenant.pages[cluster].push_back(page);
+        PID* page_ids = ids_of(page);
+        for (size_t i = 0; i < num; ++i) {
+            PID row = members[begin + i];
+            rotator_->rotate(data + (row * dim_), &rotated[i * padded_dim_]);
+            page_ids[i] = ids[row];
+        }
+        quant::quantize_split_batch(
+            rotated.data(),
+            centroid,
+            num,
+            padded_dim_,
+            ex_bits_,
+            page,
+            ex_data_of(page, 0),
+            metric_type_,
+            config_
+        );
+    }
+    tenant.sizes[cluster] = members.size();
+}
+
+// append a rotated vector to a cluster
+inline void MultiTenantIVF::append(
+    Tenant& tenant, size_t cluster, const float* rotated, PID id
+) {
+    std::vector<char> single(arena_.page_bytes());
+    quant::quantize_split_batch(
+        rotated,
+        tenant.centroids.data() + (cluster * padded_dim_),
+        1,
+        padded_dim_,
+        ex_bits_,
+        single.data(),
+        single.data() + batch_bytes(),
+        metric_type_,
+        config_
+    );
+
+    size_t offset = tenant.sizes[cluster];
+    size_t lane = offset % fastscan::kBatchSize;
+    if (lane == 0) {
+        tenant.pages[cluster].push_back(arena_.allocate());
+    }
+    char* page = tenant.pages[cluster].back();
+
+    // 1-bit codes of the page are repacked with the new one
+    size_t code_bytes = padded_dim_ / 8;
+    std::vector<uint8_t> codes((lane + 1) * code_bytes);
+    fastscan::unpack_codes(padded_dim_, codes_of(page), lane, codes.data());
+    fastscan::unpack_codes(
+        padded_dim_, codes_of(single.data()), 1, codes.data() + (lane * code_bytes)
+    );
+    fastscan::pack_codes(padded_dim_, codes.data(), lane + 1, codes_of(page));
+
+    BatchDataMap<float> batch(page, padded_dim_);
+    ConstBatchDataMap<float> new_batch(single.data(), padded_dim_);
+    batch.f_add()[lane] = new_batch.f_add()[0];
+    batch.f_rescale()[lane] = new_batch.f_rescale()[0];
+    batch.f_error()[lane] = new_batch.f_error()[0];
+    std::memcpy(ex_data_of(page, lane), single.data() + batch_bytes(), ex_bytes());
+    ids_of(page)[lane] = id;
+
+    tenant.sizes[cluster] = offset + 1;
+    tenant.id_map[id] = {static_cast<uint32_t>(cluster), static_cast<uint32_t>(offset)};
+}
+
+// move the vector at offset from to offset to of a cluster, both pages hold num vectors
+inline void MultiTenantIVF::move_vector(
+    Tenant& tenant, size_t cluster, size_t from, size_t to
+) {
+    char* src = tenant.pages[cluster][from / fastscan::kBatchSize];
+    char* dst = tenant.pages[cluster][to / fastscan::kBatchSize];
+    size_t src_lane = from % fastscan::kBatchSize;
+    size_t dst_lane = to % fastscan::kBatchSize;
+    size_t num = tenant.sizes[cluster];
+    size_t src_num = std::min(fastscan::kBatchSize, num - (from - src_lane));
+    size_t dst_num = std::min(fastscan::kBatchSize, num - (to - dst_lane));
+
+    size_t code_bytes = padded_dim_ / 8;
+    std::vector<uint8_t> src_codes(src_num * code_bytes);
+    std::vector<uint8_t> dst_codes(dst_num * code_bytes);
+    fastscan::unpack_codes(padded_dim_, codes_of(src), src_num, src_codes.data());
+    fastscan::unpack_codes(padded_dim_, codes_of(dst), dst_num, dst_codes.data());
+    std::memcpy(
+        dst_codes.data() + (dst_lane * code_bytes),
+        src_codes.data() + (src_lane * code_bytes),
+        code_bytes
+    );
+    fastscan::pack_codes(padded_dim_, dst_codes.data(), dst_num, codes_of(dst));
+
+    BatchDataMap<float> src_batch(src, padded_dim_);
+    BatchDataMap<float> dst_batch(dst, padded_dim_);
+    dst_batch.f_add()[dst_lane] = src_batch.f_add()[src_lane];
+    dst_batch.f_rescale()[dst_lane] = src_batch.f_rescale()[src_lane];
+    dst_batch.f_error()[dst_lane] = src_batch.f_error()[src_lane];
+    std::memcpy(ex_data_of(dst, dst_lane), ex_data_of(src, src_lane), ex_bytes());
+
+    PID id = ids_of(src)[src_lane];
+    ids_of(dst)[dst_lane] = id;
+    tenant.id_map[id] = {static_cast<uint32_t>(cluster), static_cast<uint32_t>(to)};
+}
+
+/**
+ * @brief Create a tenant and quantize its vectors, the tenant is resident and unsaved
+ * until it is evicted or flushed
+ *
+ * @param id id of the tenant
+ * @param num num of vectors
+ * @param data vectors (num * dim)
+ * @param ids PIDs of vectors (num), unique in the tenant
+ * @param num_clusters num of clusters, at least 1
+ * @param centroids centroids of clusters (num_clusters * dim)
+ * @param cluster_ids cluster of each vector (num)
+ * @param num_threads num of threads for quantization
+ */
+inline void MultiTenantIVF::create_tenant(
+    TenantId id,
+    size_t num,
+    const float* data,
+    const PID* ids,
+    size_t num_clusters,
+    const float* centroids,
+    const PID* cluster_ids,
+    size_t num_threads
+) {
+    if (num_clusters == 0) {
+        throw std::invalid_argument("MultiTenantIVF: a tenant needs at least 1 cluster");
+    }
+    auto tenant = std::make_shared<Tenant>();
+    tenant->id = id;
+    tenant->num_clusters = num_clusters;
+    tenant->pages.assign(num_clusters, {});
+    tenant->sizes.assign(num_clusters, 0);
+
+    // locations of vectors, arguments are checked before the tenant is visible
+    std::vector<std::vector<PID>> members(num_clusters);
+    for (size_t i = 0; i < num; ++i) {
+        if (cluster_ids[i] >= num_clusters) {
+            throw std::invalid_argument("MultiTenantIVF: bad cluster id");
+        }
+        tenant->id_map[ids[i]] = {
+            cluster_ids[i], static_cast<uint32_t>(members[cluster_ids[i]].size())
+        };
+        members[cluster_ids[i]].push_back(static_cast<PID>(i));
+    }
+    if (tenant->id_map.size() != num) {
+        throw std::invalid_argument("MultiTenantIVF: duplicated ids in a tenant");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tenants_.count(id) > 0) {
+            throw std::invalid_argument(
+                "MultiTenantIVF: tenant " + std::to_string(id) + " exists"
+            );
+        }
+    }
+
+    // the tenant is built before it is visible, thus a failed build leaves no tenant
+    tenant->centroids.resize(num_clusters * padded_dim_);
+    for (size_t c = 0; c < num_clusters; ++c) {
+        rotator_->rotate(centroids + (c * dim_), &tenant->centroids[c * padded_dim_]);
+    }
+
+    num_threads = std::max<size_t>(std::min(num_threads, rabitqlib::total_threads()), 1);
+    std::exception_ptr error = nullptr;
+    std::mutex error_mutex;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (size_t c = 0; c < num_clusters; ++c) {
+        try {
+            quantize_cluster(*tenant, c, data, ids, members[c]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            error = std::current_exception();
+        }
+    }
+    if (error) {
+        release_pages(*tenant);
+        std::rethrow_exception(error);
+    }
+
+    tenant->resident = true;
+    tenant->dirty = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // created by another thread during the build
+        if (tenants_.count(id) > 0) {
+            release_pages(*tenant);
+            throw std::invalid_argument(
+                "MultiTenantIVF: tenant " + std::to_string(id) + " exists"
+            );
+        }
+        tenant->last_used = ++clock_;
+        tenants_[id] = tenant;
+    }
+    {
+        std::unique_lock<std::shared_mutex> tenant_lock(tenant->mutex);
+        update_bytes(*tenant);
+    }
+    enforce_budget(tenant.get());
+}
+
+// remove a tenant and its file
+inline void MultiTenantIVF::drop_tenant(TenantId id) {
+    std::shared_ptr<Tenant> tenant = find(id);
+    std::unique_lock<std::shared_mutex> tenant_lock(tenant->mutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tenants_.erase(id);
+    }
+    tenant->dropped = true;
+    if (tenant->resident) {
+        release_pages(*tenant);
+        tenant->resident = false;
+        update_bytes(*tenant);
+    }
+    std::filesystem::remove(tenant_file(id));
+}
+
+/**
+ * @brief Add vectors to a tenant, each vector joins the cluster of the nearest centroid
+ *
+ * @param id id of the tenant
+ * @param num num of vectors
+ * @param data vectors (num * dim)
+ * @param ids PIDs of vectors (num), unique and not in the tenant yet
+ */
+inline void MultiTenantIVF::add(
+    TenantId id, size_t num, const float* data, const PID* ids
+) {
+    std::shared_ptr<Tenant> tenant;
+    {
+        auto lock = acquire<std::unique_lock<std::shared_mutex>>(id, tenant);
+        std::unordered_set<PID> batch_ids;
+        for (size_t i = 0; i < num; ++i) {
+            if (tenant->id_map.count(ids[i]) > 0) {
+                throw std::invalid_argument(
+                    "MultiTenantIVF: id " + std::to_string(ids[i]) + " exists in tenant"
+                );
+            }
+            if (!batch_ids.insert(ids[i]).second) {
+                throw std::invalid_argument(
+                    "MultiTenantIVF: id " + std::to_string(ids[i]) + " is duplicated in batch"
+                );
+            }
+        }
+        std::vector<float> rotated(padded_dim_);
+        for (size_t i = 0; i < num; ++i) {
+            rotator_->rotate(data + (i * dim_), rotated.data());
+            PID cluster = nearest_cluster(*tenant, rotated.data());
+            append(*tenant, cluster, rotated.data(), ids[i]);
+        }
+        tenant->dirty = true;
+        update_bytes(*tenant);
+    }
+    enforce_budget(tenant.get());
+}
+
+/**
+ * @brief Remove a vector from a tenant, the last vector of its cluster takes its place
+ *
+ * @return false if the tenant has no such vector
+ */
+inline bool MultiTenantIVF::remove(TenantId id, PID pid) {
+    std::shared_ptr<Tenant> tenant;
+    auto lock = acquire<std::unique_lock<std::shared_mutex>>(id, tenant);
+    auto it = tenant->id_map.find(pid);
+    if (it == tenant->id_map.end()) {
+        return false;
+    }
+    Location loc = it->second;
+    tenant->id_map.erase(it);
+
+    size_t last = tenant->sizes[loc.cluster] - 1;
+    if (loc.offset != last) {
+        move_vector(*tenant, loc.cluster, last, loc.offset);
+    }
+    auto& pages = tenant->pages[loc.cluster];
+    if (last % fastscan::kBatchSize == 0) {
+        arena_.release(pages.back());
+        pages.pop_back();
+    } else {
+        // repack the last page without the moved vector
+        char* page = pages.back();
+        size_t num = last % fastscan::kBatchSize;
+        std::vector<uint8_t> codes((num + 1) * (padded_dim_ / 8));
+        fastscan::unpack_codes(padded_dim_, codes_of(page), num, codes.data());
+        fastscan::pack_codes(padded_dim_, codes.data(), num, codes_of(page));
+    }
+    tenant->sizes[loc.cluster] = last;
+    tenant->dirty = true;
+    update_bytes(*tenant);
+    return true;
+}
+
+/**
+ * @brief Search the k nearest neighbors of a query in a tenant
+ *
+ * @param id id of the tenant
+ * @param query query vector (dim)
+ * @param k num of nearest neighbors
+ * @param nprobe num of clusters of the tenant to probe
+ * @param results PIDs of results (k), kPidMax if fewer than k vectors are found
+ * @param dists distances of results (k), may be nullptr
+ * @param use_hacc use high accuracy fastscan or not
+ */
+inline void MultiTenantIVF::search(
+    TenantId id,
+    const float* __restrict__ query,
+    size_t k,
+    size_t nprobe,
+    PID* __restrict__ results,
+    float* __restrict__ dists,
+    bool use_hacc
+) {
+    std::fill(results, results + k, kPidMax);
+    if (k == 0) {
+        return;
+    }
+    std::vector<float> rotated_query(padded_dim_);
+    rotator_->rotate(query, rotated_query.data());
+
+    std::shared_ptr<Tenant> tenant;
+    auto lock = acquire<std::shared_lock<std::shared_mutex>>(id, tenant);
+
+    nprobe = std::min(nprobe, tenant->num_clusters);
+    std::vector<AnnCandidate<float>> centroid_dist(tenant->num_clusters);
+    for (size_t c = 0; c < tenant->num_clusters; ++c) {
+        centroid_dist[c].id = static_cast<PID>(c);
+        centroid_dist[c].distance = std::sqrt(euclidean_sqr(
+            rotated_query.data(), tenant->centroids.data() + (c * padded_dim_), padded_dim_
+        ));
+    }
+    std::partial_sort(
+        centroid_dist.begin(),
+        centroid_dist.begin() + static_cast<long>(nprobe),
+        centroid_dist.end()
+    );
+
+    SplitBatchQuery<float> q_obj(
+        rotated_query.data(), padded_dim_, ex_bits_, metric_type_, use_hacc
+    );
+    buffer::SearchBuffer knns(k);
+    for (size_t i = 0; i < nprobe; ++i) {
+        size_t cluster = centroid_dist[i].id;
+        if (metric_type_ == METRIC_IP) {
+            q_obj.set_g_add(
+                centroid_dist[i].distance,
+                dot_product<float>(
+                    rotated_query.data(),
+                    tenant->centroids.data() + (cluster * padded_dim_),
+                    padded_dim_
+                )
+            );
+        } else {
+            q_obj.set_g_add(centroid_dist[i].distance);
+        }
+        scan_cluster(*tenant, cluster, q_obj, knns, use_hacc);
+    }
+
+    if (dists != nullptr) {
+        knns.copy_results(results, dists);
+    } else {
+        knns.copy_results(results);
+    }
+}
+
+// same as IVF::scan_one_batch() for all pages of a cluster
+inline void MultiTenantIVF::scan_cluster(
+    const Tenant& tenant,
+    size_t cluster,
+    const SplitBatchQuery<float>& q_obj,
+    buffer::SearchBuffer<float>& knns,
+    bool use_hacc
+) const {
+    std::array<float, fastscan::kBatchSize> est_distance;
+    std::array<float, fastscan::kBatchSize> low_distance;
+    std::array<float, fastscan::kBatchSize> ip_x0_qr;
+
+    const auto& pages = tenant.pages[cluster];
+    for (size_t p = 0; p < pages.size(); ++p) {
+        char* page = pages[p];
+        if (p + 1 < pages.size()) {
+            memory::mem_prefetch_l1(pages[p + 1], div_round_up(batch_bytes(), 64));
+        }
+        size_t num = std::min(
+            fastscan::kBatchSize, tenant.sizes[cluster] - (p * fastscan::kBatchSize)
+        );
+        split_batch_estdist(
+            page,
+            q_obj,
+            padded_dim_,
+            est_distance.data(),
+            low_distance.data(),
+            ip_x0_qr.data(),
+            use_hacc
+        );
+
+        const PID* ids = ids_of(page);
+        float distk = knns.top_dist();
+        for (size_t i = 0; i < num; ++i) {
+            if (ex_bits_ == 0) {
+                knns.insert(ids[i], est_distance[i]);
+            } else if (low_distance[i] < distk) {
+                knns.insert(
+                    ids[i],
+                    split_distance_boosting(
+                        ex_data_of(page, i),
+                        ip_func_,
+                        q_obj,
+                        padded_dim_,
+                        ex_bits_,
+                        ip_x0_qr[i]
+                    )
+                );
+            }
+            distk = knns.top_dist();
+        }
+    }
+}
+
+// num of vectors of a tenant, the tenant is loaded if not resident
+inline size_t MultiTenantIVF::tenant_size(TenantId id) {
+    std::shared_ptr<Tenant> tenant;
+    auto lock = acquire<std::shared_lock<std::shared_mutex>>(id, tenant);
+    return tenant->id_map.size();
+}
+
+// memory of a tenant if resident, 0 otherwise
+inline size_t MultiTenantIVF::tenant_memory(TenantId id) {
+    std::shared_ptr<Tenant> tenant = find(id);
+    std::shared_lock<std::shared_mutex> lock(tenant->mutex);
+    return tenant->bytes;
+}
+
+// save a tenant if changed and release its memory
+inline void MultiTenantIVF::evict(TenantId id) {
+    std::shared_ptr<Tenant> tenant = find(id);
+    std::unique_lock<std::shared_mutex> lock(tenant->mutex);
+    if (tenant->resident && !tenant->dropped) {
+        unload_tenant(*tenant);
+    }
+}
+
+// save all changed tenants, they stay resident
+inline void MultiTenantIVF::flush() {
+    std::vector<std::shared_ptr<Tenant>> all;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& entry : tenants_) {
+            all.push_back(entry.second);
+        }
+    }
+    for (auto& tenant : all) {
+        std::unique_lock<std::shared_mutex> lock(tenant->mutex);
+        if (tenant->resident && tenant->dirty && !tenant->dropped) {
+            save_tenant(*tenant);
+            tenant->dirty = false;
+        }
+    }
+}
+}  // namespace rabitqlib::tenant
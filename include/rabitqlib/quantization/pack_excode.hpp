@@ -1,10 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "rabitqlib/simd/pack_excode_dispatch.hpp"
 
@@ -87,4 +89,162 @@ inline void packing_rabitqplus_code(
         exit(1);
     }
 }
+
+/**
+ * @brief Packing codes of up to 15 ex_bits, one uint16 for each dim. Codes of no more than 8
+ * bits are packed as above. For 9 to 15 bits, the code is split into 2 planes stored one
+ * after another, the lower 8 bits as bytes (dim bytes), and the upper (ex_bits - 8) bits
+ * packed in the format of (ex_bits - 8)-bit codes, thus the IP with a query is computed by
+ * the kernels of 8 bits and (ex_bits - 8) bits. The total size is still dim * ex_bits / 8.
+ */
+inline void packing_rabitqplus_code(
+    const uint16_t* o_raw, uint8_t* o_compact, size_t dim, size_t ex_bits
+) {
+    std::vector<uint8_t> lower(dim);
+    for (size_t i = 0; i < dim; ++i) {
+        lower[i] = static_cast<uint8_t>(o_raw[i] & 0xff);
+    }
+    if (ex_bits <= 8) {
+        packing_rabitqplus_code(lower.data(), o_compact, dim, ex_bits);
+        return;
+    }
+    if (ex_bits > 15) {
+        std::cerr << "Bad value for ex_bits in packing_rabitqplus_code()\n";
+        exit(1);
+    }
+    std::vector<uint8_t> upper(dim);
+    for (size_t i = 0; i < dim; ++i) {
+        upper[i] = static_cast<uint8_t>(o_raw[i] >> 8);
+    }
+    packing_8bit_excode(lower.data(), o_compact, dim);
+    packing_rabitqplus_code(upper.data(), o_compact + dim, dim, ex_bits - 8);
+}
+
+namespace unpack_impl {
+// get the code of dim (8 * j + i) from the bit (8 * i + j) of a uint64, which is the
+// layout of top bits used by 3-bit, 5-bit and 7-bit codes
+inline void unpack_top_bits(const uint8_t* o_compact, uint8_t* o_raw, size_t bit) {
+    uint64_t top_bit;
+    std::memcpy(&top_bit, o_compact, sizeof(uint64_t));
+    for (size_t d = 0; d < 64; ++d) {
+        uint64_t cur_bit = (top_bit >> (((d % 8) * 8) + (d / 8))) & 1;
+        o_raw[d] |= static_cast<uint8_t>(cur_bit << bit);
+    }
+}
+
+// 16 bytes, the 2-bit codes of dim i, i + 16, i + 32, i + 48 are stored in byte i
+inline void unpack_2bit_block(const uint8_t* o_compact, uint8_t* o_raw) {
+    for (size_t i = 0; i < 16; ++i) {
+        for (size_t k = 0; k < 4; ++k) {
+            o_raw[i + (16 * k)] = (o_compact[i] >> (2 * k)) & 0b11;
+        }
+    }
+}
+
+// 48 bytes, the lower 6 bits of byte (16 * k + i) is the code of dim (16 * k + i), the
+// upper 2 bits are the bits (2 * k) and (2 * k + 1) of the code of dim (48 + i)
+inline void unpack_6bit_block(const uint8_t* o_compact, uint8_t* o_raw) {
+    for (size_t i = 0; i < 16; ++i) {
+        o_raw[48 + i] = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            uint8_t byte = o_compact[(16 * k) + i];
+            o_raw[(16 * k) + i] = byte & 0b111111;
+            o_raw[48 + i] |= static_cast<uint8_t>((byte >> 6) << (2 * k));
+        }
+    }
+}
+}  // namespace unpack_impl
+
+/**
+ * @brief Inverse of packing_rabitqplus_code(), get one uint8 code for each dim from the
+ * compact format.
+ *
+ * @param o_compact compact format of code
+ * @param o_raw unpacked code (dim)
+ * @param dim dimension of code, same requirement as packing_rabitqplus_code()
+ * @param ex_bits number of bits used for code
+ */
+inline void unpacking_rabitqplus_code(
+    const uint8_t* o_compact, uint8_t* o_raw, size_t dim, size_t ex_bits
+) {
+    using namespace unpack_impl;
+    if (ex_bits == 1) {
+        for (size_t j = 0; j < dim; j += 16) {
+            uint16_t code;
+            std::memcpy(&code, o_compact, sizeof(uint16_t));
+            for (size_t i = 0; i < 16; ++i) {
+                o_raw[j + i] = (code >> i) & 1;
+            }
+            o_compact += 2;
+        }
+    } else if (ex_bits == 2) {
+        for (size_t j = 0; j < dim; j += 64) {
+            unpack_2bit_block(o_compact, o_raw + j);
+            o_compact += 16;
+        }
+    } else if (ex_bits == 3) {
+        for (size_t j = 0; j < dim; j += 64) {
+            unpack_2bit_block(o_compact, o_raw + j);
+            unpack_top_bits(o_compact + 16, o_raw + j, 2);
+            o_compact += 24;
+        }
+    } else if (ex_bits == 4) {
+        for (size_t j = 0; j < dim; j += 16) {
+            for (size_t i = 0; i < 8; ++i) {
+                o_raw[j + i] = o_compact[i] & 0b1111;
+                o_raw[j + i + 8] = o_compact[i] >> 4;
+            }
+            o_compact += 8;
+        }
+    } else if (ex_bits == 5) {
+        for (size_t j = 0; j < dim; j += 64) {
+            for (size_t i = 0; i < 16; ++i) {
+                o_raw[j + i] = o_compact[i] & 0b1111;
+                o_raw[j + i + 16] = o_compact[i] >> 4;
+                o_raw[j + i + 32] = o_compact[i + 16] & 0b1111;
+                o_raw[j + i + 48] = o_compact[i + 16] >> 4;
+            }
+            unpack_top_bits(o_compact + 32, o_raw + j, 4);
+            o_compact += 40;
+        }
+    } else if (ex_bits == 6) {
+        for (size_t j = 0; j < dim; j += 64) {
+            unpack_6bit_block(o_compact, o_raw + j);
+            o_compact += 48;
+        }
+    } else if (ex_bits == 7) {
+        for (size_t j = 0; j < dim; j += 64) {
+            unpack_6bit_block(o_compact, o_raw + j);
+            unpack_top_bits(o_compact + 48, o_raw + j, 6);
+            o_compact += 56;
+        }
+    } else if (ex_bits == 8) {
+        std::memcpy(o_raw, o_compact, sizeof(uint8_t) * dim);
+    } else {
+        std::cerr << "Bad value for ex_bits in unpacking_rabitqplus_code()\n";
+        exit(1);
+    }
+}
+
+// inverse of packing_rabitqplus_code() of uint16 codes
+inline void unpacking_rabitqplus_code(
+    const uint8_t* o_compact, uint16_t* o_raw, size_t dim, size_t ex_bits
+) {
+    std::vector<uint8_t> lower(dim);
+    if (ex_bits <= 8) {
+        unpacking_rabitqplus_code(o_compact, lower.data(), dim, ex_bits);
+        std::copy(lower.begin(), lower.end(), o_raw);
+        return;
+    }
+    if (ex_bits > 15) {
+        std::cerr << "Bad value for ex_bits in unpacking_rabitqplus_code()\n";
+        exit(1);
+    }
+    std::vector<uint8_t> upper(dim);
+    unpacking_rabitqplus_code(o_compact, lower.data(), dim, 8);
+    unpacking_rabitqplus_code(o_compact + dim, upper.data(), dim, ex_bits - 8);
+    for (size_t i = 0; i < dim; ++i) {
+        o_raw[i] = static_cast<uint16_t>((upper[i] << 8) | lower[i]);
+    }
+}
 }  // namespace rabitqlib::quant::rabitq_impl::ex_bits
@@ -2,8 +2,10 @@
 
 #include <omp.h>
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <functional>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -15,6 +17,9 @@ namespace rabitqlib::quant {
 
 struct RabitqConfig {
     double t_const = -1;
+    // weight of the error parallel to the data vector relative to the orthogonal error for
+    // score-aware ex codes of METRIC_IP, see anisotropic_eta(). 1 for the plain RaBitQ codes
+    double eta = 1;
     explicit RabitqConfig() = default;
     RabitqConfig(RabitqConfig const&) = default;
     RabitqConfig(RabitqConfig&&) = default;
@@ -33,6 +38,19 @@ inline RabitqConfig faster_config(size_t dim, size_t total_bits) {
     return config;
 }
 
+/**
+ * @brief Weight of the parallel error for score-aware (anisotropic) quantization, as in
+ * ScaNN. Inner products with normalized data vectors above threshold are assumed to matter
+ * for the top-k, which gives eta = (dim - 1) * T^2 / (1 - T^2).
+ *
+ * @param dim Dimension of vectors
+ * @param threshold Inner product threshold T in (0, 1), relative to the norm of data vector
+ */
+inline double anisotropic_eta(size_t dim, double threshold) {
+    double sqr_threshold = threshold * threshold;
+    return static_cast<double>(dim - 1) * sqr_threshold / (1 - sqr_threshold);
+}
+
 template <typename T, bool Parallel = false>
 inline void quantize_one_batch(
     const T* data,
@@ -217,7 +235,8 @@ inline void quantize_compact_ex_bits(
         cur_ex_data.f_rescale_ex(),
         ex_error,
         metric_type,
-        config.t_const
+        config.t_const,
+        config.eta
     );
 }
 
@@ -369,6 +388,135 @@ inline void reconstruct_vec(
         (ConstRowMajorArrayMap<TP>(quantized_vec, 1, dim).template cast<T>() * delta) + vl;
 }
 
+/**
+ * @brief Reconstruction of rotated vectors (dim) by quantize_scalar() with total_bits bits
+ * and the rescaling factors minimizing the reconstruction errors, for training a
+ * LearnedRotator (see Rotator::train()). More than 8 bits are trained as 8 bits.
+ */
+template <typename T>
+inline std::function<void(const T*, T*)> scalar_reconstructor(size_t dim, size_t total_bits) {
+    total_bits = std::clamp<size_t>(total_bits, 1, 8);
+    return [dim, total_bits](const T* rotated, T* reconstructed) {
+        std::vector<uint8_t> code(dim, 0);
+        T delta = 0;
+        T vl = 0;
+        quantize_scalar(rotated, dim, total_bits, code.data(), delta, vl);
+        reconstruct_vec(code.data(), delta, vl, dim, reconstructed);
+    };
+}
+
+/**
+ * @brief Reconstruct a (rotated) data vector from its split codes and factors, i.e., the
+ * centroid plus the projection of the residual onto the direction of its code.
+ *
+ * The factors only keep ||r||^2 / <r, x_u + cb>, while the norm of residual r is recovered
+ * from the error factor of 1-bit code, which stores ||r|| * sqrt(1 / cos^2 - 1) up to a
+ * constant. The projection (rather than the unbiased estimator r * 1 / cos^2 used for
+ * distances) minimizes the reconstruction error.
+ *
+ * @param bin_code binary code (padded_dim), one uint8 for each dim
+ * @param ex_code ex-bits code (padded_dim), one uint8 (or uint16 if ex_bits > 8) for each
+ * dim, unused if ex_bits = 0
+ * @param centroid centroid used in quantization (padded_dim)
+ * @param padded_dim dimension of rotated vectors
+ * @param ex_bits number of bits of ex-bits code
+ * @param f_rescale, f_error factors of the 1-bit code
+ * @param f_rescale_ex rescaling factor of the ex-bits code
+ * @param results reconstructed vector (padded_dim)
+ * @param metric_type metric type used in quantization
+ */
+template <typename T, typename TE>
+inline void reconstruct_split(
+    const uint8_t* bin_code,
+    const TE* ex_code,
+    const T* centroid,
+    size_t padded_dim,
+    size_t ex_bits,
+    T f_rescale,
+    T f_error,
+    T f_rescale_ex,
+    T* results,
+    MetricType metric_type = METRIC_L2
+) {
+    T factor = metric_type == METRIC_L2 ? 2 : 1;
+    auto dim = static_cast<T>(padded_dim);
+
+    // residual norm from the factors of 1-bit code, where ||x_u + cb||^2 = dim / 4
+    T scale_1bit = -f_rescale / factor;
+    T error = f_error / (factor * rabitq_impl::kConstEpsilon);
+    T l2_sqr = (scale_1bit * scale_1bit * dim / 4) - ((dim - 1) * error * error);
+
+    // x_u + cb of the total code
+    std::vector<T> xu_cb(padded_dim);
+    T cb = -(static_cast<T>(1 << ex_bits) - 0.5F);
+    for (size_t i = 0; i < padded_dim; ++i) {
+        int code = bin_code[i] << ex_bits;
+        if (ex_bits > 0) {
+            code |= ex_code[i];
+        }
+        xu_cb[i] = static_cast<T>(code) + cb;
+    }
+
+    T scale = ex_bits > 0 ? (-f_rescale_ex / factor) : scale_1bit;
+    T xu_sqr = l2norm_sqr<T>(xu_cb.data(), padded_dim);
+
+    // corner case, the data vector equals the centroid
+    T ratio = 0;
+    if (scale > 0 && std::isfinite(l2_sqr) && l2_sqr > 0) {
+        ratio = l2_sqr / (scale * xu_sqr);
+    }
+
+    for (size_t i = 0; i < padded_dim; ++i) {
+        results[i] = centroid[i] + (xu_cb[i] * ratio);
+    }
+}
+
+/**
+ * @brief Recover the error factor of a split ex-bits code, i.e., f_error_ex of
+ * ex_bits_code_with_factor(), which is not kept in the ex data. The bound of the estimated
+ * distance with total bits is est -/+ f_error_ex * g_error.
+ *
+ * Parameters are the same as reconstruct_split().
+ */
+template <typename T, typename TE>
+inline T ex_error_factor(
+    const uint8_t* bin_code,
+    const TE* ex_code,
+    size_t padded_dim,
+    size_t ex_bits,
+    T f_rescale,
+    T f_error,
+    T f_rescale_ex,
+    MetricType metric_type = METRIC_L2
+) {
+    if (ex_bits == 0) {
+        return f_error;
+    }
+    T factor = metric_type == METRIC_L2 ? 2 : 1;
+    auto dim = static_cast<T>(padded_dim);
+
+    T scale_1bit = -f_rescale / factor;
+    T error = f_error / (factor * rabitq_impl::kConstEpsilon);
+    T l2_sqr = (scale_1bit * scale_1bit * dim / 4) - ((dim - 1) * error * error);
+    if (!std::isfinite(l2_sqr) || l2_sqr <= 0) {
+        return 0;
+    }
+
+    T cb = -(static_cast<T>(1 << ex_bits) - 0.5F);
+    T xu_sqr = 0;
+    for (size_t i = 0; i < padded_dim; ++i) {
+        T xu = static_cast<T>((bin_code[i] << ex_bits) | ex_code[i]) + cb;
+        xu_sqr += xu * xu;
+    }
+
+    // f_rescale_ex keeps ||r||^2 / <r, x_u + cb>, thus the 1 / cos^2 of the total code is
+    // scale^2 * ||x_u + cb||^2 / ||r||^2
+    T scale = -f_rescale_ex / factor;
+    T inv_cos_sqr = scale * scale * xu_sqr / l2_sqr;
+    return factor * rabitq_impl::kConstEpsilon * std::sqrt(l2_sqr) *
+           std::sqrt(std::max<T>(inv_cos_sqr - 1, 0) / (dim - 1));
+}
+
 template <typename TF, typename TI>
 inline TF full_est_dist(
     const TI* quantized_vec,
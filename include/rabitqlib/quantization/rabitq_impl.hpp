@@ -2,9 +2,12 @@
 
 #include <omp.h>
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -106,12 +109,17 @@ inline void one_bit_code_with_factor(
 
     // We use unnormalized vector to get error factor. To be more specific,
     // sqrt((1 - <o, o_bar>^2) / <o, o_bar>^2) / sqrt(dim - 1) = 3rd item in following
-    // expression
+    // expression. A zero residual (data on its centroid) has an exact distance and gets
+    // 0 instead of sqrt(-1), so are rounding errors below 0.
     T tmp_error =
         l2_norm * kConstEpsilon *
         std::sqrt(
-            (((l2_sqr * l2norm_sqr<T>(xu_cb.data(), dim)) / (ip_resi_xucb * ip_resi_xucb)) -
-             1) /
+            std::max<T>(
+                ((l2_sqr * l2norm_sqr<T>(xu_cb.data(), dim)) /
+                 (ip_resi_xucb * ip_resi_xucb)) -
+                    1,
+                0
+            ) /
             (dim - 1)
         );
 
@@ -271,8 +279,57 @@ constexpr std::array<float, 9> kTightStart = {
     0.81,
 };
 
+constexpr size_t kMaxEnumExBits = 8;  // max ex_bits to enumerate all rescale factors
+constexpr size_t kMaxExBits = 15;     // max ex_bits, codes are stored as uint16
+
+// <o_abs, code + 0.5> / ||code + 0.5||, where code is o_abs rescaled by t and rounded down
+template <typename T>
+inline double rescaled_ip(const T* o_abs, size_t dim, size_t ex_bits, double t) {
+    constexpr double kEps = 1e-5;
+    int max_code = (1 << ex_bits) - 1;
+    double numerator = 0;
+    double sqr_denominator = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        int cur = std::min(static_cast<int>((t * o_abs[i]) + kEps), max_code);
+        numerator += (cur + 0.5) * o_abs[i];
+        sqr_denominator += (cur + 0.5) * (cur + 0.5);
+    }
+    return numerator / std::sqrt(sqr_denominator);
+}
+
+// For ex_bits > kMaxEnumExBits, enumerating all factors (about dim * 2^ex_bits) is too
+// slow, while the ip is smooth in t since the rounding error is tiny. Thus we search a
+// coarse grid of t and then a fine grid around the best one.
+template <typename T>
+inline double grid_rescale_factor(const T* o_abs, size_t dim, size_t ex_bits) {
+    constexpr size_t kNumGrid = 64;
+    double max_o = *std::max_element(o_abs, o_abs + dim);
+    double t_end = static_cast<double>(1 << ex_bits) / max_o;
+    double t_start = t_end * kTightStart[kMaxEnumExBits];
+
+    double best_t = t_end;
+    double max_ip = 0;
+    for (size_t round = 0; round < 2; ++round) {
+        double step = (t_end - t_start) / kNumGrid;
+        for (size_t i = 0; i <= kNumGrid; ++i) {
+            double cur_t = t_start + (step * static_cast<double>(i));
+            double cur_ip = rescaled_ip(o_abs, dim, ex_bits, cur_t);
+            if (cur_ip > max_ip) {
+                max_ip = cur_ip;
+                best_t = cur_t;
+            }
+        }
+        t_start = best_t - step;
+        t_end = best_t + step;
+    }
+    return best_t;
+}
+
 template <typename T>
 inline double best_rescale_factor(const T* o_abs, size_t dim, size_t ex_bits) {
+    if (ex_bits > kMaxEnumExBits) {
+        return grid_rescale_factor(o_abs, dim, ex_bits);
+    }
     constexpr double kEps = 1e-5;
     constexpr int kNEnum = 10;
     double max_o = *std::max_element(o_abs, o_abs + dim);
@@ -431,6 +488,184 @@ inline T ex_bits_code(
     return ipnorm_inv;
 }
 
+// Score-aware loss of ex codes (see anisotropic_ex_bits_code()), given ip = <o_abs, y>,
+// sqr_norm = ||y||^2 and par_ip = <par, y> for y = code + 0.5
+inline double anisotropic_loss(
+    double ip, double sqr_norm, double par_ip, double par_u, double eta
+) {
+    double par_error = (par_ip / ip) - par_u;
+    return (sqr_norm / (ip * ip)) - 1 + ((eta - 1) * par_error * par_error);
+}
+
+// Rescale factor minimizing anisotropic_loss(), enumerated as best_rescale_factor(). For
+// ex_bits > kMaxEnumExBits, the rounding error is tiny and the factor of the plain loss
+// is used.
+template <typename T>
+inline double anisotropic_rescale_factor(
+    const T* o_abs, const double* par, double par_u, size_t dim, size_t ex_bits, double eta
+) {
+    if (ex_bits > kMaxEnumExBits) {
+        return grid_rescale_factor(o_abs, dim, ex_bits);
+    }
+    constexpr double kEps = 1e-5;
+    constexpr int kNEnum = 10;
+    double max_o = *std::max_element(o_abs, o_abs + dim);
+
+    double t_end = static_cast<double>(((1 << ex_bits) - 1) + kNEnum) / max_o;
+    double t_start = t_end * kTightStart[ex_bits];
+
+    std::vector<int> cur_o_bar(dim);
+    double sqr_norm = static_cast<double>(dim) * 0.25;
+    double ip = 0;
+    double par_ip = 0;
+
+    for (size_t i = 0; i < dim; ++i) {
+        int cur = static_cast<int>((t_start * o_abs[i]) + kEps);
+        cur_o_bar[i] = cur;
+        sqr_norm += (cur * cur) + cur;
+        ip += (cur + 0.5) * o_abs[i];
+        par_ip += (cur + 0.5) * par[i];
+    }
+
+    std::priority_queue<
+        std::pair<double, size_t>,
+        std::vector<std::pair<double, size_t>>,
+        std::greater<>>
+        next_t;
+
+    for (size_t i = 0; i < dim; ++i) {
+        next_t.emplace(static_cast<double>(cur_o_bar[i] + 1) / o_abs[i], i);
+    }
+
+    double min_loss = std::numeric_limits<double>::max();
+    double t = 0;
+
+    while (!next_t.empty()) {
+        double cur_t = next_t.top().first;
+        size_t update_id = next_t.top().second;
+        next_t.pop();
+
+        cur_o_bar[update_id]++;
+        int update_o_bar = cur_o_bar[update_id];
+        sqr_norm += 2 * update_o_bar;
+        ip += o_abs[update_id];
+        par_ip += par[update_id];
+
+        double cur_loss = anisotropic_loss(ip, sqr_norm, par_ip, par_u, eta);
+        if (cur_loss < min_loss) {
+            min_loss = cur_loss;
+            t = cur_t;
+        }
+
+        if (update_o_bar < (1 << ex_bits) - 1) {
+            double t_next = static_cast<double>(update_o_bar + 1) / o_abs[update_id];
+            if (t_next < t_end) {
+                next_t.emplace(t_next, update_id);
+            }
+        }
+    }
+
+    return t;
+}
+
+/**
+ * @brief Score-aware (anisotropic) ex code of a residual for METRIC_IP, as in ScaNN.
+ *
+ * The estimator of <q, r> reconstructs r as r' = x * ||r||^2 / <r, x> for the signed code
+ * x, thus the error e = r' - r is orthogonal to r, and its component parallel to the data
+ * vector o = c + r is <e, c> / ||o||. Only this component changes the order of large inner
+ * products, thus the code minimizes ||e||^2 + (eta - 1) * <e, o / ||o||>^2 (divided by
+ * ||r||^2), i.e., the parallel error is weighted by eta and the orthogonal one by 1. The
+ * rescale factor is searched (or t_const for faster quantization), then each coordinate is
+ * moved up or down by one if that reduces the loss. The factors are computed from the code
+ * as usual, thus the estimators are unchanged.
+ *
+ * @return ipnorm_inv, as ex_bits_code()
+ */
+template <typename T, typename TP>
+inline T anisotropic_ex_bits_code(
+    const T* residual,
+    const T* centroid,
+    size_t dim,
+    size_t ex_bits,
+    TP* ex_code,
+    double eta,
+    double t_const = -1
+) {
+    constexpr double kEps = 1e-5;
+    constexpr size_t kNumPasses = 2;  // passes of coordinate descent
+    ConstRowMajorArrayMap<T> res_arr(residual, 1, dim);
+    ConstRowMajorArrayMap<T> cent_arr(centroid, 1, dim);
+    double res_norm = std::sqrt(l2norm_sqr(residual, dim));
+    double data_norm = std::sqrt((res_arr + cent_arr).square().sum());
+    if (res_norm == 0 || data_norm == 0) {
+        return ex_bits_code<T, TP>(residual, dim, ex_bits, ex_code, t_const);
+    }
+
+    RowMajorArray<T> abs_res = res_arr.abs() / static_cast<T>(res_norm);
+
+    // the direction of the data vector in the space of abs residual
+    std::vector<double> par(dim);
+    double par_u = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        double sign = residual[i] >= 0 ? 1 : -1;
+        par[i] = sign * centroid[i] / data_norm;
+        par_u += par[i] * abs_res(0, static_cast<long>(i));
+    }
+
+    const T* o_abs = abs_res.data();
+    double t = t_const > 0
+                   ? t_const
+                   : anisotropic_rescale_factor(o_abs, par.data(), par_u, dim, ex_bits, eta);
+
+    int max_code = (1 << ex_bits) - 1;
+    std::vector<int> tmp_code(dim);
+    double ip = 0;
+    double sqr_norm = 0;
+    double par_ip = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        tmp_code[i] = std::min(static_cast<int>((t * o_abs[i]) + kEps), max_code);
+        ip += (tmp_code[i] + 0.5) * o_abs[i];
+        sqr_norm += (tmp_code[i] + 0.5) * (tmp_code[i] + 0.5);
+        par_ip += (tmp_code[i] + 0.5) * par[i];
+    }
+
+    double loss = anisotropic_loss(ip, sqr_norm, par_ip, par_u, eta);
+    for (size_t pass = 0; pass < kNumPasses; ++pass) {
+        for (size_t i = 0; i < dim; ++i) {
+            for (int step : {-1, 1}) {
+                int cur = tmp_code[i] + step;
+                if (cur < 0 || cur > max_code) {
+                    continue;
+                }
+                double cur_ip = ip + (step * o_abs[i]);
+                double cur_sqr_norm = sqr_norm + (2.0 * step * (tmp_code[i] + 0.5)) + 1;
+                double cur_par_ip = par_ip + (step * par[i]);
+                double cur_loss =
+                    anisotropic_loss(cur_ip, cur_sqr_norm, cur_par_ip, par_u, eta);
+                if (cur_ip > 0 && cur_loss < loss) {
+                    tmp_code[i] = cur;
+                    ip = cur_ip;
+                    sqr_norm = cur_sqr_norm;
+                    par_ip = cur_par_ip;
+                    loss = cur_loss;
+                }
+            }
+        }
+    }
+
+    // revert codes for negative dims
+    for (size_t i = 0; i < dim; ++i) {
+        ex_code[i] = static_cast<TP>(residual[i] < 0 ? max_code - tmp_code[i] : tmp_code[i]);
+    }
+
+    T ipnorm_inv = static_cast<T>(1 / ip);
+    if (!std::isnormal(ipnorm_inv)) {
+        ipnorm_inv = 1.F;
+    }
+    return ipnorm_inv;
+}
+
 template <typename T, typename TP>
 inline void ex_bits_code_with_factor(
     const T* data,
@@ -442,7 +677,8 @@ inline void ex_bits_code_with_factor(
     T& f_rescale_ex,
     T& f_error_ex,
     MetricType metric_type = METRIC_L2,
-    double t_const = -1
+    double t_const = -1,
+    double eta = 1
 ) {
     ConstRowMajorArrayMap<T> data_arr(data, 1, dim);
     ConstRowMajorArrayMap<T> cent_arr(centroid, 1, dim);
@@ -450,7 +686,12 @@ inline void ex_bits_code_with_factor(
     // residual vector
     RowMajorArray<T> residual_arr = data_arr - cent_arr;
 
-    T ipnorm_inv = ex_bits_code<T, TP>(residual_arr.data(), dim, ex_bits, ex_code, t_const);
+    T ipnorm_inv =
+        (metric_type == METRIC_IP && eta > 1)
+            ? anisotropic_ex_bits_code<T, TP>(
+                  residual_arr.data(), centroid, dim, ex_bits, ex_code, eta, t_const
+              )
+            : ex_bits_code<T, TP>(residual_arr.data(), dim, ex_bits, ex_code, t_const);
 
     // get factors
     RowMajorArray<int> total_code =
@@ -479,8 +720,12 @@ inline void ex_bits_code_with_factor(
     T tmp_error =
         l2_norm * kConstEpsilon *
         std::sqrt(
-            (((l2_sqr * l2norm_sqr<T>(xu_cb.data(), dim)) / (ip_resi_xucb * ip_resi_xucb)) -
-             1) /
+            std::max<T>(
+                ((l2_sqr * l2norm_sqr<T>(xu_cb.data(), dim)) /
+                 (ip_resi_xucb * ip_resi_xucb)) -
+                    1,
+                0
+            ) /
             (dim - 1)
         );
 
@@ -510,9 +755,10 @@ inline void ex_bits_compact_code(
     T& f_rescale_ex,
     T& f_error_ex,
     MetricType metric_type = METRIC_L2,
-    double t_const = -1
+    double t_const = -1,
+    double eta = 1
 ) {
-    std::vector<uint8_t> ex_code(padded_dim);
+    std::vector<uint16_t> ex_code(padded_dim);
 
     ex_bits_code_with_factor(
         data,
@@ -524,7 +770,8 @@ inline void ex_bits_compact_code(
         f_rescale_ex,
         f_error_ex,
         metric_type,
-        t_const
+        t_const,
+        eta
     );
 
     packing_rabitqplus_code(ex_code.data(), compact_code, padded_dim, ex_bits);
@@ -544,6 +791,11 @@ static inline void rabitq_scalar_impl(
     double t_const = -1,
     ScalarQuantizerType scalar_quantizer_type = ScalarQuantizerType::RECONSTRUCTION
 ) {
+    if (total_bits < 1 || total_bits > std::min(ex_bits::kMaxExBits + 1, sizeof(TP) * 8)) {
+        throw std::invalid_argument(
+            "Bad total_bits " + std::to_string(total_bits) + " for the type of code"
+        );
+    }
     std::vector<int> binary_code(dim);
     size_t ex_bits = total_bits - 1;
 
@@ -594,6 +846,11 @@ static inline void rabitq_full_impl(
     MetricType metric_type = METRIC_L2,
     double t_const = -1
 ) {
+    if (total_bits < 1 || total_bits > std::min(ex_bits::kMaxExBits + 1, sizeof(TP) * 8)) {
+        throw std::invalid_argument(
+            "Bad total_bits " + std::to_string(total_bits) + " for the type of code"
+        );
+    }
     std::vector<int> binary_code(dim);
     size_t ex_bits = total_bits - 1;
 
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/latency_histogram.hpp"
+
+namespace rabitqlib::server {
+/**
+ * @brief Search a batch of queries. Queries are stored row by row (num * dim), results
+ * of query i are stored in ids[i * k] and dists[i * k], unused slots must be set to
+ * std::numeric_limits<float>::max() in dists.
+ */
+using BatchSearchFunc = std::function<
+    void(const float* queries, size_t num, size_t k, PID* ids, float* dists)>;
+
+struct QueryResult {
+    std::vector<PID> ids;
+    std::vector<float> dists;
+};
+
+struct BatcherConfig {
+    size_t num_workers = 4;  // num of worker threads
+    size_t max_batch = 32;   // max num of queries in one batch
+    std::chrono::microseconds max_wait{200};  // max time the first query of a batch waits
+};
+
+/**
+ * @brief Collect concurrent queries into small batches and run them on a fixed pool of
+ * workers. A worker takes a batch once max_batch queries are pending or the oldest
+ * pending query has waited for max_wait, so that the batch function amortizes per-call
+ * costs across queries under load, while an isolated query is delayed by max_wait at most.
+ */
+class MicroBatcher {
+   private:
+    using clock = std::chrono::steady_clock;
+
+    struct Request {
+        std::vector<float> query;
+        size_t k;
+        clock::time_point arrival;
+        std::promise<QueryResult> result;
+    };
+
+    size_t dim_;
+    BatchSearchFunc search_func_;
+    BatcherConfig config_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::deque<Request> queue_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+
+    LatencyHistogram queue_latency_;    // time from arrival to the start of its batch
+    LatencyHistogram search_latency_;   // time to search a batch
+    LatencyHistogram batch_sizes_;      // num of queries in each batch
+
+    static uint64_t micros(clock::duration duration) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count()
+        );
+    }
+
+    // wait for a batch, return false if the batcher stops and no query is pending
+    bool next_batch(std::vector<Request>& batch) {
+        std::unique_lock<std::mutex> guard(lock_);
+        while (true) {
+            cond_.wait(guard, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return false;
+            }
+            auto deadline = queue_.front().arrival + config_.max_wait;
+            cond_.wait_until(guard, deadline, [this] {
+                return stop_ || queue_.size() >= config_.max_batch;
+            });
+            // another worker may have taken the pending queries
+            if (!queue_.empty()) {
+                break;
+            }
+        }
+
+        size_t num = std::min(queue_.size(), config_.max_batch);
+        for (size_t i = 0; i < num; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        if (!queue_.empty()) {
+            cond_.notify_one();
+        }
+        return true;
+    }
+
+    void run_batch(std::vector<Request>& batch) {
+        auto start = clock::now();
+        size_t num = batch.size();
+        size_t k = 0;
+        for (const auto& request : batch) {
+            k = std::max(k, request.k);
+            queue_latency_.record(micros(start - request.arrival));
+        }
+        batch_sizes_.record(num);
+
+        std::vector<float> queries(num * dim_);
+        for (size_t i = 0; i < num; ++i) {
+            std::copy(batch[i].query.begin(), batch[i].query.end(), &queries[i * dim_]);
+        }
+        std::vector<PID> ids(num * k, 0);
+        std::vector<float> dists(num * k, std::numeric_limits<float>::max());
+
+        try {
+            search_func_(queries.data(), num, k, ids.data(), dists.data());
+        } catch (...) {
+            for (auto& request : batch) {
+                request.result.set_exception(std::current_exception());
+            }
+            return;
+        }
+        search_latency_.record(micros(clock::now() - start));
+
+        for (size_t i = 0; i < num; ++i) {
+            QueryResult result;
+            for (size_t j = 0; j < batch[i].k; ++j) {
+                float dist = dists[(i * k) + j];
+                if (dist == std::numeric_limits<float>::max()) {
+                    break;
+                }
+                result.ids.push_back(ids[(i * k) + j]);
+                result.dists.push_back(dist);
+            }
+            batch[i].result.set_value(std::move(result));
+        }
+    }
+
+    void worker_loop() {
+        std::vector<Request> batch;
+        while (next_batch(batch)) {
+            run_batch(batch);
+            batch.clear();
+        }
+    }
+
+   public:
+    /**
+     * @param dim dimension of queries
+     * @param search_func function to search a batch of queries, called by multiple workers
+     * concurrently, thus it must be thread-safe
+     * @param config num of workers, max batch size and max wait time
+     */
+    explicit MicroBatcher(size_t dim, BatchSearchFunc search_func, BatcherConfig config = {})
+        : dim_(dim), search_func_(std::move(search_func)), config_(config) {
+        if (config_.num_workers == 0 || config_.max_batch == 0) {
+            throw std::invalid_argument("MicroBatcher needs at least one worker and query");
+        }
+        workers_.reserve(config_.num_workers);
+        for (size_t i = 0; i < config_.num_workers; ++i) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    MicroBatcher(const MicroBatcher&) = delete;
+    MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+    ~MicroBatcher() { stop(); }
+
+    // finish pending queries and join workers
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    /**
+     * @brief Submit a query, the future is ready once the batch of the query is searched
+     *
+     * @param query query vector (dim)
+     * @param k num of nearest neighbors
+     */
+    std::future<QueryResult> submit(const float* query, size_t k) {
+        Request request{std::vector<float>(query, query + dim_), k, clock::now(), {}};
+        auto future = request.result.get_future();
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (stop_) {
+                throw std::runtime_error("MicroBatcher is stopped");
+            }
+            queue_.push_back(std::move(request));
+        }
+        cond_.notify_one();
+        return future;
+    }
+
+    [[nodiscard]] size_t dimension() const { return dim_; }
+
+    [[nodiscard]] const BatcherConfig& config() const { return config_; }
+
+    [[nodiscard]] const LatencyHistogram& queue_latency() const { return queue_latency_; }
+
+    [[nodiscard]] const LatencyHistogram& search_latency() const { return search_latency_; }
+
+    [[nodiscard]] const LatencyHistogram& batch_sizes() const { return batch_sizes_; }
+};
+}  // namespace rabitqlib::server
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace rabitqlib::server {
+/*
+ * Binary frames exchanged over a Unix domain socket. Both ends live on the same host, thus
+ * all fields are in host byte order.
+ *
+ * request:  RequestHeader, float query[dim]
+ * response: ResponseHeader, PID ids[num], float dists[num]
+ *
+ * A connection carries one request at a time, concurrent clients use one connection each.
+ */
+constexpr uint32_t kFrameMagic = 0x31514252;  // "RBQ1"
+
+enum ResponseStatus : uint32_t {
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1,  // wrong magic, dimension or k
+    STATUS_ERROR = 2,        // search failed
+};
+
+struct RequestHeader {
+    uint32_t magic = kFrameMagic;
+    uint32_t dim = 0;  // num of floats in the query
+    uint32_t k = 0;    // num of nearest neighbors
+    uint32_t reserved = 0;
+};
+
+struct ResponseHeader {
+    uint32_t magic = kFrameMagic;
+    uint32_t status = STATUS_OK;
+    uint32_t num = 0;  // num of results, at most k
+    uint32_t reserved = 0;
+};
+
+static_assert(sizeof(RequestHeader) == 16 && sizeof(ResponseHeader) == 16);
+
+inline std::runtime_error socket_error(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// read exactly len bytes, return false if the peer closed the connection
+inline bool read_full(int fd, void* buf, size_t len) {
+    auto* ptr = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t ret = ::read(fd, ptr, len);
+        if (ret == 0) {
+            return false;
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += ret;
+        len -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+// write exactly len bytes, return false if the connection is broken
+inline bool write_full(int fd, const void* buf, size_t len) {
+    const auto* ptr = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t ret = ::send(fd, ptr, len, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += ret;
+        len -= static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+inline sockaddr_un make_address(const std::string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("socket path is too long: " + path);
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+}  // namespace rabitqlib::server
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/server/protocol.hpp"
+#include "rabitqlib/utils/latency_histogram.hpp"
+
+namespace rabitqlib::server {
+/**
+ * @brief Client of QueryServer. One client holds one connection and sends one query at a
+ * time, use one client for each thread to issue concurrent queries. Round-trip latencies
+ * are recorded in latency().
+ */
+class QueryClient {
+   private:
+    int fd_ = -1;
+    LatencyHistogram latency_;
+
+   public:
+    // connect to the server listening on path, throw std::runtime_error on failure
+    explicit QueryClient(const std::string& path) {
+        sockaddr_un addr = make_address(path);
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd_ < 0) {
+            throw socket_error("socket");
+        }
+        if (::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            auto error = socket_error("connect " + path);
+            ::close(fd_);
+            throw error;
+        }
+    }
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    /**
+     * @brief Search the k nearest neighbors of a query
+     *
+     * @param query query vector (dim)
+     * @param dim dimension of query, must equal the dimension of the server
+     * @param k num of nearest neighbors
+     * @param ids ids of results (k)
+     * @param dists distances of results (k), may be nullptr
+     * @return num of results, smaller than k if the index has fewer vectors
+     */
+    size_t search(const float* query, size_t dim, size_t k, PID* ids, float* dists = nullptr) {
+        auto start = std::chrono::steady_clock::now();
+
+        RequestHeader request;
+        request.dim = static_cast<uint32_t>(dim);
+        request.k = static_cast<uint32_t>(k);
+        ResponseHeader response;
+        // the server may reject a bad header and close before the payload is sent, read
+        // the response anyway to report the rejection
+        if (write_full(fd_, &request, sizeof(request))) {
+            write_full(fd_, query, dim * sizeof(float));
+        }
+        if (!read_full(fd_, &response, sizeof(response))) {
+            throw std::runtime_error("QueryClient: connection closed by server");
+        }
+        if (response.magic != kFrameMagic) {
+            throw std::runtime_error("QueryClient: bad response frame");
+        }
+        if (response.status == STATUS_BAD_REQUEST) {
+            throw std::invalid_argument("QueryClient: request rejected by server");
+        }
+        if (response.status != STATUS_OK) {
+            throw std::runtime_error("QueryClient: search failed on server");
+        }
+        if (response.num > k) {
+            throw std::runtime_error("QueryClient: too many results");
+        }
+
+        std::vector<float> discard(dists == nullptr ? response.num : 0);
+        if (!read_full(fd_, ids, response.num * sizeof(PID)) ||
+            !read_full(
+                fd_, dists == nullptr ? discard.data() : dists, response.num * sizeof(float)
+            )) {
+            throw std::runtime_error("QueryClient: connection closed by server");
+        }
+
+        latency_.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start
+            )
+                .count()
+        ));
+        return response.num;
+    }
+
+    [[nodiscard]] const LatencyHistogram& latency() const { return latency_; }
+};
+}  // namespace rabitqlib::server
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/server/micro_batcher.hpp"
+#include "rabitqlib/server/protocol.hpp"
+#include "rabitqlib/utils/latency_histogram.hpp"
+
+namespace rabitqlib::server {
+struct ServerConfig {
+    BatcherConfig batcher;
+    size_t max_k = 1024;  // requests with a larger k are rejected
+    int backlog = 128;    // backlog of the listening socket
+};
+
+/**
+ * @brief Serve top-k queries over a Unix domain socket. Each connection is read by its own
+ * thread, queries of all connections are merged into batches by a MicroBatcher and
+ * searched by its workers. The server is agnostic of the index, it only needs a
+ * BatchSearchFunc, see sample/cpp/rabitq_server.cpp for IVF, HNSW and QG.
+ */
+class QueryServer {
+   private:
+    std::string path_;
+    size_t dim_;
+    ServerConfig config_;
+    MicroBatcher batcher_;
+
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread accept_thread_;
+
+    struct Connection {
+        int fd;
+        bool done = false;
+        std::thread thread;
+    };
+
+    std::mutex conn_lock_;
+    std::list<Connection> connections_;
+
+    LatencyHistogram latency_;  // time from the arrival of a request to its response
+
+    // join the threads of closed connections, called with conn_lock_ held
+    void reap_connections() {
+        for (auto iter = connections_.begin(); iter != connections_.end();) {
+            if (iter->done) {
+                iter->thread.join();
+                iter = connections_.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    void accept_loop() {
+        while (running_.load()) {
+            int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;  // listening socket is shut down
+            }
+            std::lock_guard<std::mutex> guard(conn_lock_);
+            if (!running_.load()) {
+                ::close(fd);
+                break;
+            }
+            reap_connections();
+            auto& conn = connections_.emplace_back();
+            conn.fd = fd;
+            conn.thread = std::thread([this, &conn] { serve_connection(conn); });
+        }
+    }
+
+    void serve_connection(Connection& conn) {
+        int fd = conn.fd;
+        RequestHeader request;
+        std::vector<float> query(dim_);
+        while (read_full(fd, &request, sizeof(request))) {
+            auto start = std::chrono::steady_clock::now();
+            ResponseHeader response;
+            QueryResult result;
+
+            if (request.magic != kFrameMagic || request.dim != dim_) {
+                // the size of payload can not be trusted, reply and close the connection
+                response.status = STATUS_BAD_REQUEST;
+                write_full(fd, &response, sizeof(response));
+                break;
+            }
+            if (!read_full(fd, query.data(), dim_ * sizeof(float))) {
+                break;
+            }
+
+            if (request.k == 0 || request.k > config_.max_k) {
+                response.status = STATUS_BAD_REQUEST;
+            } else {
+                try {
+                    result = batcher_.submit(query.data(), request.k).get();
+                } catch (const std::exception&) {
+                    response.status = STATUS_ERROR;
+                }
+            }
+            response.num = static_cast<uint32_t>(result.ids.size());
+
+            // recorded before the response is sent, so that it is visible to the client
+            latency_.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start
+                )
+                    .count()
+            ));
+            if (!write_full(fd, &response, sizeof(response)) ||
+                !write_full(fd, result.ids.data(), result.ids.size() * sizeof(PID)) ||
+                !write_full(fd, result.dists.data(), result.dists.size() * sizeof(float))) {
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(conn_lock_);
+        ::close(fd);
+        conn.done = true;
+    }
+
+   public:
+    /**
+     * @param path path of the socket file, an existing file is replaced
+     * @param dim dimension of queries
+     * @param search_func thread-safe function to search a batch of queries
+     * @param config batching and limits
+     */
+    explicit QueryServer(
+        std::string path, size_t dim, BatchSearchFunc search_func, ServerConfig config = {}
+    )
+        : path_(std::move(path))
+        , dim_(dim)
+        , config_(config)
+        , batcher_(dim, std::move(search_func), config.batcher) {}
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer() { stop(); }
+
+    // bind the socket and start accepting connections in the background
+    void start() {
+        if (running_.load()) {
+            return;
+        }
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd_ < 0) {
+            throw socket_error("socket");
+        }
+        sockaddr_un addr = make_address(path_);
+        ::unlink(path_.c_str());
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(listen_fd_, config_.backlog) < 0) {
+            auto error = socket_error("bind " + path_);
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+            throw error;
+        }
+        running_.store(true);
+        accept_thread_ = std::thread([this] { accept_loop(); });
+    }
+
+    // stop accepting, close all connections, finish pending queries and remove the socket
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        accept_thread_.join();
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        ::unlink(path_.c_str());
+
+        std::list<Connection> connections;
+        {
+            std::lock_guard<std::mutex> guard(conn_lock_);
+            for (auto& conn : connections_) {
+                if (!conn.done) {
+                    ::shutdown(conn.fd, SHUT_RDWR);
+                }
+            }
+            connections.swap(connections_);
+        }
+        for (auto& conn : connections) {
+            conn.thread.join();
+        }
+        batcher_.stop();
+    }
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+
+    [[nodiscard]] const MicroBatcher& batcher() const { return batcher_; }
+
+    [[nodiscard]] const LatencyHistogram& latency() const { return latency_; }
+};
+}  // namespace rabitqlib::server
@@ -11,6 +11,12 @@ void accumulate_avx2(
     uint16_t* __restrict__ result,
     size_t dim
 );
+void pack_codes_avx2(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+);
+void unpack_codes_avx2(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+);
 void transfer_lut_hacc_avx2(const uint16_t* lut, size_t dim, uint8_t* hc_lut);
 void accumulate_hacc_avx2(
     const uint8_t* __restrict__ codes,
@@ -25,6 +31,12 @@ void accumulate_avx512(
     uint16_t* __restrict__ result,
     size_t dim
 );
+void pack_codes_avx512(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+);
+void unpack_codes_avx512(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+);
 void transfer_lut_hacc_avx512(const uint16_t* lut, size_t dim, uint8_t* hc_lut);
 void accumulate_hacc_avx512(
     const uint8_t* __restrict__ codes,
@@ -684,6 +684,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     void saveIndex(const std::string &location) {
         std::ofstream output(location, std::ios::binary);
+        saveIndex(output);
+        output.close();
+    }
+
+
+    void saveIndex(std::ostream &output) {
         std::streampos position;
 
         writeBinaryPOD(output, offsetLevel0_);
@@ -709,7 +715,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             if (linkListSize)
                 output.write(linkLists_[i], linkListSize);
         }
-        output.close();
     }
 
 
@@ -719,6 +724,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (!input.is_open())
             throw std::runtime_error("Cannot open file");
 
+        loadIndex(input, s, max_elements_i);
+        input.close();
+    }
+
+
+    // the stream must be seekable and hold only the index
+    void loadIndex(std::istream &input, SpaceInterface<dist_t> *s, size_t max_elements_i = 0) {
         clear();
         // get file size:
         input.seekg(0, input.end);
@@ -816,8 +828,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
         }
 
-        input.close();
-
         return;
     }
 
@@ -111,12 +111,12 @@ class Array {
     [[nodiscard]] reference at(size_t idx) { return pointer_[idx]; }
     [[nodiscard]] const_reference at(size_t idx) const { return pointer_[idx]; }
 
-    void save(std::ofstream& output) const {
+    void save(std::ostream& output) const {
         if (output.good()) {
             output.write(reinterpret_cast<char*>(pointer_), bytes());
         }
     }
-    void load(std::ifstream& input) {
+    void load(std::istream& input) {
         input.read(reinterpret_cast<char*>(pointer_), bytes());
     }
 
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <limits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -100,6 +104,9 @@ class SearchBuffer {
         return is_full() ? data_[size_ - 1].distance : std::numeric_limits<T>::max();
     }
 
+    // same as top_dist(), the bound does not depend on the candidate (see GroupedBuffer)
+    T top_dist(PID /*data_id*/) const { return top_dist(); }
+
     [[nodiscard]] auto is_full() const -> bool { return size_ == capacity_; }
 
     // judge if dist can be inserted into buffer
@@ -109,4 +116,232 @@ class SearchBuffer {
         return data_;
     }
 };
-}  // namespace rabitqlib::buffer
\ No newline at end of file
+
+/**
+ * @brief Hits of one group returned by grouped search
+ */
+template <typename T = float>
+struct GroupHits {
+    PID key = 0;                         // group key
+    std::vector<AnnCandidate<T>> hits;  // sorted by distance
+};
+
+/**
+ * @brief Result buffer for grouped (diversified) top-k search. It keeps at most
+ * group_size hits for each of the best num_groups groups, groups are ranked by their best
+ * hits. A candidate is useless once its distance is not smaller than top_dist(id): the
+ * worst hit of its group if the group is kept and full, the worst best hit of the kept
+ * groups if its group is not kept and num_groups groups are kept, otherwise the max
+ * value. top_dist() is the max of top_dist(id) over all ids, which is only finite once
+ * all kept groups are full, thus searches check top_dist(id) of each candidate to prune
+ * also with sparse groups. Both are maintained by heaps over the kept groups in
+ * O(log num_groups) per insertion. Since candidates are pruned on arrival, a group which
+ * replaces another one late may miss hits which were pruned before it was kept.
+ */
+template <typename T = float>
+class GroupedBuffer {
+   private:
+    struct Group {
+        PID key;
+        T best;
+        std::vector<AnnCandidate<T>> hits;  // max-heap on distance
+    };
+
+    // max-heap of the slots of groups_ by a key of each slot, the key of a slot is
+    // updated in O(log n)
+    class SlotHeap {
+       private:
+        std::vector<size_t> heap_;  // slots
+        std::vector<size_t> pos_;   // position of each slot in heap_
+        std::vector<T> keys_;       // key of each slot
+
+        void swap_at(size_t lhs, size_t rhs) {
+            std::swap(heap_[lhs], heap_[rhs]);
+            pos_[heap_[lhs]] = lhs;
+            pos_[heap_[rhs]] = rhs;
+        }
+
+        void sift_up(size_t idx) {
+            while (idx > 0) {
+                size_t parent = (idx - 1) / 2;
+                if (keys_[heap_[parent]] >= keys_[heap_[idx]]) {
+                    return;
+                }
+                swap_at(idx, parent);
+                idx = parent;
+            }
+        }
+
+        void sift_down(size_t idx) {
+            while (true) {
+                size_t largest = idx;
+                for (size_t child = (2 * idx) + 1;
+                     child <= (2 * idx) + 2 && child < heap_.size();
+                     ++child) {
+                    if (keys_[heap_[child]] > keys_[heap_[largest]]) {
+                        largest = child;
+                    }
+                }
+                if (largest == idx) {
+                    return;
+                }
+                swap_at(idx, largest);
+                idx = largest;
+            }
+        }
+
+       public:
+        void reserve(size_t num) {
+            heap_.reserve(num);
+            pos_.reserve(num);
+            keys_.reserve(num);
+        }
+
+        // add the next slot, i.e., slots are 0, 1, 2, ...
+        void push(T key) {
+            size_t slot = keys_.size();
+            keys_.push_back(key);
+            pos_.push_back(heap_.size());
+            heap_.push_back(slot);
+            sift_up(heap_.size() - 1);
+        }
+
+        void update(size_t slot, T key) {
+            T old_key = keys_[slot];
+            keys_[slot] = key;
+            if (key > old_key) {
+                sift_up(pos_[slot]);
+            } else {
+                sift_down(pos_[slot]);
+            }
+        }
+
+        [[nodiscard]] size_t top() const { return heap_.front(); }
+
+        [[nodiscard]] T top_key() const { return keys_[heap_.front()]; }
+    };
+
+    const PID* group_keys_;  // group key of each data id
+    size_t num_groups_;
+    size_t group_size_;
+    std::vector<Group> groups_;                // kept groups, unordered
+    std::unordered_map<PID, size_t> position_;  // group key -> position in groups_
+    SlotHeap best_heap_;                        // groups by their best hits
+    SlotHeap bound_heap_;                       // groups by their worst hits if full
+
+    // a hit of a kept group must be closer than its bound
+    [[nodiscard]] T group_bound(const Group& group) const {
+        return group.hits.size() == group_size_ ? group.hits.front().distance
+                                                : std::numeric_limits<T>::max();
+    }
+
+   public:
+    /**
+     * @param num_groups max number of groups in results
+     * @param group_size max number of hits for each group
+     * @param group_keys group key of each data id, must outlive the buffer
+     */
+    explicit GroupedBuffer(size_t num_groups, size_t group_size, const PID* group_keys)
+        : group_keys_(group_keys), num_groups_(num_groups), group_size_(group_size) {
+        groups_.reserve(num_groups);
+        best_heap_.reserve(num_groups);
+        bound_heap_.reserve(num_groups);
+    }
+
+    // insert a data point into buffer
+    void insert(PID data_id, T dist) {
+        if (num_groups_ == 0 || group_size_ == 0) {
+            return;
+        }
+
+        PID key = group_keys_[data_id];
+        auto iter = position_.find(key);
+        size_t slot = 0;
+        if (iter != position_.end()) {
+            slot = iter->second;
+            if (dist >= group_bound(groups_[slot])) {
+                return;
+            }
+        } else if (groups_.size() < num_groups_) {
+            slot = groups_.size();
+            position_.emplace(key, slot);
+            groups_.push_back({key, dist, {}});
+            groups_.back().hits.reserve(group_size_);
+            best_heap_.push(dist);
+            bound_heap_.push(std::numeric_limits<T>::max());
+        } else {
+            // replace the group with the worst best hit
+            slot = best_heap_.top();
+            Group& worst = groups_[slot];
+            if (dist >= worst.best) {
+                return;
+            }
+            position_.erase(worst.key);
+            position_.emplace(key, slot);
+            worst.key = key;
+            worst.best = dist;
+            worst.hits.clear();
+        }
+
+        Group& group = groups_[slot];
+        if (group.hits.size() == group_size_) {
+            std::pop_heap(group.hits.begin(), group.hits.end());
+            group.hits.pop_back();
+        }
+        group.hits.emplace_back(data_id, dist);
+        std::push_heap(group.hits.begin(), group.hits.end());
+        group.best = std::min(group.best, dist);
+        best_heap_.update(slot, group.best);
+        bound_heap_.update(slot, group_bound(group));
+    }
+
+    // bound of all candidates, see the class comment
+    [[nodiscard]] T top_dist() const {
+        if (num_groups_ == 0 || group_size_ == 0) {
+            return std::numeric_limits<T>::lowest();
+        }
+        if (groups_.size() < num_groups_) {
+            return std::numeric_limits<T>::max();
+        }
+        return std::max(best_heap_.top_key(), bound_heap_.top_key());
+    }
+
+    // bound of the candidate data_id, see the class comment
+    [[nodiscard]] T top_dist(PID data_id) const {
+        if (num_groups_ == 0 || group_size_ == 0) {
+            return std::numeric_limits<T>::lowest();
+        }
+        auto iter = position_.find(group_keys_[data_id]);
+        if (iter != position_.end()) {
+            return group_bound(groups_[iter->second]);
+        }
+        if (groups_.size() < num_groups_) {
+            return std::numeric_limits<T>::max();
+        }
+        return best_heap_.top_key();
+    }
+
+    // judge if dist can be inserted into buffer
+    [[nodiscard]] auto is_full(T dist) const -> bool { return dist >= top_dist(); }
+
+    // groups sorted by their best hits, hits of each group sorted by distance
+    [[nodiscard]] std::vector<GroupHits<T>> results() const {
+        std::vector<const Group*> order;
+        order.reserve(groups_.size());
+        for (const auto& group : groups_) {
+            order.push_back(&group);
+        }
+        std::sort(order.begin(), order.end(), [](const Group* lhs, const Group* rhs) {
+            return lhs->best < rhs->best;
+        });
+
+        std::vector<GroupHits<T>> res(order.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            res[i].key = order[i]->key;
+            res[i].hits = order[i]->hits;
+            std::sort_heap(res[i].hits.begin(), res[i].hits.end());
+        }
+        return res;
+    }
+};
+}  // namespace rabitqlib::buffer
@@ -0,0 +1,487 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/compress.hpp"
+#include "rabitqlib/utils/rotator.hpp"
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib {
+
+/*
+ * Chunked container for index files. The raw byte stream produced by an index' save()
+ * is cut into fixed-size chunks, each chunk is optionally compressed and protected by a
+ * checksum. Layout of a file:
+ *
+ *      ChunkedFileHeader | chunk 0 | chunk 1 | ... | chunk table | ChunkedFileFooter
+ *
+ * Chunks can be verified and decompressed independently, thus loading reads and decodes
+ * several chunks in parallel.
+ */
+
+enum class IndexFileType : uint32_t { Unknown = 0, IVF = 1, HNSW = 2, QG = 3, Flat = 4 };
+
+enum class ChunkCodec : uint32_t { None = 0, LZ = 1 };
+
+// meta data of the index stored in the header, checked against the loaded index. Indices
+// without quantization codes (e.g., Flat) set total_bits to 0, then rotator_type is unused
+// and not checked.
+struct IndexFileMeta {
+    IndexFileType index_type = IndexFileType::Unknown;
+    size_t dim = 0;
+    MetricType metric_type = METRIC_L2;
+    size_t total_bits = 0;
+    RotatorType rotator_type = RotatorType::FhtKacRotator;
+};
+
+struct ChunkedFileConfig {
+    size_t chunk_size = 1UL << 22;  // num of raw bytes per chunk
+    bool compress = true;           // if false, chunks are only checksummed
+    size_t num_threads = 0;         // 0 means omp_get_max_threads()
+};
+
+namespace chunked_impl {
+constexpr char kHeaderMagic[8] = {'R', 'B', 'Q', 'I', 'D', 'X', 'C', '1'};
+constexpr char kFooterMagic[8] = {'R', 'B', 'Q', 'E', 'N', 'D', 'C', '1'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kMaxChunkSize = 1UL << 30;
+
+struct ChunkedFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t index_type;
+    uint64_t dim;
+    uint32_t metric_type;
+    uint32_t total_bits;
+    uint32_t rotator_type;
+    uint32_t reserved;
+    uint64_t chunk_size;
+    uint64_t checksum;  // checksum of all previous fields
+};
+static_assert(sizeof(ChunkedFileHeader) == 56);
+
+struct ChunkEntry {
+    uint64_t offset;       // offset of the chunk in file
+    uint64_t stored_size;  // num of bytes in file
+    uint64_t raw_size;     // num of bytes after decompression
+    uint32_t codec;
+    uint32_t reserved;
+    uint64_t checksum;  // checksum of stored bytes
+};
+static_assert(sizeof(ChunkEntry) == 40);
+
+struct ChunkedFileFooter {
+    uint64_t num_chunks;
+    uint64_t raw_size;
+    uint64_t table_offset;
+    uint64_t table_checksum;
+    char magic[8];
+};
+static_assert(sizeof(ChunkedFileFooter) == 40);
+
+inline size_t resolve_threads(size_t num_threads) {
+    return num_threads == 0 ? static_cast<size_t>(omp_get_max_threads()) : num_threads;
+}
+
+inline uint64_t header_checksum(const ChunkedFileHeader& header) {
+    return compress::checksum64(&header, offsetof(ChunkedFileHeader, checksum));
+}
+
+[[noreturn]] inline void corrupt(const std::string& filename, const std::string& msg) {
+    throw std::runtime_error("Corrupt index file " + filename + ": " + msg);
+}
+}  // namespace chunked_impl
+
+// check if a file is a chunked container by its magic number
+inline bool is_chunked_file(const char* filename) {
+    std::ifstream input(filename, std::ios::binary);
+    char magic[8] = {};
+    input.read(magic, sizeof(magic));
+    return input.good() &&
+           std::memcmp(magic, chunked_impl::kHeaderMagic, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief Output stream buffer that writes a chunked container. Bytes are buffered until
+ * a window of chunks is full, then the chunks are compressed in parallel and appended to
+ * the file. finish() must be called after the last write.
+ */
+class ChunkedFileWriter : public std::streambuf {
+   private:
+    std::string filename_;
+    std::ofstream output_;
+    ChunkedFileConfig config_;
+    size_t num_threads_;
+    std::vector<char> buffer_;                     // raw bytes of current window
+    std::vector<std::vector<uint8_t>> compressed_;  // compressed chunks of current window
+    std::vector<chunked_impl::ChunkEntry> table_;
+    uint64_t offset_ = 0;
+    uint64_t raw_size_ = 0;
+    bool finished_ = false;
+
+    void flush_window() {
+        size_t num_bytes = static_cast<size_t>(pptr() - pbase());
+        size_t num_chunks = div_round_up(num_bytes, config_.chunk_size);
+        std::vector<chunked_impl::ChunkEntry> entries(num_chunks);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads_)
+        for (size_t i = 0; i < num_chunks; ++i) {
+            const char* raw = buffer_.data() + (i * config_.chunk_size);
+            size_t raw_size =
+                std::min(config_.chunk_size, num_bytes - (i * config_.chunk_size));
+            auto& stored = compressed_[i];
+            auto& entry = entries[i];
+            entry.raw_size = raw_size;
+            entry.codec = static_cast<uint32_t>(ChunkCodec::None);
+            entry.reserved = 0;
+            entry.stored_size = raw_size;
+
+            if (config_.compress) {
+                stored.resize(compress::lz_compress_bound(raw_size));
+                size_t size = compress::lz_compress(raw, raw_size, stored.data());
+                // keep raw bytes if compression does not help
+                if (size < raw_size) {
+                    entry.codec = static_cast<uint32_t>(ChunkCodec::LZ);
+                    entry.stored_size = size;
+                }
+            }
+            if (entry.codec == static_cast<uint32_t>(ChunkCodec::None)) {
+                stored.assign(raw, raw + raw_size);
+            }
+            entry.checksum = compress::checksum64(stored.data(), entry.stored_size);
+        }
+
+        for (size_t i = 0; i < num_chunks; ++i) {
+            entries[i].offset = offset_;
+            output_.write(
+                reinterpret_cast<const char*>(compressed_[i].data()),
+                static_cast<long>(entries[i].stored_size)
+            );
+            offset_ += entries[i].stored_size;
+            raw_size_ += entries[i].raw_size;
+            table_.push_back(entries[i]);
+        }
+        if (!output_.good()) {
+            throw std::runtime_error("Failed to write index file " + filename_);
+        }
+
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+   protected:
+    int_type overflow(int_type ch) override {
+        if (finished_) {
+            return traits_type::eof();
+        }
+        flush_window();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+   public:
+    explicit ChunkedFileWriter(
+        const char* filename, const IndexFileMeta& meta, const ChunkedFileConfig& config = {}
+    )
+        : filename_(filename)
+        , output_(filename, std::ios::binary)
+        , config_(config)
+        , num_threads_(chunked_impl::resolve_threads(config.num_threads)) {
+        if (!output_.is_open()) {
+            throw std::runtime_error("Cannot open file " + filename_);
+        }
+        if (config_.chunk_size == 0 || config_.chunk_size > chunked_impl::kMaxChunkSize) {
+            throw std::invalid_argument("Invalid chunk size for chunked index file");
+        }
+
+        chunked_impl::ChunkedFileHeader header{};
+        std::memcpy(header.magic, chunked_impl::kHeaderMagic, sizeof(header.magic));
+        header.version = chunked_impl::kFormatVersion;
+        header.index_type = static_cast<uint32_t>(meta.index_type);
+        header.dim = meta.dim;
+        header.metric_type = static_cast<uint32_t>(meta.metric_type);
+        header.total_bits = static_cast<uint32_t>(meta.total_bits);
+        header.rotator_type = static_cast<uint32_t>(meta.rotator_type);
+        header.chunk_size = config_.chunk_size;
+        header.checksum = chunked_impl::header_checksum(header);
+        output_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset_ = sizeof(header);
+
+        size_t window = num_threads_ * 2;
+        buffer_.resize(window * config_.chunk_size);
+        compressed_.resize(window);
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    ChunkedFileWriter(const ChunkedFileWriter&) = delete;
+    ChunkedFileWriter& operator=(const ChunkedFileWriter&) = delete;
+
+    ~ChunkedFileWriter() override {
+        if (!finished_) {
+            try {
+                finish();
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << '\n';
+            }
+        }
+    }
+
+    // write remaining chunks, the chunk table and the footer
+    void finish() {
+        if (finished_) {
+            return;
+        }
+        flush_window();
+        finished_ = true;
+
+        chunked_impl::ChunkedFileFooter footer{};
+        footer.num_chunks = table_.size();
+        footer.raw_size = raw_size_;
+        footer.table_offset = offset_;
+        footer.table_checksum = compress::checksum64(
+            table_.data(), table_.size() * sizeof(chunked_impl::ChunkEntry)
+        );
+        std::memcpy(footer.magic, chunked_impl::kFooterMagic, sizeof(footer.magic));
+
+        output_.write(
+            reinterpret_cast<const char*>(table_.data()),
+            static_cast<long>(table_.size() * sizeof(chunked_impl::ChunkEntry))
+        );
+        output_.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        output_.close();
+        if (output_.fail()) {
+            throw std::runtime_error("Failed to write index file " + filename_);
+        }
+    }
+
+    // num of raw bytes written
+    [[nodiscard]] size_t raw_size() const {
+        return raw_size_ + static_cast<size_t>(pptr() - pbase());
+    }
+
+    // num of bytes in file (valid after finish())
+    [[nodiscard]] size_t file_size() const {
+        return offset_ + (table_.size() * sizeof(chunked_impl::ChunkEntry)) +
+               sizeof(chunked_impl::ChunkedFileFooter);
+    }
+};
+
+/**
+ * @brief Input stream buffer that reads a chunked container. The header and the chunk
+ * table are validated on open. Chunks are then read, verified and decompressed a window
+ * at a time, each thread reading its chunks through its own file handle. Any mismatch
+ * throws std::runtime_error before the corrupted bytes are handed out.
+ */
+class ChunkedFileReader : public std::streambuf {
+   private:
+    std::string filename_;
+    size_t num_threads_;
+    IndexFileMeta meta_;
+    size_t chunk_size_ = 0;
+    size_t raw_size_ = 0;
+    std::vector<chunked_impl::ChunkEntry> table_;
+    std::vector<std::ifstream> inputs_;  // one file handle per thread
+    std::vector<char> buffer_;           // raw bytes of current window
+    size_t next_chunk_ = 0;
+
+    void read_header() {
+        using namespace chunked_impl;
+        std::ifstream input(filename_, std::ios::binary | std::ios::ate);
+        if (!input.is_open()) {
+            throw std::runtime_error("Cannot open file " + filename_);
+        }
+        auto file_size = static_cast<uint64_t>(input.tellg());
+        if (file_size < sizeof(ChunkedFileHeader) + sizeof(ChunkedFileFooter)) {
+            corrupt(filename_, "file is truncated");
+        }
+
+        ChunkedFileHeader header{};
+        input.seekg(0);
+        input.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (std::memcmp(header.magic, kHeaderMagic, sizeof(header.magic)) != 0) {
+            corrupt(filename_, "not a chunked index file");
+        }
+        if (header.checksum != header_checksum(header)) {
+            corrupt(filename_, "header checksum mismatch");
+        }
+        if (header.version != kFormatVersion) {
+            throw std::runtime_error(
+                "Unsupported version " + std::to_string(header.version) +
+                " of index file " + filename_
+            );
+        }
+        if (header.chunk_size == 0 || header.chunk_size > kMaxChunkSize) {
+            corrupt(filename_, "bad chunk size");
+        }
+        meta_.index_type = static_cast<IndexFileType>(header.index_type);
+        meta_.dim = header.dim;
+        meta_.metric_type = static_cast<MetricType>(header.metric_type);
+        meta_.total_bits = header.total_bits;
+        meta_.rotator_type = static_cast<RotatorType>(header.rotator_type);
+        chunk_size_ = header.chunk_size;
+
+        ChunkedFileFooter footer{};
+        input.seekg(static_cast<long>(file_size - sizeof(footer)));
+        input.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+        if (std::memcmp(footer.magic, kFooterMagic, sizeof(footer.magic)) != 0) {
+            corrupt(filename_, "footer not found, file is truncated or incomplete");
+        }
+        uint64_t table_bytes = footer.num_chunks * sizeof(ChunkEntry);
+        if (footer.num_chunks > file_size / sizeof(ChunkEntry) ||
+            footer.table_offset < sizeof(ChunkedFileHeader) ||
+            footer.table_offset + table_bytes + sizeof(footer) != file_size) {
+            corrupt(filename_, "bad chunk table location");
+        }
+
+        table_.resize(footer.num_chunks);
+        input.seekg(static_cast<long>(footer.table_offset));
+        input.read(reinterpret_cast<char*>(table_.data()), static_cast<long>(table_bytes));
+        if (!input.good() ||
+            compress::checksum64(table_.data(), table_bytes) != footer.table_checksum) {
+            corrupt(filename_, "chunk table checksum mismatch");
+        }
+
+        uint64_t total = 0;
+        for (size_t i = 0; i < table_.size(); ++i) {
+            const auto& entry = table_[i];
+            if (entry.offset < sizeof(ChunkedFileHeader) ||
+                entry.stored_size > footer.table_offset ||
+                entry.offset > footer.table_offset - entry.stored_size ||
+                entry.raw_size > chunk_size_ || entry.codec > 1) {
+                corrupt(filename_, "bad entry for chunk " + std::to_string(i));
+            }
+            total += entry.raw_size;
+        }
+        if (total != footer.raw_size) {
+            corrupt(filename_, "size of chunks does not match the footer");
+        }
+        raw_size_ = footer.raw_size;
+    }
+
+    // read, verify and decompress next window of chunks into buffer_
+    bool load_window() {
+        if (next_chunk_ >= table_.size()) {
+            return false;
+        }
+        size_t end_chunk = std::min(table_.size(), next_chunk_ + (num_threads_ * 2));
+        size_t num_chunks = end_chunk - next_chunk_;
+        std::vector<size_t> starts(num_chunks + 1, 0);
+        for (size_t i = 0; i < num_chunks; ++i) {
+            starts[i + 1] = starts[i] + table_[next_chunk_ + i].raw_size;
+        }
+        buffer_.resize(starts[num_chunks]);
+        std::vector<std::string> errors(num_chunks);
+
+#pragma omp parallel num_threads(num_threads_)
+        {
+            auto tid = static_cast<size_t>(omp_get_thread_num());
+            std::vector<uint8_t> stored;
+#pragma omp for schedule(dynamic)
+            for (size_t i = 0; i < num_chunks; ++i) {
+                size_t chunk_id = next_chunk_ + i;
+                const auto& entry = table_[chunk_id];
+                auto& input = inputs_[tid];
+                if (!input.is_open()) {
+                    input.open(filename_, std::ios::binary);
+                }
+                stored.resize(entry.stored_size);
+                input.clear();
+                input.seekg(static_cast<long>(entry.offset));
+                input.read(
+                    reinterpret_cast<char*>(stored.data()),
+                    static_cast<long>(entry.stored_size)
+                );
+                if (!input.good()) {
+                    errors[i] = "failed to read chunk " + std::to_string(chunk_id);
+                    continue;
+                }
+                if (compress::checksum64(stored.data(), entry.stored_size) !=
+                    entry.checksum) {
+                    errors[i] = "checksum mismatch in chunk " + std::to_string(chunk_id);
+                    continue;
+                }
+                char* dst = buffer_.data() + starts[i];
+                if (entry.codec == static_cast<uint32_t>(ChunkCodec::LZ)) {
+                    if (!compress::lz_decompress(
+                            stored.data(), entry.stored_size, dst, entry.raw_size
+                        )) {
+                        errors[i] = "failed to decompress chunk " + std::to_string(chunk_id);
+                    }
+                } else if (entry.stored_size != entry.raw_size) {
+                    errors[i] = "bad size of chunk " + std::to_string(chunk_id);
+                } else {
+                    std::memcpy(dst, stored.data(), entry.raw_size);
+                }
+            }
+        }
+
+        for (const auto& err : errors) {
+            if (!err.empty()) {
+                chunked_impl::corrupt(filename_, err);
+            }
+        }
+
+        next_chunk_ = end_chunk;
+        setg(buffer_.data(), buffer_.data(), buffer_.data() + buffer_.size());
+        return true;
+    }
+
+   protected:
+    int_type underflow() override {
+        while (gptr() == egptr()) {
+            if (!load_window()) {
+                return traits_type::eof();
+            }
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+
+   public:
+    explicit ChunkedFileReader(const char* filename, size_t num_threads = 0)
+        : filename_(filename), num_threads_(chunked_impl::resolve_threads(num_threads)) {
+        read_header();
+        inputs_.resize(num_threads_);
+    }
+
+    ChunkedFileReader(const ChunkedFileReader&) = delete;
+    ChunkedFileReader& operator=(const ChunkedFileReader&) = delete;
+
+    [[nodiscard]] const IndexFileMeta& meta() const { return meta_; }
+
+    [[nodiscard]] size_t raw_size() const { return raw_size_; }
+
+    [[nodiscard]] size_t num_chunks() const { return table_.size(); }
+
+    // check if all bytes in file have been consumed
+    [[nodiscard]] bool exhausted() const {
+        return next_chunk_ >= table_.size() && gptr() == egptr();
+    }
+
+    // check the meta data of a loaded index against the header
+    void check_meta(const IndexFileMeta& loaded) const {
+        if (loaded.index_type != meta_.index_type || loaded.dim != meta_.dim ||
+            loaded.metric_type != meta_.metric_type ||
+            loaded.total_bits != meta_.total_bits ||
+            (meta_.total_bits != 0 && loaded.rotator_type != meta_.rotator_type)) {
+            chunked_impl::corrupt(filename_, "index does not match the header");
+        }
+        if (!exhausted()) {
+            chunked_impl::corrupt(filename_, "unexpected trailing bytes");
+        }
+    }
+};
+}  // namespace rabitqlib
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rabitqlib::compress {
+
+namespace detail {
+inline uint64_t read64(const uint8_t* ptr) {
+    uint64_t val;
+    std::memcpy(&val, ptr, sizeof(uint64_t));
+    return val;
+}
+
+inline uint32_t read32(const uint8_t* ptr) {
+    uint32_t val;
+    std::memcpy(&val, ptr, sizeof(uint32_t));
+    return val;
+}
+
+inline uint64_t rotl64(uint64_t val, int bits) { return (val << bits) | (val >> (64 - bits)); }
+
+constexpr uint64_t kPrime64A = 11400714785074694791ULL;
+constexpr uint64_t kPrime64B = 14029467366897019727ULL;
+constexpr uint64_t kPrime64C = 1609587929392839161ULL;
+constexpr uint64_t kPrime64D = 9650029242287828579ULL;
+constexpr uint64_t kPrime64E = 2870177450012600261ULL;
+
+inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime64B;
+    acc = rotl64(acc, 31);
+    return acc * kPrime64A;
+}
+
+inline uint64_t hash_merge(uint64_t acc, uint64_t val) {
+    acc ^= hash_round(0, val);
+    return acc * kPrime64A + kPrime64D;
+}
+}  // namespace detail
+
+/**
+ * @brief 64-bit checksum of a byte array (XXH64 algorithm, several GB/s per core)
+ */
+inline uint64_t checksum64(const void* data, size_t len, uint64_t seed = 0) {
+    using namespace detail;
+    const auto* ptr = static_cast<const uint8_t*>(data);
+    const uint8_t* end = ptr + len;
+    uint64_t hash;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + kPrime64A + kPrime64B;
+        uint64_t v2 = seed + kPrime64B;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime64A;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = hash_round(v1, read64(ptr));
+            v2 = hash_round(v2, read64(ptr + 8));
+            v3 = hash_round(v3, read64(ptr + 16));
+            v4 = hash_round(v4, read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = hash_merge(hash, v1);
+        hash = hash_merge(hash, v2);
+        hash = hash_merge(hash, v3);
+        hash = hash_merge(hash, v4);
+    } else {
+        hash = seed + kPrime64E;
+    }
+
+    hash += static_cast<uint64_t>(len);
+
+    for (; ptr + 8 <= end; ptr += 8) {
+        hash ^= hash_round(0, read64(ptr));
+        hash = rotl64(hash, 27) * kPrime64A + kPrime64D;
+    }
+    if (ptr + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(ptr)) * kPrime64A;
+        hash = rotl64(hash, 23) * kPrime64B + kPrime64C;
+        ptr += 4;
+    }
+    for (; ptr < end; ++ptr) {
+        hash ^= (*ptr) * kPrime64E;
+        hash = rotl64(hash, 11) * kPrime64A;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime64B;
+    hash ^= hash >> 29;
+    hash *= kPrime64C;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/*
+ * A small LZ77 byte codec in the style of LZ4. The stream is a list of sequences, each
+ * sequence is
+ *      token | [literal length ext] | literals | offset (2B) | [match length ext]
+ * where the high 4 bits of token is the literal length and the low 4 bits is the match
+ * length minus kMinMatch. A field equals to 15 is extended by the following bytes (sum of
+ * bytes, ended by a byte < 255). The last sequence only contains literals.
+ *
+ * Quantization codes are nearly incompressible, the encoder skips faster and faster
+ * through data without matches so that it costs little on such input.
+ */
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr size_t kHashLog = 16;
+
+// max size of compressed data of given input size
+inline size_t lz_compress_bound(size_t len) { return len + (len / 255) + 16; }
+
+namespace detail {
+inline uint32_t lz_hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - static_cast<uint32_t>(kHashLog));
+}
+
+inline void write_length(uint8_t*& op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+}
+
+inline uint8_t* write_sequence(
+    uint8_t* op, const uint8_t* literals, size_t num_literals, size_t offset, size_t match_len
+) {
+    uint8_t* token = op++;
+    size_t lit_field = num_literals >= 15 ? 15 : num_literals;
+    *token = static_cast<uint8_t>(lit_field << 4);
+    if (lit_field == 15) {
+        write_length(op, num_literals - 15);
+    }
+    std::memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_len == 0) {  // last sequence
+        return op;
+    }
+
+    op[0] = static_cast<uint8_t>(offset & 0xFF);
+    op[1] = static_cast<uint8_t>(offset >> 8);
+    op += 2;
+
+    size_t match_field = match_len - kMinMatch;
+    if (match_field >= 15) {
+        *token |= 15;
+        write_length(op, match_field - 15);
+    } else {
+        *token |= static_cast<uint8_t>(match_field);
+    }
+    return op;
+}
+
+// read an extended length, return false if input is exhausted
+inline bool read_length(const uint8_t*& ip, const uint8_t* iend, size_t& len) {
+    uint8_t byte;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        byte = *ip++;
+        len += byte;
+    } while (byte == 255);
+    return true;
+}
+}  // namespace detail
+
+/**
+ * @brief Compress src into dst, dst should have lz_compress_bound(len) bytes
+ *
+ * @return size of compressed data
+ */
+inline size_t lz_compress(const void* src, size_t len, void* dst) {
+    const auto* base = static_cast<const uint8_t*>(src);
+    const uint8_t* iend = base + len;
+    auto* op = static_cast<uint8_t*>(dst);
+    auto* ostart = op;
+
+    std::vector<uint32_t> table(1UL << kHashLog, 0);
+    const uint8_t* anchor = base;  // start of pending literals
+    const uint8_t* ip = base + 1;
+
+    if (len > kMinMatch) {
+        const uint8_t* match_limit = iend - kMinMatch;
+        size_t misses = 0;
+        while (ip <= match_limit) {
+            uint32_t seq = detail::read32(ip);
+            uint32_t hash = detail::lz_hash(seq);
+            const uint8_t* ref = base + table[hash];
+            table[hash] = static_cast<uint32_t>(ip - base);
+
+            if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset ||
+                detail::read32(ref) != seq) {
+                // skip faster on incompressible data
+                ip += 1 + (misses++ >> 5);
+                continue;
+            }
+            misses = 0;
+
+            // extend match backward and forward
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                --ip;
+                --ref;
+            }
+            size_t match_len = kMinMatch;
+            while (ip + match_len < iend && ip[match_len] == ref[match_len]) {
+                ++match_len;
+            }
+
+            op = detail::write_sequence(
+                op,
+                anchor,
+                static_cast<size_t>(ip - anchor),
+                static_cast<size_t>(ip - ref),
+                match_len
+            );
+
+            ip += match_len;
+            anchor = ip;
+            if (ip - 2 > base && ip <= match_limit) {
+                table[detail::lz_hash(detail::read32(ip - 2))] =
+                    static_cast<uint32_t>(ip - 2 - base);
+            }
+        }
+    }
+
+    op = detail::write_sequence(op, anchor, static_cast<size_t>(iend - anchor), 0, 0);
+    return static_cast<size_t>(op - ostart);
+}
+
+/**
+ * @brief Decompress src into dst. The decoder checks every bound, corrupt input never
+ * reads or writes out of the buffers.
+ *
+ * @return true if src is well-formed and decompresses to exactly dst_len bytes
+ */
+inline bool lz_decompress(const void* src, size_t src_len, void* dst, size_t dst_len) {
+    const auto* ip = static_cast<const uint8_t*>(src);
+    const uint8_t* iend = ip + src_len;
+    auto* op = static_cast<uint8_t*>(dst);
+    auto* ostart = op;
+    uint8_t* oend = op + dst_len;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !detail::read_length(ip, iend, num_literals)) {
+            return false;
+        }
+        if (num_literals > static_cast<size_t>(iend - ip) ||
+            num_literals > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        std::memcpy(op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == iend) {  // last sequence
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !detail::read_length(ip, iend, match_len)) {
+            return false;
+        }
+        match_len += kMinMatch;
+
+        if (offset == 0 || offset > static_cast<size_t>(op - ostart) ||
+            match_len > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        const uint8_t* ref = op - offset;
+        if (offset >= match_len) {
+            std::memcpy(op, ref, match_len);
+            op += match_len;
+        } else {  // overlapped copy
+            for (size_t i = 0; i < match_len; ++i) {
+                *op++ = *ref++;
+            }
+        }
+    }
+
+    return op == oend;
+}
+}  // namespace rabitqlib::compress
@@ -48,17 +48,21 @@ class HashBasedBooleanSet {
     HashBasedBooleanSet(HashBasedBooleanSet&&) noexcept = default;
     HashBasedBooleanSet& operator=(HashBasedBooleanSet&&) noexcept = default;
 
-    explicit HashBasedBooleanSet(size_t size) {
+    explicit HashBasedBooleanSet(size_t size) { initialize(table_size_for(size)); }
+
+    // size of the table for a set of the given size
+    static size_t table_size_for(size_t size) {
         size_t bit_size = 0;
         size_t bit = size;
         while (bit != 0) {
             bit_size++;
             bit >>= 1;
         }
-        size_t bucket_size = 0x1 << ((bit_size + 4) / 2 + 3);
-        initialize(bucket_size);
+        return size_t{0x1} << ((bit_size + 4) / 2 + 3);
     }
 
+    [[nodiscard]] size_t table_size() const { return table_size_; }
+
     void initialize(const size_t table_size) {
         table_size_ = table_size;
         mask_ = static_cast<PID>(table_size_ - 1);
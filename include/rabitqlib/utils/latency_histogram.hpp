@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+namespace rabitqlib {
+/**
+ * @brief Lock-free histogram of latencies in microseconds. Buckets are log-linear (in the
+ * spirit of HdrHistogram): values below kSubBuckets are exact, larger values are grouped
+ * by their highest bit and kSubBucketBits following bits, thus the relative error of
+ * percentiles is below 1 / kSubBuckets.
+ */
+class LatencyHistogram {
+   private:
+    static constexpr size_t kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+
+    static size_t bucket_of(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        size_t high = 63 - static_cast<size_t>(__builtin_clzll(value));
+        size_t shift = high - kSubBucketBits;
+        size_t sub = static_cast<size_t>(value >> shift) - kSubBuckets;
+        return ((shift + 1) * kSubBuckets) + sub;
+    }
+
+    // largest value in a bucket
+    static uint64_t bucket_value(size_t bucket) {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        size_t shift = (bucket / kSubBuckets) - 1;
+        uint64_t sub = (bucket % kSubBuckets) + kSubBuckets;
+        return ((sub + 1) << shift) - 1;
+    }
+
+   public:
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t micros) {
+        buckets_[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(micros, std::memory_order_relaxed);
+        uint64_t cur_max = max_.load(std::memory_order_relaxed);
+        while (micros > cur_max &&
+               !max_.compare_exchange_weak(cur_max, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            uint64_t num = other.buckets_[i].load(std::memory_order_relaxed);
+            if (num != 0) {
+                buckets_[i].fetch_add(num, std::memory_order_relaxed);
+            }
+        }
+        count_.fetch_add(other.count(), std::memory_order_relaxed);
+        sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        uint64_t other_max = other.max();
+        uint64_t cur_max = max_.load(std::memory_order_relaxed);
+        while (other_max > cur_max &&
+               !max_.compare_exchange_weak(cur_max, other_max, std::memory_order_relaxed)) {
+        }
+    }
+
+    void clear() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] double mean() const {
+        uint64_t num = count();
+        return num == 0 ? 0.0
+                        : static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                              static_cast<double>(num);
+    }
+
+    /**
+     * @brief Latency at a given percentile, the upper bound of the bucket which contains it
+     *
+     * @param percentile percentile in [0, 100]
+     */
+    [[nodiscard]] uint64_t percentile(double percentile) const {
+        uint64_t num = count();
+        if (num == 0) {
+            return 0;
+        }
+        auto rank = static_cast<uint64_t>(
+            std::ceil((std::clamp(percentile, 0.0, 100.0) / 100.0) * static_cast<double>(num))
+        );
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(bucket_value(i), max());
+            }
+        }
+        return max();
+    }
+
+    // one line summary, e.g., "count=100 mean=12.3us p50=11us ... p999=24us max=25us"
+    [[nodiscard]] std::string summary() const {
+        std::ostringstream out;
+        out << "count=" << count() << " mean=" << std::fixed << std::setprecision(1)
+            << mean() << "us";
+        out << " p50=" << percentile(50) << "us p90=" << percentile(90)
+            << "us p99=" << percentile(99) << "us p999=" << percentile(99.9) << "us";
+        out << " max=" << max() << "us";
+        return out.str();
+    }
+};
+}  // namespace rabitqlib
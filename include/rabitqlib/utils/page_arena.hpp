@@ -0,0 +1,124 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
+#include <set>
+#include <vector>
+
+#include "rabitqlib/utils/tools.hpp"
+
+namespace rabitqlib::memory {
+/**
+ * @brief Pool of fixed-size pages shared by many owners, e.g., the batches of all tenants
+ * of MultiTenantIVF. Pages are carved from large chunks mapped by mmap, thus many small
+ * owners do not pay for an allocation (and its alignment and rounding) each. Released pages
+ * are reused by later allocations, which take pages of the lowest chunk first so that other
+ * chunks drain. Once all pages of a chunk are released, the chunk is unmapped, except for
+ * one empty chunk kept for reuse, thus the memory of the process shrinks with the pages in
+ * use. Thread-safe.
+ */
+class PageArena {
+   private:
+    size_t page_bytes_;                            // bytes of a page, multiple of 64
+    size_t pages_per_chunk_;                       // num of pages allocated at once
+    std::map<char*, std::vector<char*>> chunks_;   // free pages of each chunk by address
+    std::set<char*> partial_;                      // chunks with free pages
+    size_t empty_chunks_ = 0;                      // num of chunks without used pages
+    size_t used_pages_ = 0;                        // num of allocated pages
+    mutable std::mutex mutex_;
+
+    [[nodiscard]] size_t chunk_bytes() const { return pages_per_chunk_ * page_bytes_; }
+
+    // call with mutex_ locked
+    char* map_chunk() {
+        void* ptr = mmap(
+            nullptr, chunk_bytes(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+        );
+        if (ptr == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        madvise(ptr, chunk_bytes(), MADV_HUGEPAGE);
+        char* chunk = static_cast<char*>(ptr);
+        auto& free_pages = chunks_[chunk];
+        for (size_t i = pages_per_chunk_; i > 0; --i) {
+            free_pages.push_back(chunk + ((i - 1) * page_bytes_));
+        }
+        partial_.insert(chunk);
+        ++empty_chunks_;
+        return chunk;
+    }
+
+   public:
+    explicit PageArena(size_t page_bytes, size_t pages_per_chunk = 256)
+        : page_bytes_(round_up_to_multiple(page_bytes, 64))
+        , pages_per_chunk_(pages_per_chunk) {}
+
+    PageArena(const PageArena&) = delete;
+    PageArena& operator=(const PageArena&) = delete;
+
+    ~PageArena() {
+        for (const auto& chunk : chunks_) {
+            munmap(chunk.first, chunk_bytes());
+        }
+    }
+
+    [[nodiscard]] size_t page_bytes() const { return page_bytes_; }
+
+    [[nodiscard]] size_t used_pages() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return used_pages_;
+    }
+
+    // bytes of all mapped chunks, including free pages
+    [[nodiscard]] size_t reserved_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return chunks_.size() * chunk_bytes();
+    }
+
+    // a zeroed page
+    [[nodiscard]] char* allocate() {
+        char* page = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            char* chunk = partial_.empty() ? map_chunk() : *partial_.begin();
+            auto& free_pages = chunks_[chunk];
+            if (free_pages.size() == pages_per_chunk_) {
+                --empty_chunks_;
+            }
+            page = free_pages.back();
+            free_pages.pop_back();
+            if (free_pages.empty()) {
+                partial_.erase(chunk);
+            }
+            ++used_pages_;
+        }
+        std::memset(page, 0, page_bytes_);
+        return page;
+    }
+
+    void release(char* page) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::prev(chunks_.upper_bound(page));
+        char* chunk = it->first;
+        auto& free_pages = it->second;
+        free_pages.push_back(page);
+        partial_.insert(chunk);
+        --used_pages_;
+        if (free_pages.size() == pages_per_chunk_) {
+            if (empty_chunks_ > 0) {
+                munmap(chunk, chunk_bytes());
+                partial_.erase(chunk);
+                chunks_.erase(it);
+            } else {
+                ++empty_chunks_;
+            }
+        }
+    }
+};
+}  // namespace rabitqlib::memory
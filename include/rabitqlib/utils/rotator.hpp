@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
@@ -8,7 +9,12 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <optional>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "rabitqlib/defines.hpp"
 #include "rabitqlib/simd/rotator_dispatch.hpp"
@@ -17,8 +23,20 @@
 #include "rabitqlib/utils/tools.hpp"
 
 namespace rabitqlib {
+/**
+ * @brief Reconstruction of a rotated vector (padded_dim) by the quantizer of an index,
+ * used by Rotator::train() so that rotators do not depend on quantizers, see
+ * quant::scalar_reconstructor() for RaBitQ. It is called by many threads at once.
+ */
+template <typename T>
+using ReconstructFunc = std::function<void(const T* rotated, T* reconstructed)>;
 
-enum class RotatorType : uint8_t { MatrixRotator, FhtKacRotator };
+enum class RotatorType : uint8_t {
+    MatrixRotator,
+    FhtKacRotator,
+    LearnedRotator,
+    SorfRotator
+};
 
 // abstract rotator
 template <typename T>
@@ -32,8 +50,21 @@ class Rotator {
     explicit Rotator(size_t dim, size_t padded_dim) : dim_(dim), padded_dim_(padded_dim) {};
     virtual ~Rotator() = default;
     virtual void rotate(const T* src, T* dst) const = 0;
-    virtual void load(std::ifstream&) = 0;
-    virtual void save(std::ofstream&) const = 0;
+    // rotate num vectors (num * dim) into dst (num * padded_dim)
+    virtual void rotate_batch(const T* src, size_t num, T* dst) const {
+        for (size_t i = 0; i < num; ++i) {
+            rotate(src + (i * dim_), dst + (i * padded_dim_));
+        }
+    }
+    // learn the rotation from num vectors, reconstruct maps a rotated vector
+    // (padded_dim) to its reconstruction by the quantizer, random rotators ignore it
+    virtual void train(
+        const T* /*data*/, size_t /*num*/, const ReconstructFunc<T>& /*reconstruct*/
+    ) {}
+    // map a rotated vector (padded_dim) back to the original space (dim)
+    virtual void inverse_rotate(const T* src, T* dst) const = 0;
+    virtual void load(std::istream&) = 0;
+    virtual void save(std::ostream&) const = 0;
     // Buffer I/O
     virtual void load(const char *data) = 0;
     virtual void save(char *data) const = 0; // dump to buffer
@@ -45,12 +76,15 @@ namespace rotator_impl {
 
 // get padding requirement for different rotator
 inline size_t padding_requirement(size_t dim, RotatorType type) {
-    if (type == RotatorType::MatrixRotator) {
+    if (type == RotatorType::MatrixRotator || type == RotatorType::LearnedRotator) {
         return dim;
     }
     if (type == RotatorType::FhtKacRotator) {
         return round_up_to_multiple(dim, 64);
     }
+    if (type == RotatorType::SorfRotator) {
+        return std::max<size_t>(1UL << ceil_log2(dim), 64);
+    }
     std::cerr << "Invalid rotator type in padding_requirement()\n" << std::flush;
     exit(1);
 }
@@ -60,9 +94,11 @@ class MatrixRotator : public Rotator<T> {
    private:
     RowMajorMatrix<T> rand_mat_;  // Rotation Maxtrix
    public:
-    explicit MatrixRotator(size_t dim, size_t padded_dim)
+    explicit MatrixRotator(
+        size_t dim, size_t padded_dim, std::optional<unsigned> seed = std::nullopt
+    )
         : Rotator<T>(dim, padded_dim), rand_mat_(dim, padded_dim) {
-        RowMajorMatrix<T> rand = random_gaussian_matrix<T>(padded_dim, padded_dim);
+        RowMajorMatrix<T> rand = random_gaussian_matrix<T>(padded_dim, padded_dim, seed);
         Eigen::HouseholderQR<RowMajorMatrix<T>> qr(rand);
         RowMajorMatrix<T> q_inv =
             qr.householderQ().transpose();  // inverse of orthogonal mat is its inverse
@@ -81,14 +117,14 @@ class MatrixRotator : public Rotator<T> {
         return *this;
     }
 
-    void load(std::ifstream& input) override {
+    void load(std::istream& input) override {
         input.read(
             reinterpret_cast<char*>(rand_mat_.data()),
             static_cast<long>(sizeof(float) * this->dim_ * this->padded_dim_)
         );
     }
 
-    void save(std::ofstream& output) const override {
+    void save(std::ostream& output) const override {
         output.write(
             reinterpret_cast<const char*>(rand_mat_.data()),
             (sizeof(float) * this->dim_ * this->padded_dim_)
@@ -112,76 +148,297 @@ class MatrixRotator : public Rotator<T> {
         RowMajorMatrixMap<T> rv(rotated_vec, 1, this->padded_dim_);
         rv = v * this->rand_mat_;
     }
+
+    void rotate_batch(const T* vecs, size_t num, T* rotated_vecs) const override {
+        ConstRowMajorMatrixMap<T> v(vecs, num, this->dim_);
+        RowMajorMatrixMap<T> rv(rotated_vecs, num, this->padded_dim_);
+        rv.noalias() = v * this->rand_mat_;
+    }
+
+    void inverse_rotate(const T* rotated_vec, T* vec) const override {
+        ConstRowMajorMatrixMap<T> rv(rotated_vec, 1, this->padded_dim_);
+        RowMajorMatrixMap<T> v(vec, 1, this->dim_);
+        v = rv * this->rand_mat_.transpose();
+    }
+};
+
+/**
+ * @brief Orthogonal transformation learned from data. It starts from a random orthogonal
+ * matrix as MatrixRotator. train() alternates between quantizing the rotated sample by
+ * the given quantizer (e.g., RaBitQ with the rescaling factors minimizing the
+ * reconstruction errors, see quant::scalar_reconstructor()) and updating
+ * the rotation to minimize the total reconstruction error for the fixed codes, i.e., the
+ * orthogonal Procrustes problem, which is solved by U * V^T for the SVD U * S * V^T of
+ * X^T * Z (X for the sample and Z for its reconstruction). This is the iterative
+ * quantization of ITQ/OPQ with RaBitQ as the quantizer, thus anisotropic data are turned
+ * to suit the codes rather than spread evenly. A batch of vectors is rotated by one GEMM.
+ */
+template <typename T = float>
+class LearnedRotator : public Rotator<T> {
+   private:
+    RowMajorMatrix<T> rotation_;  // dim * padded_dim, rows are orthonormal
+
+   public:
+    static constexpr size_t kMaxTrainSize = 20000;  // max num of vectors in the sample
+    static constexpr size_t kTrainIters = 10;
+    static constexpr double kRegularizer = 1e-6;
+
+    // random_init = false only sizes the rotation for load(), which skips the QR of a
+    // padded_dim * padded_dim random matrix
+    explicit LearnedRotator(
+        size_t dim,
+        size_t padded_dim,
+        bool random_init = true,
+        std::optional<unsigned> seed = std::nullopt
+    )
+        : Rotator<T>(dim, padded_dim), rotation_(dim, padded_dim) {
+        if (!random_init) {
+            return;
+        }
+        RowMajorMatrix<T> rand = random_gaussian_matrix<T>(padded_dim, padded_dim, seed);
+        Eigen::HouseholderQR<RowMajorMatrix<T>> qr(rand);
+        RowMajorMatrix<T> q_inv = qr.householderQ().transpose();
+        rotation_ = q_inv.topRows(dim);
+    }
+    LearnedRotator() = default;
+    ~LearnedRotator() override = default;
+
+    void train(const T* data, size_t num, const ReconstructFunc<T>& reconstruct) override {
+        size_t num_sample = std::min(num, kMaxTrainSize);
+        if (num_sample == 0) {
+            return;
+        }
+
+        // sample evenly
+        RowMajorMatrix<T> sample(num_sample, this->dim_);
+        for (size_t i = 0; i < num_sample; ++i) {
+            const T* vec = data + ((i * num / num_sample) * this->dim_);
+            std::copy(vec, vec + this->dim_, &sample(static_cast<long>(i), 0));
+        }
+
+        size_t num_threads = total_threads();
+        RowMajorMatrix<T> rotated(num_sample, this->padded_dim_);
+        RowMajorMatrix<T> reconstructed(num_sample, this->padded_dim_);
+        for (size_t iter = 0; iter < kTrainIters; ++iter) {
+            rotated.noalias() = sample * rotation_;
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+            for (size_t i = 0; i < num_sample; ++i) {
+                auto row = static_cast<long>(i);
+                // zero vectors (e.g., data on centroids) are reconstructed exactly
+                if (rotated.row(row).squaredNorm() <= std::numeric_limits<T>::min()) {
+                    reconstructed.row(row).setZero();
+                    continue;
+                }
+                reconstruct(&rotated(row, 0), &reconstructed(row, 0));
+            }
+
+            // U * V^T = (C * C^T)^(-1/2) * C for C = X^T * Z. The SVD of Eigen (BDCSVD) is
+            // unreliable with -Ofast, thus it is computed by the eigen decomposition of
+            // C * C^T in double. A tiny multiple of the current rotation is added to C to
+            // keep the directions out of the span of low-rank data.
+            RowMajorMatrix<double> cross =
+                (sample.transpose() * reconstructed).template cast<double>();
+            cross += (kRegularizer * cross.norm()) * rotation_.template cast<double>();
+            Eigen::SelfAdjointEigenSolver<RowMajorMatrix<double>> eig(
+                cross * cross.transpose()
+            );
+            Eigen::VectorXd inv_sqrt = eig.eigenvalues()
+                                           .cwiseMax(std::numeric_limits<double>::min())
+                                           .cwiseSqrt()
+                                           .cwiseInverse();
+            rotation_ = (eig.eigenvectors() * inv_sqrt.asDiagonal() *
+                         eig.eigenvectors().transpose() * cross)
+                            .template cast<T>();
+        }
+    }
+
+    void load(std::istream& input) override {
+        input.read(
+            reinterpret_cast<char*>(rotation_.data()),
+            static_cast<long>(sizeof(T) * this->dim_ * this->padded_dim_)
+        );
+    }
+
+    void save(std::ostream& output) const override {
+        output.write(
+            reinterpret_cast<const char*>(rotation_.data()),
+            static_cast<long>(sizeof(T) * this->dim_ * this->padded_dim_)
+        );
+    }
+
+    void load(const char* data) override {
+        std::memcpy(rotation_.data(), data, sizeof(T) * this->dim_ * this->padded_dim_);
+    }
+
+    void save(char* data) const override {
+        std::memcpy(data, rotation_.data(), sizeof(T) * this->dim_ * this->padded_dim_);
+    }
+
+    size_t dump_bytes() const override {
+        return sizeof(T) * this->dim_ * this->padded_dim_;
+    }
+
+    void rotate(const T* vec, T* rotated_vec) const override {
+        ConstRowMajorMatrixMap<T> v(vec, 1, this->dim_);
+        RowMajorMatrixMap<T> rv(rotated_vec, 1, this->padded_dim_);
+        rv.noalias() = v * rotation_;
+    }
+
+    void rotate_batch(const T* vecs, size_t num, T* rotated_vecs) const override {
+        ConstRowMajorMatrixMap<T> v(vecs, num, this->dim_);
+        RowMajorMatrixMap<T> rv(rotated_vecs, num, this->padded_dim_);
+        rv.noalias() = v * rotation_;
+    }
+
+    void inverse_rotate(const T* rotated_vec, T* vec) const override {
+        ConstRowMajorMatrixMap<T> rv(rotated_vec, 1, this->padded_dim_);
+        RowMajorMatrixMap<T> v(vec, 1, this->dim_);
+        v.noalias() = rv * rotation_.transpose();
+    }
 };
 
 static inline void flip_sign(const uint8_t* flip, float* data, size_t dim) {
     simd::flip_sign(flip, data, dim);
 }
 
+// random bits for sign flips, seeded by a random device if no seed is given
+inline std::vector<uint8_t> random_flips(
+    size_t num_bytes, std::optional<unsigned> seed = std::nullopt
+) {
+    std::mt19937 gen(seed.has_value() ? *seed : std::random_device{}());
+
+    // Uniform distribution in the range [0, 255]
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    std::vector<uint8_t> flips(num_bytes);
+    for (auto& i : flips) {
+        i = static_cast<uint8_t>(dist(gen));
+    }
+    return flips;
+}
+
+// unnormalized FHT of 2^log_dim floats
+inline std::function<void(float*)> select_fht(size_t log_dim) {
+    switch (log_dim) {
+        case 6:
+            return helper_float_6;
+        case 7:
+            return helper_float_7;
+        case 8:
+            return helper_float_8;
+        case 9:
+            return helper_float_9;
+        case 10:
+            return helper_float_10;
+        case 11:
+            return helper_float_11;
+        default:
+            throw std::invalid_argument(
+                "FHT supports 2^6 to 2^11 dims, got 2^" + std::to_string(log_dim)
+            );
+    }
+}
+
+inline void check_rounds(size_t rounds, size_t max_rounds) {
+    if (rounds < 1 || rounds > max_rounds) {
+        throw std::invalid_argument(
+            "num of rotation rounds must be 1 to " + std::to_string(max_rounds)
+        );
+    }
+}
+
+/**
+ * @brief Rounds of random sign flips, FHT and Kac's walk. The FHT is over the largest
+ * power of 2 not greater than the padded dimension, alternately at the head and the tail
+ * of the vector, and Kac's walks mix the two. 4 rounds by default, fewer rounds rotate
+ * faster while mixing coordinates less. Rotators of 4 rounds are saved as flips only, as
+ * before the rounds were configurable, others save the rounds ahead of the flips.
+ */
 class FhtKacRotator : public Rotator<float> {
    private:
+    size_t rounds_ = kDefaultRounds;
     std::vector<uint8_t> flip_;
     std::function<void(float*)> fht_float_ = helper_float_6;
     size_t trunc_dim_ = 0;
     float fac_ = 0;
 
     static constexpr size_t kByteLen = 8;
+    static constexpr uint64_t kRoundsTag = 0x53444E554F524B46;  // before saved rounds
 
-   public:
-    explicit FhtKacRotator(size_t dim, size_t padded_dim)
-        : Rotator<float>(dim, padded_dim), flip_(4 * padded_dim / kByteLen) {
-        std::random_device rd;   // Seed
-        std::mt19937 gen(rd());  // Mersenne Twister RNG
+    [[nodiscard]] size_t flip_bytes() const { return rounds_ * padded_dim_ / kByteLen; }
+
+    [[nodiscard]] size_t header_bytes() const {
+        return rounds_ == kDefaultRounds ? 0 : sizeof(uint64_t) * 2;
+    }
 
-        // Uniform distribution in the range [0, 255]
-        std::uniform_int_distribution<int> dist(0, 255);
+    // set rounds by the header of saved data, whose first 8 bytes are in head
+    void load_header(uint64_t head, uint64_t rounds) {
+        if (head == kRoundsTag) {
+            if (rounds < 1 || rounds > kMaxRounds) {
+                throw std::runtime_error("invalid num of rounds of saved FhtKacRotator");
+            }
+            rounds_ = rounds;
+        } else {
+            rounds_ = kDefaultRounds;
+        }
+        flip_.resize(flip_bytes());
+    }
 
-        // Generate a single random uint8_t value
-        for (auto& i : flip_) {
-            i = static_cast<uint8_t>(dist(gen));
+    // scaling of the norm by a Kac's walk is sqrt(2)
+    [[nodiscard]] float walk_rescale() const {
+        float res = 1;
+        for (size_t i = 0; i < rounds_ / 2; ++i) {
+            res *= 0.5F;
         }
+        return rounds_ % 2 == 0 ? res : res / std::sqrt(2.0F);
+    }
+
+   public:
+    static constexpr size_t kDefaultRounds = 4;
+    static constexpr size_t kMaxRounds = 8;
+
+    explicit FhtKacRotator(
+        size_t dim,
+        size_t padded_dim,
+        size_t rounds = kDefaultRounds,
+        std::optional<unsigned> seed = std::nullopt
+    )
+        : Rotator<float>(dim, padded_dim), rounds_(rounds) {
+        check_rounds(rounds, kMaxRounds);
+        flip_ = random_flips(flip_bytes(), seed);
 
         // TODO(lib): is it portable?
         size_t bottom_log_dim = floor_log2(dim);
         trunc_dim_ = 1 << bottom_log_dim;
         fac_ = 1.0F / std::sqrt(static_cast<float>(trunc_dim_));
-
-        switch (bottom_log_dim) {
-            case 6:
-                this->fht_float_ = helper_float_6;
-                break;
-            case 7:
-                this->fht_float_ = helper_float_7;
-                break;
-            case 8:
-                this->fht_float_ = helper_float_8;
-                break;
-            case 9:
-                this->fht_float_ = helper_float_9;
-                break;
-            case 10:
-                this->fht_float_ = helper_float_10;
-                break;
-            case 11:
-                this->fht_float_ = helper_float_11;
-                break;
-            default:
-                // TODO(lib): should we do more?
-                std::cerr << "dimension of vector is too big\n";
-                exit(1);
-        }
+        this->fht_float_ = select_fht(bottom_log_dim);
     }
     FhtKacRotator() = default;
     ~FhtKacRotator() override = default;
 
-    void load(std::ifstream& input) override {
+    [[nodiscard]] size_t rounds() const { return rounds_; }
+
+    void load(std::istream& input) override {
+        uint64_t head[2] = {0, 0};
+        input.read(reinterpret_cast<char*>(head), sizeof(uint64_t));
+        if (head[0] == kRoundsTag) {
+            input.read(reinterpret_cast<char*>(&head[1]), sizeof(uint64_t));
+        }
+        load_header(head[0], head[1]);
+        // without the header, the first 8 bytes are flips
+        size_t offset = head[0] == kRoundsTag ? 0 : sizeof(uint64_t);
+        std::memcpy(flip_.data(), head, offset);
         input.read(
-            reinterpret_cast<char*>(flip_.data()),
-            static_cast<long>(sizeof(uint8_t) * flip_.size())
+            reinterpret_cast<char*>(flip_.data() + offset),
+            static_cast<long>(sizeof(uint8_t) * (flip_.size() - offset))
         );
     }
 
-    void save(std::ofstream& output) const override {
+    void save(std::ostream& output) const override {
+        if (rounds_ != kDefaultRounds) {
+            uint64_t head[2] = {kRoundsTag, rounds_};
+            output.write(reinterpret_cast<const char*>(head), sizeof(head));
+        }
         output.write(
             reinterpret_cast<const char*>(flip_.data()),
             static_cast<long>(sizeof(uint8_t) * flip_.size())
@@ -189,20 +446,32 @@ class FhtKacRotator : public Rotator<float> {
     }
 
     void load(const char *data) override {
-        std::memcpy(flip_.data(), data, sizeof(uint8_t) * flip_.size());
+        uint64_t head[2] = {0, 0};
+        std::memcpy(head, data, sizeof(uint64_t));
+        if (head[0] == kRoundsTag) {
+            std::memcpy(&head[1], data + sizeof(uint64_t), sizeof(uint64_t));
+        }
+        load_header(head[0], head[1]);
+        size_t offset = head[0] == kRoundsTag ? sizeof(head) : 0;
+        std::memcpy(flip_.data(), data + offset, sizeof(uint8_t) * flip_.size());
     }
 
     void save(char *data) const override {
-        std::memcpy(data, flip_.data(), sizeof(uint8_t) * flip_.size());
+        if (rounds_ != kDefaultRounds) {
+            uint64_t head[2] = {kRoundsTag, rounds_};
+            std::memcpy(data, head, sizeof(head));
+        }
+        std::memcpy(data + header_bytes(), flip_.data(), sizeof(uint8_t) * flip_.size());
     }
 
     size_t dump_bytes() const override {
-        return sizeof(uint8_t) * flip_.size();
+        return header_bytes() + (sizeof(uint8_t) * flip_.size());
     }
 
     FhtKacRotator& operator=(const FhtKacRotator& other) {
         this->dim_ = other.dim_;
         this->padded_dim_ = other.padded_dim_;
+        this->rounds_ = other.rounds_;
         this->flip_ = other.flip_;
         this->fht_float_ = other.fht_float_;
         this->trunc_dim_ = other.trunc_dim_;
@@ -219,63 +488,210 @@ class FhtKacRotator : public Rotator<float> {
         std::fill(rotated_vec + dim_, rotated_vec + padded_dim_, 0);
 
         if (trunc_dim_ == padded_dim_) {
-            flip_sign(flip_.data(), rotated_vec, padded_dim_);
-            fht_float_(rotated_vec);
-            vec_rescale(rotated_vec, trunc_dim_, fac_);
+            for (size_t i = 0; i < rounds_; ++i) {
+                flip_sign(
+                    flip_.data() + (i * padded_dim_ / kByteLen), rotated_vec, padded_dim_
+                );
+                fht_float_(rotated_vec);
+                vec_rescale(rotated_vec, trunc_dim_, fac_);
+            }
+            return;
+        }
 
-            flip_sign(flip_.data() + (padded_dim_ / kByteLen), rotated_vec, padded_dim_);
-            fht_float_(rotated_vec);
-            vec_rescale(rotated_vec, trunc_dim_, fac_);
+        size_t start = padded_dim_ - trunc_dim_;
 
+        for (size_t i = 0; i < rounds_; ++i) {
             flip_sign(
-                flip_.data() + (2 * padded_dim_ / kByteLen), rotated_vec, padded_dim_
+                flip_.data() + (i * padded_dim_ / kByteLen), rotated_vec, padded_dim_
             );
-            fht_float_(rotated_vec);
-            vec_rescale(rotated_vec, trunc_dim_, fac_);
+            float* fht_data = (i % 2 == 0) ? rotated_vec : rotated_vec + start;
+            fht_float_(fht_data);
+            vec_rescale(fht_data, trunc_dim_, fac_);
+            kacs_walk(rotated_vec, padded_dim_);
+        }
 
-            flip_sign(
-                flip_.data() + (3 * padded_dim_ / kByteLen), rotated_vec, padded_dim_
-            );
-            fht_float_(rotated_vec);
-            vec_rescale(rotated_vec, trunc_dim_, fac_);
+        // This can be removed if we don't care about the absolute value of
+        // similarities.
+        vec_rescale(rotated_vec, padded_dim_, walk_rescale());
+    }
+
+    // Each step of rotate() is inverted in reverse order. Flipping signs and the
+    // normalized FHT are involutions, while the inverse of a Kac's walk is itself followed
+    // by a rescaling of 0.5, these rescalings cancel the final rescaling above in total.
+    void inverse_rotate(const float* rotated_vec, float* vec) const override {
+        std::vector<float> tmp(rotated_vec, rotated_vec + padded_dim_);
+        float* data = tmp.data();
 
+        if (trunc_dim_ == padded_dim_) {
+            for (size_t i = rounds_; i-- > 0;) {
+                fht_float_(data);
+                vec_rescale(data, trunc_dim_, fac_);
+                flip_sign(flip_.data() + (i * padded_dim_ / kByteLen), data, padded_dim_);
+            }
+            std::memcpy(vec, data, sizeof(float) * dim_);
             return;
         }
 
         size_t start = padded_dim_ - trunc_dim_;
 
-        flip_sign(flip_.data(), rotated_vec, padded_dim_);
-        fht_float_(rotated_vec);
-        vec_rescale(rotated_vec, trunc_dim_, fac_);
-        kacs_walk(rotated_vec, padded_dim_);
+        for (size_t i = rounds_; i-- > 0;) {
+            kacs_walk(data, padded_dim_);
+            float* fht_data = (i % 2 == 0) ? data : data + start;
+            fht_float_(fht_data);
+            vec_rescale(fht_data, trunc_dim_, fac_);
+            flip_sign(flip_.data() + (i * padded_dim_ / kByteLen), data, padded_dim_);
+        }
+
+        vec_rescale(data, padded_dim_, walk_rescale());
+        std::memcpy(vec, data, sizeof(float) * dim_);
+    }
+};
 
-        flip_sign(flip_.data() + (padded_dim_ / kByteLen), rotated_vec, padded_dim_);
-        fht_float_(rotated_vec + start);
-        vec_rescale(rotated_vec + start, trunc_dim_, fac_);
-        kacs_walk(rotated_vec, padded_dim_);
+/**
+ * @brief Structured orthogonal random features (SORF), i.e., rounds of random sign flips
+ * and FHT over the whole padded dimension, which is a power of 2. A round is one flip and
+ * one FHT without the Kac's walks of FhtKacRotator, and the normalization of all rounds
+ * is merged into one rescaling. Dimensions that are not powers of 2 are padded further
+ * (e.g., 1536 to 2048), which also enlarges the codes. 3 rounds by default. The rounds
+ * are saved ahead of the flips. The FHT covers at most kMaxDim dims, thus larger
+ * dimensions throw std::invalid_argument.
+ */
+class SorfRotator : public Rotator<float> {
+   private:
+    size_t rounds_ = kDefaultRounds;
+    std::vector<uint8_t> flip_;
+    std::function<void(float*)> fht_float_ = helper_float_6;
+    float fac_ = 0;  // normalization of all rounds
 
-        flip_sign(flip_.data() + (2 * padded_dim_ / kByteLen), rotated_vec, padded_dim_);
-        fht_float_(rotated_vec);
-        vec_rescale(rotated_vec, trunc_dim_, fac_);
-        kacs_walk(rotated_vec, padded_dim_);
+    static constexpr size_t kByteLen = 8;
 
-        flip_sign(flip_.data() + (3 * padded_dim_ / kByteLen), rotated_vec, padded_dim_);
-        fht_float_(rotated_vec + start);
-        vec_rescale(rotated_vec + start, trunc_dim_, fac_);
-        kacs_walk(rotated_vec, padded_dim_);
+    [[nodiscard]] size_t flip_bytes() const { return rounds_ * padded_dim_ / kByteLen; }
 
-        // This can be removed if we don't care about the absolute value of
-        // similarities.
-        vec_rescale(rotated_vec, padded_dim_, 0.25F);
+    void set_rounds(uint64_t rounds) {
+        if (rounds < 1 || rounds > kMaxRounds) {
+            throw std::runtime_error("invalid num of rounds of saved SorfRotator");
+        }
+        rounds_ = rounds;
+        flip_.resize(flip_bytes());
+        fac_ =
+            std::pow(static_cast<float>(padded_dim_), -0.5F * static_cast<float>(rounds_));
+    }
+
+   public:
+    static constexpr size_t kDefaultRounds = 3;
+    static constexpr size_t kMaxRounds = 8;
+    static constexpr size_t kMaxDim = 2048;
+
+    explicit SorfRotator(
+        size_t dim,
+        size_t padded_dim,
+        size_t rounds = kDefaultRounds,
+        std::optional<unsigned> seed = std::nullopt
+    )
+        : Rotator<float>(dim, padded_dim) {
+        if (padded_dim > kMaxDim) {
+            throw std::invalid_argument(
+                "SorfRotator supports at most " + std::to_string(kMaxDim) +
+                " padded dims, got " + std::to_string(padded_dim)
+            );
+        }
+        check_rounds(rounds, kMaxRounds);
+        set_rounds(rounds);
+        flip_ = random_flips(flip_bytes(), seed);
+        fht_float_ = select_fht(floor_log2(padded_dim));
+    }
+    SorfRotator() = default;
+    ~SorfRotator() override = default;
+
+    [[nodiscard]] size_t rounds() const { return rounds_; }
+
+    void load(std::istream& input) override {
+        uint64_t rounds = 0;
+        input.read(reinterpret_cast<char*>(&rounds), sizeof(uint64_t));
+        set_rounds(rounds);
+        input.read(
+            reinterpret_cast<char*>(flip_.data()),
+            static_cast<long>(sizeof(uint8_t) * flip_.size())
+        );
+    }
+
+    void save(std::ostream& output) const override {
+        uint64_t rounds = rounds_;
+        output.write(reinterpret_cast<const char*>(&rounds), sizeof(uint64_t));
+        output.write(
+            reinterpret_cast<const char*>(flip_.data()),
+            static_cast<long>(sizeof(uint8_t) * flip_.size())
+        );
+    }
+
+    void load(const char* data) override {
+        uint64_t rounds = 0;
+        std::memcpy(&rounds, data, sizeof(uint64_t));
+        set_rounds(rounds);
+        std::memcpy(flip_.data(), data + sizeof(uint64_t), sizeof(uint8_t) * flip_.size());
+    }
+
+    void save(char* data) const override {
+        uint64_t rounds = rounds_;
+        std::memcpy(data, &rounds, sizeof(uint64_t));
+        std::memcpy(data + sizeof(uint64_t), flip_.data(), sizeof(uint8_t) * flip_.size());
+    }
+
+    size_t dump_bytes() const override {
+        return sizeof(uint64_t) + (sizeof(uint8_t) * flip_.size());
+    }
+
+    void rotate(const float* data, float* rotated_vec) const override {
+        std::memcpy(rotated_vec, data, sizeof(float) * dim_);
+        std::fill(rotated_vec + dim_, rotated_vec + padded_dim_, 0);
+        for (size_t i = 0; i < rounds_; ++i) {
+            flip_sign(
+                flip_.data() + (i * padded_dim_ / kByteLen), rotated_vec, padded_dim_
+            );
+            fht_float_(rotated_vec);
+        }
+        vec_rescale(rotated_vec, padded_dim_, fac_);
+    }
+
+    // the inverse of a flip and an unnormalized FHT is the FHT followed by the flip and a
+    // rescaling of 1 / padded_dim, these rescalings equal fac_ in total with the forward
+    // normalization
+    void inverse_rotate(const float* rotated_vec, float* vec) const override {
+        std::vector<float> tmp(rotated_vec, rotated_vec + padded_dim_);
+        float* data = tmp.data();
+        for (size_t i = rounds_; i-- > 0;) {
+            fht_float_(data);
+            flip_sign(flip_.data() + (i * padded_dim_ / kByteLen), data, padded_dim_);
+        }
+        vec_rescale(data, padded_dim_, fac_);
+        std::memcpy(vec, data, sizeof(float) * dim_);
     }
 };
 }  // namespace rotator_impl
 
-// for given dim & type, set rotator, return padded dimension
+// padded dimension of codes in indices, a multiple of 64 which suits the rotator
+inline size_t index_padded_dim(size_t dim, RotatorType type) {
+    return rotator_impl::padding_requirement(round_up_to_multiple(dim, 64), type);
+}
+
+// for given dim & type, set rotator, return padded dimension. rounds is for FhtKacRotator
+// and SorfRotator, 0 for their defaults. seed fixes the random rotation, a random device
+// seeds it if no seed is given
 template <typename T>
 Rotator<T>* choose_rotator(
-    size_t dim, RotatorType type = RotatorType::FhtKacRotator, size_t padded_dim = 0
+    size_t dim,
+    RotatorType type = RotatorType::FhtKacRotator,
+    size_t padded_dim = 0,
+    size_t rounds = 0,
+    std::optional<unsigned> seed = std::nullopt
 ) {
+    if (type == RotatorType::SorfRotator && dim > rotator_impl::SorfRotator::kMaxDim) {
+        throw std::invalid_argument(
+            "SorfRotator supports at most " +
+            std::to_string(rotator_impl::SorfRotator::kMaxDim) + " dims, got " +
+            std::to_string(dim)
+        );
+    }
     if (padded_dim == 0) {
         padded_dim = rotator_impl::padding_requirement(dim, type);
         if (padded_dim != dim) {
@@ -297,12 +713,36 @@ Rotator<T>* choose_rotator(
             exit(1);
         }
         std::cerr << "FhtKacRotator is selected\n";
-        return ::new rotator_impl::FhtKacRotator(dim, padded_dim);
+        return ::new rotator_impl::FhtKacRotator(
+            dim,
+            padded_dim,
+            rounds == 0 ? rotator_impl::FhtKacRotator::kDefaultRounds : rounds,
+            seed
+        );
+    }
+
+    if (type == RotatorType::SorfRotator) {
+        if (!std::is_same_v<T, float>) {
+            std::cerr << "SorfRotator is only for float type currently\n";
+            exit(1);
+        }
+        std::cerr << "SorfRotator is selected\n";
+        return ::new rotator_impl::SorfRotator(
+            dim,
+            padded_dim,
+            rounds == 0 ? rotator_impl::SorfRotator::kDefaultRounds : rounds,
+            seed
+        );
     }
 
     if (type == RotatorType::MatrixRotator) {
         std::cerr << "MatrixRotator is selected\n";
-        return ::new rotator_impl::MatrixRotator<T>(dim, padded_dim);
+        return ::new rotator_impl::MatrixRotator<T>(dim, padded_dim, seed);
+    }
+
+    if (type == RotatorType::LearnedRotator) {
+        std::cerr << "LearnedRotator is selected\n";
+        return ::new rotator_impl::LearnedRotator<T>(dim, padded_dim, true, seed);
     }
 
     std::cerr << "Invaid rotator type in choose_rotator()\n";
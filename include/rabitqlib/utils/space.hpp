@@ -135,6 +135,19 @@ inline void pack_binary(
     }
 }
 
+// unpack compact code of pack_binary() to 0/1 data
+template <typename T, typename TD>
+inline void unpack_binary(
+    const T* __restrict__ compact_code, TD* __restrict__ binary_code, size_t length
+) {
+    constexpr size_t kTypeBits = sizeof(T) * 8;
+
+    for (size_t i = 0; i < length; ++i) {
+        T cur = compact_code[i / kTypeBits] >> (kTypeBits - 1 - (i % kTypeBits));
+        binary_code[i] = static_cast<TD>(cur & 1);
+    }
+}
+
 template <typename T>
 inline void data_range(const T* __restrict__ vec0, size_t dim, T& lo, T& hi) {
     ConstRowMajorArrayMap<T> v0(vec0, 1, dim);
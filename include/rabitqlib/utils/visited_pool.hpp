@@ -1,24 +1,164 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "rabitqlib/utils/hashset.hpp"
 
 namespace rabitqlib {
+/**
+ * @brief Pool of visited lists for graph search.
+ *
+ * Each thread keeps one visited list per pool in a thread-local cache, thus the lists are
+ * got and released without any lock. A list is taken from the shared pool (guarded by a
+ * mutex) only when a thread first searches the pool, or when it needs more than one list
+ * at the same time. Pools are tagged by unique epochs, so that caches of destroyed pools
+ * are never used even if a new pool takes the same address. Cached lists are returned to
+ * their pools when threads exit, and all lists are owned and freed by the pool.
+ *
+ * Lists are sized lazily: their tables are allocated when they are first got, and are
+ * resized on their next get after set_max_elements().
+ */
 class VisitedListPool {
     std::deque<HashBasedBooleanSet*> pool_;
+    std::vector<std::unique_ptr<HashBasedBooleanSet>> lists_;  // all lists of this pool
     std::mutex poolguard_;
-    size_t numelements_;
+    std::atomic<size_t> numelements_;
+    uint64_t epoch_;
+
+    struct CacheEntry {
+        uint64_t epoch;
+        HashBasedBooleanSet* list;
+        bool in_use;
+    };
+
+    // live pools by epochs, used to return cached lists of evicted entries or exited
+    // threads
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, VisitedListPool*> pools;
+        std::atomic<uint64_t> next_epoch{0};
+    };
+
+    static Registry& registry() {
+        static Registry* reg = new Registry();  // never destroyed, used by thread exits
+        return *reg;
+    }
+
+    static void return_to_pool(const CacheEntry& entry) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        auto iter = reg.pools.find(entry.epoch);
+        if (iter != reg.pools.end()) {
+            iter->second->release_shared_vis_list(entry.list);
+        }
+    }
+
+    struct ThreadCache {
+        static constexpr size_t kMaxEntries = 8;  // max num of pools cached by a thread
+        std::vector<CacheEntry> entries;
+
+        ThreadCache() = default;
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+
+        ~ThreadCache() {
+            for (const auto& entry : entries) {
+                return_to_pool(entry);
+            }
+        }
+    };
+
+    static ThreadCache& thread_cache() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    // lists are created empty and sized by prepare() when they are got
+    HashBasedBooleanSet* new_vislist() {
+        lists_.emplace_back(std::make_unique<HashBasedBooleanSet>());
+        return lists_.back().get();
+    }
+
+    // size a list for the current max_elements, or clear it if it is already sized
+    void prepare(HashBasedBooleanSet* vl) const {
+        size_t table_size = HashBasedBooleanSet::table_size_for(
+            numelements_.load(std::memory_order_relaxed)
+        );
+        if (vl->table_size() != table_size) {
+            vl->initialize(table_size);
+        } else {
+            vl->clear();
+        }
+    }
 
    public:
-    VisitedListPool(size_t initpoolsize, size_t max_elements) {
-        numelements_ = max_elements / 10;
+    VisitedListPool(size_t initpoolsize, size_t max_elements)
+        : numelements_(max_elements / 10), epoch_(++registry().next_epoch) {
         for (size_t i = 0; i < initpoolsize; i++) {
-            pool_.push_front(new HashBasedBooleanSet(numelements_));
+            pool_.push_front(new_vislist());
         }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.pools.emplace(epoch_, this);
     }
 
+    VisitedListPool(const VisitedListPool&) = delete;
+    VisitedListPool& operator=(const VisitedListPool&) = delete;
+
+    /**
+     * @brief Get a cleared visited list, from the thread-local cache if possible
+     */
     HashBasedBooleanSet* get_free_vislist() {
+        auto& entries = thread_cache().entries;
+        for (auto& entry : entries) {
+            if (entry.epoch == epoch_) {
+                if (entry.in_use) {
+                    return get_shared_vislist();
+                }
+                entry.in_use = true;
+                prepare(entry.list);
+                return entry.list;
+            }
+        }
+
+        // first search of this thread, evict the oldest entry which is not in use, the list
+        // is not cached if all entries are in use by outer searches
+        HashBasedBooleanSet* rez = get_shared_vislist();
+        if (entries.size() >= ThreadCache::kMaxEntries) {
+            auto victim = std::find_if(entries.begin(), entries.end(), [](const auto& entry) {
+                return !entry.in_use;
+            });
+            if (victim == entries.end()) {
+                return rez;
+            }
+            return_to_pool(*victim);
+            entries.erase(victim);
+        }
+        entries.push_back({epoch_, rez, true});
+        return rez;
+    }
+
+    void release_vis_list(HashBasedBooleanSet* vl) {
+        for (auto& entry : thread_cache().entries) {
+            if (entry.epoch == epoch_ && entry.list == vl) {
+                entry.in_use = false;
+                return;
+            }
+        }
+        release_shared_vis_list(vl);
+    }
+
+    /**
+     * @brief Get a cleared visited list from the shared pool, bypassing the thread-local
+     * cache
+     */
+    HashBasedBooleanSet* get_shared_vislist() {
         HashBasedBooleanSet* rez;
         {
             std::unique_lock<std::mutex> lock(poolguard_);
@@ -26,24 +166,41 @@ class VisitedListPool {
                 rez = pool_.front();
                 pool_.pop_front();
             } else {
-                rez = new HashBasedBooleanSet(numelements_);
+                rez = new_vislist();
             }
         }
-        rez->clear();
+        prepare(rez);
         return rez;
     }
 
-    void release_vis_list(HashBasedBooleanSet* vl) {
+    void release_shared_vis_list(HashBasedBooleanSet* vl) {
         std::unique_lock<std::mutex> lock(poolguard_);
         pool_.push_front(vl);
     }
 
+    /**
+     * @brief Set the max num of elements of searches, lists are resized on their next get
+     */
+    void set_max_elements(size_t max_elements) {
+        numelements_.store(max_elements / 10, std::memory_order_relaxed);
+    }
+
+    // num of lists in the shared pool
+    [[nodiscard]] size_t num_free() {
+        std::unique_lock<std::mutex> lock(poolguard_);
+        return pool_.size();
+    }
+
+    // num of lists created by this pool
+    [[nodiscard]] size_t num_lists() {
+        std::unique_lock<std::mutex> lock(poolguard_);
+        return lists_.size();
+    }
+
     ~VisitedListPool() {
-        while (pool_.size() > 0) {
-            HashBasedBooleanSet* rez = pool_.front();
-            pool_.pop_front();
-            ::delete rez;
-        }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.pools.erase(epoch_);
     }
 };
-}  // namespace rabitqlib
\ No newline at end of file
+}  // namespace rabitqlib
@@ -3,8 +3,10 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
@@ -37,7 +39,15 @@ inline rabitqlib::RotatorType rotator_from_string(const std::string& method) {
     if (method == "fht_kac" || method == "fht") {
         return rabitqlib::RotatorType::FhtKacRotator;
     }
-    throw std::invalid_argument("Unsupported rotator method. Use 'fht_kac' or 'matrix'.");
+    if (method == "learned") {
+        return rabitqlib::RotatorType::LearnedRotator;
+    }
+    if (method == "sorf") {
+        return rabitqlib::RotatorType::SorfRotator;
+    }
+    throw std::invalid_argument(
+        "Unsupported rotator method. Use 'fht_kac', 'matrix', 'learned' or 'sorf'."
+    );
 }
 
 template <typename T>
@@ -70,4 +80,114 @@ inline py::array_t<T, py::array::c_style | py::array::forcecast> ensure_1d_array
     return array;
 }
 
+/**
+ * @brief Buffer of a 2D C-contiguous float32 matrix, e.g., np.ndarray or np.memmap of
+ * float32, whose data can be used in place without copy. std::nullopt for other objects.
+ */
+inline std::optional<py::buffer_info> float_matrix_buffer(py::handle value) {
+    if (!py::isinstance<py::buffer>(value)) {
+        return std::nullopt;
+    }
+    py::buffer_info info = py::reinterpret_borrow<py::buffer>(value).request();
+    if (info.ndim != 2 || !info.item_type_is_equivalent_to<float>() ||
+        info.strides[1] != static_cast<ssize_t>(sizeof(float)) ||
+        info.strides[0] != info.shape[1] * static_cast<ssize_t>(sizeof(float))) {
+        return std::nullopt;
+    }
+    return info;
+}
+
+/**
+ * @brief Read data rows chunk by chunk, from an iterable of 2D arrays (e.g., a generator of
+ * slices), or from a 2D array which is not C-contiguous float32 (converted by slices of
+ * kSliceRows rows). Only the current chunk is kept, thus the data is never copied as a
+ * whole. next() acquires the GIL itself, so it can be used as a ChunkFunc while the GIL is
+ * released. The reader must be destroyed with the GIL held.
+ */
+class ChunkReader {
+   public:
+    static constexpr size_t kSliceRows = 1 << 16;
+
+    ChunkReader(py::handle data, size_t dim, const char* name) : dim_(dim), name_(name) {
+        if (py::isinstance<py::buffer>(data)) {
+            array_ = py::module_::import("numpy").attr("asarray")(data);
+            if (array_.attr("ndim").cast<size_t>() != 2) {
+                throw std::invalid_argument(name_ + " must be a 2D array");
+            }
+            num_rows_ = py::tuple(array_.attr("shape"))[0].cast<size_t>();
+        } else if (py::hasattr(data, "__iter__")) {
+            iter_ = py::iter(data);
+        } else {
+            throw std::invalid_argument(
+                name_ + " must be a 2D array or an iterable of 2D arrays"
+            );
+        }
+    }
+
+    // the next chunk, see rabitqlib::ChunkFunc
+    size_t next(const float*& rows) {
+        py::gil_scoped_acquire gil;
+        while (true) {
+            py::object chunk;
+            if (array_) {
+                if (pos_ >= num_rows_) {
+                    return 0;
+                }
+                size_t end = std::min(pos_ + kSliceRows, num_rows_);
+                chunk = array_[py::slice(
+                    static_cast<ssize_t>(pos_), static_cast<ssize_t>(end), 1
+                )];
+                pos_ = end;
+            } else {
+                chunk = py::reinterpret_steal<py::object>(PyIter_Next(iter_.ptr()));
+                if (!chunk) {
+                    if (PyErr_Occurred() != nullptr) {
+                        throw py::error_already_set();
+                    }
+                    return 0;
+                }
+            }
+
+            chunk_ = ensure_2d_array<float>(chunk, name_.c_str());
+            if (static_cast<size_t>(chunk_.shape(1)) != dim_) {
+                throw std::invalid_argument(name_ + " dimension does not match index dim");
+            }
+            if (chunk_.shape(0) > 0) {  // skip empty chunks
+                rows = chunk_.data();
+                return static_cast<size_t>(chunk_.shape(0));
+            }
+        }
+    }
+
+    // read all rows into one buffer, for indices which need all vectors at the same time
+    [[nodiscard]] std::vector<float> read_all() {
+        std::vector<float> data;
+        const float* rows = nullptr;
+        while (size_t num = next(rows)) {
+            data.insert(data.end(), rows, rows + (num * dim_));
+        }
+        return data;
+    }
+
+   private:
+    size_t dim_;
+    std::string name_;
+    py::object array_;  // for 2D arrays
+    size_t num_rows_ = 0;
+    size_t pos_ = 0;
+    py::object iter_;   // for iterables
+    py::array_t<float, py::array::c_style | py::array::forcecast> chunk_;
+};
+
+// ProgressFunc calling a Python callable(done, total) with the GIL, empty for None
+inline rabitqlib::ProgressFunc progress_callback(const py::object& callback) {
+    if (callback.is_none()) {
+        return {};
+    }
+    return [callback](size_t done, size_t total) {
+        py::gil_scoped_acquire gil;
+        callback(done, total);
+    };
+}
+
 }  // namespace rabitqlib::python_bindings
\ No newline at end of file
@@ -41,24 +41,45 @@ class HnswIndex {
               metric_
           )) {}
 
+    /**
+     * data is a 2D array (np.ndarray, np.memmap or any object exposing the buffer
+     * protocol) or an iterable of 2D arrays of consecutive rows. C-contiguous float32
+     * arrays are used in place. Since edges are built with the raw vectors of all points,
+     * other inputs are read chunk by chunk into one float32 buffer. progress(done, total) is
+     * called with the num of inserted points.
+     */
     void build(
         py::handle data,
         py::handle centroids,
         py::handle cluster_ids,
         size_t num_threads = 1,
-        bool fast_quantization = false
+        bool fast_quantization = false,
+        const py::object& progress = py::none()
     ) {
-        auto data_array = ensure_2d_array<float>(data, "data");
         auto centroids_array = ensure_2d_array<float>(centroids, "centroids");
         auto cluster_ids_array = ensure_1d_array<rabitqlib::PID>(cluster_ids, "cluster_ids");
 
-        if (static_cast<size_t>(data_array.shape(1)) != dim_) {
-            throw std::invalid_argument("data dimension does not match index dim");
-        }
         if (static_cast<size_t>(centroids_array.shape(1)) != dim_) {
             throw std::invalid_argument("centroid dimension does not match index dim");
         }
-        if (static_cast<size_t>(cluster_ids_array.shape(0)) != static_cast<size_t>(data_array.shape(0))) {
+
+        std::vector<float> gathered;
+        const float* data_ptr = nullptr;
+        size_t num_rows = 0;
+        auto buffer = float_matrix_buffer(data);
+        if (buffer) {
+            if (static_cast<size_t>(buffer->shape[1]) != dim_) {
+                throw std::invalid_argument("data dimension does not match index dim");
+            }
+            data_ptr = static_cast<const float*>(buffer->ptr);
+            num_rows = static_cast<size_t>(buffer->shape[0]);
+        } else {
+            ChunkReader reader(data, dim_, "data");
+            gathered = reader.read_all();
+            data_ptr = gathered.data();
+            num_rows = gathered.size() / dim_;
+        }
+        if (static_cast<size_t>(cluster_ids_array.shape(0)) != num_rows) {
             throw std::invalid_argument("cluster_ids length must match number of rows in data");
         }
 
@@ -69,15 +90,20 @@ class HnswIndex {
         std::vector<rabitqlib::PID> cluster_ids_vec(static_cast<size_t>(cluster_ids_array.shape(0)));
         std::memcpy(cluster_ids_vec.data(), cluster_ids_array.data(), cluster_ids_vec.size() * sizeof(rabitqlib::PID));
 
-        index_->construct(
-            num_clusters,
-            centroids_array.data(),
-            static_cast<size_t>(data_array.shape(0)),
-            data_array.data(),
-            cluster_ids_vec.data(),
-            num_threads,
-            fast_quantization
-        );
+        rabitqlib::ProgressFunc on_progress = progress_callback(progress);
+        {
+            py::gil_scoped_release release;
+            index_->construct(
+                num_clusters,
+                centroids_array.data(),
+                num_rows,
+                data_ptr,
+                cluster_ids_vec.data(),
+                num_threads,
+                fast_quantization,
+                on_progress
+            );
+        }
         built_ = true;
     }
 
@@ -118,11 +144,15 @@ class HnswIndex {
         return py::make_tuple(ids, dists);
     }
 
-    void save(const std::string& path) const {
+    void save(const std::string& path, bool compress) const {
         if (!built_) {
             throw std::runtime_error("HnswIndex must be built or loaded before save");
         }
-        index_->save(path.c_str());
+        if (compress) {
+            index_->save_compressed(path.c_str());
+        } else {
+            index_->save(path.c_str());
+        }
     }
 
     static HnswIndex load(const std::string& path) {
@@ -182,13 +212,14 @@ void register_hnsw(py::module_ &m) {
              py::arg("centroids"),
              py::arg("cluster_ids"),
              py::arg("num_threads") = 1,
-             py::arg("fast_quantization") = false)
+             py::arg("fast_quantization") = false,
+             py::arg("progress") = py::none())
         .def("search", &HnswIndex::search,
              py::arg("queries"),
              py::arg("k"),
              py::arg("ef") = 0,
              py::arg("num_threads") = 1)
-        .def("save", &HnswIndex::save, py::arg("path"))
+        .def("save", &HnswIndex::save, py::arg("path"), py::arg("compress") = false)
         .def_static("load", &HnswIndex::load, py::arg("path"))
         .def_property_readonly("dim", &HnswIndex::dim)
         .def_property_readonly("max_elements", &HnswIndex::max_elements)
@@ -35,28 +35,59 @@ class IvfIndex {
               rabitqlib::RotatorType::FhtKacRotator
           )) {}
 
+    /**
+     * data is a 2D array (np.ndarray, np.memmap or any object exposing the buffer
+     * protocol) or an iterable of 2D arrays of consecutive rows. C-contiguous float32
+     * arrays are used in place, others are read chunk by chunk, thus the data is never
+     * copied as a whole. progress(done, total) is called with the num of built vectors.
+     */
     void build(
         py::handle data,
         py::handle centroids,
         py::handle cluster_ids,
         size_t num_threads = 1,
-        bool fast_quantization = false
+        bool fast_quantization = false,
+        const py::object& progress = py::none()
     ) {
-        auto data_array = ensure_2d_array<float>(data, "data");
         auto centroids_array = ensure_2d_array<float>(centroids, "centroids");
         auto cluster_ids_array = ensure_1d_array<rabitqlib::PID>(cluster_ids, "cluster_ids");
 
-        if (static_cast<size_t>(data_array.shape(1)) != dim_) {
-            throw std::invalid_argument("data dimension does not match index dim");
-        }
         if (static_cast<size_t>(centroids_array.shape(1)) != dim_) {
             throw std::invalid_argument("centroid dimension does not match index dim");
         }
-        if (static_cast<size_t>(cluster_ids_array.shape(0)) != static_cast<size_t>(data_array.shape(0))) {
-            throw std::invalid_argument("cluster_ids length must match number of rows in data");
+        if (static_cast<size_t>(cluster_ids_array.shape(0)) != max_elements_) {
+            throw std::invalid_argument("cluster_ids length must match max_elements");
         }
 
-        index_->construct(data_array.data(), centroids_array.data(), cluster_ids_array.data(), fast_quantization, num_threads);
+        rabitqlib::ProgressFunc on_progress = progress_callback(progress);
+        if (auto buffer = float_matrix_buffer(data)) {
+            if (static_cast<size_t>(buffer->shape[1]) != dim_) {
+                throw std::invalid_argument("data dimension does not match index dim");
+            }
+            if (static_cast<size_t>(buffer->shape[0]) != max_elements_) {
+                throw std::invalid_argument("cluster_ids length must match number of rows in data");
+            }
+            py::gil_scoped_release release;
+            index_->construct(
+                static_cast<const float*>(buffer->ptr),
+                centroids_array.data(),
+                cluster_ids_array.data(),
+                fast_quantization,
+                num_threads,
+                on_progress
+            );
+        } else {
+            ChunkReader reader(data, dim_, "data");
+            py::gil_scoped_release release;
+            index_->construct_chunked(
+                centroids_array.data(),
+                cluster_ids_array.data(),
+                [&reader](const float*& rows) { return reader.next(rows); },
+                fast_quantization,
+                num_threads,
+                on_progress
+            );
+        }
         built_ = true;
     }
 
@@ -106,11 +137,64 @@ class IvfIndex {
         return py::make_tuple(ids, dists);
     }
 
-    void save(const std::string& path) const {
+    py::list search_grouped(
+        py::handle query,
+        size_t num_groups,
+        size_t group_size,
+        size_t nprobe,
+        py::handle group_keys,
+        bool high_accuracy = true
+    ) const {
+        auto query_array = ensure_1d_array<float>(query, "query");
+        auto keys_array = ensure_1d_array<rabitqlib::PID>(group_keys, "group_keys");
+        if (static_cast<size_t>(query_array.shape(0)) != dim_) {
+            throw std::invalid_argument("query dimension does not match index dim");
+        }
+        if (static_cast<size_t>(keys_array.shape(0)) != max_elements_) {
+            throw std::invalid_argument("group_keys length must match max_elements");
+        }
+
+        auto groups = index_->search_grouped(
+            query_array.data(), num_groups, group_size, nprobe, keys_array.data(), high_accuracy
+        );
+
+        py::list results;
+        for (const auto& group : groups) {
+            auto ids = py::array_t<rabitqlib::PID>(static_cast<ssize_t>(group.hits.size()));
+            auto dists = py::array_t<float>(static_cast<ssize_t>(group.hits.size()));
+            auto ids_buf = ids.mutable_unchecked<1>();
+            auto dists_buf = dists.mutable_unchecked<1>();
+            for (size_t j = 0; j < group.hits.size(); ++j) {
+                ids_buf(static_cast<ssize_t>(j)) = group.hits[j].id;
+                dists_buf(static_cast<ssize_t>(j)) = group.hits[j].distance;
+            }
+            results.append(py::make_tuple(group.key, ids, dists));
+        }
+        return results;
+    }
+
+    py::array_t<float> reconstruct(py::handle ids, size_t num_threads = 1) const {
+        if (!built_) {
+            throw std::runtime_error("IvfIndex must be built or loaded before reconstruct");
+        }
+        auto ids_array = ensure_1d_array<rabitqlib::PID>(ids, "ids");
+        const size_t num = static_cast<size_t>(ids_array.shape(0));
+        auto vecs = py::array_t<float>(
+            std::vector<ssize_t>{static_cast<ssize_t>(num), static_cast<ssize_t>(dim_)}
+        );
+        index_->reconstruct_batch(ids_array.data(), num, vecs.mutable_data(), num_threads);
+        return vecs;
+    }
+
+    void save(const std::string& path, bool compress) const {
         if (!built_) {
             throw std::runtime_error("IvfIndex must be built or loaded before save");
         }
-        index_->save(path.c_str());
+        if (compress) {
+            index_->save_compressed(path.c_str());
+        } else {
+            index_->save(path.c_str());
+        }
     }
 
     static IvfIndex load(const std::string& path) {
@@ -163,14 +247,25 @@ void register_ivf(py::module_ &m) {
            py::arg("centroids"),
            py::arg("cluster_ids"),
            py::arg("num_threads") = 1,
-           py::arg("fast_quantization") = false)
+           py::arg("fast_quantization") = false,
+           py::arg("progress") = py::none())
        .def("search", &IvfIndex::search,
            py::arg("queries"),
            py::arg("k"),
            py::arg("nprobe"),
            py::arg("high_accuracy") = true,
            py::arg("num_threads") = 1)
-       .def("save", &IvfIndex::save, py::arg("path"))
+       .def("search_grouped", &IvfIndex::search_grouped,
+           py::arg("query"),
+           py::arg("num_groups"),
+           py::arg("group_size"),
+           py::arg("nprobe"),
+           py::arg("group_keys"),
+           py::arg("high_accuracy") = true)
+       .def("reconstruct", &IvfIndex::reconstruct,
+           py::arg("ids"),
+           py::arg("num_threads") = 1)
+       .def("save", &IvfIndex::save, py::arg("path"), py::arg("compress") = false)
        .def_static("load", &IvfIndex::load, py::arg("path"))
        .def_property_readonly("dim", &IvfIndex::dim)
        .def_property_readonly("max_elements", &IvfIndex::max_elements)
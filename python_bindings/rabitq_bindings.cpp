@@ -22,6 +22,8 @@ PYBIND11_MODULE(_rabitqlib, m) {
     py::enum_<rabitqlib::RotatorType>(m, "RotatorType")
         .value("FhtKacRotator", rabitqlib::RotatorType::FhtKacRotator)
         .value("MatrixRotator", rabitqlib::RotatorType::MatrixRotator)
+        .value("LearnedRotator", rabitqlib::RotatorType::LearnedRotator)
+        .value("SorfRotator", rabitqlib::RotatorType::SorfRotator)
         .export_values();
 
     // Register each index's bindings into the same module
@@ -21,19 +21,46 @@ class SymqgIndex {
         , max_degree_(max_degree)
         , metric_(metric_from_string(metric)) {}
 
-    void build(py::handle data, size_t ef_construction, size_t num_threads = 1) {
-        auto data_array = ensure_2d_array<float>(data, "data");
-        if (static_cast<size_t>(data_array.shape(1)) != dim_) {
-            throw std::invalid_argument("data dimension does not match index dim");
+    /**
+     * data is a 2D array (np.ndarray, np.memmap or any object exposing the buffer
+     * protocol) or an iterable of 2D arrays of consecutive rows. C-contiguous float32
+     * arrays are used in place. Since the graph keeps the raw vectors of all points, other
+     * inputs are read chunk by chunk into one float32 buffer. progress(done, total) is
+     * called after each iteration of building, which counts all points.
+     */
+    void build(
+        py::handle data,
+        size_t ef_construction,
+        size_t num_threads = 1,
+        const py::object& progress = py::none()
+    ) {
+        std::vector<float> gathered;
+        const float* data_ptr = nullptr;
+        auto buffer = float_matrix_buffer(data);
+        if (buffer) {
+            if (static_cast<size_t>(buffer->shape[1]) != dim_) {
+                throw std::invalid_argument("data dimension does not match index dim");
+            }
+            data_ptr = static_cast<const float*>(buffer->ptr);
+            num_points_ = static_cast<size_t>(buffer->shape[0]);
+        } else {
+            ChunkReader reader(data, dim_, "data");
+            gathered = reader.read_all();
+            data_ptr = gathered.data();
+            num_points_ = gathered.size() / dim_;
         }
 
-        num_points_ = static_cast<size_t>(data_array.shape(0));
         index_ = std::make_unique<rabitqlib::symqg::QuantizedGraph<float>>(
             num_points_, dim_, max_degree_, metric_, rabitqlib::RotatorType::FhtKacRotator
         );
 
-        rabitqlib::symqg::QGBuilder builder(*index_, ef_construction, data_array.data(), num_threads);
-        builder.build();
+        rabitqlib::ProgressFunc on_progress = progress_callback(progress);
+        {
+            py::gil_scoped_release release;
+            rabitqlib::symqg::QGBuilder builder(*index_, ef_construction, data_ptr, num_threads);
+            gathered = {};  // vectors are copied into the graph
+            builder.build(3, on_progress);
+        }
         built_ = true;
     }
 
@@ -73,11 +100,15 @@ class SymqgIndex {
         return py::make_tuple(ids, dists);
     }
 
-    void save(const std::string& path) const {
+    void save(const std::string& path, bool compress) const {
         if (!built_) {
             throw std::runtime_error("SymqgIndex must be built before save");
         }
-        index_->save(path.c_str());
+        if (compress) {
+            index_->save_compressed(path.c_str());
+        } else {
+            index_->save(path.c_str());
+        }
     }
 
     static SymqgIndex load(const std::string& path) {
@@ -123,13 +154,14 @@ void register_symqg(py::module_ &m) {
        .def("build", &SymqgIndex::build,
            py::arg("data"),
            py::arg("ef_construction"),
-           py::arg("num_threads") = 1)
+           py::arg("num_threads") = 1,
+           py::arg("progress") = py::none())
        .def("search", &SymqgIndex::search,
            py::arg("queries"),
            py::arg("k"),
            py::arg("ef"),
            py::arg("num_threads") = 1)
-       .def("save", &SymqgIndex::save, py::arg("path"))
+       .def("save", &SymqgIndex::save, py::arg("path"), py::arg("compress") = false)
        .def_static("load", &SymqgIndex::load, py::arg("path"))
        .def_property_readonly("dim", &SymqgIndex::dim)
        .def_property_readonly("max_degree", &SymqgIndex::max_degree)
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "rabitqlib/index/hnsw/hnsw.hpp"
@@ -18,10 +19,11 @@ using gt_type = rabitqlib::RowMajorArray<uint32_t>;
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3>\n"
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4>\n"
                   << "arg1: path for index \n"
                   << "arg2: path for query file, format .fvecs\n"
-                  << "arg3: path for groundtruth file format .ivecs\n";
+                  << "arg3: path for groundtruth file format .ivecs\n"
+                  << "arg4: num of stages to read ex codes, 1 by default\n";
         exit(1);
     }
 
@@ -39,6 +41,10 @@ int main(int argc, char* argv[]) {
     index_type hnsw;
 
     hnsw.load(index_file);
+    if (argc > 4) {
+        hnsw.set_refine_stages(std::stoul(argv[4]));
+        std::cout << "Read ex codes in " << hnsw.refine_stages() << " stages\n";
+    }
 
     rabitqlib::StopW stopw;
 
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using index_type = rabitqlib::ivf::IVF;
+using layout_type = rabitqlib::ivf::ClusterLayout;
+using data_type = rabitqlib::RowMajorArray<float>;
+using gt_type = rabitqlib::RowMajorArray<uint32_t>;
+
+static std::vector<size_t> all_bits = {1, 3, 5, 7, 9};
+static std::vector<size_t> all_nprobes = {5, 10, 20, 40, 80, 160, 320};
+static size_t topk = 10;
+static size_t test_round = 3;
+
+// best QPS over rounds and recall of top-k
+static std::pair<float, float> run(
+    const index_type& ivf, size_t nprobe, const data_type& query, const gt_type& gt
+) {
+    size_t nq = query.rows();
+    std::vector<PID> results(topk);
+    float best_qps = 0;
+    size_t total_correct = 0;
+    rabitqlib::StopW stopw;
+    for (size_t r = 0; r < test_round; ++r) {
+        total_correct = 0;
+        float total_time = 0;
+        for (size_t i = 0; i < nq; ++i) {
+            stopw.reset();
+            ivf.search(&query(i, 0), topk, nprobe, results.data(), true);
+            total_time += stopw.get_elapsed_micro();
+            for (size_t j = 0; j < topk; ++j) {
+                for (size_t k = 0; k < topk; ++k) {
+                    if (gt(i, k) == results[j]) {
+                        total_correct++;
+                        break;
+                    }
+                }
+            }
+        }
+        best_qps = std::max(best_qps, static_cast<float>(nq) / (total_time / 1e6F));
+    }
+    return {best_qps, static_cast<float>(total_correct) / static_cast<float>(nq * topk)};
+}
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5> <arg6>\n"
+                  << "arg1: path for data file, format .fvecs\n"
+                  << "arg2: path for centroids file generated by ivf.py\n"
+                  << "arg3: path for cluster ids file generated by ivf.py\n"
+                  << "arg4: path for query file, format .fvecs\n"
+                  << "arg5: path for groundtruth file format .ivecs\n"
+                  << "arg6: metric type (\"l2\" or \"ip\"), l2 by default\n";
+        exit(1);
+    }
+
+    rabitqlib::MetricType metric_type = rabitqlib::METRIC_L2;
+    if (argc > 6) {
+        std::string metric_str(argv[6]);
+        if (metric_str == "ip" || metric_str == "IP") {
+            metric_type = rabitqlib::METRIC_IP;
+        }
+    }
+
+    data_type data;
+    data_type centroids;
+    gt_type cids;
+    data_type query;
+    gt_type gt;
+    rabitqlib::load_vecs<float, data_type>(argv[1], data);
+    rabitqlib::load_vecs<float, data_type>(argv[2], centroids);
+    rabitqlib::load_vecs<PID, gt_type>(argv[3], cids);
+    rabitqlib::load_vecs<float, data_type>(argv[4], query);
+    rabitqlib::load_vecs<uint32_t, gt_type>(argv[5], gt);
+    std::string index_file = "ivf_layout_benchmark.index";
+
+    // each index is built once, and loaded in both layouts
+    std::vector<std::string> lines;
+    for (size_t bits : all_bits) {
+        {
+            index_type ivf(data.rows(), data.cols(), centroids.rows(), bits, metric_type);
+            ivf.construct(data.data(), centroids.data(), cids.data(), false);
+            ivf.save(index_file.c_str());
+        }
+        index_type separate;
+        separate.load(index_file.c_str(), 0, layout_type::Separate);
+        index_type interleaved;
+        interleaved.load(index_file.c_str(), 0, layout_type::Interleaved);
+
+        for (size_t nprobe : all_nprobes) {
+            if (nprobe > separate.num_clusters()) {
+                break;
+            }
+            auto [separate_qps, separate_recall] = run(separate, nprobe, query, gt);
+            auto [interleaved_qps, interleaved_recall] = run(interleaved, nprobe, query, gt);
+            lines.push_back(
+                std::to_string(bits) + '\t' + std::to_string(nprobe) + '\t' +
+                std::to_string(separate_recall) + '\t' + std::to_string(separate_qps) +
+                '\t' + std::to_string(interleaved_qps) + '\t' +
+                std::to_string(interleaved_qps / separate_qps)
+            );
+            if (separate_recall != interleaved_recall) {
+                std::cerr << "Recall differs between layouts\n";
+            }
+        }
+    }
+    std::remove(index_file.c_str());
+
+    std::cout << "total_bits\tnprobe\trecall\tseparate QPS\tinterleaved QPS\tspeedup\n";
+    for (const auto& line : lines) {
+        std::cout << line << '\n';
+    }
+
+    return 0;
+}
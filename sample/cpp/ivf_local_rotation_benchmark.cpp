@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using index_type = rabitqlib::ivf::IVF;
+using rabitqlib::RotatorType;
+
+// rotator type, num of groups of local rotations (0 for none, max for one per cluster)
+// and name
+static std::vector<std::tuple<RotatorType, size_t, std::string>> all_configs = {
+    {RotatorType::FhtKacRotator, 0, "fht_kac"},
+    {RotatorType::LearnedRotator, 0, "learned"},
+    {RotatorType::FhtKacRotator, 16, "local_16"},
+    {RotatorType::FhtKacRotator, 64, "local_64"},
+    {RotatorType::FhtKacRotator, std::numeric_limits<size_t>::max(), "local_all"}
+};
+static std::vector<size_t> all_nprobes = {5, 10, 20, 40, 80};
+static size_t topk = 10;
+
+// each cluster spans its own low-rank subspace around its center, the local structure of
+// embeddings that a single global rotation does not fit
+struct LocalData {
+    std::vector<float> data;
+    std::vector<float> centroids;
+    std::vector<PID> cluster_ids;
+    std::vector<float> queries;
+    std::vector<PID> gt;
+};
+
+static LocalData generate(
+    size_t num, size_t dim, size_t num_clusters, size_t num_queries, size_t rank
+) {
+    std::mt19937 gen(2025);
+    std::normal_distribution<float> normal(0.0F, 1.0F);
+    std::uniform_int_distribution<size_t> pick(0, num_clusters - 1);
+
+    std::vector<float> centers(num_clusters * dim);
+    for (auto& val : centers) {
+        val = normal(gen);
+    }
+    std::vector<float> bases(num_clusters * rank * dim);
+    for (auto& val : bases) {
+        val = normal(gen) / std::sqrt(static_cast<float>(rank));
+    }
+    auto sample = [&](float* vec) {
+        size_t cid = pick(gen);
+        std::copy_n(&centers[cid * dim], dim, vec);
+        for (size_t r = 0; r < rank; ++r) {
+            float coef = normal(gen);
+            const float* basis = &bases[((cid * rank) + r) * dim];
+            for (size_t j = 0; j < dim; ++j) {
+                vec[j] += coef * basis[j];
+            }
+        }
+        for (size_t j = 0; j < dim; ++j) {
+            vec[j] += 0.02F * normal(gen);
+        }
+        return cid;
+    };
+
+    LocalData res;
+    res.data.resize(num * dim);
+    res.cluster_ids.resize(num);
+    res.centroids.assign(num_clusters * dim, 0);
+    std::vector<size_t> counts(num_clusters, 0);
+    for (size_t i = 0; i < num; ++i) {
+        float* vec = &res.data[i * dim];
+        size_t cid = sample(vec);
+        res.cluster_ids[i] = static_cast<PID>(cid);
+        counts[cid]++;
+        for (size_t j = 0; j < dim; ++j) {
+            res.centroids[(cid * dim) + j] += vec[j];
+        }
+    }
+    for (size_t i = 0; i < num_clusters; ++i) {
+        for (size_t j = 0; j < dim; ++j) {
+            res.centroids[(i * dim) + j] /= static_cast<float>(std::max<size_t>(counts[i], 1));
+        }
+    }
+
+    res.queries.resize(num_queries * dim);
+    res.gt.resize(num_queries * topk);
+    std::vector<float> dists(num);
+    std::vector<PID> ids(num);
+    for (size_t q = 0; q < num_queries; ++q) {
+        float* query = &res.queries[q * dim];
+        sample(query);
+        for (size_t i = 0; i < num; ++i) {
+            dists[i] = rabitqlib::euclidean_sqr(query, &res.data[i * dim], dim);
+        }
+        std::iota(ids.begin(), ids.end(), 0);
+        std::partial_sort(ids.begin(), ids.begin() + topk, ids.end(), [&](PID a, PID b) {
+            return dists[a] < dists[b];
+        });
+        std::copy(ids.begin(), ids.begin() + topk, &res.gt[q * topk]);
+    }
+    return res;
+}
+
+// QPS and recall of top-k by L2 distance
+static std::pair<float, float> run(
+    const index_type& ivf, size_t nprobe, const LocalData& ld, size_t dim
+) {
+    size_t nq = ld.gt.size() / topk;
+    std::vector<PID> results(topk);
+    size_t total_correct = 0;
+    float total_time = 0;
+    rabitqlib::StopW stopw;
+    for (size_t i = 0; i < nq; ++i) {
+        stopw.reset();
+        ivf.search(&ld.queries[i * dim], topk, nprobe, results.data(), true);
+        total_time += stopw.get_elapsed_micro();
+        const PID* gt = &ld.gt[i * topk];
+        for (size_t j = 0; j < topk; ++j) {
+            total_correct += std::count(gt, gt + topk, results[j]);
+        }
+    }
+    float qps = static_cast<float>(nq) / (total_time / 1e6F);
+    return {qps, static_cast<float>(total_correct) / static_cast<float>(nq * topk)};
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "-h") {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5>\n"
+                  << "arg1: num of data vectors, 200000 by default\n"
+                  << "arg2: dimension, 128 by default\n"
+                  << "arg3: num of clusters, 256 by default\n"
+                  << "arg4: total number of bits for quantization, 3 by default\n"
+                  << "arg5: rank of the subspace of each cluster, 16 by default\n";
+        exit(1);
+    }
+    size_t num = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t dim = argc > 2 ? atoi(argv[2]) : 128;
+    size_t num_clusters = argc > 3 ? atoi(argv[3]) : 256;
+    size_t total_bits = argc > 4 ? atoi(argv[4]) : 3;
+    size_t rank = argc > 5 ? atoi(argv[5]) : 16;
+    size_t num_queries = 500;
+
+    std::cout << "Generating data and groundtruth...\n";
+    LocalData ld = generate(num, dim, num_clusters, num_queries, rank);
+
+    std::vector<std::string> lines;
+    rabitqlib::StopW stopw;
+    for (const auto& [type, num_groups, name] : all_configs) {
+        index_type ivf(num, dim, num_clusters, total_bits, rabitqlib::METRIC_L2, type);
+        ivf.set_local_rotations(std::min(num_groups, num_clusters));
+        stopw.reset();
+        ivf.construct(ld.data.data(), ld.centroids.data(), ld.cluster_ids.data(), false);
+        float build_time = stopw.get_elapsed_micro() / 1e6F;
+        lines.push_back(name + "\tbuild time (s)\t" + std::to_string(build_time));
+
+        for (size_t nprobe : all_nprobes) {
+            if (nprobe > num_clusters) {
+                break;
+            }
+            auto [qps, recall] = run(ivf, nprobe, ld, dim);
+            lines.push_back(
+                name + '\t' + std::to_string(nprobe) + '\t' + std::to_string(recall) +
+                '\t' + std::to_string(qps)
+            );
+        }
+    }
+
+    std::cout << "rotation\tnprobe\trecall\tQPS\n";
+    for (const auto& line : lines) {
+        std::cout << line << '\n';
+    }
+
+    return 0;
+}
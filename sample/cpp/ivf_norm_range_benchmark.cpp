@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using index_type = rabitqlib::ivf::IVF;
+
+static std::vector<size_t> all_buckets = {1, 4, 16, 64};
+static std::vector<size_t> all_nprobes = {5, 10, 20, 40, 80, 160};
+static size_t topk = 10;
+
+// Gaussian clusters whose vectors are scaled to log-uniform norms in [1, max_norm], the
+// norm skew of embeddings from, e.g., recommendation models
+struct SkewedData {
+    std::vector<float> data;
+    std::vector<float> centroids;
+    std::vector<PID> cluster_ids;
+    std::vector<float> queries;
+    std::vector<PID> gt;
+};
+
+static void scale_to(float* vec, size_t dim, float norm) {
+    float scale = norm / std::sqrt(rabitqlib::l2norm_sqr(vec, dim));
+    for (size_t j = 0; j < dim; ++j) {
+        vec[j] *= scale;
+    }
+}
+
+static SkewedData generate(
+    size_t num, size_t dim, size_t num_clusters, size_t num_queries, float max_norm
+) {
+    std::mt19937 gen(2025);
+    std::normal_distribution<float> normal(0.0F, 1.0F);
+    std::uniform_real_distribution<float> log_norm(0.0F, std::log(max_norm));
+    std::uniform_int_distribution<size_t> pick(0, num_clusters - 1);
+
+    std::vector<float> centers(num_clusters * dim);
+    for (auto& val : centers) {
+        val = normal(gen);
+    }
+    auto sample = [&](float* vec) {
+        size_t cid = pick(gen);
+        for (size_t j = 0; j < dim; ++j) {
+            vec[j] = centers[(cid * dim) + j] + (0.5F * normal(gen));
+        }
+        return cid;
+    };
+
+    SkewedData res;
+    res.data.resize(num * dim);
+    res.cluster_ids.resize(num);
+    res.centroids.assign(num_clusters * dim, 0);
+    std::vector<size_t> counts(num_clusters, 0);
+    for (size_t i = 0; i < num; ++i) {
+        float* vec = &res.data[i * dim];
+        size_t cid = sample(vec);
+        scale_to(vec, dim, std::exp(log_norm(gen)));
+        res.cluster_ids[i] = static_cast<PID>(cid);
+        counts[cid]++;
+        for (size_t j = 0; j < dim; ++j) {
+            res.centroids[(cid * dim) + j] += vec[j];
+        }
+    }
+    for (size_t i = 0; i < num_clusters; ++i) {
+        for (size_t j = 0; j < dim; ++j) {
+            res.centroids[(i * dim) + j] /= static_cast<float>(std::max<size_t>(counts[i], 1));
+        }
+    }
+
+    res.queries.resize(num_queries * dim);
+    res.gt.resize(num_queries * topk);
+    std::vector<float> ips(num);
+    std::vector<PID> ids(num);
+    for (size_t q = 0; q < num_queries; ++q) {
+        float* query = &res.queries[q * dim];
+        sample(query);
+        scale_to(query, dim, 1.0F);
+        for (size_t i = 0; i < num; ++i) {
+            ips[i] = rabitqlib::dot_product<float>(query, &res.data[i * dim], dim);
+        }
+        std::iota(ids.begin(), ids.end(), 0);
+        std::partial_sort(ids.begin(), ids.begin() + topk, ids.end(), [&](PID a, PID b) {
+            return ips[a] > ips[b];
+        });
+        std::copy(ids.begin(), ids.begin() + topk, &res.gt[q * topk]);
+    }
+    return res;
+}
+
+// QPS and recall of top-k by inner product
+static std::pair<float, float> run(
+    const index_type& ivf, size_t nprobe, const SkewedData& sd, size_t dim
+) {
+    size_t nq = sd.gt.size() / topk;
+    std::vector<PID> results(topk);
+    size_t total_correct = 0;
+    float total_time = 0;
+    rabitqlib::StopW stopw;
+    for (size_t i = 0; i < nq; ++i) {
+        stopw.reset();
+        ivf.search(&sd.queries[i * dim], topk, nprobe, results.data(), true);
+        total_time += stopw.get_elapsed_micro();
+        const PID* gt = &sd.gt[i * topk];
+        for (size_t j = 0; j < topk; ++j) {
+            total_correct += std::count(gt, gt + topk, results[j]);
+        }
+    }
+    float qps = static_cast<float>(nq) / (total_time / 1e6F);
+    return {qps, static_cast<float>(total_correct) / static_cast<float>(nq * topk)};
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "-h") {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5>\n"
+                  << "arg1: num of data vectors, 200000 by default\n"
+                  << "arg2: dimension, 128 by default\n"
+                  << "arg3: num of clusters, 256 by default\n"
+                  << "arg4: total number of bits for quantization, 5 by default\n"
+                  << "arg5: ratio of the max norm to the min norm, 10 by default\n";
+        exit(1);
+    }
+    size_t num = argc > 1 ? atoi(argv[1]) : 200000;
+    size_t dim = argc > 2 ? atoi(argv[2]) : 128;
+    size_t num_clusters = argc > 3 ? atoi(argv[3]) : 256;
+    size_t total_bits = argc > 4 ? atoi(argv[4]) : 5;
+    float max_norm = argc > 5 ? static_cast<float>(atof(argv[5])) : 10.0F;
+    size_t num_queries = 500;
+
+    std::cout << "Generating data and groundtruth...\n";
+    SkewedData sd = generate(num, dim, num_clusters, num_queries, max_norm);
+
+    std::vector<std::string> lines;
+    rabitqlib::StopW stopw;
+    for (size_t num_buckets : all_buckets) {
+        index_type ivf(
+            num, dim, num_clusters, total_bits, rabitqlib::METRIC_IP,
+            rabitqlib::RotatorType::FhtKacRotator
+        );
+        ivf.set_norm_buckets(num_buckets);
+        stopw.reset();
+        ivf.construct(sd.data.data(), sd.centroids.data(), sd.cluster_ids.data(), false);
+        float build_time = stopw.get_elapsed_micro() / 1e6F;
+        std::string name = std::to_string(num_buckets);
+        lines.push_back(name + "\tbuild time (s)\t" + std::to_string(build_time));
+
+        for (size_t nprobe : all_nprobes) {
+            if (nprobe > num_clusters) {
+                break;
+            }
+            auto [qps, recall] = run(ivf, nprobe, sd, dim);
+            lines.push_back(
+                name + '\t' + std::to_string(nprobe) + '\t' + std::to_string(recall) +
+                '\t' + std::to_string(qps)
+            );
+        }
+    }
+
+    std::cout << "buckets\tnprobe\trecall\tQPS\n";
+    for (const auto& line : lines) {
+        std::cout << line << '\n';
+    }
+
+    return 0;
+}
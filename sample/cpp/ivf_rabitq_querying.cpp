@@ -1,4 +1,5 @@
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "rabitqlib/defines.hpp"
@@ -24,12 +25,13 @@ static size_t test_round = 5;
 
 int main(int argc, char** argv) {
     if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4>\n"
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5>\n"
                   << "arg1: path for index \n"
                   << "arg2: path for query file, format .fvecs\n"
                   << "arg3: path for groundtruth file format .ivecs\n"
                   << "arg4: whether use high accuracy fastscan, (\"true\" or \"false\"), "
-                     "true by default\n\n";
+                     "true by default\n"
+                  << "arg5: num of stages to read ex codes, 1 by default\n\n";
         exit(1);
     }
 
@@ -55,6 +57,10 @@ int main(int argc, char** argv) {
 
     index_type ivf;
     ivf.load(index_file);
+    if (argc > 5) {
+        ivf.set_refine_stages(std::stoul(argv[5]));
+        std::cout << "Read ex codes in " << ivf.refine_stages() << " stages\n";
+    }
 
     std::vector<size_t> all_nprobes;
     all_nprobes.push_back(5);
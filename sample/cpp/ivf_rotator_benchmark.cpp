@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using index_type = rabitqlib::ivf::IVF;
+using data_type = rabitqlib::RowMajorArray<float>;
+using gt_type = rabitqlib::RowMajorArray<uint32_t>;
+using rabitqlib::RotatorType;
+
+// rotator type, num of rounds (0 for the default) and name
+static std::vector<std::tuple<RotatorType, size_t, std::string>> all_rotators = {
+    {RotatorType::FhtKacRotator, 0, "fht_kac"},
+    {RotatorType::FhtKacRotator, 1, "fht_kac_r1"},
+    {RotatorType::FhtKacRotator, 2, "fht_kac_r2"},
+    {RotatorType::SorfRotator, 0, "sorf"},
+    {RotatorType::SorfRotator, 2, "sorf_r2"},
+    {RotatorType::MatrixRotator, 0, "matrix"},
+    {RotatorType::LearnedRotator, 0, "learned"}
+};
+static std::vector<size_t> all_nprobes = {5, 10, 20, 40, 80, 160, 320};
+static size_t topk = 10;
+
+// QPS and recall of top-k, IVF ranks by estimated distances, thus the recall shows the
+// accuracy of codes
+static std::pair<float, float> run(
+    const index_type& ivf, size_t nprobe, const data_type& query, const gt_type& gt
+) {
+    size_t nq = query.rows();
+    std::vector<PID> results(topk);
+    size_t total_correct = 0;
+    float total_time = 0;
+    rabitqlib::StopW stopw;
+    for (size_t i = 0; i < nq; ++i) {
+        stopw.reset();
+        ivf.search(&query(i, 0), topk, nprobe, results.data(), true);
+        total_time += stopw.get_elapsed_micro();
+        for (size_t j = 0; j < topk; ++j) {
+            for (size_t k = 0; k < topk; ++k) {
+                if (gt(i, k) == results[j]) {
+                    total_correct++;
+                    break;
+                }
+            }
+        }
+    }
+    float qps = static_cast<float>(nq) / (total_time / 1e6F);
+    return {qps, static_cast<float>(total_correct) / static_cast<float>(nq * topk)};
+}
+
+int main(int argc, char** argv) {
+    if (argc < 7) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <arg1> <arg2> <arg3> <arg4> <arg5> <arg6> <arg7>\n"
+                  << "arg1: path for data file, format .fvecs\n"
+                  << "arg2: path for centroids file generated by ivf.py\n"
+                  << "arg3: path for cluster ids file generated by ivf.py\n"
+                  << "arg4: path for query file, format .fvecs\n"
+                  << "arg5: path for groundtruth file format .ivecs\n"
+                  << "arg6: total number of bits for quantization\n"
+                  << "arg7: metric type (\"l2\" or \"ip\"), l2 by default\n";
+        exit(1);
+    }
+
+    size_t total_bits = std::atoi(argv[6]);
+    rabitqlib::MetricType metric_type = rabitqlib::METRIC_L2;
+    if (argc > 7) {
+        std::string metric_str(argv[7]);
+        if (metric_str == "ip" || metric_str == "IP") {
+            metric_type = rabitqlib::METRIC_IP;
+        }
+    }
+
+    data_type data;
+    data_type centroids;
+    gt_type cids;
+    data_type query;
+    gt_type gt;
+    rabitqlib::load_vecs<float, data_type>(argv[1], data);
+    rabitqlib::load_vecs<float, data_type>(argv[2], centroids);
+    rabitqlib::load_vecs<PID, gt_type>(argv[3], cids);
+    rabitqlib::load_vecs<float, data_type>(argv[4], query);
+    rabitqlib::load_vecs<uint32_t, gt_type>(argv[5], gt);
+
+    std::vector<std::string> lines;
+    rabitqlib::StopW stopw;
+    for (const auto& [type, rounds, name] : all_rotators) {
+        index_type ivf(
+            data.rows(), data.cols(), centroids.rows(), total_bits, metric_type, type
+        );
+        if (rounds > 0) {
+            ivf.set_rotator_rounds(rounds);
+        }
+        stopw.reset();
+        ivf.construct(data.data(), centroids.data(), cids.data(), false);
+        float build_time = stopw.get_elapsed_micro() / 1e6F;
+        lines.push_back(name + "\tbuild time (s)\t" + std::to_string(build_time));
+
+        for (size_t nprobe : all_nprobes) {
+            if (nprobe > ivf.num_clusters()) {
+                break;
+            }
+            auto [qps, recall] = run(ivf, nprobe, query, gt);
+            lines.push_back(
+                name + '\t' + std::to_string(nprobe) + '\t' + std::to_string(recall) +
+                '\t' + std::to_string(qps)
+            );
+        }
+    }
+
+    std::cout << "rotator\tnprobe\trecall\tQPS\n";
+    for (const auto& line : lines) {
+        std::cout << line << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/server/query_client.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/latency_histogram.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using data_type = rabitqlib::RowMajorArray<float>;
+using gt_type = rabitqlib::RowMajorArray<uint32_t>;
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5>\n"
+                  << "arg1: path for unix domain socket of rabitq_server\n"
+                  << "arg2: path for query file, format .fvecs\n"
+                  << "arg3: num of nearest neighbors, 10 by default\n"
+                  << "arg4: num of concurrent clients, 8 by default\n"
+                  << "arg5: path for groundtruth file format .ivecs, optional\n\n";
+        exit(1);
+    }
+
+    std::string socket_path(argv[1]);
+    char* query_file = argv[2];
+    size_t topk = argc > 3 ? std::stoul(argv[3]) : 10;
+    size_t num_clients = argc > 4 ? std::stoul(argv[4]) : 8;
+
+    data_type query;
+    rabitqlib::load_vecs<float, data_type>(query_file, query);
+    size_t nq = query.rows();
+    size_t dim = query.cols();
+
+    gt_type gt;
+    if (argc > 5) {
+        rabitqlib::load_vecs<uint32_t, gt_type>(argv[5], gt);
+    }
+
+    // each client sends queries i, i + num_clients, ... over its own connection
+    std::vector<PID> results(nq * topk, 0);
+    rabitqlib::LatencyHistogram latency;
+    std::vector<std::thread> clients;
+    rabitqlib::StopW stopw;
+    for (size_t c = 0; c < num_clients; ++c) {
+        clients.emplace_back([&, c] {
+            rabitqlib::server::QueryClient client(socket_path);
+            for (size_t i = c; i < nq; i += num_clients) {
+                client.search(&query(i, 0), dim, topk, &results[i * topk]);
+            }
+            latency.merge(client.latency());
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    float total_time = stopw.get_elapsed_sec();
+
+    std::cout << "clients\tQPS\n"
+              << num_clients << '\t' << static_cast<float>(nq) / total_time << '\n'
+              << "latency: " << latency.summary() << '\n';
+
+    if (argc > 5) {
+        size_t total_correct = 0;
+        for (size_t i = 0; i < nq; i++) {
+            for (size_t j = 0; j < topk; j++) {
+                for (size_t k = 0; k < topk; k++) {
+                    if (gt(i, k) == results[(i * topk) + j]) {
+                        total_correct++;
+                        break;
+                    }
+                }
+            }
+        }
+        std::cout << "recall: "
+                  << static_cast<float>(total_correct) / static_cast<float>(nq * topk)
+                  << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/server/query_server.hpp"
+
+using PID = rabitqlib::PID;
+
+static volatile std::sig_atomic_t stop_flag = 0;
+
+static void handle_signal(int /*signal*/) { stop_flag = 1; }
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <arg1> <arg2> <arg3> <arg4> <arg5> <arg6> <arg7>\n"
+                  << "arg1: type of index, \"ivf\", \"hnsw\" or \"qg\"\n"
+                  << "arg2: path for index\n"
+                  << "arg3: path for unix domain socket\n"
+                  << "arg4: nprobe for ivf, ef for hnsw and qg\n"
+                  << "arg5: num of worker threads, 4 by default\n"
+                  << "arg6: max num of queries in a batch, 32 by default\n"
+                  << "arg7: max wait time of a batch in microseconds, 200 by default\n\n";
+        exit(1);
+    }
+
+    std::string index_type(argv[1]);
+    char* index_file = argv[2];
+    std::string socket_path(argv[3]);
+    size_t search_param = std::stoul(argv[4]);
+
+    rabitqlib::server::ServerConfig config;
+    if (argc > 5) {
+        config.batcher.num_workers = std::stoul(argv[5]);
+    }
+    if (argc > 6) {
+        config.batcher.max_batch = std::stoul(argv[6]);
+    }
+    if (argc > 7) {
+        config.batcher.max_wait = std::chrono::microseconds(std::stoul(argv[7]));
+    }
+
+    // every index is loaded by its own load(), which also detects chunked and compressed
+    // files. Indices are read into their own buffers since none of them can search on a
+    // mapped file. Search parameters are fixed before serving, thus the search function of
+    // each batch only reads the index and batches may run concurrently
+    size_t dim = 0;
+    rabitqlib::server::BatchSearchFunc search_func;
+    std::unique_ptr<rabitqlib::ivf::IVF> ivf;
+    std::unique_ptr<rabitqlib::hnsw::HierarchicalNSW> hnsw;
+    std::unique_ptr<rabitqlib::symqg::QuantizedGraph<float>> qg;
+
+    if (index_type == "ivf") {
+        ivf = std::make_unique<rabitqlib::ivf::IVF>();
+        ivf->load(index_file);
+        dim = ivf->dimension();
+        search_func = [&](const float* queries, size_t num, size_t k, PID* ids, float* dists) {
+            for (size_t i = 0; i < num; ++i) {
+                ivf->search(
+                    queries + (i * dim), k, search_param, ids + (i * k), dists + (i * k), true
+                );
+            }
+        };
+    } else if (index_type == "hnsw") {
+        hnsw = std::make_unique<rabitqlib::hnsw::HierarchicalNSW>();
+        hnsw->load(index_file);
+        dim = hnsw->dimension();
+        const rabitqlib::hnsw::HierarchicalNSW& hnsw_index = *hnsw;
+        search_func = [&](const float* queries, size_t num, size_t k, PID* ids, float* dists) {
+            // results of each query are sorted by distances, nearest first
+            auto results = hnsw_index.search(queries, num, k, search_param, 1);
+            for (size_t i = 0; i < num; ++i) {
+                for (size_t j = 0; j < results[i].size(); ++j) {
+                    dists[(i * k) + j] = results[i][j].first;
+                    ids[(i * k) + j] = results[i][j].second;
+                }
+            }
+        };
+    } else if (index_type == "qg") {
+        qg = std::make_unique<rabitqlib::symqg::QuantizedGraph<float>>();
+        qg->load(index_file);
+        qg->set_ef(search_param);
+        dim = qg->dimension();
+        search_func = [&](const float* queries, size_t num, size_t k, PID* ids, float* dists) {
+            for (size_t i = 0; i < num; ++i) {
+                qg->search(
+                    queries + (i * dim),
+                    static_cast<uint32_t>(k),
+                    ids + (i * k),
+                    dists + (i * k)
+                );
+            }
+        };
+    } else {
+        std::cerr << "Unknown index type: " << index_type << '\n';
+        exit(1);
+    }
+
+    rabitqlib::server::QueryServer server(socket_path, dim, search_func, config);
+    server.start();
+    std::cout << "Serving " << index_type << " index (dim " << dim << ") on " << socket_path
+              << ", workers " << config.batcher.num_workers << ", max batch "
+              << config.batcher.max_batch << ", max wait "
+              << config.batcher.max_wait.count() << "us\n"
+              << std::flush;
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    while (stop_flag == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.stop();
+
+    const auto& batcher = server.batcher();
+    std::cout << "request latency: " << server.latency().summary() << '\n'
+              << "queue latency:   " << batcher.queue_latency().summary() << '\n'
+              << "batch latency:   " << batcher.search_latency().summary() << '\n'
+              << "batch size:      avg " << batcher.batch_sizes().mean() << ", max "
+              << batcher.batch_sizes().max() << '\n';
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+
+using PID = rabitqlib::PID;
+using index_type = rabitqlib::symqg::QuantizedGraph<float>;
+using data_type = rabitqlib::RowMajorArray<float>;
+using gt_type = rabitqlib::RowMajorArray<uint32_t>;
+
+std::vector<size_t> efs = {10, 20, 40, 60, 80, 100, 150, 200, 300, 500};
+size_t topk = 10;
+
+static std::vector<float> recalls(
+    index_type& qg, const data_type& query, const gt_type& gt
+) {
+    size_t nq = query.rows();
+    std::vector<float> res;
+    std::vector<PID> results(topk);
+    for (size_t ef : efs) {
+        qg.set_ef(ef);
+        size_t total_correct = 0;
+        for (size_t z = 0; z < nq; z++) {
+            qg.search(&query(z, 0), topk, results.data());
+            for (size_t y = 0; y < topk; y++) {
+                for (size_t k = 0; k < topk; k++) {
+                    if (gt(z, k) == results[y]) {
+                        total_correct++;
+                        break;
+                    }
+                }
+            }
+        }
+        res.push_back(static_cast<float>(total_correct) / static_cast<float>(nq * topk));
+    }
+    return res;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3> <arg4> <arg5> <arg6>\n"
+                  << "arg1: path for data file, format .fvecs\n"
+                  << "arg2: path for query file, format .fvecs\n"
+                  << "arg3: path for groundtruth file format .ivecs\n"
+                  << "arg4: degree bound for symqg, must be a multiple of 32\n"
+                  << "arg5: ef for indexing\n"
+                  << "arg6: alpha for single-pass build, 1.0 by default\n";
+        exit(1);
+    }
+
+    char* data_file = argv[1];
+    char* query_file = argv[2];
+    char* gt_file = argv[3];
+    size_t degree = atoi(argv[4]);
+    size_t ef = atoi(argv[5]);
+    float alpha = argc > 6 ? std::stof(argv[6]) : 1.0F;
+
+    data_type data;
+    data_type query;
+    gt_type gt;
+    rabitqlib::load_vecs<float, data_type>(data_file, data);
+    rabitqlib::load_vecs<float, data_type>(query_file, query);
+    rabitqlib::load_vecs<uint32_t, gt_type>(gt_file, gt);
+
+    // iterative build, 3 iters, refine at last iter
+    rabitqlib::StopW stopw;
+    index_type qg_iter(data.rows(), data.cols(), degree);
+    {
+        rabitqlib::symqg::QGBuilder builder(qg_iter, ef, data.data());
+        builder.build();
+    }
+    float iter_secs = stopw.get_elapsed_mili() / 1000.F;
+
+    // single-pass build
+    stopw.reset();
+    index_type qg_vamana(data.rows(), data.cols(), degree);
+    {
+        rabitqlib::symqg::QGBuilder builder(qg_vamana, ef, data.data());
+        builder.build_vamana(alpha);
+    }
+    float vamana_secs = stopw.get_elapsed_mili() / 1000.F;
+
+    auto iter_recalls = recalls(qg_iter, query, gt);
+    auto vamana_recalls = recalls(qg_vamana, query, gt);
+
+    std::cout << "Build time (secs)\titerative " << iter_secs << "\tsingle-pass "
+              << vamana_secs << '\n';
+    std::cout << "EF\tRecall(iterative)\tRecall(single-pass)\n";
+    for (size_t i = 0; i < efs.size(); ++i) {
+        std::cout << efs[i] << '\t' << iter_recalls[i] << '\t' << vamana_recalls[i] << '\n';
+    }
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <limits>
+#include <string>
 
 #include "rabitqlib/defines.hpp"
 #include "rabitqlib/index/symqg/qg.hpp"
@@ -18,7 +20,10 @@ int main(int argc, char** argv) {
                   << "arg2: degree bound for symqg, must be a multiple of 32\n"
                   << "arg3: ef for indexing \n"
                   << "arg4: path for saving index\n"
-                  << "arg5: metric type (\"l2\" or \"ip\"), l2 by default\n";
+                  << "arg5: metric type (\"l2\" or \"ip\"), l2 by default\n"
+                  << "arg6: initial graph (\"random\", \"nndescent\" or \"cluster\"), random "
+                     "by default\n"
+                  << "arg7: num of iterations, 3 by default\n";
         exit(1);
     }
 
@@ -40,6 +45,17 @@ int main(int argc, char** argv) {
         std::cout << "Metric Type: L2\n";
     }
 
+    rabitqlib::symqg::QGInitType init_type = rabitqlib::symqg::QGInitType::Random;
+    if (argc > 6) {
+        std::string init_str(argv[6]);
+        if (init_str == "nndescent") {
+            init_type = rabitqlib::symqg::QGInitType::NNDescent;
+        } else if (init_str == "cluster") {
+            init_type = rabitqlib::symqg::QGInitType::Cluster;
+        }
+    }
+    size_t num_iter = argc > 7 ? atoi(argv[7]) : 3;
+
     data_type data;
 
     rabitqlib::load_vecs<float, data_type>(data_file, data);
@@ -48,10 +64,12 @@ int main(int argc, char** argv) {
 
     index_type qg(data.rows(), data.cols(), degree, metric_type);
 
-    rabitqlib::symqg::QGBuilder builder(qg, ef, data.data());
+    rabitqlib::symqg::QGBuilder builder(
+        qg, ef, data.data(), std::numeric_limits<size_t>::max(), init_type
+    );
 
-    // 3 iters, refine at last iter
-    builder.build();
+    // refine at last iter
+    builder.build(num_iter);
 
     auto milisecs = stopw.get_elapsed_mili();
 
@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rabitqlib/defines.hpp"
+#include "rabitqlib/utils/stopw.hpp"
+#include "rabitqlib/utils/visited_pool.hpp"
+
+using PID = rabitqlib::PID;
+using rabitqlib::HashBasedBooleanSet;
+using rabitqlib::VisitedListPool;
+
+// num of vertices visited by a search, i.e., a search with a small ef
+constexpr size_t kVisitsPerSearch = 64;
+
+// searches per second of threads which only get, fill and release visited lists
+template <typename Get, typename Release>
+static double throughput(size_t num_threads, size_t num_searches, Get get, Release release) {
+    std::vector<std::thread> threads;
+    rabitqlib::StopW stopw;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < num_searches; ++i) {
+                HashBasedBooleanSet* vis = get();
+                for (size_t j = 0; j < kVisitsPerSearch; ++j) {
+                    vis->set(static_cast<PID>((t * 7919) + (i * 31) + (j * 131)));
+                }
+                release(vis);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return static_cast<double>(num_threads * num_searches) / stopw.get_elapsed_sec();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "-h") {
+        std::cerr << "Usage: " << argv[0] << " <arg1> <arg2> <arg3>\n"
+                  << "arg1: max num of threads, 128 by default\n"
+                  << "arg2: num of searches per thread, 100000 by default\n"
+                  << "arg3: max_elements of the index, 1000000 by default\n";
+        exit(1);
+    }
+    size_t max_threads = argc > 1 ? atoi(argv[1]) : 128;
+    size_t num_searches = argc > 2 ? atoi(argv[2]) : 100000;
+    size_t max_elements = argc > 3 ? atoi(argv[3]) : 1000000;
+
+    std::cout << "threads\tshared pool (searches/s)\tthread-local (searches/s)\tspeedup\n";
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        VisitedListPool pool(1, max_elements);
+        double shared = throughput(
+            num_threads,
+            num_searches,
+            [&] { return pool.get_shared_vislist(); },
+            [&](HashBasedBooleanSet* vis) { pool.release_shared_vis_list(vis); }
+        );
+        double local = throughput(
+            num_threads,
+            num_searches,
+            [&] { return pool.get_free_vislist(); },
+            [&](HashBasedBooleanSet* vis) { pool.release_vis_list(vis); }
+        );
+        std::cout << num_threads << '\t' << shared << '\t' << local << '\t'
+                  << local / shared << '\n';
+    }
+
+    return 0;
+}
@@ -25,9 +25,9 @@ struct HnswAvx512CoreKernel {
 };
 
 maxheap<std::pair<float, PID>> search_knn_avx512_core(
-    HierarchicalNSW& index, const float* rotated_query, size_t topk
+    const HierarchicalNSW& index, const float* rotated_query, size_t topk, size_t ef
 ) {
-    return index.search_knn_direct<HnswAvx512CoreKernel>(rotated_query, topk);
+    return index.search_knn_direct<HnswAvx512CoreKernel>(rotated_query, topk, ef);
 }
 
 }  // namespace rabitqlib::hnsw::detail
@@ -208,10 +208,39 @@ const MaskIpX0QFn kMaskIpX0QFn = [] {
     }
 }();
 
+// ip of codes of 9 to 15 ex_bits, whose lower 8 bits and upper H bits are stored in 2
+// planes, see packing_rabitqplus_code() of uint16 codes. The query stays in float, there
+// are no integer (VNNI) kernels, see docs/rabitq/quantizer.md
+template <size_t H>
+float ip_fxu_wide(
+    const float* __restrict__ query, const uint8_t* __restrict__ compact_code, size_t dim
+) {
+    return kExcodeIpTable[8](query, compact_code, dim) +
+           (256.F * kExcodeIpTable[H](query, compact_code + dim, dim));
+}
+
 ex_ipfunc select_excode_ipfunc(size_t ex_bits) {
     if (ex_bits <= 8) {
         return kExcodeIpTable[ex_bits];
     }
+    switch (ex_bits) {
+        case 9:
+            return ip_fxu_wide<1>;
+        case 10:
+            return ip_fxu_wide<2>;
+        case 11:
+            return ip_fxu_wide<3>;
+        case 12:
+            return ip_fxu_wide<4>;
+        case 13:
+            return ip_fxu_wide<5>;
+        case 14:
+            return ip_fxu_wide<6>;
+        case 15:
+            return ip_fxu_wide<7>;
+        default:
+            break;
+    }
 
     throw std::invalid_argument("Bad IP function for IVF");
 }
@@ -289,6 +318,27 @@ const AccumulateFn kAccumulateFn = [] {
     }
 }();
 
+using PackCodesFn = void (*)(size_t, const uint8_t*, size_t, uint8_t*);
+const PackCodesFn kPackCodesFn = [] {
+    if (cpu::has_avx512_core()) {
+        return simd::pack_codes_avx512;
+    } else if (cpu::has_avx2()) {
+        return simd::pack_codes_avx2;
+    } else {
+        rabitqlib::simd::missing_feature("fastscan code packing");
+    }
+}();
+
+const PackCodesFn kUnpackCodesFn = [] {
+    if (cpu::has_avx512_core()) {
+        return simd::unpack_codes_avx512;
+    } else if (cpu::has_avx2()) {
+        return simd::unpack_codes_avx2;
+    } else {
+        rabitqlib::simd::missing_feature("fastscan code unpacking");
+    }
+}();
+
 using TransferLutHaccFn = void (*)(const uint16_t*, size_t, uint8_t*);
 const TransferLutHaccFn kTransferLutHaccFn = [] {
     if (cpu::has_avx512_core()) {
@@ -320,6 +370,18 @@ void accumulate(
     kAccumulateFn(codes, lp_table, result, dim);
 }
 
+void pack_codes(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+) {
+    kPackCodesFn(padded_dim, quantization_code, num, blocks);
+}
+
+void unpack_codes(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+) {
+    kUnpackCodesFn(padded_dim, blocks, num, quantization_code);
+}
+
 void transfer_lut_hacc(const uint16_t* lut, size_t dim, uint8_t* hc_lut) {
     kTransferLutHaccFn(lut, dim, hc_lut);
 }
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "fastscan_pack_kernels.hpp"
 #include "rabitqlib/fastscan/fastscan.hpp"
 #include "rabitqlib/fastscan/highacc_fastscan.hpp"
 
@@ -168,4 +169,17 @@ void accumulate_hacc_avx2(
     _mm256_storeu_si256((__m256i*)(accu_res + 24), res[3]);
 }
 
+
+void pack_codes_avx2(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+) {
+    detail::pack_codes_avx2_impl(padded_dim, quantization_code, num, blocks);
+}
+
+void unpack_codes_avx2(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+) {
+    detail::unpack_codes_avx2_impl(padded_dim, blocks, num, quantization_code);
+}
+
 }  // namespace rabitqlib::fastscan::simd
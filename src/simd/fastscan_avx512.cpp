@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "fastscan_pack_kernels.hpp"
 #include "rabitqlib/fastscan/fastscan.hpp"
 #include "rabitqlib/fastscan/highacc_fastscan.hpp"
 
@@ -187,4 +188,165 @@ void accumulate_hacc_avx512(
     _mm512_storeu_epi32(accu_res + 16, res[1]);
 }
 
+namespace {
+// transpose 16x16 bytes in each 128-bit lane, see detail::transpose_16x16_epi8()
+inline void transpose_16x16_epi8(__m512i* rows) {
+    __m512i tmp[16];
+    for (size_t round = 0; round < 4; ++round) {
+        for (size_t i = 0; i < 8; ++i) {
+            tmp[2 * i] = _mm512_unpacklo_epi8(rows[i], rows[i + 8]);
+            tmp[(2 * i) + 1] = _mm512_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        for (size_t i = 0; i < 16; ++i) {
+            rows[i] = tmp[i];
+        }
+    }
+}
+
+inline __m512i load_rows(const uint8_t* row0, bool valid0, const uint8_t* row1, bool valid1) {
+    __m256i vec0 = valid0 ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0))
+                          : _mm256_setzero_si256();
+    __m256i vec1 = valid1 ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1))
+                          : _mm256_setzero_si256();
+    return _mm512_inserti64x4(_mm512_castsi256_si512(vec0), vec1, 1);
+}
+
+// pack 32 columns starting at col of a batch, lanes of rows[j] hold 16 columns of vector
+// j, 16 columns of vector j, 16 columns of vector j + 16 and 16 columns of vector j + 16
+inline void pack_32_columns(
+    const uint8_t* batch_code, size_t num_rows, size_t cols, size_t col, uint8_t* blocks
+) {
+    __m512i rows[16];
+    for (size_t j = 0; j < 16; ++j) {
+        rows[j] = load_rows(
+            batch_code + (j * cols) + col,
+            j < num_rows,
+            batch_code + ((j + 16) * cols) + col,
+            j + 16 < num_rows
+        );
+    }
+    transpose_16x16_epi8(rows);
+
+    const __m512i perm = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15)
+    );
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i high_mask = _mm256_set1_epi8(static_cast<char>(0xf0));
+    for (size_t i = 0; i < 16; ++i) {
+        // columns col + i and col + 16 + i
+        __m512i column = _mm512_shuffle_epi8(rows[i], perm);
+        __m256i vec_lo = _mm512_castsi512_si256(column);        // vectors 0 to 15
+        __m256i vec_hi = _mm512_extracti64x4_epi64(column, 1);  // vectors 16 to 31
+        __m256i upper = _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi16(vec_lo, 4), low_mask),
+            _mm256_and_si256(vec_hi, high_mask)
+        );
+        __m256i lower = _mm256_or_si256(
+            _mm256_and_si256(vec_lo, low_mask),
+            _mm256_slli_epi16(_mm256_and_si256(vec_hi, low_mask), 4)
+        );
+        _mm256_storeu2_m128i(
+            reinterpret_cast<__m128i*>(blocks + ((i + 16) * 32)),
+            reinterpret_cast<__m128i*>(blocks + (i * 32)),
+            upper
+        );
+        _mm256_storeu2_m128i(
+            reinterpret_cast<__m128i*>(blocks + ((i + 16) * 32) + 16),
+            reinterpret_cast<__m128i*>(blocks + (i * 32) + 16),
+            lower
+        );
+    }
+}
+
+// inverse of pack_32_columns()
+inline void unpack_32_columns(
+    const uint8_t* blocks, size_t num_rows, size_t cols, size_t col, uint8_t* batch_code
+) {
+    const __m512i inv_perm = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15)
+    );
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i high_mask = _mm256_set1_epi8(static_cast<char>(0xf0));
+    __m512i rows[16];
+    for (size_t i = 0; i < 16; ++i) {
+        __m256i upper = _mm256_loadu2_m128i(
+            reinterpret_cast<const __m128i*>(blocks + ((i + 16) * 32)),
+            reinterpret_cast<const __m128i*>(blocks + (i * 32))
+        );
+        __m256i lower = _mm256_loadu2_m128i(
+            reinterpret_cast<const __m128i*>(blocks + ((i + 16) * 32) + 16),
+            reinterpret_cast<const __m128i*>(blocks + (i * 32) + 16)
+        );
+        __m256i vec_lo = _mm256_or_si256(
+            _mm256_slli_epi16(_mm256_and_si256(upper, low_mask), 4),
+            _mm256_and_si256(lower, low_mask)
+        );
+        __m256i vec_hi = _mm256_or_si256(
+            _mm256_and_si256(upper, high_mask),
+            _mm256_and_si256(_mm256_srli_epi16(lower, 4), low_mask)
+        );
+        rows[i] = _mm512_shuffle_epi8(
+            _mm512_inserti64x4(_mm512_castsi256_si512(vec_lo), vec_hi, 1), inv_perm
+        );
+    }
+    transpose_16x16_epi8(rows);
+
+    for (size_t j = 0; j < 16; ++j) {
+        if (j < num_rows) {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(batch_code + (j * cols) + col),
+                _mm512_castsi512_si256(rows[j])
+            );
+        }
+        if (j + 16 < num_rows) {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(batch_code + ((j + 16) * cols) + col),
+                _mm512_extracti64x4_epi64(rows[j], 1)
+            );
+        }
+    }
+}
+}  // namespace
+
+void pack_codes_avx512(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+) {
+    // ! require padded_dim % 64 == 0, the last 8 or 16 columns are packed by AVX2
+    size_t cols = padded_dim / 8;
+    for (size_t row = 0; row < num; row += kBatchSize) {
+        size_t num_rows = std::min(kBatchSize, num - row);
+        const uint8_t* batch_code = quantization_code + (row * cols);
+        size_t col = 0;
+        for (; col + 32 <= cols; col += 32) {
+            pack_32_columns(batch_code, num_rows, cols, col, blocks);
+            blocks += 32 * 32;
+        }
+        for (; col < cols; col += 16) {
+            size_t width = std::min<size_t>(16, cols - col);
+            detail::pack_columns_avx2(batch_code, num_rows, cols, col, width, blocks);
+            blocks += width * 32;
+        }
+    }
+}
+
+void unpack_codes_avx512(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+) {
+    size_t cols = padded_dim / 8;
+    for (size_t row = 0; row < num; row += kBatchSize) {
+        size_t num_rows = std::min(kBatchSize, num - row);
+        uint8_t* batch_code = quantization_code + (row * cols);
+        size_t col = 0;
+        for (; col + 32 <= cols; col += 32) {
+            unpack_32_columns(blocks, num_rows, cols, col, batch_code);
+            blocks += 32 * 32;
+        }
+        for (; col < cols; col += 16) {
+            size_t width = std::min<size_t>(16, cols - col);
+            detail::unpack_columns_avx2(blocks, num_rows, cols, col, width, batch_code);
+            blocks += width * 32;
+        }
+    }
+}
+
 }  // namespace rabitqlib::fastscan::simd
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "rabitqlib/fastscan/fastscan.hpp"
+
+namespace rabitqlib::fastscan::simd::detail {
+
+// transpose 16x16 bytes in each 128-bit lane, i.e., byte c of row r goes to byte r of row
+// c. Each round interleaves rows i and i + 8, which rotates the 8-bit index (row, byte) by
+// 1 bit, thus 4 rounds swap the row and the byte.
+inline void transpose_16x16_epi8(__m256i* rows) {
+    __m256i tmp[16];
+    for (size_t round = 0; round < 4; ++round) {
+        for (size_t i = 0; i < 8; ++i) {
+            tmp[2 * i] = _mm256_unpacklo_epi8(rows[i], rows[i + 8]);
+            tmp[(2 * i) + 1] = _mm256_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        for (size_t i = 0; i < 16; ++i) {
+            rows[i] = tmp[i];
+        }
+    }
+}
+
+// kPerm0 in both lanes, and its inverse
+inline __m256i perm0_epi8() {
+    return _mm256_setr_epi8(
+        0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15,
+        0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15
+    );
+}
+
+inline __m256i inv_perm0_epi8() {
+    return _mm256_setr_epi8(
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+        0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15
+    );
+}
+
+// load width (8 or 16) bytes of row, zeros for absent rows
+inline __m128i load_row(const uint8_t* row, bool valid, size_t width) {
+    if (!valid) {
+        return _mm_setzero_si128();
+    }
+    if (width == 16) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+    }
+    return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row));
+}
+
+inline void store_row(uint8_t* row, __m128i val, size_t width) {
+    if (width == 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row), val);
+    } else {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), val);
+    }
+}
+
+// pack width (8 or 16) columns starting at col of a batch, see pack_codes_scalar()
+inline void pack_columns_avx2(
+    const uint8_t* batch_code,
+    size_t num_rows,
+    size_t cols,
+    size_t col,
+    size_t width,
+    uint8_t* blocks
+) {
+    // lane 0 holds vector j, lane 1 holds vector j + 16
+    __m256i rows[16];
+    for (size_t j = 0; j < 16; ++j) {
+        const uint8_t* row0 = batch_code + (j * cols) + col;
+        const uint8_t* row1 = batch_code + ((j + 16) * cols) + col;
+        rows[j] = _mm256_set_m128i(
+            load_row(row1, j + 16 < num_rows, width), load_row(row0, j < num_rows, width)
+        );
+    }
+    transpose_16x16_epi8(rows);
+
+    const __m256i perm = perm0_epi8();
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    const __m128i high_mask = _mm_set1_epi8(static_cast<char>(0xf0));
+    for (size_t i = 0; i < width; ++i) {
+        __m256i column = _mm256_shuffle_epi8(rows[i], perm);
+        __m128i vec_lo = _mm256_castsi256_si128(column);       // vectors 0 to 15
+        __m128i vec_hi = _mm256_extracti128_si256(column, 1);  // vectors 16 to 31
+        __m128i upper = _mm_or_si128(
+            _mm_and_si128(_mm_srli_epi16(vec_lo, 4), low_mask),
+            _mm_and_si128(vec_hi, high_mask)
+        );
+        __m128i lower = _mm_or_si128(
+            _mm_and_si128(vec_lo, low_mask),
+            _mm_slli_epi16(_mm_and_si128(vec_hi, low_mask), 4)
+        );
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blocks + (i * 32)), upper);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(blocks + (i * 32) + 16), lower);
+    }
+}
+
+// inverse of pack_columns_avx2()
+inline void unpack_columns_avx2(
+    const uint8_t* blocks,
+    size_t num_rows,
+    size_t cols,
+    size_t col,
+    size_t width,
+    uint8_t* batch_code
+) {
+    const __m256i inv_perm = inv_perm0_epi8();
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    const __m128i high_mask = _mm_set1_epi8(static_cast<char>(0xf0));
+    __m256i rows[16];
+    for (size_t i = 0; i < 16; ++i) {
+        if (i >= width) {
+            rows[i] = _mm256_setzero_si256();
+            continue;
+        }
+        __m128i upper = _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + (i * 32)));
+        __m128i lower =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + (i * 32) + 16));
+        __m128i vec_lo = _mm_or_si128(
+            _mm_slli_epi16(_mm_and_si128(upper, low_mask), 4), _mm_and_si128(lower, low_mask)
+        );
+        __m128i vec_hi = _mm_or_si128(
+            _mm_and_si128(upper, high_mask),
+            _mm_and_si128(_mm_srli_epi16(lower, 4), low_mask)
+        );
+        rows[i] = _mm256_shuffle_epi8(_mm256_set_m128i(vec_hi, vec_lo), inv_perm);
+    }
+    transpose_16x16_epi8(rows);
+
+    for (size_t j = 0; j < 16; ++j) {
+        if (j < num_rows) {
+            store_row(batch_code + (j * cols) + col, _mm256_castsi256_si128(rows[j]), width);
+        }
+        if (j + 16 < num_rows) {
+            store_row(
+                batch_code + ((j + 16) * cols) + col,
+                _mm256_extracti128_si256(rows[j], 1),
+                width
+            );
+        }
+    }
+}
+
+inline void pack_codes_avx2_impl(
+    size_t padded_dim, const uint8_t* quantization_code, size_t num, uint8_t* blocks
+) {
+    // ! require padded_dim % 64 == 0, thus cols % 8 == 0
+    size_t cols = padded_dim / 8;
+    for (size_t row = 0; row < num; row += kBatchSize) {
+        size_t num_rows = std::min(kBatchSize, num - row);
+        const uint8_t* batch_code = quantization_code + (row * cols);
+        for (size_t col = 0; col < cols; col += 16) {
+            size_t width = std::min<size_t>(16, cols - col);
+            pack_columns_avx2(batch_code, num_rows, cols, col, width, blocks);
+            blocks += width * 32;
+        }
+    }
+}
+
+inline void unpack_codes_avx2_impl(
+    size_t padded_dim, const uint8_t* blocks, size_t num, uint8_t* quantization_code
+) {
+    size_t cols = padded_dim / 8;
+    for (size_t row = 0; row < num; row += kBatchSize) {
+        size_t num_rows = std::min(kBatchSize, num - row);
+        uint8_t* batch_code = quantization_code + (row * cols);
+        for (size_t col = 0; col < cols; col += 16) {
+            size_t width = std::min<size_t>(16, cols - col);
+            unpack_columns_avx2(blocks, num_rows, cols, col, width, batch_code);
+            blocks += width * 32;
+        }
+    }
+}
+
+}  // namespace rabitqlib::fastscan::simd::detail
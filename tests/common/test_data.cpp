@@ -1,6 +1,8 @@
 #include "test_data.hpp"
+#include "rabitqlib/utils/space.hpp"
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 namespace rabitq_test {
 
@@ -100,4 +102,86 @@ std::vector<float> TestDataGenerator::GenerateIncrementalVector(size_t dim) {
     return vec;
 }
 
+ClusteredData TestDataGenerator::GenerateClusteredData(
+    size_t num_vectors,
+    size_t dim,
+    size_t num_clusters,
+    unsigned int seed
+) {
+    ClusteredData clustered;
+    auto vecs = GenerateRandomVectors(num_vectors, dim, -1.0f, 1.0f, seed);
+    clustered.data.reserve(num_vectors * dim);
+    for (const auto& vec : vecs) {
+        clustered.data.insert(clustered.data.end(), vec.begin(), vec.end());
+    }
+    clustered.centroids.assign(
+        clustered.data.begin(), clustered.data.begin() + static_cast<long>(num_clusters * dim)
+    );
+    AssignNearestCentroids(clustered, dim);
+    return clustered;
+}
+
+ClusteredData TestDataGenerator::GenerateBlobData(
+    size_t num_vectors,
+    size_t dim,
+    size_t num_clusters,
+    unsigned int center_seed,
+    unsigned int noise_seed,
+    float noise
+) {
+    ClusteredData clustered;
+    auto centers = GenerateRandomVectors(num_clusters, dim, -1.0f, 1.0f, center_seed);
+    auto noises = GenerateRandomVectors(num_vectors, dim, -noise, noise, noise_seed);
+    clustered.data.reserve(num_vectors * dim);
+    clustered.cluster_ids.resize(num_vectors);
+    for (size_t i = 0; i < num_vectors; ++i) {
+        clustered.cluster_ids[i] = static_cast<uint32_t>(i % num_clusters);
+        for (size_t j = 0; j < dim; ++j) {
+            clustered.data.push_back(centers[clustered.cluster_ids[i]][j] + noises[i][j]);
+        }
+    }
+    ComputeMeanCentroids(clustered, dim, num_clusters);
+    return clustered;
+}
+
+void TestDataGenerator::AssignNearestCentroids(ClusteredData& clustered, size_t dim) {
+    size_t num_vectors = clustered.data.size() / dim;
+    size_t num_clusters = clustered.centroids.size() / dim;
+    clustered.cluster_ids.assign(num_vectors, 0);
+    clustered.residual_sqr = 0.0f;
+    for (size_t i = 0; i < num_vectors; ++i) {
+        float best = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < num_clusters; ++c) {
+            float dist = rabitqlib::euclidean_sqr(
+                &clustered.data[i * dim], &clustered.centroids[c * dim], dim
+            );
+            if (dist < best) {
+                best = dist;
+                clustered.cluster_ids[i] = static_cast<uint32_t>(c);
+            }
+        }
+        clustered.residual_sqr += best;
+    }
+}
+
+void TestDataGenerator::ComputeMeanCentroids(
+    ClusteredData& clustered, size_t dim, size_t num_clusters
+) {
+    size_t num_vectors = clustered.cluster_ids.size();
+    std::vector<size_t> counts(num_clusters, 0);
+    clustered.centroids.assign(num_clusters * dim, 0.0f);
+    for (size_t i = 0; i < num_vectors; ++i) {
+        uint32_t cid = clustered.cluster_ids[i];
+        ++counts[cid];
+        for (size_t j = 0; j < dim; ++j) {
+            clustered.centroids[(cid * dim) + j] += clustered.data[(i * dim) + j];
+        }
+    }
+    for (size_t c = 0; c < num_clusters; ++c) {
+        for (size_t j = 0; j < dim; ++j) {
+            clustered.centroids[(c * dim) + j] /= static_cast<float>(std::max<size_t>(counts[c], 1));
+        }
+    }
+}
+
 } // namespace rabitq_test
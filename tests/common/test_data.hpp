@@ -4,9 +4,19 @@
 #include <vector>
 #include <random>
 #include <cstddef>
+#include <cstdint>
 
 namespace rabitq_test {
 
+// Row-major vectors with centroids and cluster ids, as taken by IVF::construct
+struct ClusteredData {
+    std::vector<float> data;
+    std::vector<float> centroids;
+    std::vector<uint32_t> cluster_ids;
+    // Sum of squared distances of vectors to their centroids (set by AssignNearestCentroids)
+    float residual_sqr = 0.0f;
+};
+
 class TestDataGenerator {
 public:
     // Generate random float vector with values in [min, max]
@@ -51,6 +61,32 @@ public:
 
     // Generate vector with incremental values [0, 1, 2, 3, ...]
     static std::vector<float> GenerateIncrementalVector(size_t dim);
+
+    // Generate uniform random vectors, the first num_clusters vectors are the centroids
+    // and every vector is assigned to its nearest centroid
+    static ClusteredData GenerateClusteredData(
+        size_t num_vectors,
+        size_t dim,
+        size_t num_clusters,
+        unsigned int seed = 42
+    );
+
+    // Generate vector i as the random center of cluster i % num_clusters plus uniform
+    // noise in [-noise, noise], the centroids are the means of the clusters
+    static ClusteredData GenerateBlobData(
+        size_t num_vectors,
+        size_t dim,
+        size_t num_clusters,
+        unsigned int center_seed,
+        unsigned int noise_seed,
+        float noise = 0.5f
+    );
+
+    // Assign every vector to its nearest centroid
+    static void AssignNearestCentroids(ClusteredData& clustered, size_t dim);
+
+    // Set the centroids to the means of the clusters
+    static void ComputeMeanCentroids(ClusteredData& clustered, size_t dim, size_t num_clusters);
 };
 
 } // namespace rabitq_test
@@ -5,6 +5,7 @@
 #include <vector>
 #include <cmath>
 #include <cstdlib>
+#include <stdexcept>
 
 using namespace rabitqlib;
 
@@ -140,3 +141,44 @@ TEST_F(BitPackUnpackTest, ExCode7Bit) {
     ExpectIpNear(result);
 }
 
+
+TEST_F(BitPackUnpackTest, UnpackRoundTrip) {
+    for (size_t bits = 1; bits <= 8; ++bits) {
+        PrepareData(bits);
+
+        std::vector<uint8_t> unpacked(dim);
+        rabitqlib::quant::rabitq_impl::ex_bits::unpacking_rabitqplus_code(
+            compact_code.data(), unpacked.data(), dim, bits
+        );
+
+        ASSERT_EQ(unpacked, code) << bits << "-bit code";
+    }
+}
+
+// codes of 9 to 15 bits are split into a byte plane and a plane of the upper bits
+TEST_F(BitPackUnpackTest, WideCodeRoundTripAndIp) {
+    for (size_t bits = 9; bits <= 15; ++bits) {
+        std::vector<uint16_t> wide_code(dim);
+        for (size_t i = 0; i < dim; ++i) {
+            wide_code[i] = static_cast<uint16_t>(rand() % (1 << bits));
+        }
+        std::vector<uint8_t> wide_compact(dim * bits / 8);
+        rabitqlib::quant::rabitq_impl::ex_bits::packing_rabitqplus_code(
+            wide_code.data(), wide_compact.data(), dim, bits
+        );
+
+        std::vector<uint16_t> unpacked(dim);
+        rabitqlib::quant::rabitq_impl::ex_bits::unpacking_rabitqplus_code(
+            wide_compact.data(), unpacked.data(), dim, bits
+        );
+        ASSERT_EQ(unpacked, wide_code) << bits << "-bit code";
+
+        double expected = 0;
+        for (size_t i = 0; i < dim; ++i) {
+            expected += static_cast<double>(query[i]) * wide_code[i];
+        }
+        float result = select_excode_ipfunc(bits)(query.data(), wide_compact.data(), dim);
+        ASSERT_NEAR(expected, result, std::abs(expected) * 1e-5) << bits << "-bit code";
+    }
+    EXPECT_THROW(select_excode_ipfunc(16), std::invalid_argument);
+}
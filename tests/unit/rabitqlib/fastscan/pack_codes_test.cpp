@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/fastscan/fastscan.hpp"
+#include "rabitqlib/simd/fastscan_dispatch.hpp"
+#include "rabitqlib/utils/cpu_features.hpp"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace rabitqlib;
+
+namespace {
+using PackFn = void (*)(size_t, const uint8_t*, size_t, uint8_t*);
+
+// packed blocks equal the scalar reference, and unpacking restores the codes
+void ExpectRoundTrip(PackFn pack, PackFn unpack) {
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (size_t padded_dim : {64, 128, 192, 256, 320, 768}) {
+        for (size_t num : {1, 17, 31, 32, 33, 100}) {
+            size_t cols = padded_dim / 8;
+            std::vector<uint8_t> codes(num * cols);
+            for (auto& code : codes) {
+                code = static_cast<uint8_t>(byte(gen));
+            }
+            size_t num_blocks = (num + 31) / 32 * padded_dim * 4;
+            std::vector<uint8_t> expected(num_blocks, 0xff);
+            std::vector<uint8_t> blocks(num_blocks, 0xee);
+            fastscan::pack_codes_scalar(padded_dim, codes.data(), num, expected.data());
+            pack(padded_dim, codes.data(), num, blocks.data());
+            EXPECT_EQ(blocks, expected) << "padded_dim " << padded_dim << ", num " << num;
+
+            std::vector<uint8_t> restored(num * cols, 0);
+            std::vector<uint8_t> scalar_restored(num * cols, 0);
+            unpack(padded_dim, blocks.data(), num, restored.data());
+            fastscan::unpack_codes_scalar(padded_dim, blocks.data(), num, scalar_restored.data());
+            EXPECT_EQ(restored, codes) << "padded_dim " << padded_dim << ", num " << num;
+            EXPECT_EQ(scalar_restored, codes);
+        }
+    }
+}
+}  // namespace
+
+TEST(PackCodesTest, DispatchedRoundTrip) {
+    ExpectRoundTrip(fastscan::pack_codes, fastscan::unpack_codes);
+}
+
+TEST(PackCodesTest, Avx2RoundTrip) {
+    if (!cpu::has_avx2()) {
+        GTEST_SKIP() << "AVX2 is not supported";
+    }
+    ExpectRoundTrip(fastscan::simd::pack_codes_avx2, fastscan::simd::unpack_codes_avx2);
+}
+
+TEST(PackCodesTest, Avx512RoundTrip) {
+    if (!cpu::has_avx512_core()) {
+        GTEST_SKIP() << "AVX-512 is not supported";
+    }
+    ExpectRoundTrip(fastscan::simd::pack_codes_avx512, fastscan::simd::unpack_codes_avx512);
+}
+
+// unpack_code() of a single vector agrees with unpack_codes()
+TEST(PackCodesTest, SingleLane) {
+    constexpr size_t kPaddedDim = 128;
+    constexpr size_t kNum = 32;
+    std::vector<uint8_t> codes(kNum * kPaddedDim / 8);
+    for (size_t i = 0; i < codes.size(); ++i) {
+        codes[i] = static_cast<uint8_t>((i * 37) + 5);
+    }
+    std::vector<uint8_t> blocks(kPaddedDim * 4);
+    fastscan::pack_codes(kPaddedDim, codes.data(), kNum, blocks.data());
+    std::vector<uint8_t> binary(kPaddedDim);
+    for (size_t lane = 0; lane < kNum; ++lane) {
+        fastscan::unpack_code(kPaddedDim, blocks.data(), lane, binary.data());
+        for (size_t d = 0; d < kPaddedDim; ++d) {
+            uint8_t bit = (codes[(lane * kPaddedDim / 8) + (d / 8)] >> (7 - (d % 8))) & 1;
+            ASSERT_EQ(binary[d], bit);
+        }
+    }
+}
+
+// unpack_code_words() gives the bits of unpack_code() in the order of pack_binary()
+TEST(PackCodesTest, SingleLaneWords) {
+    constexpr size_t kPaddedDim = 192;
+    constexpr size_t kNum = 32;
+    std::vector<uint8_t> codes(kNum * kPaddedDim / 8);
+    for (size_t i = 0; i < codes.size(); ++i) {
+        codes[i] = static_cast<uint8_t>((i * 53) + 3);
+    }
+    std::vector<uint8_t> blocks(kPaddedDim * 4);
+    fastscan::pack_codes(kPaddedDim, codes.data(), kNum, blocks.data());
+    std::vector<uint8_t> binary(kPaddedDim);
+    std::vector<uint64_t> words(kPaddedDim / 64);
+    for (size_t lane = 0; lane < kNum; ++lane) {
+        fastscan::unpack_code(kPaddedDim, blocks.data(), lane, binary.data());
+        fastscan::unpack_code_words(kPaddedDim, blocks.data(), lane, words.data());
+        for (size_t d = 0; d < kPaddedDim; ++d) {
+            ASSERT_EQ((words[d / 64] >> (63 - (d % 64))) & 1, binary[d]);
+        }
+    }
+}
@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/hamming.hpp"
+#include "rabitqlib/index/ivf/binary_ivf.hpp"
+#include "rabitqlib/index/symqg/binary_qg.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class BinaryIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 gen(71);
+        std::uniform_int_distribution<int> byte_dist(0, 255);
+        // vectors are noisy copies of a few prototypes, thus they have close neighbors
+        std::vector<uint8_t> protos(kNumClusters * kBytes);
+        for (auto& byte : protos) {
+            byte = static_cast<uint8_t>(byte_dist(gen));
+        }
+        std::uniform_int_distribution<size_t> dim_dist(0, kDim - 1);
+        data_.resize(kNum * kBytes);
+        cluster_ids_.resize(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            cluster_ids_[i] = static_cast<PID>(i % kNumClusters);
+            std::copy_n(&protos[cluster_ids_[i] * kBytes], kBytes, &data_[i * kBytes]);
+            for (size_t j = 0; j < 40; ++j) {
+                size_t bit = dim_dist(gen);
+                data_[(i * kBytes) + (bit / 8)] ^= static_cast<uint8_t>(0x80 >> (bit % 8));
+            }
+        }
+        centroids_.assign(protos.begin(), protos.end());
+
+        auto query_vecs =
+            TestDataGenerator::GenerateRandomVectors(kNumQueries, kDim, -1.0f, 1.0f, 73);
+        for (const auto& vec : query_vecs) {
+            float_queries_.insert(float_queries_.end(), vec.begin(), vec.end());
+        }
+        path_ = "/tmp/rabitq_binary_index_test_" + std::to_string(::getpid());
+    }
+
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    [[nodiscard]] int Bit(size_t i, size_t j) const {
+        return (data_[(i * kBytes) + (j / 8)] >> (7 - (j % 8))) & 1;
+    }
+
+    [[nodiscard]] const uint8_t* BinaryQuery(size_t q) const {
+        return &data_[(q * 53) * kBytes];
+    }
+
+    // sorted exact distances of the k nearest neighbors
+    [[nodiscard]] std::vector<float> HammingTopk(const uint8_t* query, size_t k) const {
+        std::vector<float> dists(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            int dist = 0;
+            for (size_t j = 0; j < kDim; ++j) {
+                dist += ((query[j / 8] >> (7 - (j % 8))) & 1) != Bit(i, j);
+            }
+            dists[i] = static_cast<float>(dist);
+        }
+        std::partial_sort(dists.begin(), dists.begin() + k, dists.end());
+        dists.resize(k);
+        return dists;
+    }
+
+    [[nodiscard]] std::vector<float> AsymmetricTopk(const float* query, size_t k) const {
+        std::vector<float> dists(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            float dist = 0;
+            for (size_t j = 0; j < kDim; ++j) {
+                float diff = query[j] - static_cast<float>((2 * Bit(i, j)) - 1);
+                dist += diff * diff;
+            }
+            dists[i] = dist;
+        }
+        std::partial_sort(dists.begin(), dists.begin() + k, dists.end());
+        dists.resize(k);
+        return dists;
+    }
+
+    // dim is not a multiple of 8, thus the last byte has unused bits
+    static constexpr size_t kDim = 250;
+    static constexpr size_t kBytes = (kDim + 7) / 8;
+    static constexpr size_t kNum = 1500;
+    static constexpr size_t kNumClusters = 6;
+    static constexpr size_t kNumQueries = 10;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<uint8_t> data_;
+    std::vector<uint8_t> centroids_;
+    std::vector<PID> cluster_ids_;
+    std::vector<float> float_queries_;
+    std::string path_;
+};
+
+TEST_F(BinaryIndexTest, HammingQueryIsExact) {
+    std::vector<uint8_t> codes(fastscan::kBatchSize * 256 / 8);
+    for (size_t i = 0; i < fastscan::kBatchSize; ++i) {
+        pad_binary_code(&data_[i * kBytes], kDim, 256, &codes[i * 256 / 8]);
+    }
+    std::vector<uint8_t> batch(fastscan::kBatchSize * 256 / 8);
+    fastscan::pack_codes(256, codes.data(), fastscan::kBatchSize, batch.data());
+
+    HammingQuery query(BinaryQuery(3), kDim, 256);
+    std::vector<float> dists(fastscan::kBatchSize);
+    query.batch_distance(batch.data(), dists.data());
+    for (size_t i = 0; i < fastscan::kBatchSize; ++i) {
+        std::vector<uint64_t> words(4);
+        binary_code_to_words(&codes[i * 256 / 8], 256, words.data());
+        EXPECT_EQ(query.distance(words.data()), dists[i]);
+
+        float expected = 0;
+        for (size_t j = 0; j < kDim; ++j) {
+            expected += static_cast<float>(Bit(3 * 53, j) != Bit(i, j));
+        }
+        EXPECT_EQ(dists[i], expected);
+    }
+}
+
+// with all clusters probed, results are the exact nearest neighbors
+TEST_F(BinaryIndexTest, IVFIsExact) {
+    ivf::BinaryIVF index(kNum, kDim, kNumClusters);
+    index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), 2);
+    index.save(path_.c_str());
+    ivf::BinaryIVF loaded;
+    loaded.load(path_.c_str());
+
+    for (size_t q = 0; q < kNumQueries; ++q) {
+        std::vector<PID> ids(kTopk);
+        std::vector<float> dists(kTopk);
+        index.search(BinaryQuery(q), kTopk, kNumClusters, ids.data(), dists.data());
+        EXPECT_EQ(dists, HammingTopk(BinaryQuery(q), kTopk));
+        EXPECT_EQ(dists[0], 0.0F);
+
+        const float* query = &float_queries_[q * kDim];
+        index.search(query, kTopk, kNumClusters, ids.data(), dists.data());
+        auto expected = AsymmetricTopk(query, kTopk);
+        for (size_t i = 0; i < kTopk; ++i) {
+            EXPECT_NEAR(dists[i], expected[i], 1e-3F * expected[i]);
+        }
+
+        std::vector<PID> loaded_ids(kTopk);
+        std::vector<float> loaded_dists(kTopk);
+        loaded.search(query, kTopk, kNumClusters, loaded_ids.data(), loaded_dists.data());
+        EXPECT_EQ(ids, loaded_ids);
+        EXPECT_EQ(dists, loaded_dists);
+    }
+}
+
+TEST_F(BinaryIndexTest, QGFindsNeighbors) {
+    symqg::BinaryQG index(kNum, kDim, 32);
+    index.build(data_.data(), 100, 2, 2);
+    index.set_ef(100);
+    index.save(path_.c_str());
+    symqg::BinaryQG loaded;
+    loaded.load(path_.c_str());
+    loaded.set_ef(100);
+
+    size_t correct = 0;
+    for (size_t q = 0; q < kNumQueries; ++q) {
+        std::vector<PID> ids(kTopk);
+        std::vector<float> dists(kTopk);
+        index.search(BinaryQuery(q), kTopk, ids.data(), dists.data());
+        EXPECT_EQ(dists[0], 0.0F);
+        // distances are exact, thus the k-th distance is no less than the exact one
+        auto expected = HammingTopk(BinaryQuery(q), kTopk);
+        EXPECT_TRUE(std::is_sorted(dists.begin(), dists.end()));
+        for (size_t i = 0; i < kTopk; ++i) {
+            EXPECT_GE(dists[i], expected[i]);
+            correct += static_cast<size_t>(dists[i] <= expected[kTopk - 1]);
+        }
+
+        std::vector<PID> loaded_ids(kTopk);
+        loaded.search(BinaryQuery(q), kTopk, loaded_ids.data());
+        EXPECT_EQ(ids, loaded_ids);
+
+        const float* query = &float_queries_[q * kDim];
+        loaded.search(query, kTopk, ids.data(), dists.data());
+        auto asym_expected = AsymmetricTopk(query, kTopk);
+        EXPECT_GE(dists[0], asym_expected[0] * (1 - 1e-3F));
+    }
+    EXPECT_GE(correct, kNumQueries * kTopk * 9 / 10);
+}
+
+TEST_F(BinaryIndexTest, QGWithFewerVerticesThanDegree) {
+    // 20 vertices cannot fill 32 neighbors, rest slots must not point to other vertices
+    constexpr size_t kFew = 20;
+    symqg::BinaryQG index(kFew, kDim, 32);
+    index.build(data_.data(), 50, 2, 1);
+    index.set_ef(100);
+
+    for (size_t q = 0; q < kFew; ++q) {
+        std::vector<PID> ids(kTopk);
+        std::vector<float> dists(kTopk);
+        index.search(&data_[q * kBytes], kTopk, ids.data(), dists.data());
+        EXPECT_EQ(ids[0], static_cast<PID>(q));
+        EXPECT_EQ(dists[0], 0.0F);
+        for (auto id : ids) {
+            EXPECT_LT(id, kFew);
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ChunkedBuildTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 31);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_.resize(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            cluster_ids_[i] = static_cast<PID>((i * 7) % kNumClusters);
+        }
+    }
+
+    // chunks of chunk_rows rows, each copied to a buffer which is reused by the next chunk
+    ChunkFunc Chunks(size_t chunk_rows, size_t num_rows) {
+        return [this, chunk_rows, num_rows, pos = size_t{0}](const float*& rows) mutable {
+            size_t num = std::min(chunk_rows, num_rows - pos);
+            chunk_.assign(
+                data_.begin() + static_cast<long>(pos * kDim),
+                data_.begin() + static_cast<long>((pos + num) * kDim)
+            );
+            rows = chunk_.data();
+            pos += num;
+            return num;
+        };
+    }
+
+    // recall of top-10 and max relative error of estimated distances on a few queries,
+    // rotators are random, thus indices are compared by accuracy
+    std::pair<float, float> Accuracy(const ivf::IVF& index) const {
+        constexpr size_t kTopk = 10;
+        constexpr size_t kNumQueries = 10;
+        size_t correct = 0;
+        float max_error = 0;
+        for (size_t q = 0; q < kNumQueries; ++q) {
+            const float* query = &data_[(q * 37) * kDim];
+            std::vector<PID> ids(kTopk);
+            std::vector<float> dists(kTopk);
+            index.search(query, kTopk, kNumClusters, ids.data(), dists.data(), true);
+
+            std::vector<std::pair<float, PID>> truth(kNum);
+            for (size_t i = 0; i < kNum; ++i) {
+                truth[i] = {euclidean_sqr(query, &data_[i * kDim], kDim), static_cast<PID>(i)};
+            }
+            std::partial_sort(truth.begin(), truth.begin() + kTopk, truth.end());
+            for (size_t i = 0; i < kTopk; ++i) {
+                for (size_t j = 0; j < kTopk; ++j) {
+                    correct += static_cast<size_t>(ids[i] == truth[j].second);
+                }
+                float exact = euclidean_sqr(query, &data_[ids[i] * kDim], kDim);
+                max_error = std::max(max_error, std::abs(dists[i] - exact) / (exact + 1));
+            }
+        }
+        return {static_cast<float>(correct) / (kTopk * kNumQueries), max_error};
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kNumClusters = 8;
+
+    std::vector<float> data_;
+    std::vector<float> chunk_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+};
+
+// chunks of any size give an index as accurate as the one by the whole data
+TEST_F(ChunkedBuildTest, IVFChunkedMatchesConstruct) {
+    ivf::IVF whole(kNum, kDim, kNumClusters, 5, METRIC_L2, RotatorType::FhtKacRotator);
+    whole.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+    auto [whole_recall, whole_error] = Accuracy(whole);
+    EXPECT_GE(whole_recall, 0.9f);
+
+    for (size_t chunk_rows : {1UL, 97UL, kNum}) {
+        ivf::IVF chunked(kNum, kDim, kNumClusters, 5, METRIC_L2, RotatorType::FhtKacRotator);
+        std::vector<std::pair<size_t, size_t>> reports;
+        chunked.construct_chunked(
+            centroids_.data(),
+            cluster_ids_.data(),
+            Chunks(chunk_rows, kNum),
+            false,
+            2,
+            [&](size_t done, size_t total) { reports.emplace_back(done, total); }
+        );
+        ASSERT_EQ(reports.size(), (kNum + chunk_rows - 1) / chunk_rows);
+        EXPECT_EQ(reports.back().first, kNum);
+
+        auto [recall, error] = Accuracy(chunked);
+        EXPECT_GE(recall, 0.9f) << chunk_rows << " rows per chunk";
+        EXPECT_LT(error, std::max(2 * whole_error, 0.05f)) << chunk_rows << " rows per chunk";
+    }
+
+    ivf::IVF fewer(kNum, kDim, kNumClusters, 5, METRIC_L2, RotatorType::FhtKacRotator);
+    EXPECT_THROW(
+        fewer.construct_chunked(
+            centroids_.data(), cluster_ids_.data(), Chunks(100, kNum - 1), false, 1
+        ),
+        std::invalid_argument
+    );
+}
+
+TEST_F(ChunkedBuildTest, ProgressReachesTotal) {
+    auto check = [](const std::vector<std::pair<size_t, size_t>>& reports, size_t total) {
+        ASSERT_FALSE(reports.empty());
+        for (size_t i = 0; i < reports.size(); ++i) {
+            EXPECT_EQ(reports[i].second, total);
+            if (i > 0) {
+                EXPECT_GT(reports[i].first, reports[i - 1].first);
+            }
+        }
+        EXPECT_EQ(reports.back().first, total);
+    };
+    std::vector<std::pair<size_t, size_t>> reports;
+    auto progress = [&](size_t done, size_t total) { reports.emplace_back(done, total); };
+
+    ivf::IVF ivf_index(kNum, kDim, kNumClusters, 3, METRIC_L2, RotatorType::FhtKacRotator);
+    ivf_index.construct(
+        data_.data(), centroids_.data(), cluster_ids_.data(), false, 1, progress
+    );
+    check(reports, kNum);
+
+    reports.clear();
+    hnsw::HierarchicalNSW hnsw_index(kNum, kDim, 3, 16, 100);
+    hnsw_index.construct(
+        kNumClusters,
+        centroids_.data(),
+        kNum,
+        data_.data(),
+        cluster_ids_.data(),
+        2,
+        false,
+        progress
+    );
+    check(reports, kNum);
+    EXPECT_EQ(reports.size(), 100U);
+
+    reports.clear();
+    symqg::QuantizedGraph<float> qg_index(kNum, kDim, 32);
+    symqg::QGBuilder builder(qg_index, 64, data_.data(), 1);
+    builder.build(2, progress);
+    check(reports, 2 * kNum);
+}
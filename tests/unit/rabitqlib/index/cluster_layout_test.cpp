@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ClusterLayoutTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 43);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_.resize(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            // clusters of different sizes with partial batches, and a few empty clusters
+            cluster_ids_[i] = static_cast<PID>((i * i) % kNumClusters);
+        }
+        path_ = "/tmp/rabitq_cluster_layout_test_" + std::to_string(::getpid());
+    }
+
+    void TearDown() override { std::remove(path_.c_str()); }
+
+    // search results, scores and reconstructions of two indices are the same
+    void ExpectSameResults(const ivf::IVF& first, const ivf::IVF& second) const {
+        constexpr size_t kTopk = 20;
+        for (size_t q = 0; q < 5; ++q) {
+            const float* query = &data_[(q * 101) * kDim];
+            std::vector<PID> ids(kTopk);
+            std::vector<PID> other_ids(kTopk);
+            std::vector<float> dists(kTopk);
+            std::vector<float> other_dists(kTopk);
+            first.search(query, kTopk, 3, ids.data(), dists.data(), true);
+            second.search(query, kTopk, 3, other_ids.data(), other_dists.data(), true);
+            EXPECT_EQ(ids, other_ids);
+            EXPECT_EQ(dists, other_dists);
+
+            std::vector<DistBound> bounds(kTopk);
+            std::vector<DistBound> other_bounds(kTopk);
+            first.score_ids(query, ids.data(), kTopk, bounds.data());
+            second.score_ids(query, ids.data(), kTopk, other_bounds.data());
+            for (size_t i = 0; i < kTopk; ++i) {
+                EXPECT_EQ(bounds[i].est_dist, other_bounds[i].est_dist);
+                EXPECT_EQ(bounds[i].up_dist, other_bounds[i].up_dist);
+            }
+        }
+
+        std::vector<PID> ids = {0, 1, 500, kNum - 1};
+        std::vector<float> vecs(ids.size() * kDim);
+        std::vector<float> other_vecs(ids.size() * kDim);
+        first.reconstruct_batch(ids.data(), ids.size(), vecs.data());
+        second.reconstruct_batch(ids.data(), ids.size(), other_vecs.data());
+        EXPECT_EQ(vecs, other_vecs);
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kNumClusters = 7;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+    std::string path_;
+};
+
+// files do not depend on the layout, an index gives the same results in both layouts
+TEST_F(ClusterLayoutTest, LayoutsGiveSameResults) {
+    for (size_t bits : {1UL, 4UL, 9UL}) {
+        ivf::IVF built(
+            kNum,
+            kDim,
+            kNumClusters,
+            bits,
+            METRIC_L2,
+            RotatorType::FhtKacRotator,
+            ivf::ClusterLayout::Interleaved
+        );
+        built.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+        EXPECT_EQ(built.layout(), ivf::ClusterLayout::Interleaved);
+        built.save(path_.c_str());
+
+        ivf::IVF separate;
+        separate.load(path_.c_str());
+        EXPECT_EQ(separate.layout(), ivf::ClusterLayout::Separate);
+        ExpectSameResults(built, separate);
+
+        separate.save_compressed(path_.c_str());
+        ivf::IVF interleaved;
+        interleaved.load(path_.c_str(), 0, ivf::ClusterLayout::Interleaved);
+        ExpectSameResults(separate, interleaved);
+    }
+}
+
+TEST_F(ClusterLayoutTest, InterleavedChunkedBuild) {
+    ivf::IVF index(
+        kNum,
+        kDim,
+        kNumClusters,
+        5,
+        METRIC_IP,
+        RotatorType::FhtKacRotator,
+        ivf::ClusterLayout::Interleaved
+    );
+    size_t pos = 0;
+    index.construct_chunked(
+        centroids_.data(),
+        cluster_ids_.data(),
+        [&](const float*& rows) {
+            size_t num = std::min<size_t>(77, kNum - pos);
+            rows = &data_[pos * kDim];
+            pos += num;
+            return num;
+        },
+        false,
+        1
+    );
+    index.save(path_.c_str());
+    ivf::IVF separate;
+    separate.load(path_.c_str());
+    ExpectSameResults(index, separate);
+}
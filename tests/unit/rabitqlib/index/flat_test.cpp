@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/flat/flat.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class FlatIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto data_vecs = TestDataGenerator::GenerateRandomVectors(kNum, kDim, -1.0f, 1.0f, 37);
+        for (const auto& vec : data_vecs) {
+            data_.insert(data_.end(), vec.begin(), vec.end());
+        }
+        auto query_vecs =
+            TestDataGenerator::GenerateRandomVectors(kNumQueries, kDim, -1.0f, 1.0f, 41);
+        for (const auto& vec : query_vecs) {
+            queries_.insert(queries_.end(), vec.begin(), vec.end());
+        }
+    }
+
+    // top-k by sorting all distances
+    std::vector<std::pair<float, PID>> Truth(const float* query, MetricType metric) const {
+        std::vector<std::pair<float, PID>> res(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            const float* vec = &data_[i * kDim];
+            float dist = metric == METRIC_IP ? dot_product_dis(query, vec, kDim)
+                                             : euclidean_sqr(query, vec, kDim);
+            res[i] = {dist, static_cast<PID>(i)};
+        }
+        std::partial_sort(res.begin(), res.begin() + kTopk, res.end());
+        res.resize(kTopk);
+        return res;
+    }
+
+    // not a multiple of the block sizes of search_batch()
+    static constexpr size_t kNum = 2500;
+    static constexpr size_t kDim = 70;
+    static constexpr size_t kNumQueries = 130;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> queries_;
+};
+
+TEST_F(FlatIndexTest, SearchIsExact) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        flat::FlatIndex index(kDim, metric);
+        // added in two parts, ids are consecutive
+        index.add(data_.data(), 1000);
+        index.add(&data_[1000 * kDim], kNum - 1000);
+        ASSERT_EQ(index.size(), kNum);
+
+        std::vector<PID> batch_ids(kNumQueries * kTopk);
+        std::vector<float> batch_dists(kNumQueries * kTopk);
+        index.search_batch(
+            queries_.data(), kNumQueries, kTopk, batch_ids.data(), batch_dists.data(), 2
+        );
+
+        for (size_t q = 0; q < kNumQueries; ++q) {
+            const float* query = &queries_[q * kDim];
+            auto truth = Truth(query, metric);
+            std::vector<PID> ids(kTopk);
+            std::vector<float> dists(kTopk);
+            index.search(query, kTopk, ids.data(), dists.data());
+            for (size_t i = 0; i < kTopk; ++i) {
+                EXPECT_EQ(ids[i], truth[i].second);
+                EXPECT_NEAR(dists[i], truth[i].first, 1e-4F);
+                EXPECT_EQ(batch_ids[(q * kTopk) + i], truth[i].second);
+                EXPECT_NEAR(batch_dists[(q * kTopk) + i], truth[i].first, 1e-3F);
+            }
+        }
+    }
+
+    // fewer vectors than k
+    flat::FlatIndex small(kDim);
+    small.add(data_.data(), 3);
+    std::vector<PID> ids(kTopk, kPidMax);
+    small.search(data_.data(), kTopk, ids.data());
+    EXPECT_EQ(ids[0], 0U);
+    EXPECT_EQ(ids[3], kPidMax);
+}
+
+TEST_F(FlatIndexTest, SaveAndLoad) {
+    flat::FlatIndex index(kDim, METRIC_IP);
+    index.add(data_.data(), kNum);
+
+    std::string path = "/tmp/rabitq_flat_test_" + std::to_string(::getpid());
+    for (bool compressed : {false, true}) {
+        if (compressed) {
+            index.save_compressed(path.c_str());
+        } else {
+            index.save(path.c_str());
+        }
+        flat::FlatIndex loaded;
+        loaded.load(path.c_str());
+        EXPECT_EQ(loaded.size(), kNum);
+        EXPECT_EQ(loaded.dimension(), kDim);
+        EXPECT_EQ(loaded.metric_type(), METRIC_IP);
+
+        std::vector<PID> ids(kTopk);
+        std::vector<PID> loaded_ids(kTopk);
+        index.search(queries_.data(), kTopk, ids.data());
+        loaded.search(queries_.data(), kTopk, loaded_ids.data());
+        EXPECT_EQ(loaded_ids, ids);
+        EXPECT_TRUE(std::equal(
+            index.vector(kNum - 1), index.vector(kNum - 1) + kDim, loaded.vector(kNum - 1)
+        ));
+    }
+    std::remove(path.c_str());
+}
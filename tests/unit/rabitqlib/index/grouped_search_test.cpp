@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "rabitqlib/utils/buffer.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+namespace {
+// brute-force grouping: keys of the best num_groups groups ranked by their best hits
+std::vector<PID> BruteForceGroups(
+    const std::vector<float>& dists, const std::vector<PID>& keys, size_t num_groups
+) {
+    std::map<PID, float> best;
+    for (size_t i = 0; i < dists.size(); ++i) {
+        auto iter = best.find(keys[i]);
+        if (iter == best.end() || dists[i] < iter->second) {
+            best[keys[i]] = dists[i];
+        }
+    }
+    std::vector<std::pair<float, PID>> order;
+    for (const auto& [key, dist] : best) {
+        order.emplace_back(dist, key);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<PID> res;
+    for (size_t i = 0; i < std::min(num_groups, order.size()); ++i) {
+        res.push_back(order[i].second);
+    }
+    return res;
+}
+
+// results are sorted, every group has at most group_size hits of its own key
+void CheckGroups(
+    const std::vector<buffer::GroupHits<float>>& groups,
+    const std::vector<PID>& keys,
+    size_t num_groups,
+    size_t group_size
+) {
+    ASSERT_LE(groups.size(), num_groups);
+    std::set<PID> seen;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        const auto& hits = groups[g].hits;
+        EXPECT_TRUE(seen.insert(groups[g].key).second);
+        ASSERT_FALSE(hits.empty());
+        EXPECT_LE(hits.size(), group_size);
+        if (g > 0) {
+            EXPECT_LE(groups[g - 1].hits[0].distance, hits[0].distance);
+        }
+        for (size_t i = 0; i < hits.size(); ++i) {
+            EXPECT_EQ(keys[hits[i].id], groups[g].key);
+            if (i > 0) {
+                EXPECT_LE(hits[i - 1].distance, hits[i].distance);
+            }
+        }
+    }
+}
+
+size_t Overlap(const std::vector<buffer::GroupHits<float>>& groups, std::vector<PID> truth) {
+    std::set<PID> truth_set(truth.begin(), truth.end());
+    size_t count = 0;
+    for (const auto& group : groups) {
+        count += truth_set.count(group.key);
+    }
+    return count;
+}
+}  // namespace
+
+class GroupedSearchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 17);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+        keys_.resize(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            keys_[i] = static_cast<PID>((i * 7) % kNumKeys);
+        }
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kNumClusters = 8;
+    static constexpr size_t kNumKeys = 50;
+    static constexpr size_t kNumGroups = 5;
+    static constexpr size_t kGroupSize = 3;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+    std::vector<PID> keys_;
+};
+
+// inserting all candidates in ascending order gives the exact grouped results
+TEST_F(GroupedSearchTest, BufferMatchesBruteForce) {
+    const float* query = &data_[3 * kDim];
+    std::vector<float> dists(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        dists[i] = euclidean_sqr(query, &data_[i * kDim], kDim);
+    }
+
+    buffer::GroupedBuffer<float> buffer(kNumGroups, kGroupSize, keys_.data());
+    EXPECT_EQ(buffer.top_dist(), std::numeric_limits<float>::max());
+    std::vector<PID> order(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        order[i] = static_cast<PID>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](PID a, PID b) { return dists[a] < dists[b]; });
+    for (PID id : order) {
+        buffer.insert(id, dists[id]);
+    }
+    EXPECT_LT(buffer.top_dist(), std::numeric_limits<float>::max());
+
+    auto groups = buffer.results();
+    CheckGroups(groups, keys_, kNumGroups, kGroupSize);
+    auto truth = BruteForceGroups(dists, keys_, kNumGroups);
+    ASSERT_EQ(groups.size(), truth.size());
+    for (size_t g = 0; g < groups.size(); ++g) {
+        EXPECT_EQ(groups[g].key, truth[g]);
+        EXPECT_EQ(groups[g].hits.size(), kGroupSize);
+
+        std::vector<float> group_dists;
+        for (size_t i = 0; i < kNum; ++i) {
+            if (keys_[i] == truth[g]) {
+                group_dists.push_back(dists[i]);
+            }
+        }
+        std::sort(group_dists.begin(), group_dists.end());
+        for (size_t i = 0; i < kGroupSize; ++i) {
+            EXPECT_FLOAT_EQ(groups[g].hits[i].distance, group_dists[i]);
+        }
+    }
+    // the threshold is the worst hit of the kept groups
+    float worst = 0;
+    for (const auto& group : groups) {
+        worst = std::max(worst, group.hits.back().distance);
+    }
+    EXPECT_FLOAT_EQ(buffer.top_dist(), worst);
+}
+
+// groups with fewer members than group_size still prune candidates of other groups
+TEST_F(GroupedSearchTest, SparseGroupsPrune) {
+    const float* query = &data_[3 * kDim];
+    std::vector<float> dists(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        dists[i] = euclidean_sqr(query, &data_[i * kDim], kDim);
+    }
+    // every vector is a group of its own, thus no group is ever full
+    std::vector<PID> unique_keys(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        unique_keys[i] = static_cast<PID>(i);
+    }
+    std::vector<PID> order(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        order[i] = static_cast<PID>((i * 389) % kNum);
+    }
+
+    buffer::GroupedBuffer<float> buffer(kNumGroups, kGroupSize, unique_keys.data());
+    for (PID id : order) {
+        buffer.insert(id, dists[id]);
+    }
+    auto groups = buffer.results();
+    CheckGroups(groups, unique_keys, kNumGroups, kGroupSize);
+    auto truth = BruteForceGroups(dists, unique_keys, kNumGroups);
+    ASSERT_EQ(groups.size(), truth.size());
+    for (size_t g = 0; g < groups.size(); ++g) {
+        EXPECT_EQ(groups[g].key, truth[g]);
+    }
+
+    // kept groups take any hit, other groups are bounded by the worst best hit
+    EXPECT_EQ(buffer.top_dist(), std::numeric_limits<float>::max());
+    EXPECT_EQ(buffer.top_dist(truth[0]), std::numeric_limits<float>::max());
+    PID other = *std::find_if(order.begin(), order.end(), [&](PID id) {
+        return std::find(truth.begin(), truth.end(), id) == truth.end();
+    });
+    EXPECT_FLOAT_EQ(buffer.top_dist(other), groups.back().hits[0].distance);
+}
+
+// the best groups are found in any order of insertion
+TEST_F(GroupedSearchTest, BufferKeysInAnyOrder) {
+    const float* query = &data_[3 * kDim];
+    std::vector<float> dists(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        dists[i] = euclidean_sqr(query, &data_[i * kDim], kDim);
+    }
+    auto truth = BruteForceGroups(dists, keys_, kNumGroups);
+    for (size_t step : {1UL, 389UL, 999UL}) {
+        buffer::GroupedBuffer<float> buffer(kNumGroups, kGroupSize, keys_.data());
+        for (size_t i = 0; i < kNum; ++i) {
+            PID id = static_cast<PID>((i * step) % kNum);
+            buffer.insert(id, dists[id]);
+        }
+        auto groups = buffer.results();
+        CheckGroups(groups, keys_, kNumGroups, kGroupSize);
+        ASSERT_EQ(groups.size(), truth.size());
+        for (size_t g = 0; g < groups.size(); ++g) {
+            EXPECT_EQ(groups[g].key, truth[g]) << "step " << step;
+        }
+    }
+}
+
+TEST_F(GroupedSearchTest, IVFGroupedSearch) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        ivf::IVF index(kNum, kDim, kNumClusters, 7, metric, RotatorType::FhtKacRotator);
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+        size_t overlap = 0;
+        for (size_t q = 0; q < 10; ++q) {
+            const float* query = &data_[(kNum - 1 - q) * kDim];
+            auto groups =
+                index.search_grouped(query, kNumGroups, kGroupSize, kNumClusters, keys_.data());
+            CheckGroups(groups, keys_, kNumGroups, kGroupSize);
+            EXPECT_EQ(groups.size(), kNumGroups);
+
+            std::vector<float> dists(kNum);
+            for (size_t i = 0; i < kNum; ++i) {
+                const float* vec = &data_[i * kDim];
+                dists[i] = metric == METRIC_L2 ? euclidean_sqr(query, vec, kDim)
+                                               : -dot_product(query, vec, kDim);
+            }
+            overlap += Overlap(groups, BruteForceGroups(dists, keys_, kNumGroups));
+        }
+        EXPECT_GE(overlap, 10 * kNumGroups * 8 / 10);
+    }
+}
+
+TEST_F(GroupedSearchTest, QGGroupedSearch) {
+    symqg::QuantizedGraph<float> index(kNum, kDim, 32);
+    symqg::QGBuilder builder(index, 64, data_.data(), 1);
+    builder.build(3);
+    index.set_ef(100);
+
+    size_t overlap = 0;
+    for (size_t q = 0; q < 10; ++q) {
+        const float* query = &data_[(kNum - 1 - q) * kDim];
+        auto groups = index.search_grouped(query, kNumGroups, kGroupSize, keys_.data());
+        CheckGroups(groups, keys_, kNumGroups, kGroupSize);
+        EXPECT_EQ(groups.size(), kNumGroups);
+
+        std::vector<float> dists(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            dists[i] = euclidean_sqr(query, &data_[i * kDim], kDim);
+        }
+        overlap += Overlap(groups, BruteForceGroups(dists, keys_, kNumGroups));
+    }
+    EXPECT_GE(overlap, 10 * kNumGroups * 8 / 10);
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/index_holder.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+namespace {
+
+// Fake index that detects use after free and counts live versions
+struct TrackedIndex {
+    static constexpr uint64_t kAlive = 0x5AFE5AFE5AFE5AFEULL;
+    static constexpr uint64_t kDead = 0xDEADDEADDEADDEADULL;
+    static std::atomic<int64_t> live;
+
+    volatile uint64_t magic = kAlive;
+    uint64_t version;
+    std::vector<uint64_t> payload;
+
+    explicit TrackedIndex(uint64_t ver) : version(ver), payload(64, ver) { live.fetch_add(1); }
+
+    ~TrackedIndex() {
+        magic = kDead;
+        for (auto& v : payload) {
+            v = kDead;
+        }
+        live.fetch_sub(1);
+    }
+
+    // emulate a search that reads the whole index
+    [[nodiscard]] bool search() const {
+        if (magic != kAlive) {
+            return false;
+        }
+        for (auto v : payload) {
+            if (v != version) {
+                return false;
+            }
+        }
+        return magic == kAlive;
+    }
+};
+
+std::atomic<int64_t> TrackedIndex::live{0};
+
+}  // namespace
+
+class IndexHolderTest : public ::testing::Test {
+protected:
+    void SetUp() override { TrackedIndex::live = 0; }
+};
+
+TEST_F(IndexHolderTest, EmptyHolder) {
+    IndexHolder<TrackedIndex> holder;
+    auto snapshot = holder.acquire();
+    EXPECT_FALSE(snapshot);
+    EXPECT_EQ(snapshot.get(), nullptr);
+    EXPECT_EQ(holder.version(), 0);
+}
+
+TEST_F(IndexHolderTest, SnapshotKeepsOldVersionAlive) {
+    IndexHolder<TrackedIndex> holder(std::make_unique<TrackedIndex>(1));
+    EXPECT_EQ(holder.version(), 1);
+
+    std::atomic<bool> published{false};
+    {
+        auto snapshot = holder.acquire();
+        ASSERT_TRUE(snapshot);
+        EXPECT_EQ(snapshot->version, 1);
+
+        std::thread writer([&]() {
+            holder.publish(std::make_unique<TrackedIndex>(2));
+            published = true;
+        });
+
+        // publish must wait for the snapshot, so the old version stays valid
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(published.load());
+        EXPECT_TRUE(snapshot->search());
+        EXPECT_EQ(TrackedIndex::live.load(), 2);
+
+        // new readers already see the new version
+        std::thread reader([&]() {
+            auto fresh = holder.acquire();
+            EXPECT_EQ(fresh->version, 2);
+        });
+        reader.join();
+
+        snapshot = {};
+        writer.join();
+    }
+    EXPECT_TRUE(published.load());
+    EXPECT_EQ(TrackedIndex::live.load(), 1);
+    EXPECT_EQ(holder.version(), 2);
+
+    holder.retire();
+    EXPECT_EQ(TrackedIndex::live.load(), 0);
+    EXPECT_FALSE(holder.acquire());
+}
+
+TEST_F(IndexHolderTest, ConcurrentSearchAndSwap) {
+    constexpr size_t kNumReaders = 8;
+    constexpr uint64_t kNumVersions = 200;
+
+    {
+        IndexHolder<TrackedIndex> holder(std::make_unique<TrackedIndex>(0));
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> failures{0};
+        std::atomic<size_t> searches{0};
+        std::atomic<size_t> started{0};
+
+        std::vector<std::thread> readers;
+        for (size_t i = 0; i < kNumReaders; ++i) {
+            readers.emplace_back([&]() {
+                uint64_t last_version = 0;
+                started.fetch_add(1);
+                while (!stop.load(std::memory_order_relaxed)) {
+                    auto snapshot = holder.acquire();
+                    // versions observed by one thread never go backwards
+                    if (!snapshot || !snapshot->search() || snapshot->version < last_version) {
+                        failures.fetch_add(1);
+                    } else {
+                        last_version = snapshot->version;
+                    }
+                    searches.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        while (started.load() < kNumReaders) {
+            std::this_thread::yield();
+        }
+        for (uint64_t ver = 1; ver <= kNumVersions; ++ver) {
+            holder.publish(std::make_unique<TrackedIndex>(ver));
+            std::this_thread::yield();
+            // at most the current version and nothing pending
+            EXPECT_EQ(TrackedIndex::live.load(), 1);
+        }
+        stop = true;
+        for (auto& t : readers) {
+            t.join();
+        }
+
+        EXPECT_EQ(failures.load(), 0);
+        EXPECT_GT(searches.load(), 0);
+        EXPECT_EQ(holder.version(), kNumVersions + 1);
+        EXPECT_EQ(holder.acquire()->version, kNumVersions);
+    }
+    EXPECT_EQ(TrackedIndex::live.load(), 0);
+}
+
+TEST_F(IndexHolderTest, HotSwapIVF) {
+    constexpr size_t kNum = 2000;
+    constexpr size_t kDim = 64;
+    constexpr size_t kNumClusters = 16;
+    constexpr size_t kTopk = 10;
+
+    auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 7);
+    const auto& data = clustered.data;
+    const auto& centroids = clustered.centroids;
+    const auto& cluster_ids = clustered.cluster_ids;
+
+    auto build = [&](size_t total_bits) {
+        auto index = std::make_unique<ivf::IVF>(kNum, kDim, kNumClusters, total_bits);
+        index->construct(data.data(), centroids.data(), cluster_ids.data(), true, 1);
+        return index;
+    };
+
+    IndexHolder<ivf::IVF> holder(build(1));
+    std::vector<std::unique_ptr<ivf::IVF>> next_versions;
+    next_versions.push_back(build(4));
+    next_versions.push_back(build(7));
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            std::vector<PID> results(kTopk);
+            size_t qid = t;
+            while (!stop.load(std::memory_order_relaxed)) {
+                auto snapshot = holder.acquire();
+                const float* query = data.data() + (qid % kNum) * kDim;
+                snapshot->search(query, kTopk, kNumClusters, results.data(), false);
+                // query is a data point, full probing must find it
+                if (std::find(results.begin(), results.end(), qid % kNum) == results.end()) {
+                    failures.fetch_add(1);
+                }
+                qid += 4;
+            }
+        });
+    }
+
+    for (auto& index : next_versions) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        holder.publish(std::move(index));
+    }
+    stop = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(holder.acquire()->nbits(), 7);
+}
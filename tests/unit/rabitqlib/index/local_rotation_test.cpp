@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class LocalRotationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // each cluster spans its own low-rank subspace around a random center, thus no
+        // single rotation fits all clusters
+        auto centers = TestDataGenerator::GenerateRandomVectors(kNumClusters, kDim, -1.0f, 1.0f, 51);
+        std::mt19937 gen(53);
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        std::vector<float> bases(kNumClusters * kRank * kDim);
+        for (auto& val : bases) {
+            val = normal(gen);
+        }
+        centroids_.assign(kNumClusters * kDim, 0);
+        cluster_ids_.resize(kNum);
+        data_.resize(kNum * kDim);
+        for (size_t i = 0; i < kNum; ++i) {
+            PID cid = static_cast<PID>(i % kNumClusters);
+            cluster_ids_[i] = cid;
+            float* vec = &data_[i * kDim];
+            std::copy(centers[cid].begin(), centers[cid].end(), vec);
+            for (size_t r = 0; r < kRank; ++r) {
+                float coef = 0.2f * normal(gen);
+                const float* basis = &bases[((cid * kRank) + r) * kDim];
+                for (size_t j = 0; j < kDim; ++j) {
+                    vec[j] += coef * basis[j];
+                }
+            }
+            for (size_t j = 0; j < kDim; ++j) {
+                centroids_[(cid * kDim) + j] += vec[j];
+            }
+        }
+        for (auto& val : centroids_) {
+            val /= static_cast<float>(kNum / kNumClusters);
+        }
+    }
+
+    std::unique_ptr<ivf::IVF> Build(MetricType metric, size_t num_groups) const {
+        auto index = std::make_unique<ivf::IVF>(
+            kNum, kDim, kNumClusters, kTotalBits, metric, RotatorType::FhtKacRotator
+        );
+        index->set_local_rotations(num_groups);
+        index->construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+        return index;
+    }
+
+    // mean squared error of vectors reconstructed from their codes
+    float ReconstructError(const ivf::IVF& index) const {
+        std::vector<float> vec(kDim);
+        double err = 0;
+        for (size_t i = 0; i < kNum; ++i) {
+            index.reconstruct(static_cast<PID>(i), vec.data());
+            err += euclidean_sqr(vec.data(), &data_[i * kDim], kDim);
+        }
+        return static_cast<float>(err / kNum);
+    }
+
+    // recall of top-k for queries taken from the data, all clusters are probed
+    float Recall(const ivf::IVF& index, MetricType metric) const {
+        size_t hits = 0;
+        std::vector<float> scores(kNum);
+        std::vector<PID> ids(kNum);
+        for (size_t q = 0; q < kNumQuery; ++q) {
+            const float* query = &data_[(q * 37 % kNum) * kDim];
+            for (size_t i = 0; i < kNum; ++i) {
+                scores[i] = metric == METRIC_L2
+                                ? euclidean_sqr(query, &data_[i * kDim], kDim)
+                                : -dot_product<float>(query, &data_[i * kDim], kDim);
+            }
+            std::iota(ids.begin(), ids.end(), 0);
+            std::partial_sort(ids.begin(), ids.begin() + kTopk, ids.end(), [&](PID a, PID b) {
+                return scores[a] < scores[b];
+            });
+            std::unordered_set<PID> truth(ids.begin(), ids.begin() + kTopk);
+
+            std::vector<PID> results(kTopk);
+            index.search(query, kTopk, kNumClusters, results.data(), true);
+            for (PID id : results) {
+                hits += truth.count(id);
+            }
+        }
+        return static_cast<float>(hits) / static_cast<float>(kNumQuery * kTopk);
+    }
+
+    static constexpr size_t kNum = 4000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kRank = 4;
+    static constexpr size_t kNumClusters = 8;
+    static constexpr size_t kTotalBits = 3;
+    static constexpr size_t kNumQuery = 50;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+};
+
+// rotations fitted to the subspace of each cluster quantize the clusters more accurately
+TEST_F(LocalRotationTest, ReducesReconstructionError) {
+    auto global = Build(METRIC_L2, 0);
+    EXPECT_EQ(global->local_rotations(), 0);
+    float global_err = ReconstructError(*global);
+
+    auto local = Build(METRIC_L2, kNumClusters);
+    EXPECT_EQ(local->local_rotations(), kNumClusters);
+    EXPECT_LT(ReconstructError(*local), global_err * 0.8f);
+
+    // groups of clusters share a rotation
+    auto grouped = Build(METRIC_L2, 2);
+    EXPECT_EQ(grouped->local_rotations(), 2);
+    EXPECT_LT(ReconstructError(*grouped), global_err);
+}
+
+TEST_F(LocalRotationTest, KeepsRecall) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        float global_recall = Recall(*Build(metric, 0), metric);
+        for (size_t num_groups : {2UL, kNumClusters}) {
+            EXPECT_GE(Recall(*Build(metric, num_groups), metric), global_recall - 0.02f)
+                << num_groups << " groups";
+        }
+    }
+}
+
+// distances of score_ids are estimated in the same local spaces as those of search
+TEST_F(LocalRotationTest, ScoreIdsMatchesSearch) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        auto index = Build(metric, 3);
+        for (size_t q = 0; q < 10; ++q) {
+            const float* query = &data_[(q * 101 % kNum) * kDim];
+            std::vector<PID> ids(kTopk);
+            std::vector<float> search_dists(kTopk);
+            index->search(query, kTopk, kNumClusters, ids.data(), search_dists.data(), true);
+            std::vector<float> dists(kTopk);
+            index->score_ids(query, ids.data(), kTopk, dists.data());
+            for (size_t i = 0; i < kTopk; ++i) {
+                EXPECT_NEAR(dists[i], search_dists[i], 1e-3f * (1 + std::abs(search_dists[i])));
+            }
+        }
+    }
+}
+
+TEST_F(LocalRotationTest, SaveLoadKeepsRotations) {
+    auto index = Build(METRIC_L2, 3);
+    std::string path = "/tmp/rabitq_local_rotation_test_" + std::to_string(::getpid());
+    const char* filename = path.c_str();
+    index->save(filename);
+    ivf::IVF loaded;
+    loaded.load(filename);
+    std::remove(filename);
+    EXPECT_EQ(loaded.local_rotations(), 3);
+
+    std::vector<float> expected_vec(kDim);
+    std::vector<float> vec(kDim);
+    for (size_t q = 0; q < kNumQuery; ++q) {
+        const float* query = &data_[(q * 37 % kNum) * kDim];
+        std::vector<PID> expected(kTopk);
+        std::vector<PID> results(kTopk);
+        index->search(query, kTopk, kNumClusters, expected.data(), true);
+        loaded.search(query, kTopk, kNumClusters, results.data(), true);
+        EXPECT_EQ(results, expected);
+
+        index->reconstruct(static_cast<PID>(q), expected_vec.data());
+        loaded.reconstruct(static_cast<PID>(q), vec.data());
+        EXPECT_EQ(vec, expected_vec);
+    }
+
+    // a file without local rotations resets them
+    auto global = Build(METRIC_L2, 0);
+    global->save(filename);
+    loaded.load(filename);
+    std::remove(filename);
+    EXPECT_EQ(loaded.local_rotations(), 0);
+    EXPECT_FLOAT_EQ(ReconstructError(loaded), ReconstructError(*global));
+}
+
+// the section of local rotations ends the file, a group id out of range is rejected
+TEST_F(LocalRotationTest, LoadRejectsInvalidGroup) {
+    auto index = Build(METRIC_L2, 3);
+    std::string path = "/tmp/rabitq_local_rotation_test_" + std::to_string(::getpid());
+    index->save(path.c_str());
+
+    size_t rotation_bytes = sizeof(float) * index->padded_dim() * index->padded_dim();
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(0, std::ios::end);
+    auto end = static_cast<size_t>(file.tellp());
+    uint32_t group = 3;
+    file.seekp(static_cast<long>(end - (3 * rotation_bytes) - (sizeof(uint32_t) * kNumClusters)));
+    file.write(reinterpret_cast<const char*>(&group), sizeof(uint32_t));
+    file.close();
+
+    ivf::IVF loaded;
+    EXPECT_THROW(loaded.load(path.c_str()), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+TEST_F(LocalRotationTest, ChunkedBuildThrows) {
+    ivf::IVF chunked(kNum, kDim, kNumClusters, kTotalBits, METRIC_L2, RotatorType::FhtKacRotator);
+    chunked.set_local_rotations(2);
+    ChunkFunc all_rows = [this, done = false](const float*& rows) mutable {
+        rows = data_.data();
+        size_t num = done ? 0 : kNum;
+        done = true;
+        return num;
+    };
+    EXPECT_THROW(
+        chunked.construct_chunked(centroids_.data(), cluster_ids_.data(), all_rows, false, 1),
+        std::invalid_argument
+    );
+}
@@ -0,0 +1,283 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/tenant/multi_tenant_ivf.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class MultiTenantTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        for (size_t t = 0; t < kNumTenants; ++t) {
+            auto clustered =
+                TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 61 + t);
+            std::vector<PID> ids(kNum);
+            for (size_t i = 0; i < kNum; ++i) {
+                // disjoint ids of tenants
+                ids[i] = static_cast<PID>((t * 100000) + i);
+            }
+            data_.push_back(std::move(clustered.data));
+            centroids_.push_back(std::move(clustered.centroids));
+            cluster_ids_.push_back(std::move(clustered.cluster_ids));
+            ids_.push_back(std::move(ids));
+        }
+        directory_ = "/tmp/rabitq_multi_tenant_test_" + std::to_string(::getpid());
+        std::filesystem::remove_all(directory_);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(directory_); }
+
+    void CreateAll(tenant::MultiTenantIVF& index) const {
+        for (size_t t = 0; t < kNumTenants; ++t) {
+            index.create_tenant(
+                t,
+                kNum,
+                data_[t].data(),
+                ids_[t].data(),
+                kNumClusters,
+                centroids_[t].data(),
+                cluster_ids_[t].data(),
+                2
+            );
+        }
+    }
+
+    // ids of exact nearest neighbors of a query in a tenant
+    std::vector<PID> Groundtruth(size_t t, const float* query) const {
+        std::vector<std::pair<float, PID>> dists(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            dists[i] = {euclidean_sqr(query, &data_[t][i * kDim], kDim), ids_[t][i]};
+        }
+        std::partial_sort(dists.begin(), dists.begin() + kTopk, dists.end());
+        std::vector<PID> gt(kTopk);
+        for (size_t i = 0; i < kTopk; ++i) {
+            gt[i] = dists[i].second;
+        }
+        return gt;
+    }
+
+    static constexpr size_t kNum = 600;
+    static constexpr size_t kDim = 96;
+    static constexpr size_t kNumClusters = 5;
+    static constexpr size_t kNumTenants = 3;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<std::vector<float>> data_;
+    std::vector<std::vector<float>> centroids_;
+    std::vector<std::vector<PID>> cluster_ids_;
+    std::vector<std::vector<PID>> ids_;
+    std::string directory_;
+};
+
+TEST_F(MultiTenantTest, SearchInTenant) {
+    tenant::MultiTenantIVF index(directory_, kDim, 7);
+    CreateAll(index);
+    EXPECT_EQ(index.tenants().size(), kNumTenants);
+    EXPECT_GT(index.memory_usage(), 0U);
+
+    for (size_t t = 0; t < kNumTenants; ++t) {
+        EXPECT_EQ(index.tenant_size(t), kNum);
+        size_t correct = 0;
+        for (size_t q = 0; q < 10; ++q) {
+            std::vector<float> query(data_[t].begin() + (q * 37 * kDim), data_[t].end());
+            for (float& val : query) {
+                val += 0.01F;
+            }
+            std::vector<PID> results(kTopk);
+            index.search(t, query.data(), kTopk, kNumClusters, results.data());
+            auto gt = Groundtruth(t, query.data());
+            for (PID id : results) {
+                // results are in the tenant
+                EXPECT_EQ(id / 100000, t);
+                correct += std::count(gt.begin(), gt.end(), id);
+            }
+        }
+        EXPECT_GE(correct, 10 * kTopk * 9 / 10);
+    }
+
+    std::vector<PID> results(kTopk);
+    EXPECT_THROW(
+        index.search(kNumTenants, data_[0].data(), kTopk, 1, results.data()), std::out_of_range
+    );
+    EXPECT_THROW(CreateAll(index), std::invalid_argument);
+}
+
+TEST_F(MultiTenantTest, AddAndRemove) {
+    tenant::MultiTenantIVF index(directory_, kDim, 5, METRIC_L2);
+    // the first half is built, the second half is added
+    size_t half = kNum / 2;
+    index.create_tenant(
+        0,
+        half,
+        data_[0].data(),
+        ids_[0].data(),
+        kNumClusters,
+        centroids_[0].data(),
+        cluster_ids_[0].data()
+    );
+    index.add(0, kNum - half, &data_[0][half * kDim], &ids_[0][half]);
+    EXPECT_EQ(index.tenant_size(0), kNum);
+    EXPECT_THROW(index.add(0, 1, data_[0].data(), ids_[0].data()), std::invalid_argument);
+    // ids repeated in a batch are rejected before any vector is added
+    std::vector<PID> repeated = {900000, 900001, 900000};
+    EXPECT_THROW(index.add(0, 3, data_[0].data(), repeated.data()), std::invalid_argument);
+    EXPECT_EQ(index.tenant_size(0), kNum);
+
+    // every vector is its own nearest neighbor
+    std::vector<PID> results(1);
+    std::vector<float> dists(1);
+    for (size_t i = 0; i < kNum; i += 7) {
+        index.search(0, &data_[0][i * kDim], 1, kNumClusters, results.data(), dists.data());
+        EXPECT_EQ(results[0], ids_[0][i]);
+    }
+
+    // removed vectors are not found, the others are
+    for (size_t i = 0; i < kNum; i += 2) {
+        EXPECT_TRUE(index.remove(0, ids_[0][i]));
+    }
+    EXPECT_FALSE(index.remove(0, ids_[0][0]));
+    EXPECT_EQ(index.tenant_size(0), kNum / 2);
+    for (size_t i = 0; i < kNum; i += 5) {
+        index.search(0, &data_[0][i * kDim], 1, kNumClusters, results.data());
+        if (i % 2 == 0) {
+            EXPECT_NE(results[0], ids_[0][i]);
+        } else {
+            EXPECT_EQ(results[0], ids_[0][i]);
+        }
+    }
+
+    // an emptied tenant finds nothing
+    for (size_t i = 1; i < kNum; i += 2) {
+        EXPECT_TRUE(index.remove(0, ids_[0][i]));
+    }
+    std::vector<PID> all(kTopk);
+    index.search(0, data_[0].data(), kTopk, kNumClusters, all.data());
+    EXPECT_TRUE(std::all_of(all.begin(), all.end(), [](PID id) { return id == kPidMax; }));
+}
+
+// tenants are saved and evicted over the budget, and give the same results after reload
+TEST_F(MultiTenantTest, EvictAndReload) {
+    constexpr size_t kBits = 4;
+    std::vector<std::vector<PID>> expected(kNumTenants, std::vector<PID>(kTopk));
+    std::vector<std::vector<float>> expected_dists(kNumTenants, std::vector<float>(kTopk));
+    size_t tenant_memory = 0;
+    {
+        tenant::MultiTenantIVF index(directory_, kDim, kBits, METRIC_IP);
+        CreateAll(index);
+        index.remove(0, ids_[0][3]);
+        for (size_t t = 0; t < kNumTenants; ++t) {
+            index.search(
+                t, data_[t].data(), kTopk, 3, expected[t].data(), expected_dists[t].data()
+            );
+        }
+        tenant_memory = index.tenant_memory(0);
+        index.flush();
+    }
+
+    // one tenant fits in the budget
+    tenant::MultiTenantIVF index(
+        directory_, kDim, kBits, METRIC_IP, tenant_memory + (tenant_memory / 2)
+    );
+    EXPECT_EQ(index.tenants().size(), kNumTenants);
+    EXPECT_EQ(index.memory_usage(), 0U);
+    for (size_t round = 0; round < 2; ++round) {
+        for (size_t t = 0; t < kNumTenants; ++t) {
+            std::vector<PID> results(kTopk);
+            std::vector<float> dists(kTopk);
+            index.search(t, data_[t].data(), kTopk, 3, results.data(), dists.data());
+            EXPECT_EQ(results, expected[t]);
+            EXPECT_EQ(dists, expected_dists[t]);
+            EXPECT_TRUE(index.is_resident(t));
+            EXPECT_LE(index.memory_usage(), index.memory_budget());
+        }
+    }
+    EXPECT_EQ(index.tenant_size(0), kNum - 1);
+
+    // changes are saved on eviction
+    index.add(1, 1, data_[0].data(), ids_[0].data());
+    index.evict(1);
+    EXPECT_FALSE(index.is_resident(1));
+    EXPECT_EQ(index.tenant_size(1), kNum + 1);
+
+    index.drop_tenant(2);
+    EXPECT_FALSE(index.has_tenant(2));
+    EXPECT_THROW(tenant::MultiTenantIVF(directory_, kDim, 5), std::invalid_argument);
+    // stray files which look like tenant files are ignored
+    for (const char* name :
+         {"tenant_.bin", "tenant_x.bin", "tenant_1a.bin", "tenant_99999999999999999999.bin"}) {
+        std::ofstream(directory_ + "/" + name) << "stray";
+    }
+    tenant::MultiTenantIVF reopened(directory_, kDim, kBits, METRIC_IP);
+    EXPECT_EQ(reopened.tenants(), std::vector<tenant::TenantId>({0, 1}));
+}
+
+// a tenant larger than the budget is kept until its call locks it, also when other
+// threads load tenants at the same time
+TEST_F(MultiTenantTest, TenantOverBudget) {
+    std::vector<std::vector<PID>> expected(kNumTenants, std::vector<PID>(kTopk));
+    {
+        tenant::MultiTenantIVF index(directory_, kDim, 5);
+        CreateAll(index);
+        for (size_t t = 0; t < kNumTenants; ++t) {
+            index.search(t, data_[t].data(), kTopk, 3, expected[t].data());
+        }
+        index.flush();
+    }
+
+    tenant::MultiTenantIVF index(directory_, kDim, 5, METRIC_L2, 1);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> mismatches{0};
+    for (size_t t = 0; t < kNumTenants; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<PID> results(kTopk);
+            for (size_t round = 0; round < 20; ++round) {
+                index.search(t, data_[t].data(), kTopk, 3, results.data());
+                mismatches += static_cast<size_t>(results != expected[t]);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(mismatches.load(), 0U);
+}
+
+// of a tenant created twice at the same time, one is kept and the other is released
+TEST_F(MultiTenantTest, ConcurrentCreate) {
+    tenant::MultiTenantIVF index(directory_, kDim, 5);
+    std::atomic<size_t> failures{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2; ++i) {
+        threads.emplace_back([&] {
+            try {
+                index.create_tenant(
+                    0,
+                    kNum,
+                    data_[0].data(),
+                    ids_[0].data(),
+                    kNumClusters,
+                    centroids_[0].data(),
+                    cluster_ids_[0].data()
+                );
+            } catch (const std::invalid_argument&) {
+                ++failures;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures.load(), 1U);
+    EXPECT_EQ(index.tenants(), std::vector<tenant::TenantId>({0}));
+    EXPECT_EQ(index.tenant_size(0), kNum);
+    // pages of the discarded build are released
+    EXPECT_EQ(index.memory_usage(), index.tenant_memory(0));
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class NormBucketTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // clusters around random centers, norms of vectors are log-uniform in [1, 10]
+        auto clustered = TestDataGenerator::GenerateBlobData(kNum, kDim, kNumClusters, 31, 37);
+        std::mt19937 gen(41);
+        std::uniform_real_distribution<float> log_norm(0.0f, std::log(10.0f));
+        for (size_t i = 0; i < kNum; ++i) {
+            float* vec = &clustered.data[i * kDim];
+            float scale = std::exp(log_norm(gen)) / std::sqrt(l2norm_sqr(vec, kDim));
+            for (size_t j = 0; j < kDim; ++j) {
+                vec[j] *= scale;
+            }
+        }
+        TestDataGenerator::ComputeMeanCentroids(clustered, kDim, kNumClusters);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+        auto query_vecs = TestDataGenerator::GenerateRandomVectors(kNumQuery, kDim, -1.0f, 1.0f, 43);
+        for (const auto& vec : query_vecs) {
+            queries_.insert(queries_.end(), vec.begin(), vec.end());
+        }
+    }
+
+    // recall of the top-k by inner product, all clusters are probed
+    float Recall(const ivf::IVF& index) const {
+        size_t hits = 0;
+        for (size_t q = 0; q < kNumQuery; ++q) {
+            const float* query = &queries_[q * kDim];
+            std::vector<PID> ids(kNum);
+            std::iota(ids.begin(), ids.end(), 0);
+            std::vector<float> ips(kNum);
+            for (size_t i = 0; i < kNum; ++i) {
+                ips[i] = dot_product<float>(query, &data_[i * kDim], kDim);
+            }
+            std::partial_sort(ids.begin(), ids.begin() + kTopk, ids.end(), [&](PID a, PID b) {
+                return ips[a] > ips[b];
+            });
+            std::unordered_set<PID> truth(ids.begin(), ids.begin() + kTopk);
+
+            std::vector<PID> results(kTopk);
+            index.search(query, kTopk, kNumClusters, results.data(), true);
+            for (PID id : results) {
+                hits += truth.count(id);
+            }
+        }
+        return static_cast<float>(hits) / static_cast<float>(kNumQuery * kTopk);
+    }
+
+    static constexpr size_t kNum = 4000;
+    static constexpr size_t kDim = 128;
+    static constexpr size_t kNumClusters = 4;
+    static constexpr size_t kNumQuery = 50;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+    std::vector<float> queries_;
+};
+
+// skipping buckets by their bounds keeps the recall of scanning whole clusters, the index
+// is rebuilt with the same rotator so that both quantize the data alike
+TEST_F(NormBucketTest, RecallMatchesWholeClusters) {
+    ivf::IVF index(kNum, kDim, kNumClusters, 5, METRIC_IP, RotatorType::FhtKacRotator);
+    index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+    float whole_recall = Recall(index);
+
+    for (size_t num_buckets : {2UL, 8UL, 1000UL}) {
+        index.set_norm_buckets(num_buckets);
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+        EXPECT_EQ(index.norm_buckets(), num_buckets);
+        EXPECT_GE(Recall(index), whole_recall - 0.02f) << num_buckets << " buckets";
+    }
+}
+
+TEST_F(NormBucketTest, SaveLoadKeepsBuckets) {
+    ivf::IVF index(kNum, kDim, kNumClusters, 5, METRIC_IP, RotatorType::FhtKacRotator);
+    index.set_norm_buckets(8);
+    index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+    std::string filename = "/tmp/rabitq_norm_bucket_test_" + std::to_string(::getpid());
+    index.save(filename.c_str());
+    ivf::IVF loaded;
+    loaded.load(filename.c_str());
+    std::remove(filename.c_str());
+    EXPECT_EQ(loaded.norm_buckets(), 8);
+
+    for (size_t q = 0; q < kNumQuery; ++q) {
+        const float* query = &queries_[q * kDim];
+        std::vector<PID> expected(kTopk);
+        std::vector<PID> results(kTopk);
+        index.search(query, kTopk, kNumClusters, expected.data(), true);
+        loaded.search(query, kTopk, kNumClusters, results.data(), true);
+        EXPECT_EQ(results, expected);
+    }
+
+    // a file without buckets resets the buckets of the loaded index
+    ivf::IVF whole(kNum, kDim, kNumClusters, 5, METRIC_IP, RotatorType::FhtKacRotator);
+    whole.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+    whole.save(filename.c_str());
+    loaded.load(filename.c_str());
+    std::remove(filename.c_str());
+    EXPECT_EQ(loaded.norm_buckets(), 1);
+    EXPECT_FLOAT_EQ(Recall(loaded), Recall(whole));
+}
+
+TEST_F(NormBucketTest, UnsupportedSettingsThrow) {
+    ivf::IVF l2(kNum, kDim, kNumClusters, 5, METRIC_L2, RotatorType::FhtKacRotator);
+    EXPECT_THROW(l2.set_norm_buckets(4), std::invalid_argument);
+    EXPECT_NO_THROW(l2.set_norm_buckets(1));
+
+    ivf::IVF chunked(kNum, kDim, kNumClusters, 5, METRIC_IP, RotatorType::FhtKacRotator);
+    chunked.set_norm_buckets(4);
+    ChunkFunc all_rows = [this, done = false](const float*& rows) mutable {
+        rows = data_.data();
+        size_t num = done ? 0 : kNum;
+        done = true;
+        return num;
+    };
+    EXPECT_THROW(
+        chunked.construct_chunked(centroids_.data(), cluster_ids_.data(), all_rows, false, 1),
+        std::invalid_argument
+    );
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/query.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ProgressiveRefineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto query_vecs =
+            TestDataGenerator::GenerateRandomVectors(kNumQueries, kDim, -1.0f, 1.0f, 53);
+        for (const auto& vec : query_vecs) {
+            queries_.insert(queries_.end(), vec.begin(), vec.end());
+        }
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 47);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+    }
+
+    // num of common ids, and the distances of common ids are the same up to rounding
+    static size_t Overlap(
+        const std::vector<std::pair<float, PID>>& first,
+        const std::vector<std::pair<float, PID>>& second
+    ) {
+        size_t common = 0;
+        for (const auto& [dist, id] : first) {
+            auto it = std::find_if(second.begin(), second.end(), [&](const auto& res) {
+                return res.second == id;
+            });
+            if (it != second.end()) {
+                EXPECT_NEAR(it->first, dist, 1e-3F * std::max(1.0F, std::abs(dist)));
+                ++common;
+            }
+        }
+        return common;
+    }
+
+    static constexpr size_t kNum = 2000;
+    static constexpr size_t kDim = 256;
+    static constexpr size_t kNumClusters = 8;
+    static constexpr size_t kNumQueries = 20;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> queries_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+};
+
+TEST_F(ProgressiveRefineTest, StagesCoverAllDims) {
+    RefineStages<float> stages(queries_.data(), kDim, 7, 3);
+    ASSERT_EQ(stages.num_stages(), 3U);
+    EXPECT_EQ(stages.end(0), 64U);
+    EXPECT_EQ(stages.end(1), 128U);
+    EXPECT_EQ(stages.end(2), kDim);
+    EXPECT_GT(stages.rest_error(0), stages.rest_error(1));
+    EXPECT_EQ(stages.rest_mid(2), 0.0F);
+    EXPECT_EQ(stages.rest_error(2), 0.0F);
+
+    // at most one stage per 64 dims
+    EXPECT_EQ(RefineStages<float>(queries_.data(), kDim, 7, 100).num_stages(), kDim / 64);
+    // 1-bit codes and codes in 2 planes
+    EXPECT_EQ(RefineStages<float>(queries_.data(), kDim, 0, 4).num_stages(), 1U);
+    EXPECT_EQ(RefineStages<float>(queries_.data(), kDim, 9, 4).num_stages(), 1U);
+}
+
+// dropped candidates are outside the top-k, thus results hardly change
+TEST_F(ProgressiveRefineTest, IVFKeepsResults) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        for (size_t bits : {7UL, 8UL, 9UL}) {
+            ivf::IVF index(
+                kNum, kDim, kNumClusters, bits, metric, RotatorType::FhtKacRotator
+            );
+            index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+            EXPECT_EQ(index.refine_stages(), 1U);
+
+            size_t common = 0;
+            for (size_t q = 0; q < kNumQueries; ++q) {
+                const float* query = &queries_[q * kDim];
+                std::vector<std::pair<float, PID>> results[2];
+                for (size_t num_stages : {1UL, 4UL}) {
+                    index.set_refine_stages(num_stages);
+                    std::vector<PID> ids(kTopk);
+                    std::vector<float> dists(kTopk);
+                    index.search(query, kTopk, 4, ids.data(), dists.data(), true);
+                    for (size_t i = 0; i < kTopk; ++i) {
+                        results[num_stages == 1 ? 0 : 1].emplace_back(dists[i], ids[i]);
+                    }
+                }
+                common += Overlap(results[0], results[1]);
+            }
+            EXPECT_GE(common, kNumQueries * kTopk * 95 / 100);
+        }
+    }
+}
+
+// the seed fixes the rotator and the graph (built by 1 thread), thus the overlap is the
+// same in every run
+TEST_F(ProgressiveRefineTest, HNSWKeepsResults) {
+    hnsw::HierarchicalNSW index(kNum, kDim, 8, 16, 100, 11);
+    index.construct(
+        kNumClusters, centroids_.data(), kNum, data_.data(), cluster_ids_.data(), 1, false
+    );
+
+    auto full = index.search(queries_.data(), kNumQueries, kTopk, 100, 1);
+    index.set_refine_stages(4);
+    auto progressive = index.search(queries_.data(), kNumQueries, kTopk, 100, 1);
+
+    size_t common = 0;
+    for (size_t q = 0; q < kNumQueries; ++q) {
+        common += Overlap(full[q], progressive[q]);
+    }
+    EXPECT_GE(common, kNumQueries * kTopk * 95 / 100);
+}
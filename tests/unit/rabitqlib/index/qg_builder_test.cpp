@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class QGBuilderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto data_vecs = TestDataGenerator::GenerateRandomVectors(kNum, kDim, -1.0f, 1.0f, 31);
+        for (const auto& vec : data_vecs) {
+            data_.insert(data_.end(), vec.begin(), vec.end());
+        }
+    }
+
+    // recall@10 of the first num_queries vectors of data
+    static float Recall(
+        symqg::QuantizedGraph<float>& index,
+        const std::vector<float>& data,
+        size_t ef,
+        size_t num_queries
+    ) {
+        size_t num = data.size() / kDim;
+        index.set_ef(ef);
+        size_t correct = 0;
+        for (size_t q = 0; q < num_queries; ++q) {
+            const float* query = &data[q * kDim];
+            std::vector<float> dists(num);
+            for (size_t i = 0; i < num; ++i) {
+                dists[i] = euclidean_sqr(query, &data[i * kDim], kDim);
+            }
+            std::vector<PID> truth(num);
+            std::iota(truth.begin(), truth.end(), 0);
+            auto end = truth.begin() + kTopk;
+            std::partial_sort(truth.begin(), end, truth.end(), [&](PID a, PID b) {
+                return dists[a] < dists[b];
+            });
+
+            std::vector<PID> results(kTopk);
+            index.search(query, kTopk, results.data());
+            for (PID id : results) {
+                correct += static_cast<size_t>(std::find(truth.begin(), end, id) != end);
+            }
+        }
+        return static_cast<float>(correct) / static_cast<float>(num_queries * kTopk);
+    }
+
+    static constexpr size_t kNum = 2000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kTopk = 10;
+    static constexpr size_t kNumQueries = 50;
+
+    std::vector<float> data_;
+};
+
+TEST_F(QGBuilderTest, SinglePassBuild) {
+    symqg::QuantizedGraph<float> index(kNum, kDim, 32);
+    symqg::QGBuilder builder(index, 100, data_.data(), 2);
+    builder.build_vamana();
+
+    EXPECT_FALSE(builder.check_dup());
+    EXPECT_FLOAT_EQ(builder.avg_degree(), 32.0F);
+    EXPECT_GE(Recall(index, data_, 100, kNumQueries), 0.9F);
+}
+
+// a kNN-like initial graph reaches the recall of 3 iterations from a random graph in 1
+// iteration. Clustered data, more vertices and a small search pool make the recall depend
+// on the graph rather than on quantization errors.
+TEST_F(QGBuilderTest, InitialGraph) {
+    constexpr size_t kNumBlob = 5000;
+    constexpr size_t kEf = 20;
+    auto blobs = TestDataGenerator::GenerateBlobData(kNumBlob, kDim, 50, 5, 7);
+    auto recall = [&](symqg::QGInitType init_type, size_t num_iter) {
+        symqg::QuantizedGraph<float> index(kNumBlob, kDim, 32);
+        symqg::QGBuilder builder(index, 100, blobs.data.data(), 2, init_type);
+        builder.build(num_iter);
+        EXPECT_FALSE(builder.check_dup());
+        EXPECT_FLOAT_EQ(builder.avg_degree(), 32.0F);
+        return Recall(index, blobs.data, kEf, 200);
+    };
+
+    float random_recall = recall(symqg::QGInitType::Random, 3);
+    for (auto init_type : {symqg::QGInitType::NNDescent, symqg::QGInitType::Cluster}) {
+        EXPECT_GE(recall(init_type, 1), random_recall - 0.03F)
+            << "init type " << static_cast<int>(init_type);
+    }
+}
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "test_data.hpp"
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ReconstructTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 13);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+        residual_sqr_ = clustered.residual_sqr;
+    }
+
+    // squared reconstruction error of all vectors, relative to the squared residuals
+    float RelativeError(const ivf::IVF& index) const {
+        std::vector<PID> ids(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            ids[i] = static_cast<PID>(i);
+        }
+        std::vector<float> vecs(kNum * kDim);
+        index.reconstruct_batch(ids.data(), kNum, vecs.data(), 2);
+
+        float error = 0;
+        for (size_t i = 0; i < kNum; ++i) {
+            error += euclidean_sqr(&vecs[i * kDim], &data_[i * kDim], kDim);
+        }
+        return error / residual_sqr_;
+    }
+
+    static constexpr size_t kNum = 500;
+    static constexpr size_t kDim = 100;
+    static constexpr size_t kNumClusters = 4;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+    float residual_sqr_ = 0;
+};
+
+// The error decreases with total_bits, roughly by 4x for each extra bit
+TEST_F(ReconstructTest, ErrorDecreasesWithBits) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        float last_error = std::numeric_limits<float>::max();
+        for (size_t total_bits = 1; total_bits <= 9; ++total_bits) {
+            ivf::IVF index(
+                kNum, kDim, kNumClusters, total_bits, metric, RotatorType::FhtKacRotator
+            );
+            index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+            float error = RelativeError(index);
+            EXPECT_LT(error, last_error) << total_bits << " bits";
+            if (total_bits == 1) {
+                EXPECT_LT(error, 0.5f);
+            } else {
+                EXPECT_LT(error, last_error * 0.5f) << total_bits << " bits";
+            }
+            last_error = error;
+        }
+        EXPECT_LT(last_error, 1e-3f);
+    }
+}
+
+// Total bits beyond 9 keep the ex-codes as uint16, and the errors keep decreasing
+TEST_F(ReconstructTest, HighBitsErrorDecreases) {
+    std::vector<float> query(kDim);
+    for (size_t j = 0; j < kDim; ++j) {
+        query[j] = (data_[j] + data_[((kNum - 1) * kDim) + j]) / 2;
+    }
+
+    float last_error = std::numeric_limits<float>::max();
+    float dist_error = 0;
+    for (size_t total_bits = 9; total_bits <= 16; ++total_bits) {
+        ivf::IVF index(
+            kNum, kDim, kNumClusters, total_bits, METRIC_L2, RotatorType::FhtKacRotator
+        );
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+        float error = RelativeError(index);
+        EXPECT_LT(error, last_error * 0.5f) << total_bits << " bits";
+        last_error = error;
+
+        // relative errors of the estimated distances of nearest neighbors
+        std::vector<PID> ids(10);
+        std::vector<float> dists(10);
+        index.search(
+            query.data(), ids.size(), kNumClusters, ids.data(), dists.data(), true
+        );
+        dist_error = 0;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            float truth = euclidean_sqr(query.data(), &data_[ids[i] * kDim], kDim);
+            dist_error = std::max(dist_error, std::abs(dists[i] - truth) / truth);
+        }
+        EXPECT_LT(dist_error, 5e-3f) << total_bits << " bits";
+    }
+    EXPECT_LT(last_error, 1e-6f);
+    EXPECT_LT(dist_error, 1e-4f);
+}
+
+TEST_F(ReconstructTest, SingleMatchesBatch) {
+    ivf::IVF index(kNum, kDim, kNumClusters, 4, METRIC_L2, RotatorType::MatrixRotator);
+    index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), true, 1);
+
+    std::vector<PID> ids = {3, 499, 0, 250, 3};
+    std::vector<float> batch(ids.size() * kDim);
+    index.reconstruct_batch(ids.data(), ids.size(), batch.data());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        std::vector<float> vec(kDim);
+        index.reconstruct(ids[i], vec.data());
+        for (size_t j = 0; j < kDim; ++j) {
+            EXPECT_FLOAT_EQ(vec[j], batch[(i * kDim) + j]);
+        }
+    }
+
+    std::vector<float> vec(kDim);
+    EXPECT_THROW(index.reconstruct(static_cast<PID>(kNum), vec.data()), std::out_of_range);
+}
+
+// The rotation learned from residuals reduces the error, and it is saved with the index
+TEST_F(ReconstructTest, LearnedRotator) {
+    ivf::IVF random(kNum, kDim, kNumClusters, 4, METRIC_L2, RotatorType::MatrixRotator);
+    random.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+    ivf::IVF learned(kNum, kDim, kNumClusters, 4, METRIC_L2, RotatorType::LearnedRotator);
+    learned.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+    EXPECT_LT(RelativeError(learned), RelativeError(random) * 0.95f);
+
+    std::string path = "/tmp/rabitq_reconstruct_test_" + std::to_string(::getpid());
+    learned.save(path.c_str());
+    ivf::IVF loaded;
+    loaded.load(path.c_str());
+    std::remove(path.c_str());
+    EXPECT_EQ(loaded.rotator_type(), RotatorType::LearnedRotator);
+
+    std::vector<float> vec(kDim);
+    std::vector<float> loaded_vec(kDim);
+    learned.reconstruct(kNum - 1, vec.data());
+    loaded.reconstruct(kNum - 1, loaded_vec.data());
+    EXPECT_EQ(loaded_vec, vec);
+}
+
+// Rotators of fewer rounds and SORF are saved with their rounds
+TEST_F(ReconstructTest, RotatorRounds) {
+    for (auto [type, rounds] : {std::pair{RotatorType::FhtKacRotator, size_t{2}},
+                                std::pair{RotatorType::SorfRotator, size_t{0}},
+                                std::pair{RotatorType::SorfRotator, size_t{1}}}) {
+        ivf::IVF index(kNum, kDim, kNumClusters, 4, METRIC_L2, type);
+        index.set_rotator_rounds(rounds);
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+        EXPECT_LT(RelativeError(index), 0.05f);
+
+        std::string path = "/tmp/rabitq_reconstruct_test_" + std::to_string(::getpid());
+        index.save(path.c_str());
+        ivf::IVF loaded;
+        loaded.load(path.c_str());
+        std::remove(path.c_str());
+        EXPECT_EQ(loaded.rotator_type(), type);
+
+        std::vector<float> vec(kDim);
+        std::vector<float> loaded_vec(kDim);
+        index.reconstruct(kNum - 1, vec.data());
+        loaded.reconstruct(kNum - 1, loaded_vec.data());
+        EXPECT_EQ(loaded_vec, vec);
+    }
+
+    ivf::IVF matrix(kNum, kDim, kNumClusters, 4, METRIC_L2, RotatorType::MatrixRotator);
+    EXPECT_THROW(matrix.set_rotator_rounds(2), std::invalid_argument);
+}
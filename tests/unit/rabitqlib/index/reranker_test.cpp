@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/reranker.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class RerankerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto data_vecs = TestDataGenerator::GenerateRandomVectors(kNum, kDim, -1.0f, 1.0f, 29);
+        for (const auto& vec : data_vecs) {
+            data_.insert(data_.end(), vec.begin(), vec.end());
+        }
+    }
+
+    FetchFunc MemoryFetch(size_t& num_calls) const {
+        return [this, &num_calls](const PID* ids, size_t num, float* vecs) {
+            ++num_calls;
+            for (size_t i = 0; i < num; ++i) {
+                const float* vec = &data_[static_cast<size_t>(ids[i]) * kDim];
+                std::copy_n(vec, kDim, vecs + (i * kDim));
+            }
+        };
+    }
+
+    // ids of the k nearest candidates by exact distances
+    std::vector<PID> ExactTopk(const float* query, const std::vector<PID>& ids, size_t k) const {
+        std::vector<PID> res = ids;
+        auto dist = [&](PID id) {
+            return euclidean_sqr(query, &data_[static_cast<size_t>(id) * kDim], kDim);
+        };
+        std::sort(res.begin(), res.end(), [&](PID a, PID b) { return dist(a) < dist(b); });
+        res.resize(std::min(k, res.size()));
+        return res;
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+
+    std::vector<float> data_;
+};
+
+// bounds which always cover the exact distances, thus the top-k must be exact
+TEST_F(RerankerTest, CertifiedTopk) {
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> noise(0.0F, 1.0F);
+    const float* query = data_.data();
+
+    constexpr size_t kNumCand = 200;
+    constexpr size_t kTopk = 10;
+    std::vector<PID> ids(kNumCand);
+    std::iota(ids.begin(), ids.end(), 100);
+    std::vector<DistBound> bounds(kNumCand);
+    for (size_t i = 0; i < kNumCand; ++i) {
+        float truth = euclidean_sqr(query, &data_[ids[i] * kDim], kDim);
+        float est = truth + noise(gen) - 0.5F;
+        bounds[i] = {est, est - 0.6F, est + 0.6F, false};
+    }
+
+    size_t num_calls = 0;
+    RerankConfig config;
+    config.batch_size = 4;
+    Reranker reranker(kDim, METRIC_L2, MemoryFetch(num_calls), config);
+    std::vector<PID> results(kTopk);
+    std::vector<DistBound> result_bounds(kTopk);
+    auto stats = reranker.rerank(
+        query, ids.data(), bounds.data(), kNumCand, kTopk, results.data(), result_bounds.data()
+    );
+
+    // the set is certified, while unfetched results are ranked by estimations
+    auto truth = ExactTopk(query, ids, kTopk);
+    std::sort(truth.begin(), truth.end());
+    std::vector<PID> sorted_results = results;
+    std::sort(sorted_results.begin(), sorted_results.end());
+    EXPECT_EQ(sorted_results, truth);
+    EXPECT_EQ(stats.num_candidates, kNumCand);
+    EXPECT_EQ(stats.num_fetched + stats.num_saved, kNumCand);
+    EXPECT_EQ(stats.num_batches, num_calls);
+    EXPECT_GT(stats.num_saved, kNumCand / 2);
+    for (size_t i = 0; i + 1 < kTopk; ++i) {
+        if (result_bounds[i].exact && result_bounds[i + 1].exact) {
+            EXPECT_LE(result_bounds[i].est_dist, result_bounds[i + 1].est_dist);
+        }
+    }
+
+    // tight bounds need no fetch, fewer candidates than k are returned as they are
+    for (size_t i = 0; i < kNumCand; ++i) {
+        bounds[i].low_dist = bounds[i].up_dist = bounds[i].est_dist;
+    }
+    stats = reranker.rerank(query, ids.data(), bounds.data(), kNumCand, kTopk, results.data());
+    EXPECT_EQ(stats.num_fetched, 0U);
+    stats = reranker.rerank(query, ids.data(), bounds.data(), 5, kTopk, results.data());
+    EXPECT_EQ(stats.num_saved, 5U);
+}
+
+// async fetches by pread from a .fvecs file, candidates from IVF
+TEST_F(RerankerTest, AsyncPreadFetch) {
+    std::string path = "/tmp/rabitq_reranker_test_" + std::to_string(::getpid()) + ".fvecs";
+    {
+        std::ofstream output(path, std::ios::binary);
+        int dim = kDim;
+        for (size_t i = 0; i < kNum; ++i) {
+            output.write(reinterpret_cast<const char*>(&dim), sizeof(int));
+            output.write(
+                reinterpret_cast<const char*>(&data_[i * kDim]), kDim * sizeof(float)
+            );
+        }
+    }
+
+    constexpr size_t kNumClusters = 8;
+    std::vector<float> centroids(data_.begin(), data_.begin() + (kNumClusters * kDim));
+    std::vector<PID> cluster_ids(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        cluster_ids[i] = static_cast<PID>(i % kNumClusters);
+    }
+    ivf::IVF index(kNum, kDim, kNumClusters, 4, METRIC_L2, RotatorType::FhtKacRotator);
+    index.construct(data_.data(), centroids.data(), cluster_ids.data(), false, 1);
+
+    auto fetcher = PreadFetcher::fvecs(path, kDim);
+    Reranker reranker(
+        kDim,
+        METRIC_L2,
+        AsyncFetchFunc([&fetcher](const PID* ids, size_t num, float* vecs) {
+            return std::async(std::launch::async, [&fetcher, ids, num, vecs] {
+                fetcher(ids, num, vecs);
+            });
+        })
+    );
+
+    constexpr size_t kNumCand = 100;
+    constexpr size_t kTopk = 10;
+    size_t correct = 0;
+    size_t saved = 0;
+    for (size_t q = 0; q < 10; ++q) {
+        const float* query = &data_[(kNum - 1 - q) * kDim];
+        std::vector<PID> ids(kNumCand);
+        std::vector<DistBound> bounds(kNumCand);
+        index.search_with_bounds(query, kNumCand, kNumClusters, ids.data(), bounds.data());
+
+        std::vector<PID> results(kTopk);
+        auto stats = reranker.rerank(
+            query, ids.data(), bounds.data(), kNumCand, kTopk, results.data()
+        );
+        saved += stats.num_saved;
+        auto truth = ExactTopk(query, ids, kTopk);
+        for (PID id : results) {
+            correct += static_cast<size_t>(
+                std::find(truth.begin(), truth.end(), id) != truth.end()
+            );
+        }
+    }
+    std::remove(path.c_str());
+
+    EXPECT_GE(correct, 10 * kTopk * 9 / 10);
+    EXPECT_GT(saved, 10 * kNumCand / 2);
+    EXPECT_THROW(PreadFetcher::fvecs(path, kDim), std::runtime_error);
+}
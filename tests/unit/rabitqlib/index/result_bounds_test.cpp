@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ResultBoundsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 23);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+    }
+
+    float Truth(const float* query, PID id, MetricType metric) const {
+        const float* vec = &data_[static_cast<size_t>(id) * kDim];
+        return metric == METRIC_L2 ? euclidean_sqr(query, vec, kDim)
+                                   : dot_product_dis(query, vec, kDim);
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kNumClusters = 8;
+    static constexpr size_t kTopk = 10;
+    static constexpr size_t kNumQueries = 10;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+};
+
+TEST_F(ResultBoundsTest, IVFBoundsCoverTruth) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        ivf::IVF index(kNum, kDim, kNumClusters, 4, metric, RotatorType::FhtKacRotator);
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+        size_t covered = 0;
+        size_t one_bit_covered = 0;
+        float width = 0;
+        float one_bit_width = 0;
+        for (size_t q = 0; q < kNumQueries; ++q) {
+            const float* query = &data_[(kNum - 1 - q) * kDim];
+            std::vector<PID> ids(kTopk);
+            std::vector<float> dists(kTopk);
+            index.search(query, kTopk, kNumClusters, ids.data(), dists.data(), true);
+
+            std::vector<PID> bound_ids(kTopk);
+            std::vector<DistBound> bounds(kTopk);
+            index.search_with_bounds(query, kTopk, kNumClusters, bound_ids.data(), bounds.data());
+            EXPECT_EQ(bound_ids, ids);
+
+            std::vector<DistBound> one_bit(kTopk);
+            std::vector<DistBound> exact(kTopk);
+            index.score_ids(query, ids.data(), kTopk, one_bit.data(), SCORE_ONE_BIT);
+            index.score_ids(query, ids.data(), kTopk, exact.data(), SCORE_EXACT, data_.data());
+
+            for (size_t i = 0; i < kTopk; ++i) {
+                float truth = Truth(query, ids[i], metric);
+                EXPECT_FLOAT_EQ(bounds[i].est_dist, dists[i]);
+                EXPECT_LE(bounds[i].low_dist, bounds[i].est_dist);
+                EXPECT_GE(bounds[i].up_dist, bounds[i].est_dist);
+                EXPECT_FALSE(bounds[i].exact);
+                covered += static_cast<size_t>(
+                    bounds[i].low_dist <= truth && truth <= bounds[i].up_dist
+                );
+                one_bit_covered += static_cast<size_t>(
+                    one_bit[i].low_dist <= truth && truth <= one_bit[i].up_dist
+                );
+                width += bounds[i].up_dist - bounds[i].low_dist;
+                one_bit_width += one_bit[i].up_dist - one_bit[i].low_dist;
+
+                EXPECT_TRUE(exact[i].exact);
+                EXPECT_FLOAT_EQ(exact[i].est_dist, truth);
+                EXPECT_FLOAT_EQ(exact[i].low_dist, truth);
+                EXPECT_FLOAT_EQ(exact[i].up_dist, truth);
+            }
+        }
+        // bounds hold with high probability, full-bits bounds are much tighter
+        EXPECT_GE(covered, kNumQueries * kTopk * 9 / 10);
+        EXPECT_GE(one_bit_covered, kNumQueries * kTopk * 9 / 10);
+        EXPECT_LT(width * 4, one_bit_width);
+    }
+}
+
+TEST_F(ResultBoundsTest, HNSWBoundsCoverTruth) {
+    hnsw::HierarchicalNSW index(kNum, kDim, 4, 16, 100);
+    index.construct(
+        kNumClusters, centroids_.data(), kNum, data_.data(), cluster_ids_.data(), 1, false
+    );
+
+    // queries are not centroids, whose estimations are exact
+    const float* queries = &data_[(kNum - kNumQueries) * kDim];
+    auto results = index.search(queries, kNumQueries, kTopk, 100, 1);
+    auto bounded = index.search_with_bounds(queries, kNumQueries, kTopk, 100, 1);
+    ASSERT_EQ(bounded.size(), kNumQueries);
+    size_t covered = 0;
+    size_t total = 0;
+    for (size_t q = 0; q < kNumQueries; ++q) {
+        // nearest first, as IVF and QG
+        EXPECT_TRUE(std::is_sorted(results[q].begin(), results[q].end()));
+        ASSERT_EQ(bounded[q].size(), results[q].size());
+        for (size_t i = 0; i < results[q].size(); ++i) {
+            const auto& [bound, label] = bounded[q][i];
+            EXPECT_EQ(label, results[q][i].second);
+            EXPECT_FLOAT_EQ(bound.est_dist, results[q][i].first);
+            EXPECT_LE(bound.low_dist, bound.est_dist);
+            EXPECT_GE(bound.up_dist, bound.est_dist);
+            EXPECT_FALSE(bound.exact);
+            float truth = Truth(queries + (q * kDim), label, METRIC_L2);
+            covered += static_cast<size_t>(bound.low_dist <= truth && truth <= bound.up_dist);
+            ++total;
+        }
+    }
+    EXPECT_GE(covered, total * 9 / 10);
+}
+
+TEST_F(ResultBoundsTest, QGResultsAreExact) {
+    symqg::QuantizedGraph<float> index(kNum, kDim, 32);
+    symqg::QGBuilder builder(index, 64, data_.data(), 1);
+    builder.build(3);
+    index.set_ef(50);
+
+    const float* query = &data_[7 * kDim];
+    std::vector<PID> ids(kTopk);
+    std::vector<DistBound> bounds(kTopk);
+    index.search_with_bounds(query, kTopk, ids.data(), bounds.data());
+    for (size_t i = 0; i < kTopk; ++i) {
+        float truth = Truth(query, ids[i], METRIC_L2);
+        EXPECT_TRUE(bounds[i].exact);
+        EXPECT_FLOAT_EQ(bounds[i].est_dist, truth);
+        EXPECT_FLOAT_EQ(bounds[i].low_dist, truth);
+        EXPECT_FLOAT_EQ(bounds[i].up_dist, truth);
+    }
+}
+
+// a vector on its centroid has a zero residual, its bounds are finite and tight
+TEST_F(ResultBoundsTest, VectorOnCentroidHasFiniteBounds) {
+    for (size_t i = 0; i < kNumClusters; ++i) {
+        std::copy_n(&centroids_[i * kDim], kDim, &data_[i * kDim]);
+        cluster_ids_[i] = static_cast<PID>(i);
+    }
+    std::vector<PID> ids(kNumClusters);
+    for (size_t i = 0; i < kNumClusters; ++i) {
+        ids[i] = static_cast<PID>(i);
+    }
+
+    for (size_t total_bits : {1, 4}) {
+        for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+            ivf::IVF index(
+                kNum, kDim, kNumClusters, total_bits, metric, RotatorType::FhtKacRotator
+            );
+            index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+            for (size_t q = 0; q < kNumQueries; ++q) {
+                const float* query = &data_[(kNum - 1 - q) * kDim];
+                for (ScoreMode mode : {SCORE_ONE_BIT, SCORE_FULL_BITS}) {
+                    std::vector<DistBound> bounds(kNumClusters);
+                    index.score_ids(query, ids.data(), kNumClusters, bounds.data(), mode);
+                    for (size_t i = 0; i < kNumClusters; ++i) {
+                        EXPECT_TRUE(std::isfinite(bounds[i].low_dist));
+                        EXPECT_TRUE(std::isfinite(bounds[i].up_dist));
+                        EXPECT_FLOAT_EQ(bounds[i].low_dist, bounds[i].est_dist);
+                        EXPECT_FLOAT_EQ(bounds[i].up_dist, bounds[i].est_dist);
+                    }
+                }
+
+                std::vector<PID> result_ids(kTopk);
+                std::vector<DistBound> result_bounds(kTopk);
+                index.search_with_bounds(
+                    query, kTopk, kNumClusters, result_ids.data(), result_bounds.data()
+                );
+                for (const auto& bound : result_bounds) {
+                    EXPECT_FALSE(std::isnan(bound.low_dist));
+                    EXPECT_FALSE(std::isnan(bound.up_dist));
+                }
+            }
+        }
+    }
+}
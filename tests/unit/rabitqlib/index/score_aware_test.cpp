@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/quantization/rabitq.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ScoreAwareTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // clusters around random centers, thus data vectors are far from their residuals
+        auto clustered = TestDataGenerator::GenerateBlobData(kNum, kDim, kNumClusters, 19, 23);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+        auto query_vecs = TestDataGenerator::GenerateRandomVectors(kNumQuery, kDim, -1.0f, 1.0f, 29);
+        for (const auto& vec : query_vecs) {
+            queries_.insert(queries_.end(), vec.begin(), vec.end());
+        }
+    }
+
+    // true top-k of a query by inner product
+    std::vector<PID> TopK(const float* query) const {
+        std::vector<PID> ids(kNum);
+        std::iota(ids.begin(), ids.end(), 0);
+        std::vector<float> ips(kNum);
+        for (size_t i = 0; i < kNum; ++i) {
+            ips[i] = dot_product<float>(query, &data_[i * kDim], kDim);
+        }
+        std::partial_sort(ids.begin(), ids.begin() + kTopk, ids.end(), [&](PID a, PID b) {
+            return ips[a] > ips[b];
+        });
+        ids.resize(kTopk);
+        return ids;
+    }
+
+    // squared errors of estimated distances of the true top-k, summed over queries
+    template <typename Index>
+    float TopSqrError(const Index& index) const {
+        float error = 0;
+        for (size_t q = 0; q < kNumQuery; ++q) {
+            const float* query = &queries_[q * kDim];
+            std::vector<PID> ids = TopK(query);
+            std::vector<float> est(kTopk);
+            std::vector<float> exact(kTopk);
+            index.score_ids(query, ids.data(), kTopk, est.data());
+            index.score_ids(query, ids.data(), kTopk, exact.data(), SCORE_EXACT, data_.data());
+            for (size_t i = 0; i < kTopk; ++i) {
+                error += (est[i] - exact[i]) * (est[i] - exact[i]);
+            }
+        }
+        return error;
+    }
+
+    static constexpr size_t kNum = 2000;
+    static constexpr size_t kDim = 128;
+    static constexpr size_t kNumClusters = 4;
+    static constexpr size_t kNumQuery = 50;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+    std::vector<float> queries_;
+};
+
+// Score-aware ex codes reduce the errors of the largest inner products, also with the
+// const rescaling factor of faster quantization
+TEST_F(ScoreAwareTest, IVFTopErrorsDecrease) {
+    for (bool faster : {false, true}) {
+        ivf::IVF plain(kNum, kDim, kNumClusters, 3, METRIC_IP, RotatorType::FhtKacRotator);
+        plain.construct(data_.data(), centroids_.data(), cluster_ids_.data(), faster, 1);
+
+        ivf::IVF aware(kNum, kDim, kNumClusters, 3, METRIC_IP, RotatorType::FhtKacRotator);
+        aware.set_score_aware(quant::anisotropic_eta(kDim, 0.2));
+        aware.construct(data_.data(), centroids_.data(), cluster_ids_.data(), faster, 1);
+
+        EXPECT_LT(TopSqrError(aware), TopSqrError(plain) * 0.8F) << "faster " << faster;
+    }
+}
+
+TEST_F(ScoreAwareTest, HNSWTopErrorsDecrease) {
+    hnsw::HierarchicalNSW plain(kNum, kDim, 3, 16, 100, 100, METRIC_IP);
+    plain.construct(
+        kNumClusters, centroids_.data(), kNum, data_.data(), cluster_ids_.data(), 1, false
+    );
+
+    hnsw::HierarchicalNSW aware(kNum, kDim, 3, 16, 100, 100, METRIC_IP);
+    aware.set_score_aware(quant::anisotropic_eta(kDim, 0.2));
+    aware.construct(
+        kNumClusters, centroids_.data(), kNum, data_.data(), cluster_ids_.data(), 1, false
+    );
+
+    EXPECT_LT(TopSqrError(aware), TopSqrError(plain) * 0.8F);
+}
+
+// eta only changes the ex codes of METRIC_IP
+TEST_F(ScoreAwareTest, L2CodesUnchanged) {
+    constexpr size_t kExBits = 4;
+    size_t bin_bytes = BinDataMap<float>::data_bytes(kDim);
+    size_t ex_bytes = ExDataMap<float>::data_bytes(kDim, kExBits);
+    quant::RabitqConfig aware_config;
+    aware_config.eta = quant::anisotropic_eta(kDim, 0.2);
+
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        std::vector<char> bin_data(bin_bytes);
+        std::vector<char> plain_ex(ex_bytes);
+        std::vector<char> aware_ex(ex_bytes);
+        quant::quantize_split_single(
+            data_.data(), centroids_.data(), kDim, kExBits, bin_data.data(),
+            plain_ex.data(), metric
+        );
+        quant::quantize_split_single(
+            data_.data(), centroids_.data(), kDim, kExBits, bin_data.data(),
+            aware_ex.data(), metric, aware_config
+        );
+        EXPECT_EQ(plain_ex == aware_ex, metric == METRIC_L2);
+    }
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/hnsw/hnsw.hpp"
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/index/symqg/qg.hpp"
+#include "rabitqlib/index/symqg/qg_builder.hpp"
+#include "test_data.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ScoreIdsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto clustered = TestDataGenerator::GenerateClusteredData(kNum, kDim, kNumClusters, 11);
+        data_ = std::move(clustered.data);
+        centroids_ = std::move(clustered.centroids);
+        cluster_ids_ = std::move(clustered.cluster_ids);
+    }
+
+    static constexpr size_t kNum = 1000;
+    static constexpr size_t kDim = 64;
+    static constexpr size_t kNumClusters = 8;
+    static constexpr size_t kTopk = 10;
+
+    std::vector<float> data_;
+    std::vector<float> centroids_;
+    std::vector<PID> cluster_ids_;
+};
+
+TEST_F(ScoreIdsTest, IVFMatchesSearch) {
+    for (MetricType metric : {METRIC_L2, METRIC_IP}) {
+        ivf::IVF index(kNum, kDim, kNumClusters, 5, metric, RotatorType::FhtKacRotator);
+        index.construct(data_.data(), centroids_.data(), cluster_ids_.data(), false, 1);
+
+        float full_err = 0;
+        float one_bit_err = 0;
+        for (size_t q = 0; q < 10; ++q) {
+            const float* query = &data_[(kNum - 1 - q) * kDim];
+            std::vector<PID> ids(kTopk);
+            std::vector<float> search_dists(kTopk);
+            index.search(query, kTopk, kNumClusters, ids.data(), search_dists.data(), true);
+
+            // full-bits scores equal the distances of search
+            std::vector<float> dists(kTopk);
+            index.score_ids(query, ids.data(), kTopk, dists.data());
+            for (size_t i = 0; i < kTopk; ++i) {
+                EXPECT_NEAR(dists[i], search_dists[i], 1e-3F * (1 + std::abs(dists[i])));
+            }
+
+            // exact scores, full-bits estimations are more accurate than 1-bit ones
+            std::vector<float> exact(kTopk);
+            std::vector<float> one_bit(kTopk);
+            index.score_ids(query, ids.data(), kTopk, exact.data(), SCORE_EXACT, data_.data());
+            index.score_ids(query, ids.data(), kTopk, one_bit.data(), SCORE_ONE_BIT);
+            for (size_t i = 0; i < kTopk; ++i) {
+                const float* vec = &data_[static_cast<size_t>(ids[i]) * kDim];
+                float truth = metric == METRIC_L2 ? euclidean_sqr(query, vec, kDim)
+                                                  : dot_product_dis(query, vec, kDim);
+                EXPECT_FLOAT_EQ(exact[i], truth);
+                full_err += std::abs(dists[i] - truth);
+                one_bit_err += std::abs(one_bit[i] - truth);
+            }
+        }
+        EXPECT_LT(full_err, one_bit_err);
+
+        PID bad_id = kNum;
+        float dist;
+        EXPECT_THROW(index.score_ids(data_.data(), &bad_id, 1, &dist), std::out_of_range);
+        EXPECT_THROW(
+            index.score_ids(data_.data(), cluster_ids_.data(), 1, &dist, SCORE_EXACT),
+            std::invalid_argument
+        );
+    }
+}
+
+TEST_F(ScoreIdsTest, HNSWMatchesSearch) {
+    hnsw::HierarchicalNSW index(kNum, kDim, 5, 16, 100);
+    index.construct(
+        kNumClusters, centroids_.data(), kNum, data_.data(), cluster_ids_.data(), 1, false
+    );
+
+    auto results = index.search(data_.data(), 5, kTopk, 100, 1);
+    for (size_t q = 0; q < 5; ++q) {
+        const float* query = &data_[q * kDim];
+        std::vector<PID> ids;
+        for (const auto& [dist, label] : results[q]) {
+            ids.push_back(label);
+        }
+        std::vector<float> dists(ids.size());
+        std::vector<float> exact(ids.size());
+        index.score_ids(query, ids.data(), ids.size(), dists.data());
+        index.score_ids(query, ids.data(), ids.size(), exact.data(), SCORE_EXACT, data_.data());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const float* vec = &data_[static_cast<size_t>(ids[i]) * kDim];
+            EXPECT_FLOAT_EQ(exact[i], euclidean_sqr(query, vec, kDim));
+            EXPECT_NEAR(dists[i], exact[i], 0.2F * exact[i]);
+        }
+    }
+
+    PID bad_id = kNum + 1;
+    float dist;
+    EXPECT_THROW(index.score_ids(data_.data(), &bad_id, 1, &dist), std::out_of_range);
+}
+
+TEST_F(ScoreIdsTest, QGOneBitAndExact) {
+    symqg::QuantizedGraph<float> index(kNum, kDim, 32);
+    symqg::QGBuilder builder(index, 64, data_.data(), 1);
+    builder.build(3);
+
+    std::vector<PID> ids = {0, 5, 17, 123, 999, 500, 501, 502};
+    const float* query = &data_[42 * kDim];
+    std::vector<float> exact(ids.size());
+    std::vector<float> one_bit(ids.size());
+    index.score_ids(query, ids.data(), ids.size(), exact.data(), SCORE_EXACT);
+    index.score_ids(query, ids.data(), ids.size(), one_bit.data(), SCORE_ONE_BIT);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        float truth = euclidean_sqr(query, &data_[static_cast<size_t>(ids[i]) * kDim], kDim);
+        EXPECT_FLOAT_EQ(exact[i], truth);
+        EXPECT_NEAR(one_bit[i], truth, 0.5F * (1 + truth));
+    }
+
+    PID bad_id = kNum;
+    float dist;
+    EXPECT_THROW(index.score_ids(query, &bad_id, 1, &dist), std::out_of_range);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include "rabitqlib/server/micro_batcher.hpp"
+#include "rabitqlib/server/query_client.hpp"
+#include "rabitqlib/server/query_server.hpp"
+#include "rabitqlib/utils/latency_histogram.hpp"
+#include "rabitqlib/utils/space.hpp"
+#include "test_data.hpp"
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class QueryServerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto data_vecs = TestDataGenerator::GenerateRandomVectors(kNum, kDim, -1.0f, 1.0f, 19);
+        for (const auto& vec : data_vecs) {
+            data_.insert(data_.end(), vec.begin(), vec.end());
+        }
+        socket_path_ = "/tmp/rabitq_server_test_" + std::to_string(::getpid()) + ".sock";
+    }
+
+    // exact top-k by brute force, thread-safe
+    server::BatchSearchFunc BruteForce() const {
+        return [this](const float* queries, size_t num, size_t k, PID* ids, float* dists) {
+            for (size_t q = 0; q < num; ++q) {
+                std::vector<float> all(kNum);
+                for (size_t i = 0; i < kNum; ++i) {
+                    all[i] = euclidean_sqr(queries + (q * kDim), &data_[i * kDim], kDim);
+                }
+                std::vector<PID> order(kNum);
+                std::iota(order.begin(), order.end(), 0);
+                size_t num_res = std::min(k, kNum);
+                std::partial_sort(
+                    order.begin(),
+                    order.begin() + num_res,
+                    order.end(),
+                    [&](PID a, PID b) { return all[a] < all[b]; }
+                );
+                for (size_t j = 0; j < num_res; ++j) {
+                    ids[(q * k) + j] = order[j];
+                    dists[(q * k) + j] = all[order[j]];
+                }
+            }
+        };
+    }
+
+    static constexpr size_t kNum = 300;
+    static constexpr size_t kDim = 16;
+
+    std::vector<float> data_;
+    std::string socket_path_;
+};
+
+TEST(LatencyHistogramTest, Percentiles) {
+    LatencyHistogram hist;
+    EXPECT_EQ(hist.percentile(50), 0U);
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        hist.record(i);
+    }
+    EXPECT_EQ(hist.count(), 1000U);
+    EXPECT_EQ(hist.max(), 1000U);
+    EXPECT_DOUBLE_EQ(hist.mean(), 500.5);
+    // relative error of buckets is below 1/16
+    for (double p : {1.0, 50.0, 90.0, 99.0}) {
+        auto expected = static_cast<double>(p * 10);
+        EXPECT_GE(static_cast<double>(hist.percentile(p)), expected);
+        EXPECT_LE(static_cast<double>(hist.percentile(p)), expected * (1 + (1.0 / 16)));
+    }
+    EXPECT_EQ(hist.percentile(100), 1000U);
+
+    LatencyHistogram other;
+    other.record(5000);
+    hist.merge(other);
+    EXPECT_EQ(hist.count(), 1001U);
+    EXPECT_EQ(hist.max(), 5000U);
+}
+
+// concurrent queries are merged into one batch within max_wait
+TEST_F(QueryServerTest, MicroBatcherMergesQueries) {
+    server::BatcherConfig config;
+    config.num_workers = 1;
+    config.max_batch = 8;
+    config.max_wait = std::chrono::seconds(10);
+    server::MicroBatcher batcher(kDim, BruteForce(), config);
+
+    std::vector<std::future<server::QueryResult>> futures;
+    for (size_t i = 0; i < 8; ++i) {
+        futures.push_back(batcher.submit(&data_[i * kDim], 3));
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        auto result = futures[i].get();
+        ASSERT_EQ(result.ids.size(), 3U);
+        EXPECT_EQ(result.ids[0], static_cast<PID>(i));
+        EXPECT_FLOAT_EQ(result.dists[0], 0);
+    }
+    EXPECT_EQ(batcher.batch_sizes().count(), 1U);
+    EXPECT_EQ(batcher.batch_sizes().max(), 8U);
+}
+
+TEST_F(QueryServerTest, ConcurrentClients) {
+    server::ServerConfig config;
+    config.batcher.num_workers = 2;
+    config.batcher.max_batch = 4;
+    config.batcher.max_wait = std::chrono::microseconds(500);
+    config.max_k = 100;
+    server::QueryServer server(socket_path_, kDim, BruteForce(), config);
+    server.start();
+
+    constexpr size_t kNumClients = 4;
+    constexpr size_t kQueriesPerClient = 25;
+    constexpr size_t kTopk = 5;
+    std::vector<std::vector<PID>> results(kNumClients * kQueriesPerClient);
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < kNumClients; ++c) {
+        clients.emplace_back([&, c] {
+            server::QueryClient client(socket_path_);
+            for (size_t i = 0; i < kQueriesPerClient; ++i) {
+                size_t q = (c * kQueriesPerClient) + i;
+                results[q].resize(kTopk);
+                size_t num = client.search(&data_[q * kDim], kDim, kTopk, results[q].data());
+                results[q].resize(num);
+            }
+            EXPECT_EQ(client.latency().count(), kQueriesPerClient);
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    // every query finds itself first, and results equal the brute-force ones
+    auto search = BruteForce();
+    for (size_t q = 0; q < results.size(); ++q) {
+        ASSERT_EQ(results[q].size(), kTopk);
+        std::vector<PID> ids(kTopk);
+        std::vector<float> dists(kTopk);
+        search(&data_[q * kDim], 1, kTopk, ids.data(), dists.data());
+        EXPECT_EQ(results[q], ids);
+        EXPECT_EQ(results[q][0], static_cast<PID>(q));
+    }
+    EXPECT_EQ(server.latency().count(), results.size());
+    EXPECT_EQ(server.batcher().queue_latency().count(), results.size());
+
+    // fewer vectors than k
+    server::QueryClient client(socket_path_);
+    std::vector<PID> ids(100);
+    std::vector<float> dists(100);
+    EXPECT_EQ(client.search(data_.data(), kDim, 100, ids.data(), dists.data()), 100U);
+    EXPECT_THROW(client.search(data_.data(), kDim, 101, ids.data()), std::invalid_argument);
+    // the connection is kept after a rejected k
+    EXPECT_EQ(client.search(data_.data(), kDim, 1, ids.data()), 1U);
+    EXPECT_THROW(client.search(data_.data(), kDim - 1, 1, ids.data()), std::invalid_argument);
+
+    server.stop();
+    EXPECT_THROW(server::QueryClient{socket_path_}, std::runtime_error);
+}
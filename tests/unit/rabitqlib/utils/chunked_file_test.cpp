@@ -0,0 +1,281 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/index/ivf/ivf.hpp"
+#include "rabitqlib/utils/chunked_file.hpp"
+#include "rabitqlib/utils/compress.hpp"
+#include "rabitqlib/utils/io.hpp"
+#include "test_data.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace rabitqlib;
+using namespace rabitq_test;
+
+class ChunkedFileTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        std::remove(kFile);
+        std::remove(kRawFile);
+    }
+
+    static constexpr const char* kFile = "test_chunked.bin";
+    static constexpr const char* kRawFile = "test_chunked_raw.bin";
+
+    // bytes mixing compressible runs and random noise
+    static std::vector<char> MakeBytes(size_t num, unsigned int seed) {
+        std::mt19937 gen(seed);
+        std::vector<char> bytes(num);
+        for (size_t i = 0; i < num; ++i) {
+            bytes[i] = (i / 1000) % 2 == 0 ? static_cast<char>(i % 7)
+                                             : static_cast<char>(gen() & 0xFF);
+        }
+        return bytes;
+    }
+
+    static void WriteContainer(
+        const std::vector<char>& bytes, const ChunkedFileConfig& config, const IndexFileMeta& meta
+    ) {
+        ChunkedFileWriter writer(kFile, meta, config);
+        std::ostream output(&writer);
+        output.write(bytes.data(), static_cast<long>(bytes.size()));
+        writer.finish();
+    }
+
+    static std::vector<char> ReadContainer(size_t num_threads = 2) {
+        ChunkedFileReader reader(kFile, num_threads);
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        std::vector<char> bytes(reader.raw_size());
+        input.read(bytes.data(), static_cast<long>(bytes.size()));
+        EXPECT_TRUE(reader.exhausted());
+        return bytes;
+    }
+
+    static void FlipByte(const char* filename, size_t pos) {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekg(static_cast<long>(pos));
+        char byte;
+        file.read(&byte, 1);
+        byte = static_cast<char>(byte ^ 0x5A);
+        file.seekp(static_cast<long>(pos));
+        file.write(&byte, 1);
+    }
+};
+
+TEST_F(ChunkedFileTest, ChecksumKnownValues) {
+    EXPECT_EQ(compress::checksum64("", 0), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(compress::checksum64("abc", 3), 0x44BC2CF5AD770999ULL);
+
+    auto bytes = MakeBytes(4096, 1);
+    uint64_t hash = compress::checksum64(bytes.data(), bytes.size());
+    bytes[2048] ^= 1;
+    EXPECT_NE(hash, compress::checksum64(bytes.data(), bytes.size()));
+}
+
+TEST_F(ChunkedFileTest, CodecRoundTrip) {
+    std::vector<std::vector<char>> inputs = {
+        {}, {'a'}, std::vector<char>(100000, 'x'), MakeBytes(300000, 2), MakeBytes(17, 3)
+    };
+    for (const auto& input : inputs) {
+        std::vector<char> compressed(compress::lz_compress_bound(input.size()));
+        size_t size = compress::lz_compress(input.data(), input.size(), compressed.data());
+        ASSERT_LE(size, compressed.size());
+
+        std::vector<char> output(input.size());
+        ASSERT_TRUE(compress::lz_decompress(compressed.data(), size, output.data(), output.size()));
+        EXPECT_EQ(output, input);
+    }
+
+    // runs are compressed well
+    std::vector<char> zeros(1 << 20, 0);
+    std::vector<char> compressed(compress::lz_compress_bound(zeros.size()));
+    EXPECT_LT(compress::lz_compress(zeros.data(), zeros.size(), compressed.data()), 8192);
+}
+
+TEST_F(ChunkedFileTest, CodecRejectsCorruptInput) {
+    auto input = MakeBytes(50000, 4);
+    std::vector<char> compressed(compress::lz_compress_bound(input.size()));
+    size_t size = compress::lz_compress(input.data(), input.size(), compressed.data());
+    std::vector<char> output(input.size());
+
+    // truncated input or wrong output size never succeeds
+    EXPECT_FALSE(compress::lz_decompress(compressed.data(), size / 2, output.data(), output.size()));
+    EXPECT_FALSE(
+        compress::lz_decompress(compressed.data(), size, output.data(), output.size() - 1)
+    );
+
+    // random garbage stays within bounds
+    std::mt19937 gen(5);
+    for (int trial = 0; trial < 100; ++trial) {
+        std::vector<char> garbage(1000);
+        for (auto& c : garbage) {
+            c = static_cast<char>(gen() & 0xFF);
+        }
+        compress::lz_decompress(garbage.data(), garbage.size(), output.data(), output.size());
+    }
+}
+
+TEST_F(ChunkedFileTest, ContainerRoundTrip) {
+    auto bytes = MakeBytes(1000003, 6);
+    IndexFileMeta meta{IndexFileType::IVF, 128, METRIC_IP, 5, RotatorType::MatrixRotator};
+
+    for (bool compress : {true, false}) {
+        ChunkedFileConfig config;
+        config.chunk_size = 65536;
+        config.compress = compress;
+        config.num_threads = 3;
+        WriteContainer(bytes, config, meta);
+
+        ASSERT_TRUE(is_chunked_file(kFile));
+        ChunkedFileReader reader(kFile);
+        EXPECT_EQ(reader.raw_size(), bytes.size());
+        EXPECT_EQ(reader.num_chunks(), div_round_up(bytes.size(), config.chunk_size));
+        EXPECT_EQ(reader.meta().index_type, IndexFileType::IVF);
+        EXPECT_EQ(reader.meta().dim, 128);
+        EXPECT_EQ(reader.meta().metric_type, METRIC_IP);
+        EXPECT_EQ(reader.meta().total_bits, 5);
+        EXPECT_EQ(reader.meta().rotator_type, RotatorType::MatrixRotator);
+
+        for (size_t threads : {1, 4}) {
+            EXPECT_EQ(ReadContainer(threads), bytes);
+        }
+    }
+}
+
+TEST_F(ChunkedFileTest, CorruptionIsDetected) {
+    auto bytes = MakeBytes(500000, 7);
+    ChunkedFileConfig config;
+    config.chunk_size = 32768;
+    WriteContainer(bytes, config, {});
+
+    size_t file_size = get_filesize(kFile);
+    std::vector<char> original(file_size);
+    {
+        std::ifstream input(kFile, std::ios::binary);
+        input.read(original.data(), static_cast<long>(file_size));
+    }
+    auto restore = [&]() {
+        std::ofstream output(kFile, std::ios::binary);
+        output.write(original.data(), static_cast<long>(file_size));
+    };
+
+    // header, chunk payloads, chunk table and footer
+    for (size_t pos : {size_t{12}, size_t{100}, file_size / 2, file_size - 100, file_size - 20}) {
+        restore();
+        FlipByte(kFile, pos);
+        EXPECT_THROW(ReadContainer(), std::runtime_error) << "byte " << pos;
+    }
+
+    // truncated file
+    restore();
+    std::filesystem::resize_file(kFile, file_size - 1000);
+    EXPECT_THROW(ReadContainer(), std::runtime_error);
+
+    restore();
+    EXPECT_EQ(ReadContainer(), bytes);
+}
+
+TEST_F(ChunkedFileTest, IVFSaveCompressed) {
+    constexpr size_t kNum = 1000;
+    constexpr size_t kDim = 64;
+    constexpr size_t kNumClusters = 8;
+    constexpr size_t kTopk = 5;
+
+    auto data_vecs = TestDataGenerator::GenerateRandomVectors(kNum, kDim, -1.0f, 1.0f, 9);
+    std::vector<float> data;
+    for (const auto& vec : data_vecs) {
+        data.insert(data.end(), vec.begin(), vec.end());
+    }
+    std::vector<float> centroids(data.begin(), data.begin() + kNumClusters * kDim);
+    std::vector<PID> cluster_ids(kNum);
+    for (size_t i = 0; i < kNum; ++i) {
+        float best = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < kNumClusters; ++c) {
+            float dist = euclidean_sqr(&data[i * kDim], &centroids[c * kDim], kDim);
+            if (dist < best) {
+                best = dist;
+                cluster_ids[i] = static_cast<PID>(c);
+            }
+        }
+    }
+
+    ivf::IVF index(kNum, kDim, kNumClusters, 5, METRIC_L2, RotatorType::FhtKacRotator);
+    index.construct(data.data(), centroids.data(), cluster_ids.data(), false, 1);
+    index.save(kRawFile);
+    ChunkedFileConfig config;
+    config.chunk_size = 16384;
+    index.save_compressed(kFile, config);
+    EXPECT_FALSE(is_chunked_file(kRawFile));
+    EXPECT_TRUE(is_chunked_file(kFile));
+
+    ivf::IVF raw_index;
+    raw_index.load(kRawFile);
+    ivf::IVF chunked_index;
+    chunked_index.load(kFile, 2);
+    EXPECT_EQ(chunked_index.dimension(), kDim);
+    EXPECT_EQ(chunked_index.nbits(), 5);
+
+    for (size_t q = 0; q < 20; ++q) {
+        std::vector<PID> raw_res(kTopk);
+        std::vector<PID> chunked_res(kTopk);
+        raw_index.search(&data[q * kDim], kTopk, kNumClusters, raw_res.data(), false);
+        chunked_index.search(&data[q * kDim], kTopk, kNumClusters, chunked_res.data(), false);
+        EXPECT_EQ(raw_res, chunked_res);
+    }
+
+    // corrupt payload is reported instead of loading garbage
+    FlipByte(kFile, get_filesize(kFile) / 2);
+    ivf::IVF bad_index;
+    EXPECT_THROW(bad_index.load(kFile), std::runtime_error);
+}
+
+// the HNSW initializer of IVF is kept in the chunks, not in a .hnsw file beside them
+TEST_F(ChunkedFileTest, HNSWInitializerInChunks) {
+    constexpr size_t kDim = 64;
+    constexpr size_t kNumClusters = 300;
+    constexpr size_t kNprobe = 10;
+
+    auto centroid_vecs =
+        TestDataGenerator::GenerateRandomVectors(kNumClusters, kDim, -1.0f, 1.0f, 13);
+    std::vector<float> centroids;
+    for (const auto& vec : centroid_vecs) {
+        centroids.insert(centroids.end(), vec.begin(), vec.end());
+    }
+    ivf::HNSWInitializer initer(kDim, kNumClusters);
+    initer.add_vectors(centroids.data(), 1);
+    {
+        ChunkedFileWriter writer(kFile, IndexFileMeta{}, ChunkedFileConfig{});
+        std::ostream output(&writer);
+        initer.save(output, nullptr);
+        writer.finish();
+    }
+    EXPECT_FALSE(std::filesystem::exists(std::string(kFile) + ".hnsw"));
+
+    ivf::HNSWInitializer loaded(kDim, kNumClusters);
+    {
+        ChunkedFileReader reader(kFile);
+        std::istream input(&reader);
+        input.exceptions(std::ios::badbit);
+        loaded.load(input, nullptr);
+        EXPECT_TRUE(reader.exhausted());
+    }
+    for (PID c = 0; c < kNumClusters; ++c) {
+        EXPECT_EQ(std::memcmp(loaded.centroid(c), initer.centroid(c), sizeof(float) * kDim), 0);
+    }
+    std::vector<AnnCandidate<float>> expected(kNprobe);
+    std::vector<AnnCandidate<float>> results(kNprobe);
+    for (size_t q = 0; q < 10; ++q) {
+        initer.centroids_distances(&centroids[q * kDim], kNprobe, expected);
+        loaded.centroids_distances(&centroids[q * kDim], kNprobe, results);
+        for (size_t i = 0; i < kNprobe; ++i) {
+            EXPECT_EQ(results[i].id, expected[i].id);
+            EXPECT_EQ(results[i].distance, expected[i].distance);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/utils/page_arena.hpp"
+#include <cstring>
+#include <vector>
+
+using namespace rabitqlib;
+
+TEST(PageArenaTest, ReusePages) {
+    memory::PageArena arena(100, 4);
+    EXPECT_EQ(arena.page_bytes(), 128U);
+    char* first = arena.allocate();
+    std::memset(first, 7, arena.page_bytes());
+    arena.release(first);
+    // released pages are reused and zeroed
+    char* again = arena.allocate();
+    EXPECT_EQ(again, first);
+    EXPECT_EQ(again[0], 0);
+    EXPECT_EQ(arena.used_pages(), 1U);
+    arena.release(again);
+    EXPECT_EQ(arena.used_pages(), 0U);
+}
+
+// chunks whose pages are all released are unmapped, except for one spare chunk
+TEST(PageArenaTest, ReleaseChunks) {
+    constexpr size_t kPagesPerChunk = 8;
+    constexpr size_t kNumChunks = 5;
+    memory::PageArena arena(256, kPagesPerChunk);
+    size_t chunk_bytes = kPagesPerChunk * arena.page_bytes();
+
+    std::vector<char*> pages;
+    for (size_t i = 0; i < kPagesPerChunk * kNumChunks; ++i) {
+        pages.push_back(arena.allocate());
+    }
+    EXPECT_EQ(arena.reserved_bytes(), kNumChunks * chunk_bytes);
+
+    // one page kept in the first chunk
+    for (size_t i = 1; i < pages.size(); ++i) {
+        arena.release(pages[i]);
+    }
+    EXPECT_EQ(arena.used_pages(), 1U);
+    EXPECT_LE(arena.reserved_bytes(), 2 * chunk_bytes);
+
+    // new pages fill the chunks in use before new chunks are mapped
+    pages.resize(1);
+    for (size_t i = 1; i < kPagesPerChunk; ++i) {
+        pages.push_back(arena.allocate());
+    }
+    EXPECT_LE(arena.reserved_bytes(), 2 * chunk_bytes);
+    for (char* page : pages) {
+        arena.release(page);
+    }
+    EXPECT_EQ(arena.used_pages(), 0U);
+    EXPECT_EQ(arena.reserved_bytes(), chunk_bytes);
+}
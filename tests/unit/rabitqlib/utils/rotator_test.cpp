@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include "rabitqlib/quantization/rabitq.hpp"
 #include "rabitqlib/utils/rotator.hpp"
 #include "test_helpers.hpp"
 #include "test_data.hpp"
@@ -6,6 +7,7 @@
 #include <cmath>
 #include <fstream>
 #include <cstring>
+#include <sstream>
 
 using namespace rabitqlib;
 using namespace rabitq_test;
@@ -75,3 +77,149 @@ TEST(FlipSignTest, FlipWorks) {
         }
     }
 }
+
+// Inverse rotation maps a rotated vector back to the original one
+TEST_F(RotatorTest, InverseRotate) {
+    for (RotatorType type :
+         {RotatorType::FhtKacRotator,
+          RotatorType::MatrixRotator,
+          RotatorType::LearnedRotator,
+          RotatorType::SorfRotator}) {
+        // power of 2 and not
+        for (size_t cur_dim : {size_t{128}, size_t{100}}) {
+            auto vec = TestDataGenerator::GenerateRandomVector(cur_dim, -1.0f, 1.0f, 7);
+            Rotator<float>* rotator = choose_rotator<float>(cur_dim, type);
+
+            std::vector<float> rotated(rotator->size());
+            std::vector<float> restored(cur_dim);
+            rotator->rotate(vec.data(), rotated.data());
+            rotator->inverse_rotate(rotated.data(), restored.data());
+
+            for (size_t i = 0; i < cur_dim; ++i) {
+                EXPECT_NEAR(restored[i], vec[i], 1e-4f) << "dim " << cur_dim;
+            }
+            delete rotator;
+        }
+    }
+}
+
+// rotators of any rounds are orthogonal, and the rounds are restored by load()
+template <typename Fht>
+static void CheckRounds(size_t dim, size_t rounds, size_t padded_dim) {
+    auto vec = TestDataGenerator::GenerateRandomVector(dim, -1.0f, 1.0f, 11);
+    Fht rotator(dim, padded_dim, rounds);
+    std::vector<float> rotated(padded_dim);
+    std::vector<float> restored(dim);
+    rotator.rotate(vec.data(), rotated.data());
+    rotator.inverse_rotate(rotated.data(), restored.data());
+    EXPECT_NEAR(l2norm_sqr(rotated.data(), padded_dim), l2norm_sqr(vec.data(), dim), 1e-3F);
+    for (size_t i = 0; i < dim; ++i) {
+        EXPECT_NEAR(restored[i], vec[i], 1e-4F) << "rounds " << rounds;
+    }
+
+    std::stringstream stream;
+    rotator.save(stream);
+    EXPECT_EQ(stream.str().size(), rotator.dump_bytes());
+    Fht from_stream(dim, padded_dim);
+    from_stream.load(stream);
+    EXPECT_EQ(from_stream.rounds(), rounds);
+
+    std::vector<char> buffer(rotator.dump_bytes());
+    rotator.save(buffer.data());
+    Fht from_buffer(dim, padded_dim);
+    from_buffer.load(buffer.data());
+    EXPECT_EQ(from_buffer.rounds(), rounds);
+
+    for (const Fht* loaded : {&from_stream, &from_buffer}) {
+        std::vector<float> again(padded_dim);
+        loaded->rotate(vec.data(), again.data());
+        EXPECT_EQ(again, rotated) << "rounds " << rounds;
+    }
+}
+
+TEST_F(RotatorTest, RotationRounds) {
+    for (size_t cur_dim : {size_t{128}, size_t{100}}) {
+        for (size_t rounds : {1, 2, 3, 4, 8}) {
+            CheckRounds<rotator_impl::FhtKacRotator>(cur_dim, rounds, 128);
+            CheckRounds<rotator_impl::SorfRotator>(cur_dim, rounds, 128);
+        }
+    }
+    // FhtKacRotator over 64 + 128 dims, SorfRotator pads 150 to 256
+    CheckRounds<rotator_impl::FhtKacRotator>(150, 3, 192);
+    CheckRounds<rotator_impl::SorfRotator>(150, 2, 256);
+
+    // the default FhtKacRotator keeps the format without rounds
+    rotator_impl::FhtKacRotator rotator(dim, dim);
+    EXPECT_EQ(rotator.dump_bytes(), 4 * dim / 8);
+    Rotator<float>* sorf = choose_rotator<float>(150, RotatorType::SorfRotator);
+    EXPECT_EQ(sorf->size(), 256);
+    delete sorf;
+    EXPECT_EQ(index_padded_dim(1536, RotatorType::FhtKacRotator), 1536);
+    EXPECT_EQ(index_padded_dim(1536, RotatorType::SorfRotator), 2048);
+    EXPECT_EQ(index_padded_dim(20, RotatorType::SorfRotator), 64);
+
+    EXPECT_THROW(rotator_impl::FhtKacRotator(dim, dim, 0), std::invalid_argument);
+    EXPECT_THROW(rotator_impl::SorfRotator(dim, dim, 9), std::invalid_argument);
+    EXPECT_THROW(rotator_impl::SorfRotator(3000, 4096), std::invalid_argument);
+    EXPECT_THROW(choose_rotator<float>(3000, RotatorType::SorfRotator), std::invalid_argument);
+}
+
+// sum of squared reconstruction errors of vectors quantized after rotation
+static float ReconstructionError(
+    const Rotator<float>& rotator, const std::vector<float>& data, size_t dim, size_t bits
+) {
+    size_t num = data.size() / dim;
+    size_t padded_dim = rotator.size();
+    std::vector<float> rotated(num * padded_dim);
+    rotator.rotate_batch(data.data(), num, rotated.data());
+    float error = 0;
+    for (size_t i = 0; i < num; ++i) {
+        std::vector<uint8_t> code(padded_dim, 0);
+        std::vector<float> reconstructed(padded_dim);
+        float delta = 0;
+        float vl = 0;
+        quant::quantize_scalar(&rotated[i * padded_dim], padded_dim, bits, code.data(), delta, vl);
+        quant::reconstruct_vec(code.data(), delta, vl, padded_dim, reconstructed.data());
+        error += euclidean_sqr(&rotated[i * padded_dim], reconstructed.data(), padded_dim);
+    }
+    return error;
+}
+
+// the learned rotation reduces quantization errors of anisotropic data
+TEST_F(RotatorTest, LearnedRotator) {
+    constexpr size_t kNum = 2000;
+    auto vecs = TestDataGenerator::GenerateRandomVectors(kNum, dim, -1.0f, 1.0f, 17);
+    std::vector<float> data;
+    for (const auto& vec : vecs) {
+        for (size_t j = 0; j < dim; ++j) {
+            data.push_back(vec[j] * std::exp(-static_cast<float>(j) / 16.0F));
+        }
+    }
+
+    for (size_t bits : {size_t{1}, size_t{4}}) {
+        rotator_impl::LearnedRotator<float> rotator(dim, dim);
+        float random_error = ReconstructionError(rotator, data, dim, bits);
+        rotator.train(data.data(), kNum, quant::scalar_reconstructor<float>(dim, bits));
+        float learned_error = ReconstructionError(rotator, data, dim, bits);
+        EXPECT_LT(learned_error, random_error * 0.9F) << "bits " << bits;
+
+        // rotations preserve norms and batches are rotated as single vectors
+        std::vector<float> rotated(2 * dim);
+        rotator.rotate_batch(data.data(), 2, rotated.data());
+        std::vector<float> single(dim);
+        rotator.rotate(&data[dim], single.data());
+        for (size_t j = 0; j < dim; ++j) {
+            EXPECT_NEAR(single[j], rotated[dim + j], 1e-5F);
+        }
+        EXPECT_NEAR(
+            l2norm_sqr(rotated.data(), dim), l2norm_sqr(data.data(), dim), 1e-4F
+        );
+
+        std::stringstream stream;
+        rotator.save(stream);
+        rotator_impl::LearnedRotator<float> loaded(dim, dim);
+        loaded.load(stream);
+        loaded.rotate(&data[dim], rotated.data());
+        EXPECT_EQ(std::vector<float>(rotated.begin(), rotated.begin() + dim), single);
+    }
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "rabitqlib/utils/visited_pool.hpp"
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace rabitqlib;
+
+TEST(VisitedListPoolTest, ThreadLocalReuse) {
+    VisitedListPool pool(1, 10000);
+    HashBasedBooleanSet* first = pool.get_free_vislist();
+    first->set(7);
+    // nested lists of a thread come from the shared pool
+    HashBasedBooleanSet* nested = pool.get_free_vislist();
+    EXPECT_NE(first, nested);
+    EXPECT_FALSE(nested->get(7));
+    pool.release_vis_list(nested);
+    pool.release_vis_list(first);
+    EXPECT_EQ(pool.num_free(), 1U);
+
+    // the cached list is reused without the shared pool, and is cleared
+    HashBasedBooleanSet* again = pool.get_free_vislist();
+    EXPECT_EQ(again, first);
+    EXPECT_FALSE(again->get(7));
+    pool.release_vis_list(again);
+    EXPECT_EQ(pool.num_lists(), 2U);
+}
+
+TEST(VisitedListPoolTest, ThreadsReturnLists) {
+    VisitedListPool pool(0, 10000);
+    constexpr size_t kNumThreads = 8;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kNumThreads; ++t) {
+        threads.emplace_back([&pool, t] {
+            for (PID i = 0; i < 1000; ++i) {
+                HashBasedBooleanSet* vl = pool.get_free_vislist();
+                EXPECT_FALSE(vl->get(static_cast<PID>(t)));
+                vl->set(static_cast<PID>(t));
+                EXPECT_TRUE(vl->get(static_cast<PID>(t)));
+                pool.release_vis_list(vl);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // at most one list per thread, returned when the thread exits
+    EXPECT_GE(pool.num_lists(), 1U);
+    EXPECT_LE(pool.num_lists(), kNumThreads);
+    EXPECT_EQ(pool.num_free(), pool.num_lists());
+}
+
+TEST(VisitedListPoolTest, NewPoolAfterDestroy) {
+    for (size_t i = 0; i < 20; ++i) {
+        auto pool = std::make_unique<VisitedListPool>(1, 1000 * (i + 1));
+        HashBasedBooleanSet* vl = pool->get_free_vislist();
+        vl->set(1);
+        pool->release_vis_list(vl);
+        EXPECT_EQ(pool->num_lists(), 1U);
+    }
+}
+
+TEST(VisitedListPoolTest, FullCacheKeepsListsInUse) {
+    // more pools than a thread caches, with all lists in use at the same time
+    constexpr size_t kNumPools = 12;
+    std::vector<std::unique_ptr<VisitedListPool>> pools;
+    std::vector<HashBasedBooleanSet*> lists;
+    for (size_t i = 0; i < kNumPools; ++i) {
+        pools.push_back(std::make_unique<VisitedListPool>(0, 1000));
+        lists.push_back(pools.back()->get_free_vislist());
+        lists.back()->set(static_cast<PID>(i));
+    }
+    // no list in use is given back to its pool
+    for (size_t i = 0; i < kNumPools; ++i) {
+        EXPECT_EQ(pools[i]->num_free(), 0U);
+        EXPECT_TRUE(lists[i]->get(static_cast<PID>(i)));
+    }
+    // each list is released once
+    for (size_t i = 0; i < kNumPools; ++i) {
+        pools[i]->release_vis_list(lists[i]);
+        EXPECT_LE(pools[i]->num_free(), pools[i]->num_lists());
+        EXPECT_EQ(pools[i]->num_lists(), 1U);
+    }
+}
+
+TEST(VisitedListPoolTest, LazySizing) {
+    VisitedListPool pool(1, 1000);
+    EXPECT_EQ(pool.num_lists(), 1U);
+    HashBasedBooleanSet* vl = pool.get_free_vislist();
+    EXPECT_EQ(vl->table_size(), HashBasedBooleanSet::table_size_for(100));
+    vl->set(3);
+    pool.release_vis_list(vl);
+
+    // the cached list is resized on its next get
+    pool.set_max_elements(1000000);
+    HashBasedBooleanSet* again = pool.get_free_vislist();
+    EXPECT_EQ(again, vl);
+    EXPECT_EQ(again->table_size(), HashBasedBooleanSet::table_size_for(100000));
+    EXPECT_FALSE(again->get(3));
+    pool.release_vis_list(again);
+}